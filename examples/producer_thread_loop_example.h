@@ -4,6 +4,7 @@
 #define MQP_ENQUEUE_PRODUCER_H_
 
 #include <producer/base_producer.hpp>
+#include <producer/task_producer.hpp>
 
 namespace qm::example
 {
@@ -124,6 +125,28 @@ private:
      int loops_;
 };
 
+template< typename Key, typename Value >
+class SimpleLoopProducerTask : public TaskProducer< Key, Value >
+{
+public:
+     SimpleLoopProducerTask( Key id, int loops ) : TaskProducer< Key, Value >( id ), loops_( loops )
+     {};
+
+protected:
+     std::optional< Value > Next() override
+     {
+          if ( loops_-- <= 0 )
+          {
+               return std::nullopt;
+          }
+
+          return ++produce_counter_;
+     }
+
+private:
+     int loops_;
+};
+
 } // namespace qm::example
 
 #endif // MQP_ENQUEUE_PRODUCER_H_
\ No newline at end of file
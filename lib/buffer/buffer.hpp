@@ -0,0 +1,496 @@
+/// @brief Refcounted message buffers with pooled storage
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_BUFFER_H_
+#define MQP_BUFFER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+namespace qm
+{
+
+class BufferPool;
+
+/// @brief Byte buffer sharing refcounted storage block.
+/// Copies and slices point to the same block, block is returned to its pool with the last reference.
+/// Cheap to copy and move, so queues store Buffer values directly.
+class Buffer
+{
+public:
+     /// @brief Constructor of empty buffer
+     Buffer() = default;
+
+     /// @brief Copy shares storage
+     Buffer( const Buffer &other ) noexcept;
+
+     /// @brief Move takes storage
+     Buffer( Buffer &&other ) noexcept;
+
+     /// @brief Copy shares storage
+     Buffer &operator=( const Buffer &other ) noexcept;
+
+     /// @brief Move takes storage
+     Buffer &operator=( Buffer &&other ) noexcept;
+
+     /// @brief Destructor, releases storage reference
+     ~Buffer();
+
+     /// @brief Get bytes of buffer
+     /// @return Pointer to first byte, nullptr for empty buffer without storage
+     char *Data();
+
+     /// @brief Get bytes of buffer
+     /// @return Pointer to first byte, nullptr for empty buffer without storage
+     const char *Data() const;
+
+     /// @brief Get size of buffer
+     /// @return Size in bytes
+     std::size_t Size() const;
+
+     /// @brief Check is buffer empty
+     /// @return true/false
+     bool Empty() const;
+
+     /// @brief Get view of buffer bytes
+     /// @return String view
+     std::string_view View() const;
+
+     /// @brief Zero copy part of buffer sharing the same storage
+     /// @param offset Offset of first byte, clamped by size
+     /// @param size Maximal size of slice
+     /// @return Slice
+     Buffer Slice( std::size_t offset, std::size_t size = std::string_view::npos ) const;
+
+private:
+     friend class BufferPool;
+
+     struct Block;
+
+     Buffer( Block *block, std::size_t size );
+
+     void Release();
+
+private:
+     Block *block_ = nullptr;
+     std::size_t offset_ = 0;
+     std::size_t size_ = 0;
+};
+
+/// @brief Pool of buffer storage blocks with per-thread caches.
+/// Thread allocates from own cache, blocks released by other threads are returned to cache of
+/// thread that allocated them by one lock free push and taken back in batch when the cache is empty.
+/// In steady flow between producers and consumers no general purpose heap allocation is made.
+/// Requests bigger than block size are allocated from heap without pooling.
+/// @attention Pool must outlive all its buffers.
+/// Pool is created only by Create, as thread caches return to pool on thread exit through weak pointer.
+class BufferPool : public std::enable_shared_from_this< BufferPool >
+{
+     struct Token
+     {
+     };
+
+public:
+     /// @brief Create pool owned by shared pointer
+     /// @param block_size Capacity of pooled blocks in bytes
+     /// @return Pointer to pool
+     static std::shared_ptr< BufferPool > Create( std::size_t block_size = 4096 );
+
+     /// @brief Constructor, callable only by Create
+     /// @param block_size Capacity of pooled blocks in bytes
+     BufferPool( Token, std::size_t block_size );
+
+     /// @brief Destructor, frees cached blocks
+     ~BufferPool();
+
+     /// @brief Copying is forbidden
+     BufferPool( const BufferPool & ) = delete;
+
+     /// @brief Copying is forbidden
+     BufferPool &operator=( const BufferPool & ) = delete;
+
+     /// @brief Get process wide pool with default block size
+     /// @return Pool
+     static BufferPool &Default();
+
+     /// @brief Allocate buffer, bytes are not initialized
+     /// @param size Size of buffer
+     /// @return Buffer
+     /// @details Thread safe
+     Buffer Allocate( std::size_t size );
+
+     /// @brief Allocate buffer and copy bytes to it
+     /// @param data Bytes
+     /// @return Buffer
+     /// @details Thread safe
+     Buffer Copy( std::string_view data );
+
+     /// @brief Get capacity of pooled blocks
+     /// @return Size in bytes
+     std::size_t BlockSize() const;
+
+     /// @brief Count of blocks allocated from heap by pool
+     /// @return Count
+     /// @details Thread safe
+     std::size_t Blocks() const;
+
+private:
+     friend class Buffer;
+
+     struct Cache
+     {
+          Buffer::Block *local_ = nullptr;                 ///< owner thread only
+          std::atomic< Buffer::Block * > remote_{ nullptr };  ///< pushed by other threads
+          std::atomic< std::thread::id > owner_;
+     };
+
+     /// @brief Pool caches used by thread, released when thread exits
+     class ThreadCaches
+     {
+     public:
+          ~ThreadCaches();
+
+          Cache *Find( std::uint64_t pool_id ) const;
+
+          void Add( std::uint64_t pool_id, std::weak_ptr< BufferPool > pool, Cache *cache );
+
+     private:
+          struct Entry
+          {
+               std::uint64_t pool_id_;
+               std::weak_ptr< BufferPool > pool_;
+               Cache *cache_;
+          };
+
+          std::vector< Entry > entries_;
+     };
+
+     static std::uint64_t NextId();
+
+     Cache *LocalCache();
+
+     void ReleaseCache( Cache *cache );
+
+     static void Free( Buffer::Block *block );
+
+     static void FreeList( Buffer::Block *block );
+
+private:
+     const std::size_t block_size_;
+     const std::uint64_t id_;
+     std::atomic< std::size_t > blocks_;
+
+     std::mutex caches_mtx_;
+     std::vector< std::unique_ptr< Cache > > caches_;
+     std::vector< Cache * > idle_caches_;  ///< caches released by exited threads
+};
+
+/// @brief Storage block header, bytes follow it
+struct Buffer::Block
+{
+     std::atomic< std::uint32_t > refs_;
+     BufferPool::Cache *origin_;  ///< nullptr for unpooled blocks
+     std::size_t capacity_;
+     Block *next_;                ///< free list link
+
+     char *Bytes() { return reinterpret_cast< char * >( this + 1 ); }
+};
+
+/// @brief Value size of buffer includes its bytes
+template<>
+struct ValueSize< Buffer >
+{
+     std::size_t operator()( const Buffer &value ) const { return sizeof( Buffer ) + value.Size(); }
+};
+
+inline Buffer::Buffer( Block *block, std::size_t size ) : block_( block ), size_( size )
+{}
+
+inline Buffer::Buffer( const Buffer &other ) noexcept : block_( other.block_ ), offset_( other.offset_ ), size_( other.size_ )
+{
+     if ( block_ )
+     {
+          block_->refs_.fetch_add( 1, std::memory_order_relaxed );
+     }
+}
+
+inline Buffer::Buffer( Buffer &&other ) noexcept : block_( other.block_ ), offset_( other.offset_ ), size_( other.size_ )
+{
+     other.block_ = nullptr;
+     other.offset_ = 0;
+     other.size_ = 0;
+}
+
+inline Buffer &Buffer::operator=( const Buffer &other ) noexcept
+{
+     if ( this != &other )
+     {
+          Buffer copy( other );
+          *this = std::move( copy );
+     }
+
+     return *this;
+}
+
+inline Buffer &Buffer::operator=( Buffer &&other ) noexcept
+{
+     if ( this != &other )
+     {
+          Release();
+          std::swap( block_, other.block_ );
+          std::swap( offset_, other.offset_ );
+          std::swap( size_, other.size_ );
+     }
+
+     return *this;
+}
+
+inline Buffer::~Buffer()
+{
+     Release();
+}
+
+inline char *Buffer::Data()
+{
+     return block_ ? block_->Bytes() + offset_ : nullptr;
+}
+
+inline const char *Buffer::Data() const
+{
+     return block_ ? block_->Bytes() + offset_ : nullptr;
+}
+
+inline std::size_t Buffer::Size() const
+{
+     return size_;
+}
+
+inline bool Buffer::Empty() const
+{
+     return size_ == 0;
+}
+
+inline std::string_view Buffer::View() const
+{
+     return { Data(), size_ };
+}
+
+inline Buffer Buffer::Slice( std::size_t offset, std::size_t size ) const
+{
+     Buffer slice( *this );
+     slice.offset_ += std::min( offset, size_ );
+     slice.size_ = std::min( size, size_ - std::min( offset, size_ ));
+     return slice;
+}
+
+inline void Buffer::Release()
+{
+     if ( block_ && block_->refs_.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+     {
+          BufferPool::Free( block_ );
+     }
+
+     block_ = nullptr;
+     offset_ = 0;
+     size_ = 0;
+}
+
+inline std::shared_ptr< BufferPool > BufferPool::Create( std::size_t block_size )
+{
+     return std::make_shared< BufferPool >( Token(), block_size );
+}
+
+inline BufferPool::BufferPool( Token, std::size_t block_size ) : block_size_( block_size ),
+                                                                 id_( NextId() ),
+                                                                 blocks_( 0 )
+{}
+
+inline BufferPool::~BufferPool()
+{
+     for ( auto &cache : caches_ )
+     {
+          FreeList( cache->local_ );
+          FreeList( cache->remote_.load() );
+     }
+}
+
+inline BufferPool &BufferPool::Default()
+{
+     // never destroyed, buffers may be released by static destructors
+     static auto *pool = new std::shared_ptr< BufferPool >( Create() );
+     return **pool;
+}
+
+inline Buffer BufferPool::Allocate( std::size_t size )
+{
+     Buffer::Block *block = nullptr;
+     Cache *cache = nullptr;
+     if ( size <= block_size_ )
+     {
+          cache = LocalCache();
+          if ( cache->local_ == nullptr )
+          {
+               // take back all blocks freed by other threads at once
+               cache->local_ = cache->remote_.exchange( nullptr, std::memory_order_acquire );
+          }
+
+          block = cache->local_;
+          if ( block )
+          {
+               cache->local_ = block->next_;
+          }
+     }
+
+     if ( block == nullptr )
+     {
+          auto capacity = std::max( size, block_size_ );
+          block = static_cast< Buffer::Block * >( ::operator new( sizeof( Buffer::Block ) + capacity ));
+          new ( block ) Buffer::Block{ { 0 }, cache, capacity, nullptr };
+          blocks_.fetch_add( 1, std::memory_order_relaxed );
+     }
+
+     block->refs_.store( 1, std::memory_order_relaxed );
+     return Buffer( block, size );
+}
+
+inline Buffer BufferPool::Copy( std::string_view data )
+{
+     auto buffer = Allocate( data.size() );
+     if ( !data.empty() )
+     {
+          std::memcpy( buffer.Data(), data.data(), data.size() );
+     }
+
+     return buffer;
+}
+
+inline std::size_t BufferPool::BlockSize() const
+{
+     return block_size_;
+}
+
+inline std::size_t BufferPool::Blocks() const
+{
+     return blocks_.load( std::memory_order_relaxed );
+}
+
+inline std::uint64_t BufferPool::NextId()
+{
+     // thread caches find pool by id, ids are never reused unlike addresses of destroyed pools
+     static std::atomic< std::uint64_t > ids{ 0 };
+     return ids.fetch_add( 1 );
+}
+
+inline BufferPool::Cache *BufferPool::LocalCache()
+{
+     static thread_local ThreadCaches thread_caches;
+     if ( auto *cache = thread_caches.Find( id_ ))
+     {
+          return cache;
+     }
+
+     std::scoped_lock lock( caches_mtx_ );
+     Cache *cache = nullptr;
+     if ( !idle_caches_.empty() )
+     {
+          cache = idle_caches_.back();
+          idle_caches_.pop_back();
+     }
+     else
+     {
+          caches_.push_back( std::make_unique< Cache >() );
+          cache = caches_.back().get();
+     }
+
+     cache->owner_.store( std::this_thread::get_id() );
+     thread_caches.Add( id_, weak_from_this(), cache );
+     return cache;
+}
+
+inline void BufferPool::ReleaseCache( Cache *cache )
+{
+     std::scoped_lock lock( caches_mtx_ );
+     // blocks of exited thread keep coming to its cache and are reused by next thread getting it
+     cache->owner_.store( std::thread::id() );
+     idle_caches_.push_back( cache );
+}
+
+inline void BufferPool::Free( Buffer::Block *block )
+{
+     auto *cache = block->origin_;
+     if ( cache == nullptr )
+     {
+          block->~Block();
+          ::operator delete( block );
+          return;
+     }
+
+     if ( cache->owner_.load( std::memory_order_relaxed ) == std::this_thread::get_id() )
+     {
+          block->next_ = cache->local_;
+          cache->local_ = block;
+          return;
+     }
+
+     auto *head = cache->remote_.load( std::memory_order_relaxed );
+     do
+     {
+          block->next_ = head;
+     }
+     while ( !cache->remote_.compare_exchange_weak( head, block, std::memory_order_release, std::memory_order_relaxed ));
+}
+
+inline void BufferPool::FreeList( Buffer::Block *block )
+{
+     while ( block )
+     {
+          auto *next = block->next_;
+          block->~Block();
+          ::operator delete( block );
+          block = next;
+     }
+}
+
+inline BufferPool::ThreadCaches::~ThreadCaches()
+{
+     for ( auto &entry : entries_ )
+     {
+          if ( auto pool = entry.pool_.lock() )
+          {
+               pool->ReleaseCache( entry.cache_ );
+          }
+     }
+}
+
+inline BufferPool::Cache *BufferPool::ThreadCaches::Find( std::uint64_t pool_id ) const
+{
+     for ( const auto &entry : entries_ )
+     {
+          if ( entry.pool_id_ == pool_id )
+          {
+               return entry.cache_;
+          }
+     }
+
+     return nullptr;
+}
+
+inline void BufferPool::ThreadCaches::Add( std::uint64_t pool_id, std::weak_ptr< BufferPool > pool, Cache *cache )
+{
+     entries_.push_back( { pool_id, std::move( pool ), cache } );
+}
+
+} // qm
+
+#endif // MQP_BUFFER_H_
@@ -0,0 +1,221 @@
+/// @brief Memory resource backed by huge pages
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_HUGE_PAGE_RESOURCE_H_
+#define MQP_HUGE_PAGE_RESOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace qm
+{
+
+/// @brief Fault in pages of memory range for writing, contents are kept.
+/// First stores to prefaulted memory don't take page faults.
+/// @param address Start of range, any alignment
+/// @param size Size of range in bytes
+/// @return true if pages are populated, false if kernel doesn't support MADV_POPULATE_WRITE
+inline bool PrefaultPages( void *address, std::size_t size )
+{
+#ifdef MADV_POPULATE_WRITE
+     if ( size == 0 )
+     {
+          return true;
+     }
+
+     const auto page = static_cast< std::uintptr_t >( sysconf( _SC_PAGESIZE ));
+     const auto begin = reinterpret_cast< std::uintptr_t >( address ) & ~( page - 1 );
+     const auto end = reinterpret_cast< std::uintptr_t >( address ) + size;
+     return madvise( reinterpret_cast< void * >( begin ), end - begin, MADV_POPULATE_WRITE ) == 0;
+#else
+     ( void ) address;
+     ( void ) size;
+     return false;
+#endif
+}
+
+/// @brief Memory resource carving allocations from chunks backed by 2 MB pages.
+/// Chunk is mapped with MAP_HUGETLB from reserved huge pages, if none are reserved it falls back
+/// to regular 2 MB aligned mapping advised for transparent huge pages. With prefault chunks are
+/// faulted in when mapped, so storage allocated from them takes no page faults on first use.
+/// Like std::pmr::monotonic_buffer_resource, memory is returned to system on destruction only:
+/// wrap resource to std::pmr::synchronized_pool_resource when queues are removed and added often.
+/// Allocation is thread safe.
+class HugePageResource : public std::pmr::memory_resource
+{
+public:
+     static constexpr std::size_t HugePageSize = std::size_t{ 2 } << 20;
+
+     /// @brief Constructor
+     /// @param prefault Fault in chunks when they are mapped
+     /// @param chunk_size Size of chunk, rounded up to HugePageSize
+     explicit HugePageResource( bool prefault = true, std::size_t chunk_size = HugePageSize );
+
+     /// @brief Destructor, unmaps all chunks
+     ~HugePageResource() override;
+
+     /// @brief Copying is forbidden
+     HugePageResource( const HugePageResource & ) = delete;
+
+     /// @brief Copying is forbidden
+     HugePageResource &operator=( const HugePageResource & ) = delete;
+
+     /// @brief Get count of mapped chunks
+     /// @return Chunks count
+     /// @details Thread safe
+     std::size_t Chunks() const;
+
+     /// @brief Get count of chunks mapped from reserved huge pages ( MAP_HUGETLB )
+     /// @return Chunks count
+     /// @details Thread safe
+     std::size_t HugeChunks() const;
+
+private:
+     struct Chunk
+     {
+          void *address_;
+          std::size_t size_;
+          bool huge_;
+     };
+
+     void *do_allocate( std::size_t bytes, std::size_t alignment ) override;
+
+     void do_deallocate( void *p, std::size_t bytes, std::size_t alignment ) override;
+
+     bool do_is_equal( const std::pmr::memory_resource &other ) const noexcept override;
+
+     Chunk Map( std::size_t size ) const;
+
+     static std::size_t RoundUp( std::size_t size );
+
+private:
+     const bool prefault_;
+     const std::size_t chunk_size_;
+
+     mutable std::mutex mtx_;
+     std::vector< Chunk > chunks_;
+     void *current_;  ///< free space of last chunk
+     std::size_t left_;
+};
+
+inline HugePageResource::HugePageResource( bool prefault, std::size_t chunk_size ) : prefault_( prefault ),
+                                                                                     chunk_size_( RoundUp( chunk_size )),
+                                                                                     current_( nullptr ),
+                                                                                     left_( 0 )
+{}
+
+inline HugePageResource::~HugePageResource()
+{
+     for ( const auto &chunk : chunks_ )
+     {
+          munmap( chunk.address_, chunk.size_ );
+     }
+}
+
+inline std::size_t HugePageResource::Chunks() const
+{
+     std::scoped_lock lock( mtx_ );
+     return chunks_.size();
+}
+
+inline std::size_t HugePageResource::HugeChunks() const
+{
+     std::scoped_lock lock( mtx_ );
+     std::size_t count = 0;
+     for ( const auto &chunk : chunks_ )
+     {
+          count += chunk.huge_ ? 1 : 0;
+     }
+     return count;
+}
+
+inline void *HugePageResource::do_allocate( std::size_t bytes, std::size_t alignment )
+{
+     std::scoped_lock lock( mtx_ );
+     if ( auto p = std::align( alignment, bytes, current_, left_ ))
+     {
+          current_ = static_cast< std::byte * >( p ) + bytes;
+          left_ -= bytes;
+          return p;
+     }
+
+     // chunks are huge page aligned, so any smaller alignment is satisfied by chunk start
+     chunks_.reserve( chunks_.size() + 1 );
+     auto chunk = Map( bytes > chunk_size_ / 2 ? RoundUp( bytes ) : chunk_size_ );
+     chunks_.push_back( chunk );
+
+     // big allocation takes own chunk and keeps free space of current one
+     if ( chunk.size_ - bytes >= left_ )
+     {
+          current_ = static_cast< std::byte * >( chunk.address_ ) + bytes;
+          left_ = chunk.size_ - bytes;
+     }
+     return chunk.address_;
+}
+
+inline void HugePageResource::do_deallocate( void *, std::size_t, std::size_t )
+{
+     // memory is released by destructor
+}
+
+inline bool HugePageResource::do_is_equal( const std::pmr::memory_resource &other ) const noexcept
+{
+     return this == &other;
+}
+
+inline HugePageResource::Chunk HugePageResource::Map( std::size_t size ) const
+{
+     const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+     auto p = mmap( nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | ( prefault_ ? MAP_POPULATE : 0 ), -1, 0 );
+     if ( p != MAP_FAILED )
+     {
+          return { p, size, true };
+     }
+
+     // transparent huge pages need 2 MB aligned range, map more and trim edges
+     auto raw = mmap( nullptr, size + HugePageSize, PROT_READ | PROT_WRITE, flags, -1, 0 );
+     if ( raw == MAP_FAILED )
+     {
+          throw std::bad_alloc();
+     }
+
+     auto begin = reinterpret_cast< std::uintptr_t >( raw );
+     auto aligned = ( begin + HugePageSize - 1 ) & ~( HugePageSize - 1 );
+     if ( aligned != begin )
+     {
+          munmap( raw, aligned - begin );
+     }
+     munmap( reinterpret_cast< void * >( aligned + size ), begin + HugePageSize - aligned );
+
+     p = reinterpret_cast< void * >( aligned );
+     madvise( p, size, MADV_HUGEPAGE );
+     if ( prefault_ && !PrefaultPages( p, size ))
+     {
+          // fresh mapping holds no data yet, so it may be touched by plain stores
+          const auto page = static_cast< std::size_t >( sysconf( _SC_PAGESIZE ));
+          for ( std::size_t offset = 0; offset < size; offset += page )
+          {
+               static_cast< volatile char * >( p )[ offset ] = 0;
+          }
+     }
+
+     return { p, size, false };
+}
+
+inline std::size_t HugePageResource::RoundUp( std::size_t size )
+{
+     return ( size + HugePageSize - 1 ) & ~( HugePageSize - 1 );
+}
+
+} // qm
+
+#endif // MQP_HUGE_PAGE_RESOURCE_H_
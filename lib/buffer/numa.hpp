@@ -0,0 +1,92 @@
+/// @brief NUMA placement of memory ranges
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_NUMA_H_
+#define MQP_NUMA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace qm
+{
+
+/// @brief Get count of NUMA nodes possible in system
+/// @return Nodes count, 1 if system has no NUMA support
+inline int NumaNodes()
+{
+     static const int nodes = []()
+     {
+          // file holds range list like "0" or "0-3"
+          std::ifstream possible( "/sys/devices/system/node/possible" );
+          std::string range;
+          if ( !( possible >> range ))
+          {
+               return 1;
+          }
+
+          auto last = range.find_last_of( ",-" );
+          return std::stoi( last == std::string::npos ? range : range.substr( last + 1 )) + 1;
+     }();
+
+     return nodes;
+}
+
+/// @brief Get NUMA node of CPU the calling thread runs on
+/// @return Node number, 0 if unknown
+inline int CurrentNumaNode()
+{
+     unsigned int cpu = 0;
+     unsigned int node = 0;
+     return getcpu( &cpu, &node ) == 0 ? static_cast< int >( node ) : 0;
+}
+
+/// @brief Get NUMA node holding page at address, page is faulted in if it is not yet
+/// @param address Address in page
+/// @return Node number, -1 if unknown
+inline int NumaNodeOf( const void *address )
+{
+     int node = -1;
+     auto result = syscall( SYS_get_mempolicy, &node, nullptr, 0, address, MPOL_F_NODE | MPOL_F_ADDR );
+     return result == 0 ? node : -1;
+}
+
+/// @brief Prefer NUMA node for memory range and migrate its pages already faulted in to this node.
+/// Range is extended to whole pages, so neighbour data sharing the pages moves too.
+/// Preferred policy falls back to other nodes when node memory is exhausted.
+/// @param address Start of range, any alignment
+/// @param size Size of range in bytes
+/// @param node Node number
+/// @return true if policy is set, false on single node systems or failure
+inline bool BindToNumaNode( const void *address, std::size_t size, int node )
+{
+     const auto nodes = NumaNodes();
+     if ( nodes <= 1 || node < 0 || node >= nodes || size == 0 )
+     {
+          return false;
+     }
+
+     constexpr std::size_t Bits = 8 * sizeof( unsigned long );
+     std::vector< unsigned long > mask( static_cast< std::size_t >( nodes ) / Bits + 1 );
+     mask[ static_cast< std::size_t >( node ) / Bits ] |= 1UL << ( static_cast< std::size_t >( node ) % Bits );
+
+     const auto page = static_cast< std::uintptr_t >( sysconf( _SC_PAGESIZE ));
+     const auto begin = reinterpret_cast< std::uintptr_t >( address ) & ~( page - 1 );
+     const auto end = reinterpret_cast< std::uintptr_t >( address ) + size;
+
+     // kernel reads maxnode - 1 bits of mask
+     return syscall( SYS_mbind, begin, end - begin, MPOL_PREFERRED, mask.data(), mask.size() * Bits + 1,
+                     MPOL_MF_MOVE ) == 0;
+}
+
+} // qm
+
+#endif // MQP_NUMA_H_
@@ -3,11 +3,58 @@
 #ifndef MQP_COMMON_H_
 #define MQP_COMMON_H_
 
-#include "common.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
 
 namespace qm
 {
 
+/// @brief Size of cache line used to separate data modified by different threads
+#ifdef __cpp_lib_hardware_interference_size
+#if defined( __GNUC__ ) && !defined( __clang__ )
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+constexpr std::size_t CacheLineSize = std::hardware_destructive_interference_size;
+#if defined( __GNUC__ ) && !defined( __clang__ )
+#pragma GCC diagnostic pop
+#endif
+#else
+constexpr std::size_t CacheLineSize = 64;
+#endif
+
+/// @brief Field occupying whole cache line, so writes to neighbour fields don't invalidate it.
+/// Derives from T, so field is used like T itself ( e.g. CacheAligned< std::atomic< bool > > ).
+/// @tparam T Type of field
+template< typename T >
+struct alignas( CacheLineSize ) CacheAligned : T
+{
+     using T::T;
+     using T::operator=;
+
+     CacheAligned() = default;
+};
+
+/// @brief Functor estimating memory used by value, used by byte limited buffers
+/// Specialize it for types owning heap memory.
+/// @tparam Value Type of value
+template< typename Value >
+struct ValueSize
+{
+     std::size_t operator()( const Value & ) const { return sizeof( Value ); }
+};
+
+/// @brief Value size of string includes its characters
+template<>
+struct ValueSize< std::string >
+{
+     std::size_t operator()( const std::string &value ) const { return sizeof( std::string ) + value.size(); }
+};
+
 template< typename Value>
 class IQueue;
 
@@ -8,6 +8,8 @@
 #include "common.h"
 
 #include <iostream>
+#include <type_traits>
+#include <utility>
 
 namespace qm
 {
@@ -30,14 +32,38 @@ public:
      /// @param enabled True - enbaled, false - disabled
      inline void Enabled( bool enabled );
 
+     /// @brief Is consumer safe to be called from producers threads
+     /// @return true/false
+     [[nodiscard]] inline bool Inline() const;
+
+     /// @brief Allow or forbid Consume calls from producers threads.
+     /// Queues with direct hand-off (e.g. HandOffQueue) run Consume inline on producer thread when
+     /// queue is empty and consumer is idle. Calls are never concurrent and keep values order.
+     /// @param allowed True - allowed, false - forbidden
+     inline void Inline( bool allowed );
+
 public:
      /// @brief Pure virtual func for object processing
      /// Consume function makes handle to object dequeued from attached queue.
      /// @param obj Object
      virtual void Consume( const Value &obj ) = 0;
 
+     /// @brief Processing of object owned by consumer.
+     /// Called by managers for values moved out of queue, override it to keep payload without copying.
+     /// Named apart from Consume, so overriding Consume( const Value & ) alone hides nothing.
+     /// Default implementation calls Consume( const Value & ).
+     /// @param obj Object
+     virtual void ConsumeMoved( Value &&obj );
+
+     /// @brief Pass value to consumer, rvalue goes to ConsumeMoved and lvalue to Consume
+     /// @param obj Object
+     template< typename V >
+     inline void Deliver( V &&obj );
+
 private:
-     std::atomic< bool > enabled_ = true;
+     // read on every message by consumer and producers threads, kept apart from derived consumer fields
+     CacheAligned< std::atomic< bool > > enabled_{ true };
+     CacheAligned< std::atomic< bool > > inline_{ false };
 };
 
 template< typename Value >
@@ -52,6 +78,38 @@ void IConsumer< Value >::Enabled( bool enabled )
      enabled_.store( enabled );
 }
 
+template< typename Value >
+void IConsumer< Value >::ConsumeMoved( Value &&obj )
+{
+     Consume( static_cast< const Value & >( obj ));
+}
+
+template< typename Value >
+template< typename V >
+void IConsumer< Value >::Deliver( V &&obj )
+{
+     if constexpr ( std::is_lvalue_reference_v< V > )
+     {
+          Consume( obj );
+     }
+     else
+     {
+          ConsumeMoved( std::move( obj ));
+     }
+}
+
+template< typename Value >
+bool IConsumer< Value >::Inline() const
+{
+     return inline_.load();
+}
+
+template< typename Value >
+void IConsumer< Value >::Inline( bool allowed )
+{
+     inline_.store( allowed );
+}
+
 } // qm
 
 #endif // MQP_BASE_CONSUMER_H_
@@ -0,0 +1,76 @@
+/// @brief Base template class for consumers of mixed message streams
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_VARIANT_CONSUMER_H_
+#define MQP_VARIANT_CONSUMER_H_
+
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "consumer/base_consumer.hpp"
+
+namespace qm
+{
+
+/// @brief Consumer of std::variant values dispatching each alternative to own Consume overload.
+/// Queues store variant inline in their slots, so mixed streams need no boxing of messages.
+/// Derived class declares public `void Consume( const T & )` for every alternative T ( and optionally
+/// `void Consume( T && )` ) and brings base overloads to scope by `using VariantConsumer::Consume;`.
+/// Alternative is chosen by std::visit jump table, handlers are called without virtual dispatch.
+/// @tparam Derived Consumer class derived from VariantConsumer
+/// @tparam Ts Variant alternatives
+template< typename Derived, typename... Ts >
+class VariantConsumer : public IConsumer< std::variant< Ts... > >
+{
+public:
+     using Message = std::variant< Ts... >;
+
+     /// @brief Dispatch copied message to handler of its alternative
+     /// @param obj Message
+     void Consume( const Message &obj ) final;
+
+     /// @brief Dispatch message moved out of queue to handler of its alternative
+     /// @param obj Message
+     void ConsumeMoved( Message &&obj ) final;
+
+private:
+     template< typename T, typename = void >
+     struct HasHandler : std::false_type
+     {};
+
+     template< typename T >
+     struct HasHandler< T, std::void_t< decltype( static_cast< void ( Derived::* )( const T & ) >( &Derived::Consume )) > >
+          : std::true_type
+     {};
+
+     template< typename Alternative >
+     void Dispatch( Alternative &&value );
+};
+
+template< typename Derived, typename... Ts >
+void VariantConsumer< Derived, Ts... >::Consume( const Message &obj )
+{
+     std::visit( [ this ]( const auto &value ) { Dispatch( value ); }, obj );
+}
+
+template< typename Derived, typename... Ts >
+void VariantConsumer< Derived, Ts... >::ConsumeMoved( Message &&obj )
+{
+     std::visit( [ this ]( auto &&value ) { Dispatch( std::forward< decltype( value ) >( value )); }, std::move( obj ));
+}
+
+template< typename Derived, typename... Ts >
+template< typename Alternative >
+void VariantConsumer< Derived, Ts... >::Dispatch( Alternative &&value )
+{
+     // without exact handler overload resolution converts alternative back to variant and recurses
+     static_assert( HasHandler< std::decay_t< Alternative > >::value,
+                    "Derived consumer must declare void Consume( const T & ) for every alternative" );
+     static_cast< Derived * >( this )->Consume( std::forward< Alternative >( value ));
+}
+
+} // qm
+
+#endif // MQP_VARIANT_CONSUMER_H_
@@ -5,30 +5,47 @@
 #ifndef MQP_MULTI_QUEUE_MANAGER_H_
 #define MQP_MULTI_QUEUE_MANAGER_H_
 
+#include <algorithm>
+#include <memory_resource>
 #include <mutex>
 
+#include <boost/container/flat_map.hpp>
+
 #include "common.h"
+#include "manager/epoch_domain.hpp"
+#include "manager/queue_map.hpp"
+#include "manager/queue_ref.hpp"
 #include "producer/base_producer.hpp"
+#include "producer/producer_runtime.hpp"
 
 namespace qm
 {
 
 /// @brief Base class of multi queues management for multithreading consumers/producers models.
-/// @tparam Key Type for queues map store. Key must be comparable by operator<
+/// @tparam Key Type for queues map store. Key must be comparable by operator< and hashable by std::hash
+/// for lock free Enqueue lookup, integral keys are indexed directly ( see KeyTraits )
 /// @tparam Value Type for queue store
 template<typename Key, typename Value>
 class IMultiQueueManager
 {
 public:
-     using Producers = boost::container::flat_multimap< Key, ProducerPtr < Key, Value > >;
-     using Consumers = boost::container::flat_multimap< Key, ConsumerPtr < Value > >;
-     using Queues = boost::container::flat_map< Key, QueuePtr < Value > >;
+     template< typename T >
+     using Allocator = std::pmr::polymorphic_allocator< std::pair< Key, T > >;
+
+     using Producers = boost::container::flat_multimap< Key, ProducerPtr < Key, Value >, std::less< Key >,
+                                                        Allocator< ProducerPtr < Key, Value > > >;
+     using Consumers = boost::container::flat_multimap< Key, ConsumerPtr < Value >, std::less< Key >,
+                                                        Allocator< ConsumerPtr < Value > > >;
+     using Queues = QueueMap< Key, QueuePtr < Value >, Allocator< QueuePtr < Value > > >;
 
      /// @brief Constructor
-     explicit IMultiQueueManager();
+     /// @param resource Memory resource for registries of queues, producers and consumers.
+     /// It is used under manager lock only and must outlive manager. Lookup index of Enqueue
+     /// uses default heap, as its replaced parts are reclaimed outside the lock.
+     explicit IMultiQueueManager( std::pmr::memory_resource *resource = std::pmr::get_default_resource() );
 
      /// @brief Destructor
-     virtual ~IMultiQueueManager() = default;
+     virtual ~IMultiQueueManager();
 
      /// @brief Copying is forbidden
      IMultiQueueManager( const IMultiQueueManager & ) = delete;
@@ -43,25 +60,43 @@ public:
      /// @brief Enable all consumers and queues
      virtual void StartProcessing();
 
-     /// @brief Add new queue for management
+     /// @brief Add new queue for management, queue storage is prefaulted before queue is published
      /// @param id Key to access and control queue
      /// @param queue Pointer to queue
      /// @return State value
      /// @details Thread safe
      State AddQueue(const Key &id, QueuePtr <Value> queue );
 
-     /// @brief Get queue stored with specified id
+     /// @brief Remove queue stored with specified id.
+     /// Queue is unlinked and disabled immediately, concurrent Enqueue calls keep it alive until they return.
+     /// Registered producers and their endpoints are disabled without waiting for their threads,
+     /// they get State::QueueDisabled on next push and must finish. Producers are detached from queue
+     /// when they are done, by later calls of manager or StopProcessing.
      /// @param id Key to get queue
      /// @return State value
      /// @details Thread safe
      State RemoveQueue( const Key &id );
 
+     /// @brief Change maximal size of queue while producers and consumers keep running
+     /// @param id Key to find queue
+     /// @param size New maximal size
+     /// @return State::QueueAbsent or State of queue Resize
+     /// @details Thread safe
+     State Resize( const Key &id, std::size_t size );
+
      /// @brief Get queue stored with specified id
      /// @param id Key to get queue
      /// @return State value
      /// @details Thread safe
      QueueResult <Value> GetQueue( const Key &id ) const;
 
+     /// @brief Borrow queue stored with specified id for pushes from hot path.
+     /// Queue removed meanwhile stays alive until handle is released ( see QueueRef ).
+     /// @param id Key to get queue
+     /// @return Borrowed handle and State value
+     /// @details Thread safe
+     QueueRefResult <Value> BorrowQueue( const Key &id ) const;
+
      /// @brief Check are all queue empty
      /// @return true/false
      /// @details Thread safe
@@ -72,6 +107,12 @@ public:
      /// @details Thread safe
      bool AreAllProducersDone() const;
 
+     /// @brief Set runtime for cooperative producers ( see TaskProducer ).
+     /// Registered producers run their steps on runtime's workers instead of own threads.
+     /// @param runtime Pointer to runtime, nullptr to reset
+     /// @details Thread safe
+     void SetRuntime( RuntimePtr runtime );
+
 public:
      /// @brief Subscribe new consumer to queue stored with id
      /// @param id Key to find required queue
@@ -136,25 +177,45 @@ protected:
 
 protected:
      mutable std::recursive_mutex mtx_;
-     std::atomic< bool > is_enabled_;
+     CacheAligned< std::atomic< bool > > is_enabled_;  ///< read by consumers threads on every message
 
-     Queues queues_;
+     Queues queues_;           ///< guarded by mtx_, published to Enqueue by published_
      Producers producers_;
      Consumers consumers_;
+     RuntimePtr runtime_;
 
 private:
      template< typename K, typename V >
      State EnqueueFwd( K&& id, V&& value );
+
+     /// @brief Stop producer, wait for its thread and detach it from queue
+     /// @param queue Queue producer registered for, may be nullptr
+     /// @param producer Pointer to producer
+     void ReleaseProducer( const QueuePtr< Value > &queue, const ProducerPtr< Key, Value > &producer );
+
+     /// @brief Release producers of removed queues
+     /// @param wait Release all producers waiting for their threads, otherwise only done ones
+     void ReleaseRetiredProducers( bool wait );
+
+private:
+     /// producers of removed queues with the queue they are attached to, released when done
+     std::pmr::vector< std::pair< QueuePtr< Value >, ProducerPtr< Key, Value > > > retired_producers_;
+     EpochDomain epochs_;  ///< pinned by Enqueue
+     PublishedMap< Key, IQueue< Value > > published_;  ///< read by Enqueue under epoch guard, written under mtx_
 };
 
 template<typename Key, typename Value>
 State IMultiQueueManager< Key, Value >::AddQueue( const Key &id, QueuePtr< Value > queue )
 {
+     // storage is faulted in before queue becomes visible, so first messages don't pay for it
+     queue->Prefault();
+
      std::scoped_lock lock( mtx_ );
      if ( queues_.find( id ) == queues_.end())
      {
           queues_.emplace( id, queue );
           queue->Enabled( true );
+          published_.Insert( id, queue.get() );
           return State::Ok;
      }
 
@@ -171,12 +232,24 @@ State IMultiQueueManager< Key, Value >::RegisterProducer( const Key &id, Produce
           return queue_result.s_;
      }
 
-     producer->SetQueue( queue_result.queue_ );
      if ( !ProducerRegistrationAllowed( id ) )
      {
           return State::QueueBusy;
      }
 
+     // producer of removed queue is registered again, its old endpoint must be detached first
+     auto retired = std::find_if( retired_producers_.begin(), retired_producers_.end(),
+                                  [ &producer ]( const auto &retired ) { return retired.second == producer; } );
+     if ( retired != retired_producers_.end() )
+     {
+          ReleaseProducer( retired->first, retired->second );
+          retired_producers_.erase( retired );
+     }
+     ReleaseRetiredProducers( false );
+
+     auto endpoint = queue_result.queue_->AttachProducer();
+     producer->SetQueue( endpoint ? endpoint : queue_result.queue_ );
+     producer->SetRuntime( runtime_ );
      producers_.emplace( id, producer );
      return State::Ok;
 }
@@ -196,9 +269,7 @@ State IMultiQueueManager< Key, Value >::UnregisterProducer( const Key &id, Produ
      {
           if ( it->second == producer )
           {
-               producer->Enabled( false );
-               producer->WaitThreadDone();
-               producer->SetQueue( nullptr );
+               ReleaseProducer( queue_result.queue_, producer );
                producers_.erase( it );
                return State::Ok;
           }
@@ -211,32 +282,48 @@ template<typename Key, typename Value>
 State IMultiQueueManager< Key, Value >::RemoveQueue( const Key &id )
 {
      std::scoped_lock lock( mtx_ );
+     QueuePtr< Value > queue;
      auto it = queues_.find( id );
      if ( it != queues_.end())
      {
-          it->second->Enabled( false );
+          queue = it->second;
+          queue->Enabled( false );
           queues_.erase( it );
+          // Enqueue calls pinned now may still push to queue, they keep it alive
+          published_.Erase( id );
+          epochs_.RetireFn( [ queue ]() mutable { queue.reset(); } );
      }
      else
      {
           return State::QueueAbsent;
      }
 
-     Unsubscribe( id );
-     consumers_.erase( id );
-
+     // producers threads may still push to their endpoints, so lanes are detached only when producers are done
+     ReleaseRetiredProducers( false );
      auto range = producers_.equal_range( id );
      for ( auto p_it = range.first; p_it != range.second; p_it++ )
      {
           p_it->second->Enabled( false );
-          p_it->second->WaitThreadDone();
-          p_it->second->SetQueue( nullptr );
+          p_it->second->queue_->Enabled( false );
+          retired_producers_.emplace_back( queue, p_it->second );
      }
      producers_.erase( id );
 
+     Unsubscribe( id );
+     consumers_.erase( id );
+     queue->DetachConsumer();
+
      return State::Ok;
 }
 
+template<typename Key, typename Value>
+State IMultiQueueManager< Key, Value >::Resize( const Key &id, std::size_t size )
+{
+     // queue may block while resizing, so manager lock is not held
+     auto queue_result = GetQueue( id );
+     return queue_result.s_ == State::Ok ? queue_result.queue_->Resize( size ) : queue_result.s_;
+}
+
 template<typename Key, typename Value>
 QueueResult <Value> IMultiQueueManager< Key, Value >::GetQueue( const Key &id ) const
 {
@@ -247,6 +334,19 @@ QueueResult <Value> IMultiQueueManager< Key, Value >::GetQueue( const Key &id )
             QueueResult< Value >{ it->second, State::Ok };
 }
 
+template<typename Key, typename Value>
+QueueRefResult <Value> IMultiQueueManager< Key, Value >::BorrowQueue( const Key &id ) const
+{
+     std::scoped_lock lock( mtx_ );
+     auto it = queues_.find( id );
+     if ( it == queues_.end() )
+     {
+          return { QueueRef< Value >(), State::QueueAbsent };
+     }
+
+     return { QueueRef< Value >( it->second ), State::Ok };
+}
+
 template<typename Key, typename Value>
 bool IMultiQueueManager< Key, Value >::AreAllQueuesEmpty() const
 {
@@ -271,6 +371,13 @@ bool IMultiQueueManager< Key, Value >::AreAllProducersDone() const
                          } );
 }
 
+template<typename Key, typename Value>
+void IMultiQueueManager< Key, Value >::SetRuntime( RuntimePtr runtime )
+{
+     std::scoped_lock lock( mtx_ );
+     runtime_ = runtime;
+}
+
 template<typename Key, typename Value>
 State IMultiQueueManager< Key, Value >::Enqueue( const Key &id, const Value &value )
 {
@@ -287,11 +394,12 @@ template<typename Key, typename Value>
 template<typename K, typename V>
 State IMultiQueueManager< Key, Value >::EnqueueFwd( K &&id, V &&value )
 {
-     std::lock_guard<std::recursive_mutex> lock(IMultiQueueManager< Key, Value >::mtx_ );
-     auto queue = IMultiQueueManager< Key, Value >::queues_.find(std::forward< K >(id ) );
-     if (queue != IMultiQueueManager< Key, Value >::queues_.end() )
+     // lookup doesn't take manager lock, removed queues are deleted after guard is released
+     auto guard = epochs_.Pin();
+     auto *queue = published_.Find( id );
+     if ( queue != nullptr )
      {
-          return queue->second->TryPush( std::forward< V >( value ) );
+          return queue->TryPush( std::forward< V >( value ) );
      }
 
      return State::QueueAbsent;
@@ -315,11 +423,12 @@ void IMultiQueueManager< Key, Value >::StopProcessing()
      std::for_each( IMultiQueueManager< Key, Value >::producers_.begin(),
                     IMultiQueueManager< Key, Value >::producers_.end(), [this]( auto producer )
                     {
-                         producer.second->Enabled( false );
-                         producer.second->WaitThreadDone();
-                         producer.second->SetQueue( nullptr );
+                         auto queue = IMultiQueueManager< Key, Value >::queues_.find( producer.first );
+                         ReleaseProducer( queue != IMultiQueueManager< Key, Value >::queues_.end() ?
+                                          queue->second : nullptr, producer.second );
                     } );
      producers_.clear();
+     ReleaseRetiredProducers( true );
 }
 
 template<typename Key, typename Value>
@@ -339,8 +448,50 @@ void IMultiQueueManager< Key, Value >::StartProcessing()
 }
 
 template< typename Key, typename Value >
-IMultiQueueManager< Key, Value >::IMultiQueueManager() : is_enabled_( true )
+IMultiQueueManager< Key, Value >::IMultiQueueManager( std::pmr::memory_resource *resource ) :
+     is_enabled_( true ),
+     queues_( typename Queues::allocator_type( resource )),
+     producers_( typename Producers::allocator_type( resource )),
+     consumers_( typename Consumers::allocator_type( resource )),
+     retired_producers_( resource ),
+     published_( epochs_ )
+{
+}
+
+template< typename Key, typename Value >
+IMultiQueueManager< Key, Value >::~IMultiQueueManager()
+{
+}
+
+template<typename Key, typename Value>
+void IMultiQueueManager< Key, Value >::ReleaseProducer( const QueuePtr< Value > &queue,
+                                                        const ProducerPtr< Key, Value > &producer )
+{
+     producer->Enabled( false );
+     producer->WaitThreadDone();
+     if ( queue )
+     {
+          queue->DetachProducer( producer->queue_ );
+     }
+     producer->SetQueue( nullptr );
+     producer->SetRuntime( nullptr );
+}
+
+template<typename Key, typename Value>
+void IMultiQueueManager< Key, Value >::ReleaseRetiredProducers( bool wait )
 {
+     auto released = std::remove_if( retired_producers_.begin(), retired_producers_.end(),
+                                     [ this, wait ]( const auto &retired )
+                                     {
+                                          if ( !wait && !retired.second->Done() )
+                                          {
+                                               return false;
+                                          }
+
+                                          ReleaseProducer( retired.first, retired.second );
+                                          return true;
+                                     } );
+     retired_producers_.erase( released, retired_producers_.end() );
 }
 
 } // qm
@@ -0,0 +1,651 @@
+/// @brief Queue manager for huge number of mostly idle queues
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_COMPACT_QUEUE_MANAGER_H_
+#define MQP_COMPACT_QUEUE_MANAGER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "queue/queue_state.hpp"
+#include "consumer/base_consumer.hpp"
+
+namespace qm
+{
+
+/// @brief Queue manager for millions of mostly idle keys ( e.g. sessions ).
+/// Manager owns queues of keys: idle key costs one hash map entry, storage of values is allocated on first push
+/// and freed when key stays empty for idle period. No thread is started per key: consumers are called by shared
+/// pool of workers, key is drained by one worker at a time, so values of key are consumed in push order.
+/// Keys are spread over shards with own locks.
+/// @attention Consumer subscribed to several keys is called concurrently when pool has several workers.
+/// @tparam Key Type of key, hashed by std::hash
+/// @tparam Value Type for queue store
+template< typename Key, typename Value >
+class CompactQueueManager
+{
+public:
+     /// @brief Constructor, starts workers
+     /// @param workers Count of consumers threads
+     /// @param idle_period Storage of key kept empty for this period is freed, zero disables automatic compaction
+     /// @param shards Count of registry shards
+     explicit CompactQueueManager( std::size_t workers = 1,
+                                   std::chrono::milliseconds idle_period = std::chrono::seconds( 1 ),
+                                   std::size_t shards = 64 );
+
+     /// @brief Destructor, stops workers
+     ~CompactQueueManager();
+
+     /// @brief Copying is forbidden
+     CompactQueueManager( const CompactQueueManager & ) = delete;
+
+     /// @brief Copying is forbidden
+     CompactQueueManager &operator=( const CompactQueueManager & ) = delete;
+
+     /// @brief Disable enqueue, consume values of subscribed keys and stop workers
+     /// @details Thread safe
+     void StopProcessing();
+
+     /// @brief Enable enqueue and start workers
+     /// @details Thread safe
+     void StartProcessing();
+
+     /// @brief Add queue for key, no storage is allocated until first value
+     /// @param id Key of queue
+     /// @param size Maximal count of values in queue
+     /// @return State::Ok or State::QueueExists
+     /// @details Thread safe
+     State AddQueue( const Key &id, std::size_t size );
+
+     /// @brief Remove queue of key, values left in it are dropped.
+     /// Waits for worker consuming values of key.
+     /// @param id Key of queue
+     /// @return State::Ok or State::QueueAbsent
+     /// @details Thread safe
+     State RemoveQueue( const Key &id );
+
+     /// @brief Change maximal count of values in queue, values over smaller size are kept
+     /// @param id Key of queue
+     /// @param size New maximal count of values
+     /// @return State::Ok or State::QueueAbsent
+     /// @details Thread safe
+     State Resize( const Key &id, std::size_t size );
+
+     /// @brief Subscribe consumer to queue, values already stored are scheduled for consuming
+     /// @param id Key of queue
+     /// @param consumer Consumer for subscribe
+     /// @return State::Ok, State::QueueAbsent or State::QueueBusy if queue has consumer
+     /// @details Thread safe
+     State Subscribe( const Key &id, ConsumerPtr< Value > consumer );
+
+     /// @brief Unsubscribe consumer from queue, values left in queue wait for next consumer.
+     /// Waits for worker consuming values of key.
+     /// @param id Key of queue
+     /// @return State::Ok or State::QueueAbsent if queue or its consumer is absent
+     /// @details Thread safe
+     State Unsubscribe( const Key &id );
+
+     /// @brief Enqueue value to queue of key
+     /// @param id Key of queue
+     /// @param value Lvalue object to push
+     /// @return State value
+     /// @details Thread safe
+     State Enqueue( const Key &id, const Value &value );
+
+     /// @brief Enqueue value to queue of key
+     /// @param id Key of queue
+     /// @param value Rvalue object to push
+     /// @return State value
+     /// @details Thread safe
+     State Enqueue( const Key &id, Value &&value );
+
+     /// @brief Check are all queue empty
+     /// @return true/false
+     /// @details Thread safe
+     bool AreAllQueuesEmpty() const;
+
+     /// @brief Free storage of queues kept empty since previous compaction.
+     /// Called by workers once per idle period, visits only queues holding storage.
+     /// @return Count of freed storages
+     /// @details Thread safe
+     std::size_t Compact();
+
+     /// @brief Get count of queues
+     /// @return Count
+     /// @details Thread safe
+     std::size_t Queues() const;
+
+     /// @brief Get count of queues holding allocated storage
+     /// @return Count
+     /// @details Thread safe
+     std::size_t AllocatedQueues() const;
+
+private:
+     struct Entry
+     {
+          std::unique_ptr< std::deque< Value > > values_;  ///< allocated on first push
+          ConsumerPtr< Value > consumer_;
+          std::uint32_t size_;       ///< maximal count of values
+          std::uint32_t round_;      ///< compaction round of last use
+          std::uint32_t slot_;       ///< position in shard allocated list while storage is held
+          bool scheduled_ = false;   ///< key is in ready list or drained by worker
+          bool draining_ = false;    ///< worker calls consumer without lock
+     };
+
+     struct alignas( CacheLineSize ) Shard
+     {
+          mutable std::mutex mtx_;
+          std::condition_variable drained_cv_;
+          std::unordered_map< Key, Entry > entries_;
+          std::vector< Entry * > allocated_;  ///< entries holding storage, map nodes are stable on rehash
+     };
+
+     static constexpr std::size_t Batch = 64;  ///< values consumed by worker per key visit
+
+     Shard &ShardOf( const Key &id ) const;
+
+     template< typename V >
+     State EnqueueFwd( const Key &id, V &&value );
+
+     void Schedule( const Key &id );
+
+     void Work();
+
+     void Drain( const Key &id, std::vector< Value > &batch );
+
+     static void WaitDrained( Shard &shard, std::unique_lock< std::mutex > &lock, const Key &id );
+
+     void CompactOnTime();
+
+     static bool HasValues( const Entry &entry );
+
+     static void Allocate( Shard &shard, Entry &entry );
+
+     static void Release( Shard &shard, Entry &entry );
+
+private:
+     const std::size_t workers_count_;
+     const std::chrono::milliseconds idle_period_;
+     const std::size_t shards_count_;
+     std::unique_ptr< Shard[] > shards_;
+
+     std::mutex mtx_;  ///< guards start and stop of workers
+     std::vector< std::thread > workers_;
+     CacheAligned< std::atomic< bool > > is_enabled_;  ///< read on every enqueue
+
+     alignas( CacheLineSize ) std::mutex ready_mtx_;
+     std::condition_variable ready_cv_;
+     std::deque< Key > ready_;
+     bool stopping_;
+
+     alignas( CacheLineSize ) std::atomic< std::uint32_t > round_;
+     std::atomic< std::chrono::steady_clock::rep > next_compaction_;
+};
+
+template< typename Key, typename Value >
+CompactQueueManager< Key, Value >::CompactQueueManager( std::size_t workers,
+                                                        std::chrono::milliseconds idle_period,
+                                                        std::size_t shards ) :
+     workers_count_( workers == 0 ? 1 : workers ),
+     idle_period_( idle_period ),
+     shards_count_( shards == 0 ? 1 : shards ),
+     shards_( std::make_unique< Shard[] >( shards_count_ )),
+     is_enabled_( false ),
+     stopping_( false ),
+     round_( 0 ),
+     next_compaction_(( std::chrono::steady_clock::now() + idle_period ).time_since_epoch().count() )
+{
+     StartProcessing();
+}
+
+template< typename Key, typename Value >
+CompactQueueManager< Key, Value >::~CompactQueueManager()
+{
+     StopProcessing();
+}
+
+template< typename Key, typename Value >
+void CompactQueueManager< Key, Value >::StopProcessing()
+{
+     std::scoped_lock lock( mtx_ );
+     is_enabled_ = false;
+     {
+          std::scoped_lock ready_lock( ready_mtx_ );
+          stopping_ = true;
+     }
+     ready_cv_.notify_all();
+
+     // workers leave when ready list is drained
+     for ( auto &worker : workers_ )
+     {
+          worker.join();
+     }
+     workers_.clear();
+}
+
+template< typename Key, typename Value >
+void CompactQueueManager< Key, Value >::StartProcessing()
+{
+     std::scoped_lock lock( mtx_ );
+     if ( is_enabled_ )
+     {
+          return;
+     }
+
+     {
+          std::scoped_lock ready_lock( ready_mtx_ );
+          stopping_ = false;
+     }
+     for ( std::size_t i = 0; i < workers_count_; i++ )
+     {
+          workers_.emplace_back( [ this ]() { Work(); } );
+     }
+     is_enabled_ = true;
+}
+
+template< typename Key, typename Value >
+State CompactQueueManager< Key, Value >::AddQueue( const Key &id, std::size_t size )
+{
+     auto &shard = ShardOf( id );
+     std::scoped_lock lock( shard.mtx_ );
+     Entry entry;
+     entry.size_ = static_cast< std::uint32_t >( size );
+     entry.round_ = round_;
+     return shard.entries_.emplace( id, std::move( entry )).second ? State::Ok : State::QueueExists;
+}
+
+template< typename Key, typename Value >
+State CompactQueueManager< Key, Value >::RemoveQueue( const Key &id )
+{
+     auto &shard = ShardOf( id );
+     std::unique_lock lock( shard.mtx_ );
+     if ( shard.entries_.find( id ) == shard.entries_.end() )
+     {
+          return State::QueueAbsent;
+     }
+
+     WaitDrained( shard, lock, id );
+     auto it = shard.entries_.find( id );
+     if ( it == shard.entries_.end() )
+     {
+          return State::QueueAbsent;
+     }
+
+     if ( it->second.values_ )
+     {
+          Release( shard, it->second );
+     }
+     shard.entries_.erase( it );
+     return State::Ok;
+}
+
+template< typename Key, typename Value >
+State CompactQueueManager< Key, Value >::Resize( const Key &id, std::size_t size )
+{
+     auto &shard = ShardOf( id );
+     std::scoped_lock lock( shard.mtx_ );
+     auto it = shard.entries_.find( id );
+     if ( it == shard.entries_.end() )
+     {
+          return State::QueueAbsent;
+     }
+
+     it->second.size_ = static_cast< std::uint32_t >( size );
+     return State::Ok;
+}
+
+template< typename Key, typename Value >
+State CompactQueueManager< Key, Value >::Subscribe( const Key &id, ConsumerPtr< Value > consumer )
+{
+     auto &shard = ShardOf( id );
+     bool schedule = false;
+     {
+          std::scoped_lock lock( shard.mtx_ );
+          auto it = shard.entries_.find( id );
+          if ( it == shard.entries_.end() )
+          {
+               return State::QueueAbsent;
+          }
+
+          auto &entry = it->second;
+          if ( entry.consumer_ )
+          {
+               return State::QueueBusy;
+          }
+
+          entry.consumer_ = std::move( consumer );
+          schedule = HasValues( entry ) && !entry.scheduled_;
+          entry.scheduled_ = entry.scheduled_ || schedule;
+     }
+
+     if ( schedule )
+     {
+          Schedule( id );
+     }
+     return State::Ok;
+}
+
+template< typename Key, typename Value >
+State CompactQueueManager< Key, Value >::Unsubscribe( const Key &id )
+{
+     auto &shard = ShardOf( id );
+     std::unique_lock lock( shard.mtx_ );
+     auto it = shard.entries_.find( id );
+     if ( it == shard.entries_.end() || !it->second.consumer_ )
+     {
+          return State::QueueAbsent;
+     }
+
+     WaitDrained( shard, lock, id );
+     it = shard.entries_.find( id );
+     if ( it == shard.entries_.end() || !it->second.consumer_ )
+     {
+          return State::QueueAbsent;
+     }
+
+     it->second.consumer_.reset();
+     return State::Ok;
+}
+
+template< typename Key, typename Value >
+State CompactQueueManager< Key, Value >::Enqueue( const Key &id, const Value &value )
+{
+     return EnqueueFwd( id, value );
+}
+
+template< typename Key, typename Value >
+State CompactQueueManager< Key, Value >::Enqueue( const Key &id, Value &&value )
+{
+     return EnqueueFwd( id, std::move( value ));
+}
+
+template< typename Key, typename Value >
+bool CompactQueueManager< Key, Value >::AreAllQueuesEmpty() const
+{
+     for ( std::size_t i = 0; i < shards_count_; i++ )
+     {
+          std::scoped_lock lock( shards_[ i ].mtx_ );
+          for ( const auto &[ id, entry ] : shards_[ i ].entries_ )
+          {
+               if ( HasValues( entry ))
+               {
+                    return false;
+               }
+          }
+     }
+     return true;
+}
+
+template< typename Key, typename Value >
+std::size_t CompactQueueManager< Key, Value >::Compact()
+{
+     // keys used after previous compaction have current round and are kept
+     auto round = round_.fetch_add( 1 );
+     std::size_t freed = 0;
+     for ( std::size_t i = 0; i < shards_count_; i++ )
+     {
+          auto &shard = shards_[ i ];
+          std::scoped_lock lock( shard.mtx_ );
+          // idle keys without storage are not visited, released entry is replaced by the last one
+          for ( std::size_t slot = 0; slot < shard.allocated_.size(); )
+          {
+               auto &entry = *shard.allocated_[ slot ];
+               if ( entry.values_->empty() && !entry.scheduled_ && entry.round_ != round )
+               {
+                    Release( shard, entry );
+                    freed++;
+               }
+               else
+               {
+                    slot++;
+               }
+          }
+     }
+     return freed;
+}
+
+template< typename Key, typename Value >
+std::size_t CompactQueueManager< Key, Value >::Queues() const
+{
+     std::size_t count = 0;
+     for ( std::size_t i = 0; i < shards_count_; i++ )
+     {
+          std::scoped_lock lock( shards_[ i ].mtx_ );
+          count += shards_[ i ].entries_.size();
+     }
+     return count;
+}
+
+template< typename Key, typename Value >
+std::size_t CompactQueueManager< Key, Value >::AllocatedQueues() const
+{
+     std::size_t count = 0;
+     for ( std::size_t i = 0; i < shards_count_; i++ )
+     {
+          std::scoped_lock lock( shards_[ i ].mtx_ );
+          count += shards_[ i ].allocated_.size();
+     }
+     return count;
+}
+
+template< typename Key, typename Value >
+void CompactQueueManager< Key, Value >::WaitDrained( Shard &shard, std::unique_lock< std::mutex > &lock, const Key &id )
+{
+     // iterators are not kept across the wait, as map may rehash meanwhile
+     shard.drained_cv_.wait( lock, [ &shard, &id ]()
+     {
+          auto it = shard.entries_.find( id );
+          return it == shard.entries_.end() || !it->second.draining_;
+     } );
+}
+
+template< typename Key, typename Value >
+typename CompactQueueManager< Key, Value >::Shard &CompactQueueManager< Key, Value >::ShardOf( const Key &id ) const
+{
+     return shards_[ std::hash< Key >()( id ) % shards_count_ ];
+}
+
+template< typename Key, typename Value >
+template< typename V >
+State CompactQueueManager< Key, Value >::EnqueueFwd( const Key &id, V &&value )
+{
+     if ( !is_enabled_ )
+     {
+          return State::QueueDisabled;
+     }
+
+     auto &shard = ShardOf( id );
+     bool schedule = false;
+     {
+          std::scoped_lock lock( shard.mtx_ );
+          auto it = shard.entries_.find( id );
+          if ( it == shard.entries_.end() )
+          {
+               return State::QueueAbsent;
+          }
+
+          auto &entry = it->second;
+          if ( !entry.values_ )
+          {
+               Allocate( shard, entry );
+          }
+          if ( entry.values_->size() >= entry.size_ )
+          {
+               return State::QueueFull;
+          }
+
+          entry.values_->push_back( std::forward< V >( value ));
+          entry.round_ = round_.load( std::memory_order_relaxed );
+          schedule = entry.consumer_ && !entry.scheduled_;
+          entry.scheduled_ = entry.scheduled_ || schedule;
+     }
+
+     if ( schedule )
+     {
+          Schedule( id );
+     }
+     return State::Ok;
+}
+
+template< typename Key, typename Value >
+void CompactQueueManager< Key, Value >::Schedule( const Key &id )
+{
+     {
+          std::scoped_lock lock( ready_mtx_ );
+          ready_.push_back( id );
+     }
+     ready_cv_.notify_one();
+}
+
+template< typename Key, typename Value >
+void CompactQueueManager< Key, Value >::Work()
+{
+     std::vector< Value > batch;
+     batch.reserve( Batch );
+     for ( ;; )
+     {
+          std::optional< Key > id;
+          {
+               std::unique_lock lock( ready_mtx_ );
+               auto ready = [ this ]() { return !ready_.empty() || stopping_; };
+               if ( idle_period_.count() > 0 )
+               {
+                    ready_cv_.wait_for( lock, idle_period_, ready );
+               }
+               else
+               {
+                    ready_cv_.wait( lock, ready );
+               }
+
+               if ( !ready_.empty() )
+               {
+                    id.emplace( std::move( ready_.front() ));
+                    ready_.pop_front();
+               }
+               else if ( stopping_ )
+               {
+                    return;
+               }
+          }
+
+          if ( id )
+          {
+               Drain( *id, batch );
+          }
+          CompactOnTime();
+     }
+}
+
+template< typename Key, typename Value >
+void CompactQueueManager< Key, Value >::Drain( const Key &id, std::vector< Value > &batch )
+{
+     auto &shard = ShardOf( id );
+     std::unique_lock lock( shard.mtx_ );
+     auto it = shard.entries_.find( id );
+
+     // key may be removed or added again after it was scheduled, worker draining it reschedules it itself
+     if ( it == shard.entries_.end() || !it->second.scheduled_ || it->second.draining_ )
+     {
+          return;
+     }
+
+     auto &entry = it->second;
+     if ( !entry.consumer_ || !HasValues( entry ))
+     {
+          entry.scheduled_ = false;
+          return;
+     }
+
+     auto consumer = entry.consumer_;
+     while ( batch.size() < Batch && !entry.values_->empty() )
+     {
+          batch.push_back( std::move( entry.values_->front() ));
+          entry.values_->pop_front();
+     }
+     entry.draining_ = true;
+     lock.unlock();
+
+     for ( auto &value : batch )
+     {
+          consumer->ConsumeMoved( std::move( value ));
+     }
+     batch.clear();
+
+     // entry is not erased while draining_ is set
+     lock.lock();
+     entry.draining_ = false;
+     entry.round_ = round_.load( std::memory_order_relaxed );
+     bool more = entry.consumer_ && HasValues( entry );
+     entry.scheduled_ = more;
+     lock.unlock();
+     shard.drained_cv_.notify_all();
+
+     // key goes to the end of ready list, so busy key doesn't starve others
+     if ( more )
+     {
+          Schedule( id );
+     }
+}
+
+template< typename Key, typename Value >
+void CompactQueueManager< Key, Value >::CompactOnTime()
+{
+     if ( idle_period_.count() == 0 )
+     {
+          return;
+     }
+
+     auto now = std::chrono::steady_clock::now();
+     auto next = next_compaction_.load( std::memory_order_relaxed );
+     if ( now.time_since_epoch().count() < next )
+     {
+          return;
+     }
+
+     // one worker wins compaction of period
+     auto following = ( now + idle_period_ ).time_since_epoch().count();
+     if ( next_compaction_.compare_exchange_strong( next, following ))
+     {
+          Compact();
+     }
+}
+
+template< typename Key, typename Value >
+bool CompactQueueManager< Key, Value >::HasValues( const Entry &entry )
+{
+     return entry.values_ && !entry.values_->empty();
+}
+
+template< typename Key, typename Value >
+void CompactQueueManager< Key, Value >::Allocate( Shard &shard, Entry &entry )
+{
+     entry.values_ = std::make_unique< std::deque< Value > >();
+     entry.slot_ = static_cast< std::uint32_t >( shard.allocated_.size() );
+     shard.allocated_.push_back( &entry );
+}
+
+template< typename Key, typename Value >
+void CompactQueueManager< Key, Value >::Release( Shard &shard, Entry &entry )
+{
+     entry.values_.reset();
+     auto *last = shard.allocated_.back();
+     last->slot_ = entry.slot_;
+     shard.allocated_[ entry.slot_ ] = last;
+     shard.allocated_.pop_back();
+}
+
+} // qm
+
+#endif // MQP_COMPACT_QUEUE_MANAGER_H_
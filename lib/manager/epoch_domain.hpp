@@ -0,0 +1,228 @@
+/// @brief Epoch based reclamation of objects shared between threads
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_EPOCH_DOMAIN_H_
+#define MQP_EPOCH_DOMAIN_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+namespace qm
+{
+
+/// @brief Epoch based reclamation domain.
+/// Readers pin the current epoch with Guard while they access shared objects. Writer unlinks object,
+/// so new readers can't reach it, and retires it: object is deleted when every reader pinned
+/// before retirement has left its guard. Writer never waits for readers.
+class EpochDomain
+{
+public:
+     /// @brief RAII pin of epoch, objects retired while guard is alive are not deleted
+     class Guard
+     {
+     public:
+          Guard( Guard &&other ) noexcept;
+
+          Guard( const Guard & ) = delete;
+
+          Guard &operator=( const Guard & ) = delete;
+
+          Guard &operator=( Guard && ) = delete;
+
+          ~Guard();
+
+     private:
+          friend class EpochDomain;
+
+          Guard( EpochDomain *domain, std::size_t slot );
+
+          EpochDomain *domain_;
+          std::size_t slot_;
+     };
+
+     /// @brief Constructor
+     /// @param slots Maximal count of concurrently pinned guards, next guards wait for free slot
+     explicit EpochDomain( std::size_t slots = 128 );
+
+     /// @brief Destructor, deletes all retired objects. No guards must be alive.
+     ~EpochDomain();
+
+     /// @brief Copying is forbidden
+     EpochDomain( const EpochDomain & ) = delete;
+
+     /// @brief Copying is forbidden
+     EpochDomain &operator=( const EpochDomain & ) = delete;
+
+     /// @brief Pin current epoch
+     /// @return Guard
+     /// @details Thread safe, lock free unless all slots are pinned
+     Guard Pin();
+
+     /// @brief Delete object when all readers which might see it are gone.
+     /// Object must be already unlinked from shared structures.
+     /// @param ptr Pointer to object created by new
+     /// @details Thread safe
+     template< typename T >
+     void Retire( T *ptr );
+
+     /// @brief Call reclaim function when all readers which might see retired object are gone,
+     /// e.g. to return object to pool instead of deleting it.
+     /// Object must be already unlinked from shared structures.
+     /// @param deleter Function reclaiming object
+     /// @details Thread safe
+     void RetireFn( std::function< void() > deleter );
+
+     /// @brief Delete retired objects which are not reachable by pinned readers
+     /// @return Count of deleted objects
+     /// @details Thread safe
+     std::size_t Collect();
+
+     /// @brief Count of retired objects waiting for deletion
+     /// @return Count
+     /// @details Thread safe
+     std::size_t Pending() const;
+
+private:
+     static constexpr std::uint64_t Quiescent = std::numeric_limits< std::uint64_t >::max();
+
+     struct alignas( CacheLineSize ) Slot
+     {
+          std::atomic< std::uint64_t > epoch_{ Quiescent };
+     };
+
+     struct Retired
+     {
+          std::uint64_t epoch_;
+          std::function< void() > deleter_;
+     };
+
+     void Unpin( std::size_t slot );
+
+private:
+     const std::size_t slots_count_;
+     std::unique_ptr< Slot[] > slots_;
+     CacheAligned< std::atomic< std::uint64_t > > epoch_;
+
+     mutable std::mutex retired_mtx_;
+     std::vector< Retired > retired_;
+};
+
+inline EpochDomain::Guard::Guard( EpochDomain *domain, std::size_t slot ) : domain_( domain ), slot_( slot )
+{}
+
+inline EpochDomain::Guard::Guard( Guard &&other ) noexcept : domain_( other.domain_ ), slot_( other.slot_ )
+{
+     other.domain_ = nullptr;
+}
+
+inline EpochDomain::Guard::~Guard()
+{
+     if ( domain_ )
+     {
+          domain_->Unpin( slot_ );
+     }
+}
+
+inline EpochDomain::EpochDomain( std::size_t slots ) : slots_count_( std::max< std::size_t >( slots, 1 ) ),
+                                                       slots_( new Slot[ std::max< std::size_t >( slots, 1 ) ] ),
+                                                       epoch_( 0 )
+{}
+
+inline EpochDomain::~EpochDomain()
+{
+     for ( auto &retired : retired_ )
+     {
+          retired.deleter_();
+     }
+}
+
+inline EpochDomain::Guard EpochDomain::Pin()
+{
+     // start from slot chosen by thread, so threads rarely contend for one slot
+     const auto start = std::hash< std::thread::id >()( std::this_thread::get_id() ) % slots_count_;
+     while ( true )
+     {
+          for ( std::size_t i = 0; i < slots_count_; i++ )
+          {
+               auto slot = ( start + i ) % slots_count_;
+               auto expected = Quiescent;
+               // seq_cst pin is ordered before loads of shared pointers made under guard
+               if ( slots_[ slot ].epoch_.load( std::memory_order_relaxed ) == Quiescent &&
+                    slots_[ slot ].epoch_.compare_exchange_strong( expected, epoch_.load() ))
+               {
+                    return Guard( this, slot );
+               }
+          }
+
+          std::this_thread::yield();
+     }
+}
+
+template< typename T >
+void EpochDomain::Retire( T *ptr )
+{
+     RetireFn( [ ptr ]() { delete ptr; } );
+}
+
+inline void EpochDomain::RetireFn( std::function< void() > deleter )
+{
+     {
+          std::scoped_lock lock( retired_mtx_ );
+          // readers pinned at this epoch or earlier may still see unlinked object
+          retired_.push_back( { epoch_.fetch_add( 1 ), std::move( deleter ) } );
+     }
+
+     Collect();
+}
+
+inline std::size_t EpochDomain::Collect()
+{
+     // objects retired after this point may be used by readers pinned after the scan below
+     auto oldest = epoch_.load();
+     for ( std::size_t i = 0; i < slots_count_; i++ )
+     {
+          oldest = std::min( oldest, slots_[ i ].epoch_.load() );
+     }
+
+     std::vector< Retired > reclaimable;
+     {
+          std::scoped_lock lock( retired_mtx_ );
+          auto it = std::partition( retired_.begin(), retired_.end(),
+                                    [ oldest ]( const Retired &retired ) { return retired.epoch_ >= oldest; } );
+          std::move( it, retired_.end(), std::back_inserter( reclaimable ));
+          retired_.erase( it, retired_.end() );
+     }
+
+     for ( auto &retired : reclaimable )
+     {
+          retired.deleter_();
+     }
+
+     return reclaimable.size();
+}
+
+inline std::size_t EpochDomain::Pending() const
+{
+     std::scoped_lock lock( retired_mtx_ );
+     return retired_.size();
+}
+
+inline void EpochDomain::Unpin( std::size_t slot )
+{
+     slots_[ slot ].epoch_.store( Quiescent, std::memory_order_release );
+}
+
+} // qm
+
+#endif // MQP_EPOCH_DOMAIN_H_
@@ -0,0 +1,200 @@
+#pragma once
+
+#ifndef MQP_INLINE_QUEUE_MANAGER_H_
+#define MQP_INLINE_QUEUE_MANAGER_H_
+
+#include "queue/base_queue.hpp"
+#include "consumer/base_consumer.hpp"
+#include "manager/base_mqueue_manager.hpp"
+
+namespace qm
+{
+
+/// @brief Synchronous queue manager for single threaded deployments ( e.g. event loops ).
+/// No consumer threads are started: subscribed consumer is attached to queue and with InlineQueue
+/// values are consumed right on Enqueue or producer's Push, optionally by small batches.
+/// Values stored in other queue types are consumed on Flush.
+/// @attention Manager is intended for one thread, queues and consumers are called on caller's thread.
+/// @tparam Key Type for queues map store. Key must be comparable by operator< and hashable by std::hash
+/// @tparam Value Type for queue store
+template<typename Key, typename Value>
+class InlineQueueManager : public IMultiQueueManager< Key, Value >
+{
+public:
+     /// @brief Inline manager constructor
+     /// @param resource Memory resource for manager registries, see IMultiQueueManager
+     explicit InlineQueueManager( std::pmr::memory_resource *resource = std::pmr::get_default_resource() );
+
+     /// @brief destructor
+     virtual ~InlineQueueManager();
+
+     /// @brief Consume deferred values, stop all producers and consumers
+     void StopProcessing() override;
+
+     /// @brief Subscribe consumer to queue, deferred values are consumed
+     /// @param id Key to find queue
+     /// @param consumer Consumer for subscribe.
+     /// @return State value
+     State Subscribe( const Key &id, ConsumerPtr< Value > consumer ) override;
+
+     /// @brief Consume deferred values and unsubscribe consumer from queue
+     /// @param id Key to find queue
+     /// @return State value
+     State Unsubscribe( const Key &id ) override;
+
+     /// @brief Unsubscribe consumer from queue. Behaviour is equal to function without consumer arg.
+     /// @param id Key to find queue
+     /// @param consumer Consumer ptr is ignored.
+     /// @return State value
+     State Unsubscribe( const Key &id, ConsumerPtr < Value> consumer ) override;
+
+     /// @brief Consume deferred values of all queues
+     /// @return Count of consumed values
+     std::size_t Flush();
+
+     /// @brief Consume deferred values of queue
+     /// @param id Key to find queue
+     /// @return State value
+     State Flush( const Key &id );
+
+protected:
+     bool ProducerRegistrationAllowed( Key ) const override;
+
+private:
+     std::size_t FlushQueue( const QueuePtr< Value > &queue, const ConsumerPtr< Value > &consumer );
+};
+
+template<typename Key, typename Value>
+InlineQueueManager< Key, Value >::InlineQueueManager( std::pmr::memory_resource *resource ) :
+     IMultiQueueManager< Key, Value >( resource )
+{}
+
+template<typename Key, typename Value>
+InlineQueueManager< Key, Value >::~InlineQueueManager()
+{
+     StopProcessing();
+}
+
+template<typename Key, typename Value>
+void InlineQueueManager< Key, Value >::StopProcessing()
+{
+     Flush();
+     IMultiQueueManager< Key, Value >::StopProcessing();
+}
+
+template<typename Key, typename Value>
+State InlineQueueManager< Key, Value >::Subscribe( const Key &id, ConsumerPtr< Value > consumer )
+{
+     std::scoped_lock lock( IMultiQueueManager< Key, Value >::mtx_ );
+     if ( IMultiQueueManager< Key, Value >::consumers_.find( id ) !=
+          IMultiQueueManager< Key, Value >::consumers_.end() )
+     {
+          return State::QueueBusy;
+     }
+
+     auto queue_it = IMultiQueueManager< Key, Value >::queues_.find( id );
+     if ( queue_it == IMultiQueueManager< Key, Value >::queues_.end() )
+     {
+          return State::QueueAbsent;
+     }
+
+     IMultiQueueManager< Key, Value >::consumers_.emplace( id, consumer );
+     queue_it->second->AttachConsumer( consumer );
+     FlushQueue( queue_it->second, consumer );
+     return State::Ok;
+}
+
+template<typename Key, typename Value>
+State InlineQueueManager< Key, Value >::Unsubscribe( const Key &id )
+{
+     std::scoped_lock lock( IMultiQueueManager< Key, Value >::mtx_ );
+     auto consumer = IMultiQueueManager< Key, Value >::consumers_.find( id );
+     if ( consumer == IMultiQueueManager< Key, Value >::consumers_.end() )
+     {
+          return State::QueueAbsent;
+     }
+
+     auto queue = IMultiQueueManager< Key, Value >::queues_.find( id );
+     if ( queue != IMultiQueueManager< Key, Value >::queues_.end() )
+     {
+          FlushQueue( queue->second, consumer->second );
+          queue->second->DetachConsumer();
+     }
+
+     consumer->second->Enabled( false );
+     IMultiQueueManager< Key, Value >::consumers_.erase( id );
+     return State::Ok;
+}
+
+template<typename Key, typename Value>
+State InlineQueueManager< Key, Value >::Unsubscribe( const Key &id, ConsumerPtr< Value > )
+{
+     return Unsubscribe( id );
+}
+
+template<typename Key, typename Value>
+std::size_t InlineQueueManager< Key, Value >::Flush()
+{
+     std::scoped_lock lock( IMultiQueueManager< Key, Value >::mtx_ );
+     std::size_t consumed = 0;
+     for ( const auto &consumer : IMultiQueueManager< Key, Value >::consumers_ )
+     {
+          auto queue = IMultiQueueManager< Key, Value >::queues_.find( consumer.first );
+          if ( queue != IMultiQueueManager< Key, Value >::queues_.end() )
+          {
+               consumed += FlushQueue( queue->second, consumer.second );
+          }
+     }
+
+     return consumed;
+}
+
+template<typename Key, typename Value>
+State InlineQueueManager< Key, Value >::Flush( const Key &id )
+{
+     std::scoped_lock lock( IMultiQueueManager< Key, Value >::mtx_ );
+     auto queue = IMultiQueueManager< Key, Value >::queues_.find( id );
+     if ( queue == IMultiQueueManager< Key, Value >::queues_.end() )
+     {
+          return State::QueueAbsent;
+     }
+
+     auto consumer = IMultiQueueManager< Key, Value >::consumers_.find( id );
+     if ( consumer != IMultiQueueManager< Key, Value >::consumers_.end() )
+     {
+          FlushQueue( queue->second, consumer->second );
+     }
+
+     return State::Ok;
+}
+
+template<typename Key, typename Value>
+bool InlineQueueManager< Key, Value >::ProducerRegistrationAllowed( Key ) const
+{
+     // producers push on manager's thread, so any count of them is allowed
+     return true;
+}
+
+template<typename Key, typename Value>
+std::size_t InlineQueueManager< Key, Value >::FlushQueue( const QueuePtr< Value > &queue,
+                                                          const ConsumerPtr< Value > &consumer )
+{
+     std::size_t consumed = 0;
+     while ( consumer->Enabled() && !queue->Empty() )
+     {
+          auto value = queue->Pop();
+          if ( !value.has_value() )
+          {
+               break;
+          }
+
+          consumer->ConsumeMoved( std::move( value.value() ));
+          consumed++;
+     }
+
+     return consumed;
+}
+
+} // namespace qm
+
+#endif // MQP_INLINE_QUEUE_MANAGER_H_
@@ -7,9 +7,11 @@
 
 #include <map>
 #include <thread>
+#include <type_traits>
 
 #include <boost/container/flat_map.hpp>
 
+#include "buffer/numa.hpp"
 #include "queue/base_queue.hpp"
 #include "consumer/base_consumer.hpp"
 #include "manager/base_mqueue_manager.hpp"
@@ -19,14 +21,15 @@ namespace qm
 
 /// @brief SMulti producer single consumer queue manager.
 /// Used when required to create consumer thread for each queue and important that values will proceed consistently.
-/// @tparam Key Type for queues map store. Key must be comparable by operator<
+/// @tparam Key Type for queues map store. Key must be comparable by operator< and hashable by std::hash
 /// @tparam Value Type for queue store
 template<typename Key, typename Value>
 class MPSCQueueManager : public IMultiQueueManager< Key, Value >
 {
 public:
      /// @brief multi producer single consumer manager constructor
-     explicit MPSCQueueManager() = default;
+     /// @param resource Memory resource for manager registries, see IMultiQueueManager
+     explicit MPSCQueueManager( std::pmr::memory_resource *resource = std::pmr::get_default_resource() );
 
      /// @brief destructor
      virtual ~MPSCQueueManager();
@@ -68,9 +71,16 @@ protected:
 private:
      State StartConsumerThread( const Key &id, ConsumerPtr <Value> consumer, QueuePtr <Value> queue );
 
-     boost::container::flat_map< Key, std::thread > consumer_threads_;
+     boost::container::flat_map< Key, std::thread, std::less< Key >,
+                                 typename IMultiQueueManager< Key, Value >::template Allocator< std::thread > > consumer_threads_;
 };
 
+template<typename Key, typename Value>
+MPSCQueueManager< Key, Value >::MPSCQueueManager( std::pmr::memory_resource *resource ) :
+     IMultiQueueManager< Key, Value >( resource ),
+     consumer_threads_( typename decltype( consumer_threads_ )::allocator_type( resource ))
+{}
+
 template<typename Key, typename Value>
 MPSCQueueManager< Key, Value >::~MPSCQueueManager()
 {
@@ -115,15 +125,39 @@ void MPSCQueueManager< Key, Value >::StartProcessing()
 template<typename Key, typename Value>
 State MPSCQueueManager< Key, Value >::StartConsumerThread( const Key &id, ConsumerPtr< Value > consumer, QueuePtr< Value > queue )
 {
-     auto thread_lambda = [ this, id, queue, consumer ]()
+     // manager owns queue and consumer until thread is joined, so thread borrows them without refcounting
+     auto thread_lambda = [ this, queue = queue.get(), consumer = consumer.get() ]()
      {
-          while ( ( consumer->Enabled() && IMultiQueueManager< Key, Value >::is_enabled_ && queue->Enabled() ) ||
-                 !queue->Empty() )
+          // storage allocated by thread of AddQueue is moved to memory local to consumer
+          queue->BindToNode( CurrentNumaNode() );
+
+          auto running = [ & ]()
+          {
+               return ( consumer->Enabled() && IMultiQueueManager< Key, Value >::is_enabled_ && queue->Enabled() ) ||
+                      !queue->Empty();
+          };
+
+          if constexpr ( std::is_default_constructible_v< Value > )
+          {
+               // values are moved through one object, consumer may take ownership of payload
+               Value value;
+               while ( running() )
+               {
+                    if ( queue->TryPop( value ))
+                    {
+                         consumer->ConsumeMoved( std::move( value ));
+                    }
+               }
+          }
+          else
           {
-               auto value = queue->Pop();
-               if ( value.has_value() )
+               while ( running() )
                {
-                    consumer->Consume( value.value() );
+                    auto value = queue->Pop();
+                    if ( value.has_value() )
+                    {
+                         consumer->ConsumeMoved( std::move( value.value() ));
+                    }
                }
           }
      };
@@ -149,6 +183,7 @@ State MPSCQueueManager< Key, Value >::Subscribe( const Key &id, ConsumerPtr< Val
      }
 
      IMultiQueueManager< Key, Value >::consumers_.emplace( id, consumer );
+     queue_it->second->AttachConsumer( consumer );
      return StartConsumerThread( id, consumer, queue_it->second );
 }
 
@@ -176,6 +211,12 @@ State MPSCQueueManager< Key, Value >::Unsubscribe( const Key &id )
 
           consumer_threads_.erase( id );
 
+          auto queue = IMultiQueueManager< Key, Value >::queues_.find( id );
+          if ( queue != IMultiQueueManager< Key, Value >::queues_.end() )
+          {
+               queue->second->DetachConsumer();
+          }
+
           IMultiQueueManager< Key, Value >::consumers_.erase( id );
           return State::Ok;
      }
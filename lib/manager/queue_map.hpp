@@ -0,0 +1,586 @@
+/// @brief Registry of managed queues selected by key traits
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_QUEUE_MAP_H_
+#define MQP_QUEUE_MAP_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/container/flat_map.hpp>
+
+#include "manager/epoch_domain.hpp"
+
+namespace qm
+{
+
+/// @brief Traits of manager keys.
+/// Integral keys below DenseLimit index registry array directly, other keys use ordered map.
+/// Specialize for own key type to change DenseLimit, 0 keeps ordered map.
+/// @tparam Key Type of key
+template< typename Key, typename = void >
+struct KeyTraits
+{
+     static constexpr std::size_t DenseLimit = 0;
+};
+
+template< typename Key >
+struct KeyTraits< Key, std::enable_if_t< std::is_integral_v< Key > && !std::is_same_v< Key, bool > > >
+{
+     static constexpr std::size_t DenseLimit = std::size_t{ 1 } << 20;
+};
+
+/// @brief Map-like registry for integral keys.
+/// Values are stored contiguously, key below DenseLimit finds its value position by one array index.
+/// Index array grows up to the biggest such key. Keys out of range ( e.g. negative ) fall back to ordered map.
+/// Iteration order is not sorted, erase moves the last value to the freed position.
+/// @tparam Key Integral key type
+/// @tparam Mapped Type of stored value
+/// @tparam Allocator Allocator of std::pair< Key, Mapped >, rebound for index arrays
+template< typename Key, typename Mapped, typename Allocator = std::allocator< std::pair< Key, Mapped > > >
+class DenseQueueMap
+{
+     template< typename T >
+     using Rebind = typename std::allocator_traits< Allocator >::template rebind_alloc< T >;
+
+public:
+     using key_type = Key;
+     using mapped_type = Mapped;
+     using value_type = std::pair< Key, Mapped >;
+     using allocator_type = Allocator;
+     using iterator = typename std::vector< value_type, Allocator >::iterator;
+     using const_iterator = typename std::vector< value_type, Allocator >::const_iterator;
+
+     static constexpr std::size_t DenseLimit = KeyTraits< Key >::DenseLimit;
+
+     /// @brief Constructor
+     DenseQueueMap() = default;
+
+     /// @brief Constructor
+     /// @param allocator Allocator of values and index
+     explicit DenseQueueMap( const Allocator &allocator );
+
+     /// @brief Get allocator
+     /// @return Allocator
+     allocator_type get_allocator() const { return values_.get_allocator(); }
+
+     /// @brief Find value by key
+     /// @param key Key
+     /// @return Iterator to value or end()
+     iterator find( const Key &key );
+
+     /// @brief Find value by key
+     /// @param key Key
+     /// @return Iterator to value or end()
+     const_iterator find( const Key &key ) const;
+
+     /// @brief Insert value if key is absent
+     /// @param key Key
+     /// @param mapped Value
+     /// @return Iterator to value with key and true if value is inserted
+     std::pair< iterator, bool > emplace( const Key &key, Mapped mapped );
+
+     /// @brief Erase value, iterators to the last value are invalidated
+     /// @param it Iterator to value
+     /// @return Iterator to value moved to erased position
+     iterator erase( const_iterator it );
+
+     /// @brief Erase value by key
+     /// @param key Key
+     /// @return Count of erased values
+     std::size_t erase( const Key &key );
+
+     iterator begin() { return values_.begin(); }
+
+     iterator end() { return values_.end(); }
+
+     const_iterator begin() const { return values_.begin(); }
+
+     const_iterator end() const { return values_.end(); }
+
+     std::size_t size() const { return values_.size(); }
+
+     bool empty() const { return values_.empty(); }
+
+private:
+     static constexpr std::uint32_t Absent = 0;  ///< positions are stored incremented by one
+
+     std::size_t Position( const Key &key ) const;
+
+     void SetPosition( const Key &key, std::size_t position );
+
+private:
+     std::vector< value_type, Allocator > values_;
+     std::vector< std::uint32_t, Rebind< std::uint32_t > > index_;
+     boost::container::flat_map< Key, std::uint32_t, std::less< Key >, Rebind< std::pair< Key, std::uint32_t > > > overflow_;
+};
+
+/// @brief Queues registry of manager: DenseQueueMap for dense keys, ordered flat_map otherwise
+template< typename Key, typename Mapped, typename Allocator = std::allocator< std::pair< Key, Mapped > > >
+using QueueMap = std::conditional_t< ( KeyTraits< Key >::DenseLimit > 0 ),
+                                     DenseQueueMap< Key, Mapped, Allocator >,
+                                     boost::container::flat_map< Key, Mapped, std::less< Key >, Allocator > >;
+
+/// @brief Lock free lookup of queues published by manager for Enqueue.
+/// Open addressing hash table of entries holding raw pointers to queues owned by manager registry,
+/// so publishing queue copies neither registry nor shared_ptr. Insert and Erase are serialized by manager lock
+/// and cost O(1) amortized: table is rebuilt only when it gets half full. Readers pinned in EpochDomain
+/// look up without locks, replaced tables and erased entries are retired to the domain.
+/// Memory comes from default heap, as retired parts are reclaimed outside manager lock.
+/// @tparam Key Key type hashable by std::hash and comparable by operator==
+/// @tparam T Type of queue
+template< typename Key, typename T >
+class PublishedQueueMap
+{
+public:
+     /// @brief Constructor
+     /// @param epochs Domain readers are pinned in, it must outlive map
+     explicit PublishedQueueMap( EpochDomain &epochs );
+
+     /// @brief Destructor, no readers must be pinned
+     ~PublishedQueueMap();
+
+     /// @brief Copying is forbidden
+     PublishedQueueMap( const PublishedQueueMap & ) = delete;
+
+     /// @brief Copying is forbidden
+     PublishedQueueMap &operator=( const PublishedQueueMap & ) = delete;
+
+     /// @brief Find queue by key
+     /// @param key Key
+     /// @return Pointer to queue or nullptr, valid while caller keeps guard of epoch domain
+     /// @details Thread safe, lock free. Caller must be pinned in epoch domain.
+     T *Find( const Key &key ) const;
+
+     /// @brief Publish queue for key, replaces queue published before
+     /// @param key Key
+     /// @param queue Pointer to queue
+     /// @attention Writers must be serialized
+     void Insert( const Key &key, T *queue );
+
+     /// @brief Unpublish queue of key. Queue must stay alive until readers pinned before the call are gone.
+     /// @param key Key
+     /// @attention Writers must be serialized
+     void Erase( const Key &key );
+
+private:
+     /// @brief Entry is never moved, erased entry keeps its slot with nullptr queue until table is rebuilt
+     struct Entry
+     {
+          Entry( const Key &key, T *queue ) : key_( key ), queue_( queue ) {}
+
+          const Key key_;
+          std::atomic< T * > queue_;
+     };
+
+     struct Table
+     {
+          explicit Table( std::size_t bits );
+
+          std::size_t Home( const Key &key ) const;
+
+          const std::size_t bits_;
+          const std::size_t mask_;
+          std::unique_ptr< std::atomic< Entry * >[] > slots_;
+     };
+
+     Entry *FindEntry( const Table &table, const Key &key ) const;
+
+     void Rebuild();
+
+private:
+     EpochDomain &epochs_;
+     std::atomic< Table * > table_;
+     std::size_t used_;  ///< slots holding entries including erased ones, writers only
+     std::size_t live_;  ///< entries with queue, writers only
+};
+
+/// @brief Lock free lookup of queues published by manager for Enqueue, for integral keys.
+/// Key below DenseLimit indexes array of pointers to queues directly, so lookup is one load of array
+/// and one load of its slot. Array grows up to the biggest such key, replaced arrays are retired to EpochDomain.
+/// Other keys ( e.g. negative ) fall back to hashed PublishedQueueMap.
+/// @tparam Key Integral key type
+/// @tparam T Type of queue
+template< typename Key, typename T >
+class DensePublishedQueueMap
+{
+public:
+     static constexpr std::size_t DenseLimit = KeyTraits< Key >::DenseLimit;
+
+     /// @brief Constructor
+     /// @param epochs Domain readers are pinned in, it must outlive map
+     explicit DensePublishedQueueMap( EpochDomain &epochs );
+
+     /// @brief Destructor, no readers must be pinned
+     ~DensePublishedQueueMap();
+
+     /// @brief Copying is forbidden
+     DensePublishedQueueMap( const DensePublishedQueueMap & ) = delete;
+
+     /// @brief Copying is forbidden
+     DensePublishedQueueMap &operator=( const DensePublishedQueueMap & ) = delete;
+
+     /// @brief Find queue by key
+     /// @param key Key
+     /// @return Pointer to queue or nullptr, valid while caller keeps guard of epoch domain
+     /// @details Thread safe, lock free. Caller must be pinned in epoch domain.
+     T *Find( const Key &key ) const;
+
+     /// @brief Publish queue for key, replaces queue published before
+     /// @param key Key
+     /// @param queue Pointer to queue
+     /// @attention Writers must be serialized
+     void Insert( const Key &key, T *queue );
+
+     /// @brief Unpublish queue of key. Queue must stay alive until readers pinned before the call are gone.
+     /// @param key Key
+     /// @attention Writers must be serialized
+     void Erase( const Key &key );
+
+private:
+     void Grow( std::size_t size );
+
+private:
+     EpochDomain &epochs_;
+     // array is published before its size, so reader seeing size sees array at least that long
+     std::atomic< std::atomic< T * > * > slots_;
+     std::atomic< std::size_t > size_;
+     PublishedQueueMap< Key, T > overflow_;
+};
+
+/// @brief Published lookup of manager: DensePublishedQueueMap for dense keys, hashed PublishedQueueMap otherwise
+template< typename Key, typename T >
+using PublishedMap = std::conditional_t< ( KeyTraits< Key >::DenseLimit > 0 ),
+                                         DensePublishedQueueMap< Key, T >,
+                                         PublishedQueueMap< Key, T > >;
+
+template< typename Key, typename Mapped, typename Allocator >
+DenseQueueMap< Key, Mapped, Allocator >::DenseQueueMap( const Allocator &allocator ) : values_( allocator ),
+                                                                                      index_( allocator ),
+                                                                                      overflow_( allocator )
+{}
+
+template< typename Key, typename Mapped, typename Allocator >
+typename DenseQueueMap< Key, Mapped, Allocator >::iterator DenseQueueMap< Key, Mapped, Allocator >::find( const Key &key )
+{
+     auto position = Position( key );
+     return position == Absent ? values_.end() : values_.begin() + ( position - 1 );
+}
+
+template< typename Key, typename Mapped, typename Allocator >
+typename DenseQueueMap< Key, Mapped, Allocator >::const_iterator DenseQueueMap< Key, Mapped, Allocator >::find( const Key &key ) const
+{
+     auto position = Position( key );
+     return position == Absent ? values_.end() : values_.begin() + ( position - 1 );
+}
+
+template< typename Key, typename Mapped, typename Allocator >
+std::pair< typename DenseQueueMap< Key, Mapped, Allocator >::iterator, bool >
+DenseQueueMap< Key, Mapped, Allocator >::emplace( const Key &key, Mapped mapped )
+{
+     auto it = find( key );
+     if ( it != values_.end() )
+     {
+          return { it, false };
+     }
+
+     values_.emplace_back( key, std::move( mapped ));
+     SetPosition( key, values_.size() );
+     return { values_.end() - 1, true };
+}
+
+template< typename Key, typename Mapped, typename Allocator >
+typename DenseQueueMap< Key, Mapped, Allocator >::iterator DenseQueueMap< Key, Mapped, Allocator >::erase( const_iterator it )
+{
+     auto position = static_cast< std::size_t >( it - values_.cbegin() );
+     SetPosition( it->first, Absent );
+     if ( position + 1 != values_.size() )
+     {
+          values_[ position ] = std::move( values_.back() );
+          SetPosition( values_[ position ].first, position + 1 );
+     }
+
+     values_.pop_back();
+     return values_.begin() + position;
+}
+
+template< typename Key, typename Mapped, typename Allocator >
+std::size_t DenseQueueMap< Key, Mapped, Allocator >::erase( const Key &key )
+{
+     auto it = find( key );
+     if ( it == values_.end() )
+     {
+          return 0;
+     }
+
+     erase( it );
+     return 1;
+}
+
+template< typename Key, typename Mapped, typename Allocator >
+std::size_t DenseQueueMap< Key, Mapped, Allocator >::Position( const Key &key ) const
+{
+     // negative keys are converted to huge indexes and go to overflow map
+     auto index = static_cast< std::size_t >( key );
+     if ( index < DenseLimit )
+     {
+          return index < index_.size() ? index_[ index ] : Absent;
+     }
+
+     auto it = overflow_.find( key );
+     return it == overflow_.end() ? Absent : it->second;
+}
+
+template< typename Key, typename Mapped, typename Allocator >
+void DenseQueueMap< Key, Mapped, Allocator >::SetPosition( const Key &key, std::size_t position )
+{
+     auto index = static_cast< std::size_t >( key );
+     if ( index < DenseLimit )
+     {
+          if ( index >= index_.size() )
+          {
+               index_.resize( index + 1, Absent );
+          }
+          index_[ index ] = static_cast< std::uint32_t >( position );
+     }
+     else if ( position == Absent )
+     {
+          overflow_.erase( key );
+     }
+     else
+     {
+          overflow_[ key ] = static_cast< std::uint32_t >( position );
+     }
+}
+
+template< typename Key, typename T >
+PublishedQueueMap< Key, T >::Table::Table( std::size_t bits ) : bits_( bits ),
+                                                                mask_( ( std::size_t{ 1 } << bits ) - 1 ),
+                                                                slots_( new std::atomic< Entry * >[ mask_ + 1 ]() )
+{}
+
+template< typename Key, typename T >
+std::size_t PublishedQueueMap< Key, T >::Table::Home( const Key &key ) const
+{
+     // fibonacci hashing spreads keys differing in high bits only ( e.g. integral keys with common stride )
+     const std::uint64_t hash = static_cast< std::uint64_t >( std::hash< Key >()( key ));
+     return static_cast< std::size_t >(( hash * 0x9E3779B97F4A7C15ULL ) >> ( 64 - bits_ ));
+}
+
+template< typename Key, typename T >
+PublishedQueueMap< Key, T >::PublishedQueueMap( EpochDomain &epochs ) : epochs_( epochs ),
+                                                                        table_( new Table( 4 )),
+                                                                        used_( 0 ),
+                                                                        live_( 0 )
+{}
+
+template< typename Key, typename T >
+PublishedQueueMap< Key, T >::~PublishedQueueMap()
+{
+     auto *table = table_.load();
+     for ( std::size_t i = 0; i <= table->mask_; i++ )
+     {
+          delete table->slots_[ i ].load();
+     }
+     delete table;
+}
+
+template< typename Key, typename T >
+T *PublishedQueueMap< Key, T >::Find( const Key &key ) const
+{
+     auto *entry = FindEntry( *table_.load( std::memory_order_acquire ), key );
+     return entry == nullptr ? nullptr : entry->queue_.load( std::memory_order_acquire );
+}
+
+template< typename Key, typename T >
+void PublishedQueueMap< Key, T >::Insert( const Key &key, T *queue )
+{
+     auto *table = table_.load( std::memory_order_relaxed );
+     if ( auto *entry = FindEntry( *table, key ))
+     {
+          live_ += entry->queue_.load( std::memory_order_relaxed ) == nullptr ? 1 : 0;
+          entry->queue_.store( queue, std::memory_order_release );
+          return;
+     }
+
+     // table is kept at most half full, so probing is short and always finds empty slot
+     if ( ( used_ + 1 ) * 2 > table->mask_ + 1 )
+     {
+          Rebuild();
+          table = table_.load( std::memory_order_relaxed );
+     }
+
+     auto i = table->Home( key );
+     while ( table->slots_[ i ].load( std::memory_order_relaxed ) != nullptr )
+     {
+          i = ( i + 1 ) & table->mask_;
+     }
+     table->slots_[ i ].store( new Entry( key, queue ), std::memory_order_release );
+     used_++;
+     live_++;
+}
+
+template< typename Key, typename T >
+void PublishedQueueMap< Key, T >::Erase( const Key &key )
+{
+     auto *entry = FindEntry( *table_.load( std::memory_order_relaxed ), key );
+     if ( entry != nullptr && entry->queue_.load( std::memory_order_relaxed ) != nullptr )
+     {
+          entry->queue_.store( nullptr, std::memory_order_release );
+          live_--;
+     }
+}
+
+template< typename Key, typename T >
+typename PublishedQueueMap< Key, T >::Entry *PublishedQueueMap< Key, T >::FindEntry( const Table &table,
+                                                                                    const Key &key ) const
+{
+     for ( auto i = table.Home( key );; i = ( i + 1 ) & table.mask_ )
+     {
+          auto *entry = table.slots_[ i ].load( std::memory_order_acquire );
+          if ( entry == nullptr || entry->key_ == key )
+          {
+               return entry;
+          }
+     }
+}
+
+template< typename Key, typename T >
+void PublishedQueueMap< Key, T >::Rebuild()
+{
+     // live entries move to new table at most quarter full, erased ones are dropped with old table
+     std::size_t bits = 4;
+     while ( ( std::size_t{ 1 } << bits ) < ( live_ + 1 ) * 4 )
+     {
+          bits++;
+     }
+
+     auto *old = table_.load( std::memory_order_relaxed );
+     auto *table = new Table( bits );
+     std::vector< Entry * > erased;
+     for ( std::size_t i = 0; i <= old->mask_; i++ )
+     {
+          auto *entry = old->slots_[ i ].load( std::memory_order_relaxed );
+          if ( entry == nullptr )
+          {
+               continue;
+          }
+
+          if ( entry->queue_.load( std::memory_order_relaxed ) == nullptr )
+          {
+               erased.push_back( entry );
+               continue;
+          }
+
+          auto j = table->Home( entry->key_ );
+          while ( table->slots_[ j ].load( std::memory_order_relaxed ) != nullptr )
+          {
+               j = ( j + 1 ) & table->mask_;
+          }
+          table->slots_[ j ].store( entry, std::memory_order_relaxed );
+     }
+
+     table_.store( table, std::memory_order_release );
+     used_ = live_;
+     epochs_.RetireFn( [ old, erased = std::move( erased ) ]()
+     {
+          for ( auto *entry : erased )
+          {
+               delete entry;
+          }
+          delete old;
+     } );
+}
+
+template< typename Key, typename T >
+DensePublishedQueueMap< Key, T >::DensePublishedQueueMap( EpochDomain &epochs ) : epochs_( epochs ),
+                                                                                  slots_( nullptr ),
+                                                                                  size_( 0 ),
+                                                                                  overflow_( epochs )
+{}
+
+template< typename Key, typename T >
+DensePublishedQueueMap< Key, T >::~DensePublishedQueueMap()
+{
+     delete[] slots_.load();
+}
+
+template< typename Key, typename T >
+T *DensePublishedQueueMap< Key, T >::Find( const Key &key ) const
+{
+     // negative keys are converted to huge indexes and go to overflow map
+     auto index = static_cast< std::size_t >( key );
+     if ( index < DenseLimit )
+     {
+          return index < size_.load( std::memory_order_acquire ) ?
+                 slots_.load( std::memory_order_acquire )[ index ].load( std::memory_order_acquire ) : nullptr;
+     }
+
+     return overflow_.Find( key );
+}
+
+template< typename Key, typename T >
+void DensePublishedQueueMap< Key, T >::Insert( const Key &key, T *queue )
+{
+     auto index = static_cast< std::size_t >( key );
+     if ( index < DenseLimit )
+     {
+          Grow( index + 1 );
+          slots_.load( std::memory_order_relaxed )[ index ].store( queue, std::memory_order_release );
+     }
+     else
+     {
+          overflow_.Insert( key, queue );
+     }
+}
+
+template< typename Key, typename T >
+void DensePublishedQueueMap< Key, T >::Erase( const Key &key )
+{
+     auto index = static_cast< std::size_t >( key );
+     if ( index >= DenseLimit )
+     {
+          overflow_.Erase( key );
+     }
+     else if ( index < size_.load( std::memory_order_relaxed ))
+     {
+          slots_.load( std::memory_order_relaxed )[ index ].store( nullptr, std::memory_order_release );
+     }
+}
+
+template< typename Key, typename T >
+void DensePublishedQueueMap< Key, T >::Grow( std::size_t size )
+{
+     auto old_size = size_.load( std::memory_order_relaxed );
+     if ( size <= old_size )
+     {
+          return;
+     }
+
+     // doubling keeps copying O(1) amortized per insert
+     size = std::min( std::max( { size, old_size * 2, std::size_t{ 16 } } ), DenseLimit );
+     auto *old = slots_.load( std::memory_order_relaxed );
+     auto *slots = new std::atomic< T * >[ size ]();
+     for ( std::size_t i = 0; i < old_size; i++ )
+     {
+          slots[ i ].store( old[ i ].load( std::memory_order_relaxed ), std::memory_order_relaxed );
+     }
+
+     slots_.store( slots, std::memory_order_release );
+     size_.store( size, std::memory_order_release );
+     if ( old != nullptr )
+     {
+          epochs_.RetireFn( [ old ]() { delete[] old; } );
+     }
+}
+
+} // qm
+
+#endif // MQP_QUEUE_MAP_H_
@@ -0,0 +1,56 @@
+/// @brief Borrowed handle to queue registered in manager
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_QUEUE_REF_H_
+#define MQP_QUEUE_REF_H_
+
+#include <memory>
+#include <utility>
+
+#include "queue/base_queue.hpp"
+
+namespace qm
+{
+
+/// @brief Borrowed handle to queue registered in manager.
+/// Handle pins the queue itself: borrowing copies queue ownership once, dereferencing doesn't touch
+/// shared_ptr reference counter, so handle is intended for hot paths of long living producers.
+/// Queue removed from manager while handle is alive is disabled, but not destroyed until handle is released.
+/// Handle doesn't hold any slot of manager epoch domain and doesn't delay reclamation of other queues.
+/// @tparam Value Type for queue store
+/// @tparam Queue Type of queue
+template<typename Value, typename Queue = IQueue< Value >>
+class QueueRef
+{
+public:
+     QueueRef() = default;
+
+     /// @brief Constructor
+     /// @param queue Queue owned by manager
+     explicit QueueRef( std::shared_ptr< Queue > queue ) : queue_( std::move( queue )) {}
+
+     Queue *operator->() const { return queue_.get(); }
+
+     Queue &operator*() const { return *queue_; }
+
+     explicit operator bool() const { return queue_ != nullptr; }
+
+     /// @brief Get raw pointer to queue, valid while handle is alive
+     /// @return Pointer
+     Queue *Get() const { return queue_.get(); }
+
+private:
+     std::shared_ptr< Queue > queue_;
+};
+
+template<typename Value>
+struct QueueRefResult
+{
+     QueueRef< Value > queue_;
+     State s_;
+};
+
+} // qm
+
+#endif // MQP_QUEUE_REF_H_
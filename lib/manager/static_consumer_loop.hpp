@@ -0,0 +1,64 @@
+/// @brief Consumer thread loop for queue and consumer types known at compile time
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_STATIC_CONSUMER_LOOP_H_
+#define MQP_STATIC_CONSUMER_LOOP_H_
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+#include "buffer/numa.hpp"
+
+namespace qm
+{
+
+/// @brief Body of consumer thread shared by StaticMPSCQueueManager and StaticTopology.
+/// Pops values from queue and passes them to consumer until consumer, manager or queue is disabled,
+/// queue is drained before return. Calls are qualified, so they are not dispatched through vtable.
+/// Queue and consumer are borrowed, owner keeps them alive until thread is joined.
+/// @tparam Queue Concrete queue type
+/// @tparam Consumer Concrete consumer type
+/// @param queue Queue to consume
+/// @param consumer Consumer of values
+/// @param enabled Manager enable flag
+template< typename Queue, typename Consumer >
+void StaticConsumerLoop( Queue &queue, Consumer &consumer, const std::atomic< bool > &enabled )
+{
+     using Value = typename Queue::ValueType;
+
+     queue.Queue::BindToNode( CurrentNumaNode() );
+
+     auto running = [ & ]()
+     {
+          return ( consumer.Enabled() && enabled && queue.Enabled() ) || !queue.Queue::Empty();
+     };
+
+     if constexpr ( std::is_default_constructible_v< Value > )
+     {
+          Value value;
+          while ( running() )
+          {
+               if ( queue.Queue::TryPop( value ))
+               {
+                    consumer.Consumer::ConsumeMoved( std::move( value ));
+               }
+          }
+     }
+     else
+     {
+          while ( running() )
+          {
+               auto value = queue.Queue::Pop();
+               if ( value.has_value() )
+               {
+                    consumer.Consumer::ConsumeMoved( std::move( value.value() ));
+               }
+          }
+     }
+}
+
+} // qm
+
+#endif // MQP_STATIC_CONSUMER_LOOP_H_
@@ -0,0 +1,393 @@
+#pragma once
+
+#ifndef MQP_STATIC_MPSC_QUEUE_MANAGER_H_
+#define MQP_STATIC_MPSC_QUEUE_MANAGER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include <boost/container/flat_map.hpp>
+
+#include "manager/epoch_domain.hpp"
+#include "manager/queue_map.hpp"
+#include "manager/queue_ref.hpp"
+#include "manager/static_consumer_loop.hpp"
+#include "queue/base_queue.hpp"
+#include "consumer/base_consumer.hpp"
+
+namespace qm
+{
+
+/// @brief Multi producer single consumer queue manager with queue and consumer types known at compile time.
+/// Behaviour is equal to MPSCQueueManager, but queues and consumers are stored by concrete types and
+/// Push, Pop and Consume are called with qualified names, so they are bound statically and may be inlined.
+/// Producers push to queues got by GetQueue from own threads or use Enqueue.
+/// @tparam Key Type for queues map store. Key must be comparable by operator<,
+/// integral keys are indexed directly ( see KeyTraits )
+/// @tparam Queue Concrete queue type derived from IQueue
+/// @tparam Consumer Concrete consumer type derived from IConsumer
+template<typename Key, typename Queue, typename Consumer>
+class StaticMPSCQueueManager
+{
+public:
+     using Value = typename Queue::ValueType;
+     using StaticQueuePtr = std::shared_ptr< Queue >;
+     using StaticConsumerPtr = std::shared_ptr< Consumer >;
+
+     static_assert( std::is_base_of_v< IQueue< Value >, Queue >, "Queue must be derived from IQueue" );
+     static_assert( std::is_base_of_v< IConsumer< Value >, Consumer >, "Consumer must be derived from IConsumer" );
+
+     /// @brief Constructor
+     /// @param resource Memory resource for registries of queues, consumers and threads.
+     /// It is used under manager lock only and must outlive manager.
+     explicit StaticMPSCQueueManager( std::pmr::memory_resource *resource = std::pmr::get_default_resource() );
+
+     /// @brief Destructor
+     ~StaticMPSCQueueManager();
+
+     /// @brief Copying is forbidden
+     StaticMPSCQueueManager( const StaticMPSCQueueManager & ) = delete;
+
+     /// @brief Copying is forbidden
+     StaticMPSCQueueManager &operator=( const StaticMPSCQueueManager & ) = delete;
+
+     /// @brief Stop all consumers and disable queues
+     void StopProcessing();
+
+     /// @brief Enable all consumers and queues, start consumers threads
+     void StartProcessing();
+
+     /// @brief Add new queue for management, queue storage is prefaulted before queue is published
+     /// @param id Key to access and control queue
+     /// @param queue Pointer to queue
+     /// @return State value
+     /// @details Thread safe
+     State AddQueue( const Key &id, StaticQueuePtr queue );
+
+     /// @brief Remove queue and unsubscribe its consumer
+     /// @param id Key to find queue
+     /// @return State value
+     /// @details Thread safe
+     State RemoveQueue( const Key &id );
+
+     /// @brief Change maximal size of queue while producers and consumer keep running
+     /// @param id Key to find queue
+     /// @param size New maximal size
+     /// @return State::QueueAbsent or State of queue Resize
+     /// @details Thread safe
+     State Resize( const Key &id, std::size_t size );
+
+     /// @brief Get queue stored with specified id
+     /// @param id Key to get queue
+     /// @return Pointer to queue or nullptr if queue is absent
+     /// @details Thread safe
+     StaticQueuePtr GetQueue( const Key &id ) const;
+
+     /// @brief Borrow queue stored with specified id for pushes from hot path.
+     /// Queue removed meanwhile stays alive until handle is released ( see QueueRef ).
+     /// @param id Key to get queue
+     /// @return Handle to queue, empty if queue is absent
+     /// @details Thread safe
+     QueueRef< Value, Queue > BorrowQueue( const Key &id ) const;
+
+     /// @brief Check are all queue empty
+     /// @return true/false
+     /// @details Thread safe
+     bool AreAllQueuesEmpty() const;
+
+     /// @brief Subscribe consumer to queue, starts consumer thread
+     /// @param id Key to find queue
+     /// @param consumer Consumer for subscribe
+     /// @return State value
+     /// @details Thread safe
+     State Subscribe( const Key &id, StaticConsumerPtr consumer );
+
+     /// @brief Unsubscribe consumer from queue
+     /// @param id Key to find queue
+     /// @return State value
+     /// @attention Unsubscribe from blocking queue may lead to producers threads locks waiting for free space.
+     /// @details Thread safe
+     State Unsubscribe( const Key &id );
+
+     /// @brief Enqueue new value to queue with id
+     /// @param id Key to find queue
+     /// @param value Lvalue object to push
+     /// @return State value
+     /// @details Thread safe
+     State Enqueue( const Key &id, const Value &value );
+
+     /// @brief Enqueue new value to queue with id
+     /// @param id Key to find queue
+     /// @param value Rvalue object to push
+     /// @return State value
+     /// @details Thread safe
+     State Enqueue( const Key &id, Value &&value );
+
+private:
+     template< typename T >
+     using Allocator = std::pmr::polymorphic_allocator< std::pair< Key, T > >;
+
+     template< typename T >
+     using Map = boost::container::flat_map< Key, T, std::less< Key >, Allocator< T > >;
+
+     template< typename V >
+     State EnqueueFwd( const Key &id, V &&value );
+
+     void StartConsumerThread( const Key &id, const StaticConsumerPtr &consumer, const StaticQueuePtr &queue );
+
+private:
+     mutable std::recursive_mutex mtx_;
+     CacheAligned< std::atomic< bool > > is_enabled_;  ///< read by consumers threads on every message
+
+     QueueMap< Key, StaticQueuePtr, Allocator< StaticQueuePtr > > queues_;
+     Map< StaticConsumerPtr > consumers_;
+     Map< std::thread > consumer_threads_;
+     EpochDomain epochs_;  ///< pinned by Enqueue
+     PublishedMap< Key, Queue > published_;  ///< read by Enqueue under epoch guard, written under mtx_
+};
+
+template<typename Key, typename Queue, typename Consumer>
+StaticMPSCQueueManager< Key, Queue, Consumer >::StaticMPSCQueueManager( std::pmr::memory_resource *resource ) :
+     is_enabled_( true ),
+     queues_( Allocator< StaticQueuePtr >( resource )),
+     consumers_( Allocator< StaticConsumerPtr >( resource )),
+     consumer_threads_( Allocator< std::thread >( resource )),
+     published_( epochs_ )
+{}
+
+template<typename Key, typename Queue, typename Consumer>
+StaticMPSCQueueManager< Key, Queue, Consumer >::~StaticMPSCQueueManager()
+{
+     StopProcessing();
+}
+
+template<typename Key, typename Queue, typename Consumer>
+void StaticMPSCQueueManager< Key, Queue, Consumer >::StopProcessing()
+{
+     is_enabled_ = false;
+     std::scoped_lock lock( mtx_ );
+     for ( auto &queue : queues_ )
+     {
+          queue.second->Stop();
+     }
+
+     for ( auto &consumer : consumers_ )
+     {
+          consumer.second->Enabled( false );
+     }
+
+     for ( auto &thread : consumer_threads_ )
+     {
+          if ( thread.second.joinable() )
+          {
+               thread.second.join();
+          }
+     }
+
+     consumer_threads_.clear();
+}
+
+template<typename Key, typename Queue, typename Consumer>
+void StaticMPSCQueueManager< Key, Queue, Consumer >::StartProcessing()
+{
+     std::scoped_lock lock( mtx_ );
+     if ( is_enabled_ )
+     {
+          return;
+     }
+
+     is_enabled_ = true;
+     for ( auto &queue : queues_ )
+     {
+          queue.second->Enabled( true );
+     }
+
+     for ( auto &consumer : consumers_ )
+     {
+          consumer.second->Enabled( true );
+          auto queue = queues_.find( consumer.first );
+          if ( queue != queues_.end() )
+          {
+               StartConsumerThread( consumer.first, consumer.second, queue->second );
+          }
+     }
+}
+
+template<typename Key, typename Queue, typename Consumer>
+State StaticMPSCQueueManager< Key, Queue, Consumer >::AddQueue( const Key &id, StaticQueuePtr queue )
+{
+     queue->Prefault();
+
+     std::scoped_lock lock( mtx_ );
+     if ( queues_.find( id ) != queues_.end() )
+     {
+          return State::QueueExists;
+     }
+
+     queues_.emplace( id, queue );
+     queue->Enabled( true );
+     published_.Insert( id, queue.get() );
+     return State::Ok;
+}
+
+template<typename Key, typename Queue, typename Consumer>
+State StaticMPSCQueueManager< Key, Queue, Consumer >::RemoveQueue( const Key &id )
+{
+     std::scoped_lock lock( mtx_ );
+     auto it = queues_.find( id );
+     if ( it == queues_.end() )
+     {
+          return State::QueueAbsent;
+     }
+
+     auto queue = it->second;
+     queue->Enabled( false );
+     queues_.erase( it );
+     // Enqueue calls pinned now may still push to queue, they keep it alive
+     published_.Erase( id );
+     epochs_.RetireFn( [ queue ]() mutable { queue.reset(); } );
+
+     Unsubscribe( id );
+     queue->DetachConsumer();
+     return State::Ok;
+}
+
+template<typename Key, typename Queue, typename Consumer>
+State StaticMPSCQueueManager< Key, Queue, Consumer >::Resize( const Key &id, std::size_t size )
+{
+     // queue may block while resizing, so manager lock is not held
+     auto queue = GetQueue( id );
+     return queue ? queue->Resize( size ) : State::QueueAbsent;
+}
+
+template<typename Key, typename Queue, typename Consumer>
+typename StaticMPSCQueueManager< Key, Queue, Consumer >::StaticQueuePtr
+StaticMPSCQueueManager< Key, Queue, Consumer >::GetQueue( const Key &id ) const
+{
+     std::scoped_lock lock( mtx_ );
+     auto it = queues_.find( id );
+     return it == queues_.end() ? nullptr : it->second;
+}
+
+template<typename Key, typename Queue, typename Consumer>
+QueueRef< typename Queue::ValueType, Queue > StaticMPSCQueueManager< Key, Queue, Consumer >::BorrowQueue( const Key &id ) const
+{
+     std::scoped_lock lock( mtx_ );
+     auto it = queues_.find( id );
+     if ( it == queues_.end() )
+     {
+          return QueueRef< Value, Queue >();
+     }
+
+     return QueueRef< Value, Queue >( it->second );
+}
+
+template<typename Key, typename Queue, typename Consumer>
+bool StaticMPSCQueueManager< Key, Queue, Consumer >::AreAllQueuesEmpty() const
+{
+     std::scoped_lock lock( mtx_ );
+     return std::all_of( queues_.begin(), queues_.end(),
+                         []( const auto &queue ) { return queue.second->Queue::Empty(); } );
+}
+
+template<typename Key, typename Queue, typename Consumer>
+State StaticMPSCQueueManager< Key, Queue, Consumer >::Subscribe( const Key &id, StaticConsumerPtr consumer )
+{
+     std::scoped_lock lock( mtx_ );
+     if ( consumers_.find( id ) != consumers_.end() )
+     {
+          return State::QueueBusy;
+     }
+
+     auto queue = queues_.find( id );
+     if ( queue == queues_.end() )
+     {
+          return State::QueueAbsent;
+     }
+
+     consumers_.emplace( id, consumer );
+     queue->second->AttachConsumer( consumer );
+     if ( is_enabled_ )
+     {
+          StartConsumerThread( id, consumer, queue->second );
+     }
+
+     return State::Ok;
+}
+
+template<typename Key, typename Queue, typename Consumer>
+State StaticMPSCQueueManager< Key, Queue, Consumer >::Unsubscribe( const Key &id )
+{
+     std::scoped_lock lock( mtx_ );
+     auto consumer = consumers_.find( id );
+     if ( consumer == consumers_.end() )
+     {
+          return State::QueueAbsent;
+     }
+
+     consumer->second->Enabled( false );
+     auto thread = consumer_threads_.find( id );
+     if ( thread != consumer_threads_.end() )
+     {
+          thread->second.join();
+          consumer_threads_.erase( thread );
+     }
+
+     auto queue = queues_.find( id );
+     if ( queue != queues_.end() )
+     {
+          queue->second->DetachConsumer();
+     }
+
+     consumers_.erase( consumer );
+     return State::Ok;
+}
+
+template<typename Key, typename Queue, typename Consumer>
+State StaticMPSCQueueManager< Key, Queue, Consumer >::Enqueue( const Key &id, const Value &value )
+{
+     return EnqueueFwd( id, value );
+}
+
+template<typename Key, typename Queue, typename Consumer>
+State StaticMPSCQueueManager< Key, Queue, Consumer >::Enqueue( const Key &id, Value &&value )
+{
+     return EnqueueFwd( id, std::move( value ));
+}
+
+template<typename Key, typename Queue, typename Consumer>
+template< typename V >
+State StaticMPSCQueueManager< Key, Queue, Consumer >::EnqueueFwd( const Key &id, V &&value )
+{
+     // lookup doesn't take manager lock, removed queues are deleted after guard is released
+     auto guard = epochs_.Pin();
+     auto *queue = published_.Find( id );
+     if ( queue == nullptr )
+     {
+          return State::QueueAbsent;
+     }
+
+     return queue->Queue::TryPush( std::forward< V >( value ));
+}
+
+template<typename Key, typename Queue, typename Consumer>
+void StaticMPSCQueueManager< Key, Queue, Consumer >::StartConsumerThread( const Key &id,
+                                                                         const StaticConsumerPtr &consumer,
+                                                                         const StaticQueuePtr &queue )
+{
+     // manager owns queue and consumer until thread is joined, so thread borrows them without refcounting
+     auto thread_lambda = [ this, queue = queue.get(), consumer = consumer.get() ]()
+     {
+          StaticConsumerLoop( *queue, *consumer, is_enabled_ );
+     };
+
+     consumer_threads_.emplace( id, std::thread( thread_lambda ));
+}
+
+} // namespace qm
+
+#endif // MQP_STATIC_MPSC_QUEUE_MANAGER_H_
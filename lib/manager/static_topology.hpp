@@ -0,0 +1,331 @@
+/// @brief Fixed set of channels known at compile time
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_STATIC_TOPOLOGY_H_
+#define MQP_STATIC_TOPOLOGY_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+#include "common.h"
+#include "manager/static_consumer_loop.hpp"
+#include "queue/base_queue.hpp"
+#include "consumer/base_consumer.hpp"
+
+namespace qm
+{
+
+/// @brief Channel declaration for StaticTopology
+/// @tparam Tag Type naming channel, usually empty struct
+/// @tparam Queue Concrete queue type derived from IQueue
+/// @tparam Consumer Concrete consumer type derived from IConsumer
+template< typename Tag, typename Queue, typename Consumer >
+struct Channel
+{
+     using TagType = Tag;
+     using QueueType = Queue;
+     using ConsumerType = Consumer;
+     using ValueType = typename Queue::ValueType;
+
+     static_assert( std::is_base_of_v< IQueue< ValueType >, Queue >, "Queue must be derived from IQueue" );
+     static_assert( std::is_base_of_v< IConsumer< ValueType >, Consumer >, "Consumer must be derived from IConsumer" );
+};
+
+/// @brief Fixed set of channels, each with own value, queue and consumer types.
+/// Queues are members of tuple built in constructor, channel is chosen by tag at compile time:
+/// Enqueue is direct tuple access and qualified push without map lookup, lock or virtual dispatch.
+/// Every channel has at most one consumer running in own thread, like StaticMPSCQueueManager.
+/// @tparam Channels List of Channel declarations with unique tags
+template< typename... Channels >
+class StaticTopology
+{
+private:
+     template< typename Tag >
+     static constexpr std::size_t IndexOf()
+     {
+          constexpr bool matches[] = { std::is_same_v< Tag, typename Channels::TagType >... };
+          std::size_t index = sizeof...( Channels );
+          for ( std::size_t i = 0; i < sizeof...( Channels ); i++ )
+          {
+               if ( matches[ i ] )
+               {
+                    // tags must be unique, second match makes index invalid
+                    index = index == sizeof...( Channels ) ? i : sizeof...( Channels ) + 1;
+               }
+          }
+
+          return index;
+     }
+
+     template< typename Tag >
+     using ChannelOf = std::tuple_element_t< IndexOf< Tag >(), std::tuple< Channels... > >;
+
+public:
+     template< typename Tag >
+     using Queue = typename ChannelOf< Tag >::QueueType;
+
+     template< typename Tag >
+     using Consumer = typename ChannelOf< Tag >::ConsumerType;
+
+     template< typename Tag >
+     using Value = typename ChannelOf< Tag >::ValueType;
+
+     /// @brief Constructor, builds queues of all channels
+     /// @param size Maximal size of each queue
+     explicit StaticTopology( std::size_t size );
+
+     /// @brief Destructor, stops consumers threads
+     ~StaticTopology();
+
+     /// @brief Copying is forbidden
+     StaticTopology( const StaticTopology & ) = delete;
+
+     /// @brief Copying is forbidden
+     StaticTopology &operator=( const StaticTopology & ) = delete;
+
+     /// @brief Stop all consumers and disable queues
+     /// @details Thread safe
+     void StopProcessing();
+
+     /// @brief Enable all consumers and queues, start consumers threads
+     /// @details Thread safe
+     void StartProcessing();
+
+     /// @brief Get queue of channel, queue lives as long as topology
+     /// @tparam Tag Channel tag
+     /// @return Reference to queue
+     template< typename Tag >
+     Queue< Tag > &GetQueue();
+
+     /// @brief Check are all queue empty
+     /// @return true/false
+     /// @details Thread safe
+     bool AreAllQueuesEmpty() const;
+
+     /// @brief Subscribe consumer to channel, starts consumer thread
+     /// @tparam Tag Channel tag
+     /// @param consumer Consumer for subscribe
+     /// @return State::Ok or State::QueueBusy if channel already has consumer
+     /// @details Thread safe
+     template< typename Tag >
+     State Subscribe( std::shared_ptr< Consumer< Tag > > consumer );
+
+     /// @brief Unsubscribe consumer from channel
+     /// @tparam Tag Channel tag
+     /// @return State::Ok or State::QueueAbsent if channel has no consumer
+     /// @details Thread safe
+     template< typename Tag >
+     State Unsubscribe();
+
+     /// @brief Enqueue new value to channel
+     /// @tparam Tag Channel tag
+     /// @param value Lvalue object to push
+     /// @return State value
+     /// @details Thread safe
+     template< typename Tag >
+     State Enqueue( const Value< Tag > &value );
+
+     /// @brief Enqueue new value to channel
+     /// @tparam Tag Channel tag
+     /// @param value Rvalue object to push
+     /// @return State value
+     /// @details Thread safe
+     template< typename Tag >
+     State Enqueue( Value< Tag > &&value );
+
+private:
+     template< typename Chan >
+     struct Slot
+     {
+          explicit Slot( std::size_t size ) : queue_( size )
+          {}
+
+          typename Chan::QueueType queue_;
+          std::shared_ptr< typename Chan::ConsumerType > consumer_;
+          std::thread thread_;
+     };
+
+     template< typename Tag >
+     Slot< ChannelOf< Tag > > &SlotOf()
+     {
+          static_assert( IndexOf< Tag >() < sizeof...( Channels ), "Tag must name exactly one channel of topology" );
+          return std::get< IndexOf< Tag >() >( slots_ );
+     }
+
+     template< typename Chan >
+     void StartConsumerThread( Slot< Chan > &slot );
+
+     template< typename Chan >
+     void StopConsumerThread( Slot< Chan > &slot );
+
+     template< typename Op >
+     void ForEachSlot( Op &&op );
+
+private:
+     mutable std::recursive_mutex mtx_;  ///< guards subscriptions and consumers threads
+     CacheAligned< std::atomic< bool > > is_enabled_;  ///< read by consumers threads on every message
+
+     std::tuple< Slot< Channels >... > slots_;
+};
+
+template< typename... Channels >
+StaticTopology< Channels... >::StaticTopology( std::size_t size ) : is_enabled_( true ),
+                                                                    slots_( (( void ) sizeof( Channels ), size )... )
+{
+     static_assert( sizeof...( Channels ) > 0, "Topology must declare channels" );
+     ForEachSlot( []( auto &slot ) { slot.queue_.Enabled( true ); } );
+}
+
+template< typename... Channels >
+StaticTopology< Channels... >::~StaticTopology()
+{
+     StopProcessing();
+}
+
+template< typename... Channels >
+void StaticTopology< Channels... >::StopProcessing()
+{
+     is_enabled_ = false;
+     std::scoped_lock lock( mtx_ );
+     ForEachSlot( [ this ]( auto &slot )
+                  {
+                       slot.queue_.Stop();
+                       StopConsumerThread( slot );
+                  } );
+}
+
+template< typename... Channels >
+void StaticTopology< Channels... >::StartProcessing()
+{
+     std::scoped_lock lock( mtx_ );
+     if ( is_enabled_ )
+     {
+          return;
+     }
+
+     is_enabled_ = true;
+     ForEachSlot( [ this ]( auto &slot )
+                  {
+                       slot.queue_.Enabled( true );
+                       if ( slot.consumer_ )
+                       {
+                            slot.consumer_->Enabled( true );
+                            StartConsumerThread( slot );
+                       }
+                  } );
+}
+
+template< typename... Channels >
+template< typename Tag >
+typename StaticTopology< Channels... >::template Queue< Tag > &StaticTopology< Channels... >::GetQueue()
+{
+     return SlotOf< Tag >().queue_;
+}
+
+template< typename... Channels >
+bool StaticTopology< Channels... >::AreAllQueuesEmpty() const
+{
+     return std::apply( []( const auto &... slot )
+                        {
+                             return ( slot.queue_.Empty() && ... );
+                        }, slots_ );
+}
+
+template< typename... Channels >
+template< typename Tag >
+State StaticTopology< Channels... >::Subscribe( std::shared_ptr< Consumer< Tag > > consumer )
+{
+     std::scoped_lock lock( mtx_ );
+     auto &slot = SlotOf< Tag >();
+     if ( slot.consumer_ )
+     {
+          return State::QueueBusy;
+     }
+
+     slot.consumer_ = consumer;
+     slot.queue_.AttachConsumer( consumer );
+     if ( is_enabled_ )
+     {
+          StartConsumerThread( slot );
+     }
+
+     return State::Ok;
+}
+
+template< typename... Channels >
+template< typename Tag >
+State StaticTopology< Channels... >::Unsubscribe()
+{
+     std::scoped_lock lock( mtx_ );
+     auto &slot = SlotOf< Tag >();
+     if ( !slot.consumer_ )
+     {
+          return State::QueueAbsent;
+     }
+
+     slot.consumer_->Enabled( false );
+     StopConsumerThread( slot );
+     slot.queue_.DetachConsumer();
+     slot.consumer_.reset();
+     return State::Ok;
+}
+
+template< typename... Channels >
+template< typename Tag >
+State StaticTopology< Channels... >::Enqueue( const Value< Tag > &value )
+{
+     using QueueType = Queue< Tag >;
+     return SlotOf< Tag >().queue_.QueueType::TryPush( value );
+}
+
+template< typename... Channels >
+template< typename Tag >
+State StaticTopology< Channels... >::Enqueue( Value< Tag > &&value )
+{
+     using QueueType = Queue< Tag >;
+     return SlotOf< Tag >().queue_.QueueType::TryPush( std::move( value ));
+}
+
+template< typename... Channels >
+template< typename Chan >
+void StaticTopology< Channels... >::StartConsumerThread( Slot< Chan > &slot )
+{
+     // topology owns queue and consumer until thread is joined
+     auto thread_lambda = [ this, queue = &slot.queue_, consumer = slot.consumer_.get() ]()
+     {
+          StaticConsumerLoop( *queue, *consumer, is_enabled_ );
+     };
+
+     slot.thread_ = std::thread( thread_lambda );
+}
+
+template< typename... Channels >
+template< typename Chan >
+void StaticTopology< Channels... >::StopConsumerThread( Slot< Chan > &slot )
+{
+     if ( slot.consumer_ )
+     {
+          slot.consumer_->Enabled( false );
+     }
+
+     if ( slot.thread_.joinable() )
+     {
+          slot.thread_.join();
+     }
+}
+
+template< typename... Channels >
+template< typename Op >
+void StaticTopology< Channels... >::ForEachSlot( Op &&op )
+{
+     std::apply( [ &op ]( auto &... slot ) { ( op( slot ), ... ); }, slots_ );
+}
+
+} // qm
+
+#endif // MQP_STATIC_TOPOLOGY_H_
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <thread>
 
+#include "producer/producer_runtime.hpp"
 #include "manager/base_mqueue_manager.hpp"
 
 namespace qm
@@ -66,12 +67,14 @@ public:
 
 protected:
      Key id_;
-     std::atomic< bool > done_;
-     std::atomic< bool > enabled_;
+     CacheAligned< std::atomic< bool > > done_;     ///< polled by manager
+     CacheAligned< std::atomic< bool > > enabled_;  ///< read on every push, written by manager
      QueuePtr <Value> queue_;
+     RuntimePtr runtime_;  ///< Runtime for cooperative producers, set by manager
 
 private:
      void SetQueue( QueuePtr <Value> queue );
+     void SetRuntime( RuntimePtr runtime );
      friend class IMultiQueueManager< Key, Value >;
 };
 
@@ -103,6 +106,12 @@ void IProducer< Key, Value >::SetQueue( QueuePtr< Value > queue )
      queue_ = queue;
 }
 
+template< typename Key, typename Value >
+void IProducer< Key, Value >::SetRuntime( RuntimePtr runtime )
+{
+     runtime_ = runtime;
+}
+
 } // qm
 
 #endif // MQP_BASE_PRODUCER_H_
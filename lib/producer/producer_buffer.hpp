@@ -0,0 +1,207 @@
+/// @brief Producer side buffer combining pushes to queue
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_PRODUCER_BUFFER_H_
+#define MQP_PRODUCER_BUFFER_H_
+
+#include <chrono>
+#include <vector>
+
+#include "common.h"
+#include "queue/base_queue.hpp"
+
+namespace qm
+{
+
+/// @brief Flush thresholds of producer buffer
+struct BufferPolicy
+{
+     std::size_t max_count = 64;                               ///< Flush when count of staged values is reached
+     std::size_t max_bytes = 0;                                ///< Flush when staged bytes are reached, 0 - disabled
+     std::chrono::microseconds linger{ 100 };                  ///< Flush when oldest staged value waits longer
+};
+
+/// @brief Producer side write-combining buffer.
+/// Values are staged locally and pushed to queue by one TryPushBulk call, so queue synchronization
+/// is paid once per burst. Buffer is flushed when count or bytes threshold is reached,
+/// on Push or Poll after linger time and on explicit Flush.
+/// @attention Not thread safe, buffer is owned by one producer.
+/// @tparam Value Type for queue store
+/// @tparam SizeOf Functor returning size of value in bytes
+template< typename Value, typename SizeOf = ValueSize< Value > >
+class ProducerBuffer
+{
+public:
+     /// @brief Constructor
+     /// @param queue Queue to flush values to
+     /// @param policy Flush thresholds
+     explicit ProducerBuffer( QueuePtr< Value > queue, BufferPolicy policy = BufferPolicy() );
+
+     /// @brief Destructor, flushes staged values
+     ~ProducerBuffer();
+
+     /// @brief Stage value, flush if any threshold is reached
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or State::QueueFull if buffer is full and queue doesn't accept values
+     State Push( const Value &obj );
+
+     /// @brief Stage value, flush if any threshold is reached
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or State::QueueFull if buffer is full and queue doesn't accept values
+     State Push( Value &&obj );
+
+     /// @brief Push all staged values to queue. Values not accepted by queue are kept in order.
+     /// @return State::Ok if buffer is empty, other state of queue otherwise
+     State Flush();
+
+     /// @brief Flush if linger time of oldest staged value is expired. Call it from idle producers.
+     /// @return State::Ok or other state of queue on error
+     State Poll();
+
+     /// @brief Count of staged values
+     /// @return Count
+     std::size_t Size() const;
+
+     /// @brief Bytes of staged values, counted only if bytes threshold is set
+     /// @return Bytes
+     std::size_t Bytes() const;
+
+private:
+     using Clock = std::chrono::steady_clock;
+
+     template< typename V >
+     State PushFwd( V &&obj );
+
+     bool Expired() const;
+
+private:
+     QueuePtr< Value > queue_;
+     const BufferPolicy policy_;
+     SizeOf size_of_;
+
+     std::vector< Value > staged_;
+     std::size_t bytes_;
+     Clock::time_point first_staged_;
+};
+
+template< typename Value, typename SizeOf >
+ProducerBuffer< Value, SizeOf >::ProducerBuffer( QueuePtr< Value > queue, BufferPolicy policy ) : queue_( std::move( queue )),
+                                                                                                  policy_( policy ),
+                                                                                                  bytes_( 0 )
+{
+     staged_.reserve( policy_.max_count );
+}
+
+template< typename Value, typename SizeOf >
+ProducerBuffer< Value, SizeOf >::~ProducerBuffer()
+{
+     Flush();
+}
+
+template< typename Value, typename SizeOf >
+State ProducerBuffer< Value, SizeOf >::Push( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value, typename SizeOf >
+State ProducerBuffer< Value, SizeOf >::Push( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Value, typename SizeOf >
+template< typename V >
+State ProducerBuffer< Value, SizeOf >::PushFwd( V &&obj )
+{
+     if ( policy_.max_count != 0 && staged_.size() >= policy_.max_count && Flush() != State::Ok &&
+          staged_.size() >= policy_.max_count )
+     {
+          return State::QueueFull;
+     }
+
+     if ( staged_.empty() )
+     {
+          first_staged_ = Clock::now();
+     }
+
+     if ( policy_.max_bytes != 0 )
+     {
+          bytes_ += size_of_( obj );
+     }
+     staged_.emplace_back( std::forward< V >( obj ));
+
+     if (( policy_.max_count != 0 && staged_.size() >= policy_.max_count ) ||
+         ( policy_.max_bytes != 0 && bytes_ >= policy_.max_bytes ) || Expired() )
+     {
+          // value is staged, queue state is reported by next Flush
+          Flush();
+     }
+
+     return State::Ok;
+}
+
+template< typename Value, typename SizeOf >
+State ProducerBuffer< Value, SizeOf >::Flush()
+{
+     if ( staged_.empty() )
+     {
+          return State::Ok;
+     }
+
+     if ( queue_ == nullptr )
+     {
+          return State::QueueAbsent;
+     }
+
+     auto pushed = queue_->TryPushBulk( staged_.data(), staged_.size() );
+     staged_.erase( staged_.begin(), staged_.begin() + pushed );
+
+     // pushed values are moved from, so size of values left is counted again
+     bytes_ = 0;
+     if ( staged_.empty() )
+     {
+          return State::Ok;
+     }
+
+     if ( policy_.max_bytes != 0 )
+     {
+          for ( const auto &value : staged_ )
+          {
+               bytes_ += size_of_( value );
+          }
+     }
+
+     // restart linger for values left in buffer
+     first_staged_ = Clock::now();
+     return queue_->Enabled() ? State::QueueFull : State::QueueDisabled;
+}
+
+template< typename Value, typename SizeOf >
+State ProducerBuffer< Value, SizeOf >::Poll()
+{
+     return Expired() ? Flush() : State::Ok;
+}
+
+template< typename Value, typename SizeOf >
+std::size_t ProducerBuffer< Value, SizeOf >::Size() const
+{
+     return staged_.size();
+}
+
+template< typename Value, typename SizeOf >
+std::size_t ProducerBuffer< Value, SizeOf >::Bytes() const
+{
+     return bytes_;
+}
+
+template< typename Value, typename SizeOf >
+bool ProducerBuffer< Value, SizeOf >::Expired() const
+{
+     return !staged_.empty() && Clock::now() - first_staged_ >= policy_.linger;
+}
+
+} // qm
+
+#endif // MQP_PRODUCER_BUFFER_H_
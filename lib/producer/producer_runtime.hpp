@@ -0,0 +1,429 @@
+/// @brief Cooperative runtime running producers steps on work stealing thread pool
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_PRODUCER_RUNTIME_H_
+#define MQP_PRODUCER_RUNTIME_H_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+namespace qm
+{
+
+/// @brief State returned by cooperative task step
+enum class TaskState
+{
+     Ready,    ///< Task has more work, schedule it again
+     Blocked,  ///< Task cannot progress now ( e.g. queue is full ), yield to other tasks
+     Done      ///< Task is finished
+};
+
+/// @brief Cooperative task interface.
+/// Step must do a small piece of work and return, runtime never calls Step of one task concurrently.
+class ITask
+{
+public:
+     virtual ~ITask() = default;
+
+     /// @brief Do one step of work
+     /// @return TaskState value
+     virtual TaskState Step() = 0;
+
+     /// @brief Called instead of next steps when runtime is stopped before task is done
+     virtual void Cancel() {}
+
+     /// @brief Called after Blocked step, task calls wake once it may progress ( e.g. queue signals space ).
+     /// Wake may be called before Park returns and from any thread.
+     /// @param wake Callable scheduling task again
+     /// @return false if task can't be woken, wake is never called then and task is retried after other tasks
+     virtual bool Park( std::function< void() > /*wake*/ ) { return false; }
+};
+
+/// @brief Alias name for shared pointer to task
+using TaskPtr = std::shared_ptr< ITask >;
+
+/// @brief Runtime running cooperative tasks on fixed count of worker threads.
+/// Each worker has own tasks deque, idle workers steal tasks from others.
+/// Blocked tasks are parked ( see ITask::Park ) outside of deques until they are woken, so a task waiting
+/// for free space in queue neither holds a thread nor is polled. Blocked tasks which can't be parked are moved
+/// to the end of worker's deque and retried after other tasks, worker seeing only them yields shortly,
+/// then sleeps between retries instead of spinning.
+class ProducerRuntime
+{
+public:
+     /// @brief Constructor, starts worker threads
+     /// @param workers Count of worker threads
+     /// @param steps Maximal count of steps of one task before switching to next one
+     explicit ProducerRuntime( std::size_t workers = std::thread::hardware_concurrency(), std::size_t steps = 64 );
+
+     /// @brief Destructor, stops worker threads
+     ~ProducerRuntime();
+
+     /// @brief Copying is forbidden
+     ProducerRuntime( const ProducerRuntime & ) = delete;
+
+     /// @brief Copying is forbidden
+     ProducerRuntime &operator=( const ProducerRuntime & ) = delete;
+
+     /// @brief Schedule task
+     /// @param task Pointer to task
+     /// @details Thread safe
+     void Submit( TaskPtr task );
+
+     /// @brief Stop worker threads, not finished tasks are cancelled.
+     /// Called from worker thread ( e.g. by task step ) it detaches that thread, which exits after the step.
+     /// @details Thread safe
+     void Stop();
+
+     /// @brief Count of worker threads
+     /// @return Count
+     std::size_t Workers() const;
+
+private:
+     struct alignas( CacheLineSize ) Worker
+     {
+          std::mutex mtx_;
+          std::deque< TaskPtr > tasks_;
+     };
+
+     /// @brief Blocked task waiting for wake
+     struct Parked
+     {
+          enum : int { Parking, Waiting, Woken };
+
+          TaskPtr task_;                          ///< guarded by parked_mtx_ of pool, reset when task leaves
+          std::size_t worker_;
+          std::atomic< int > state_;
+          std::list< std::shared_ptr< Parked > >::iterator it_;  ///< position in parked_ of pool
+     };
+
+     /// @brief Workers state shared with their threads, so detached thread never outlives it
+     struct Pool : std::enable_shared_from_this< Pool >
+     {
+          Pool( std::size_t workers, std::size_t steps );
+
+          void Run( std::size_t index );
+
+          TaskPtr Take( std::size_t index );
+
+          void Schedule( std::size_t index, TaskPtr task );
+
+          /// @brief Park blocked task until it is woken
+          /// @return false if task can't be parked
+          bool Park( std::size_t index, const TaskPtr &task );
+
+          /// @brief Schedule woken task again, unless runtime took it on stop
+          void Resume( const std::shared_ptr< Parked > &parked );
+
+          const std::size_t steps_;
+          std::vector< std::unique_ptr< Worker > > workers_;
+
+          CacheAligned< std::atomic< bool > > stopped_;              ///< read by workers after every task
+          CacheAligned< std::atomic< std::size_t > > next_worker_;   ///< incremented on every Submit
+          CacheAligned< std::atomic< std::size_t > > scheduled_;     ///< tasks count in all deques
+          std::atomic< std::size_t > sleepers_;                      ///< workers waiting on idle_cv_
+
+          std::mutex idle_mtx_;
+          std::condition_variable idle_cv_;
+
+          std::mutex parked_mtx_;
+          std::list< std::shared_ptr< Parked > > parked_;  ///< guarded by parked_mtx_
+     };
+
+private:
+     std::shared_ptr< Pool > pool_;
+     std::vector< std::thread > threads_;
+};
+
+/// @brief Alias name for shared pointer to producer runtime
+using RuntimePtr = std::shared_ptr< ProducerRuntime >;
+
+inline ProducerRuntime::ProducerRuntime( std::size_t workers, std::size_t steps ) :
+     pool_( std::make_shared< Pool >( std::max< std::size_t >( workers, 1 ), steps ))
+{
+     for ( std::size_t i = 0; i < pool_->workers_.size(); i++ )
+     {
+          threads_.emplace_back( [ pool = pool_, i ]() { pool->Run( i ); } );
+     }
+}
+
+inline ProducerRuntime::~ProducerRuntime()
+{
+     Stop();
+}
+
+inline void ProducerRuntime::Submit( TaskPtr task )
+{
+     pool_->Schedule( pool_->next_worker_.fetch_add( 1, std::memory_order_relaxed ) % pool_->workers_.size(),
+                      std::move( task ));
+}
+
+inline void ProducerRuntime::Stop()
+{
+     pool_->stopped_ = true;
+     {
+          // sleeping worker checks flag under lock
+          std::scoped_lock lock( pool_->idle_mtx_ );
+     }
+     pool_->idle_cv_.notify_all();
+
+     for ( auto &thread : threads_ )
+     {
+          if ( !thread.joinable() )
+          {
+               continue;
+          }
+
+          // worker can't join itself, it holds pool and exits when its step returns
+          if ( thread.get_id() == std::this_thread::get_id() )
+          {
+               thread.detach();
+          }
+          else
+          {
+               thread.join();
+          }
+     }
+
+     for ( auto &worker : pool_->workers_ )
+     {
+          std::deque< TaskPtr > tasks;
+          {
+               std::scoped_lock lock( worker->mtx_ );
+               tasks.swap( worker->tasks_ );
+          }
+
+          for ( auto &task : tasks )
+          {
+               task->Cancel();
+          }
+     }
+
+     std::vector< TaskPtr > parked;
+     {
+          // tasks woken later find no task to schedule
+          std::scoped_lock lock( pool_->parked_mtx_ );
+          for ( auto &entry : pool_->parked_ )
+          {
+               parked.push_back( std::move( entry->task_ ));
+          }
+          pool_->parked_.clear();
+     }
+
+     for ( auto &task : parked )
+     {
+          task->Cancel();
+     }
+}
+
+inline std::size_t ProducerRuntime::Workers() const
+{
+     return pool_->workers_.size();
+}
+
+inline ProducerRuntime::Pool::Pool( std::size_t workers, std::size_t steps ) : steps_( steps ),
+                                                                              stopped_( false ),
+                                                                              next_worker_( 0 ),
+                                                                              scheduled_( 0 ),
+                                                                              sleepers_( 0 )
+{
+     for ( std::size_t i = 0; i < workers; i++ )
+     {
+          workers_.push_back( std::make_unique< Worker >() );
+     }
+}
+
+inline void ProducerRuntime::Pool::Schedule( std::size_t index, TaskPtr task )
+{
+     {
+          // Stop drains deques under workers locks after flag is set, so task is either drained or cancelled here
+          std::scoped_lock lock( workers_[ index ]->mtx_ );
+          if ( !stopped_ )
+          {
+               scheduled_.fetch_add( 1 );
+               workers_[ index ]->tasks_.push_back( std::move( task ));
+          }
+     }
+
+     if ( task )
+     {
+          // runtime is stopped
+          task->Cancel();
+          return;
+     }
+
+     // idle lock is taken only if some worker sleeps, it counts itself before checking scheduled_
+     if ( sleepers_.load() != 0 )
+     {
+          {
+               std::scoped_lock lock( idle_mtx_ );
+          }
+          idle_cv_.notify_one();
+     }
+}
+
+inline bool ProducerRuntime::Pool::Park( std::size_t index, const TaskPtr &task )
+{
+     auto parked = std::make_shared< Parked >();
+     parked->task_ = task;
+     parked->worker_ = index;
+     parked->state_.store( Parked::Parking, std::memory_order_relaxed );
+     {
+          std::scoped_lock lock( parked_mtx_ );
+          if ( stopped_ )
+          {
+               return false;
+          }
+          parked->it_ = parked_.insert( parked_.end(), parked );
+     }
+
+     // wake called while task is parking leaves rescheduling to this worker, so steps never run concurrently
+     std::weak_ptr< Pool > pool = weak_from_this();
+     auto wake = [ pool, parked ]()
+     {
+          if ( parked->state_.exchange( Parked::Woken ) == Parked::Waiting )
+          {
+               if ( auto alive = pool.lock() )
+               {
+                    alive->Resume( parked );
+               }
+          }
+     };
+
+     if ( !task->Park( wake ))
+     {
+          std::scoped_lock lock( parked_mtx_ );
+          if ( parked->task_ )
+          {
+               parked->task_.reset();
+               parked_.erase( parked->it_ );
+          }
+          return false;
+     }
+
+     auto expected = static_cast< int >( Parked::Parking );
+     if ( !parked->state_.compare_exchange_strong( expected, Parked::Waiting ))
+     {
+          Resume( parked );
+     }
+     return true;
+}
+
+inline void ProducerRuntime::Pool::Resume( const std::shared_ptr< Parked > &parked )
+{
+     TaskPtr task;
+     {
+          std::scoped_lock lock( parked_mtx_ );
+          if ( !parked->task_ )
+          {
+               // runtime is stopped and task is cancelled
+               return;
+          }
+          task = std::move( parked->task_ );
+          parked_.erase( parked->it_ );
+     }
+
+     Schedule( parked->worker_, std::move( task ));
+}
+
+inline TaskPtr ProducerRuntime::Pool::Take( std::size_t index )
+{
+     TaskPtr task;
+     {
+          // own tasks are taken from front, so blocked tasks moved to back wait for others
+          std::scoped_lock lock( workers_[ index ]->mtx_ );
+          if ( !workers_[ index ]->tasks_.empty() )
+          {
+               task = std::move( workers_[ index ]->tasks_.front() );
+               workers_[ index ]->tasks_.pop_front();
+          }
+     }
+
+     for ( std::size_t i = 1; !task && i < workers_.size(); i++ )
+     {
+          // steal from back of other worker's deque
+          auto &victim = workers_[ ( index + i ) % workers_.size() ];
+          std::scoped_lock lock( victim->mtx_ );
+          if ( !victim->tasks_.empty() )
+          {
+               task = std::move( victim->tasks_.back() );
+               victim->tasks_.pop_back();
+          }
+     }
+
+     if ( task )
+     {
+          scheduled_.fetch_sub( 1, std::memory_order_relaxed );
+     }
+
+     return task;
+}
+
+inline void ProducerRuntime::Pool::Run( std::size_t index )
+{
+     // blocked steps in a row, reset by any progress
+     std::size_t blocked = 0;
+     while ( !stopped_ )
+     {
+          auto task = Take( index );
+          if ( !task )
+          {
+               std::unique_lock lock( idle_mtx_ );
+               sleepers_.fetch_add( 1 );
+               idle_cv_.wait( lock, [ this ]() { return scheduled_.load() != 0 || stopped_; } );
+               sleepers_.fetch_sub( 1, std::memory_order_relaxed );
+               continue;
+          }
+
+          auto state = TaskState::Ready;
+          std::size_t step = 0;
+          for ( ; step < steps_ && state == TaskState::Ready; step++ )
+          {
+               state = task->Step();
+          }
+
+          if ( state == TaskState::Done )
+          {
+               blocked = 0;
+               continue;
+          }
+
+          if ( state == TaskState::Blocked && Park( index, task ))
+          {
+               blocked = 0;
+               continue;
+          }
+
+          Schedule( index, std::move( task ));
+          if ( state != TaskState::Blocked || step > 1 )
+          {
+               blocked = 0;
+               continue;
+          }
+
+          // let consumers free space in queues, worker with only full queues sleeps instead of spinning
+          if ( blocked++ < 64 )
+          {
+               std::this_thread::yield();
+          }
+          else
+          {
+               std::this_thread::sleep_for( std::chrono::microseconds( 50 ));
+          }
+     }
+}
+
+} // qm
+
+#endif // MQP_PRODUCER_RUNTIME_H_
@@ -0,0 +1,244 @@
+/// @brief Base template class for cooperative producers
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_TASK_PRODUCER_H_
+#define MQP_TASK_PRODUCER_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+#include "producer/base_producer.hpp"
+#include "producer/producer_runtime.hpp"
+
+namespace qm
+{
+
+/// @brief Base template class for cooperative producers.
+/// Producer doesn't own a thread: Produce() submits it to runtime set by manager ( IMultiQueueManager::SetRuntime )
+/// and runtime pushes values returned by Next() one by one. When queue is full or its memory budget is exhausted
+/// producer yields to other tasks and retries the same value later. Producer refused by full queue signalling
+/// space ( see IQueue::NotifyOnSpace ) is parked until consumer pops, otherwise runtime polls it.
+/// Refused value is moved to retries if queue keeps it ( see IQueue::KeepsRefused ) and copied otherwise.
+/// @tparam Key Type for queues map store.
+/// @tparam Value Type for queue store
+template< typename Key, typename Value >
+class TaskProducer : public IProducer< Key, Value >,
+                     public ITask,
+                     public std::enable_shared_from_this< TaskProducer< Key, Value > >
+{
+public:
+     /// @brief Constructor
+     /// @param id Key id
+     explicit TaskProducer( Key id );
+
+     /// @brief Destructor
+     ~TaskProducer() override = default;
+
+     /// @brief Submit producer's task to runtime, see Start
+     void Produce() override;
+
+     /// @brief Submit producer's task to runtime
+     /// @return State::Ok if task is submitted or already running,
+     /// State::QueueAbsent if producer is not registered, State::QueueDisabled if manager has no runtime
+     State Start();
+
+     /// @brief Waiting for producer's task has done, parked task of disabled producer is woken to finish
+     void WaitThreadDone() override;
+
+     /// @brief Push next value or retry the value rejected by full queue or budget
+     /// @return TaskState value
+     TaskState Step() override;
+
+     /// @brief Mark producer done when runtime is stopped
+     void Cancel() override;
+
+     /// @brief Park producer refused by full queue until queue signals space
+     /// @param wake Callable scheduling producer again
+     /// @return false if push was refused by budget or queue doesn't signal space
+     bool Park( std::function< void() > wake ) override;
+
+protected:
+     /// @brief Get next value to produce
+     /// @return Value or std::nullopt if producer's work is done
+     virtual std::optional< Value > Next() = 0;
+
+private:
+     /// @brief Push pending value, it is reset if accepted
+     /// @return State of push
+     State PushPending();
+
+     void Finish();
+
+private:
+     std::optional< Value > pending_;
+     State refused_;                 ///< state of last refused push, task only
+     bool parked_;                   ///< wake_ is set, task only
+     bool running_;
+     std::function< void() > wake_;  ///< wake of parked task, guarded by mtx_
+     std::mutex mtx_;
+     std::condition_variable done_cv_;
+};
+
+template< typename Key, typename Value >
+TaskProducer< Key, Value >::TaskProducer( Key id ) : IProducer< Key, Value >( id ),
+                                                      refused_( State::Ok ),
+                                                      parked_( false ),
+                                                      running_( false )
+{}
+
+template< typename Key, typename Value >
+void TaskProducer< Key, Value >::Produce()
+{
+     Start();
+}
+
+template< typename Key, typename Value >
+State TaskProducer< Key, Value >::Start()
+{
+     if ( IProducer< Key, Value >::queue_ == nullptr )
+     {
+          return State::QueueAbsent;
+     }
+
+     if ( IProducer< Key, Value >::runtime_ == nullptr )
+     {
+          return State::QueueDisabled;
+     }
+
+     {
+          std::scoped_lock lock( mtx_ );
+          if ( running_ )
+          {
+               return State::Ok;
+          }
+          running_ = true;
+     }
+
+     IProducer< Key, Value >::runtime_->Submit( this->shared_from_this() );
+     return State::Ok;
+}
+
+template< typename Key, typename Value >
+void TaskProducer< Key, Value >::WaitThreadDone()
+{
+     std::unique_lock lock( mtx_ );
+     if ( running_ && wake_ && !IProducer< Key, Value >::enabled_.load() )
+     {
+          // parked task wouldn't see disabled producer before consumer pops, wake is called once at most
+          auto wake = wake_;
+          lock.unlock();
+          wake();
+          lock.lock();
+     }
+     done_cv_.wait( lock, [ this ]() { return !running_; } );
+}
+
+template< typename Key, typename Value >
+TaskState TaskProducer< Key, Value >::Step()
+{
+     auto &queue = IProducer< Key, Value >::queue_;
+     if ( parked_ )
+     {
+          // wake of previous parking is stale once task runs again
+          parked_ = false;
+          std::scoped_lock lock( mtx_ );
+          wake_ = nullptr;
+     }
+
+     if ( !IProducer< Key, Value >::enabled_.load() || queue == nullptr )
+     {
+          Finish();
+          return TaskState::Done;
+     }
+
+     if ( !pending_.has_value() )
+     {
+          pending_ = Next();
+          if ( !pending_.has_value() )
+          {
+               Finish();
+               return TaskState::Done;
+          }
+     }
+
+     auto state = PushPending();
+     if ( state == State::Ok )
+     {
+          return TaskState::Ready;
+     }
+
+     // both states are temporary, consumer frees space and returns bytes to budget
+     if ( state == State::QueueFull || state == State::BudgetExceeded )
+     {
+          return TaskState::Blocked;
+     }
+
+     Finish();
+     return TaskState::Done;
+}
+
+template< typename Key, typename Value >
+void TaskProducer< Key, Value >::Cancel()
+{
+     Finish();
+}
+
+template< typename Key, typename Value >
+bool TaskProducer< Key, Value >::Park( std::function< void() > wake )
+{
+     // budget is returned by pops of other queues too, they don't signal this one
+     auto &queue = IProducer< Key, Value >::queue_;
+     if ( refused_ != State::QueueFull || queue == nullptr || !queue->NotifyOnSpace( wake ))
+     {
+          return false;
+     }
+
+     {
+          std::scoped_lock lock( mtx_ );
+          wake_ = wake;
+     }
+     parked_ = true;
+
+     // space freed before waiter was registered is not signalled, so push is retried once,
+     // producer disabled before wake_ was set is not woken by WaitThreadDone
+     if ( !IProducer< Key, Value >::enabled_.load() || PushPending() != State::QueueFull )
+     {
+          wake();
+     }
+     return true;
+}
+
+template< typename Key, typename Value >
+State TaskProducer< Key, Value >::PushPending()
+{
+     auto &queue = IProducer< Key, Value >::queue_;
+     auto state = queue->KeepsRefused() ? queue->TryPush( std::move( pending_.value() ))
+                                        : queue->TryPush( pending_.value() );
+     if ( state == State::Ok )
+     {
+          pending_.reset();
+     }
+     else
+     {
+          refused_ = state;
+     }
+     return state;
+}
+
+template< typename Key, typename Value >
+void TaskProducer< Key, Value >::Finish()
+{
+     IProducer< Key, Value >::done_ = true;
+     {
+          std::scoped_lock lock( mtx_ );
+          running_ = false;
+          wake_ = nullptr;
+     }
+     done_cv_.notify_all();
+}
+
+} // qm
+
+#endif // MQP_TASK_PRODUCER_H_
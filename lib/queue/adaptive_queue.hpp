@@ -0,0 +1,413 @@
+/// @brief Queue switching between single and multi producers implementations by observed contention.
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_ADAPTIVE_QUEUE_H_
+#define MQP_ADAPTIVE_QUEUE_H_
+
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include "base_queue.hpp"
+#include "lock_free_queue.hpp"
+#include "spsc_ring_queue.hpp"
+
+namespace qm
+{
+
+/// @brief Thresholds of AdaptiveQueue switching
+struct AdaptivePolicy
+{
+     std::size_t producers_threshold = 1;  ///< Multi producers mode is used when registered producers count exceeds it
+     std::size_t window = 1024;            ///< Pushes count between contention estimations
+     double upgrade_contention = 0.05;     ///< Contended pushes share to switch to multi producers mode
+     double downgrade_contention = 0.01;   ///< Contended pushes share to switch back to single producer mode
+};
+
+/// @brief Current implementation used by AdaptiveQueue
+enum class AdaptiveMode
+{
+     Single,   ///< Single producer ring buffer, producers are serialized by spin lock
+     Multi     ///< Multi producers queue
+};
+
+/// @brief Multi producers single consumer queue which starts on cheap single producer ring buffer and
+/// switches to multi producers queue when registered producers count or contention on push grows.
+/// It switches back when contention ends. Consumer drains previous implementation before the next one,
+/// so values are neither lost nor reordered.
+/// @tparam Value Type for queue store
+/// @tparam MultiQueue Multi producers queue type with nonblocking Pop
+template< typename Value, typename MultiQueue = LockFreeQueue< Value > >
+class AdaptiveQueue : public IQueue< Value >
+{
+public:
+     /// @brief Constructor
+     /// @param size Maximal size of queue
+     /// @param policy Switching thresholds
+     explicit AdaptiveQueue( std::size_t size, AdaptivePolicy policy = AdaptivePolicy() );
+
+     /// @brief Destructor
+     ~AdaptiveQueue() = default;
+
+     using IQueue< Value >::Enabled;
+
+     /// @brief Disable or enable queue
+     /// Thread safe
+     /// @param enabled - true/false
+     void Enabled( bool enabled ) override;
+
+     /// @brief Disable queue
+     /// Thread safe
+     void Stop();
+
+     /// @brief Change maximal size of ring buffer and multi queue, nothing is changed if multi queue refuses
+     /// Thread safe
+     /// @param size New maximal size
+     /// @return State of multi queue resize
+     State Resize( std::size_t size ) override;
+
+     /// @brief Let ring buffer and multi queue grow when they stay full
+     /// Thread safe
+     /// @param limit Maximal size queue may grow to, 0 disables growth
+     /// @param after Count of refused pushes in a row which triggers growth
+     void AutoGrow( std::size_t limit, std::size_t after = 16 ) override;
+
+     /// @brief Count new registered producer, may switch queue to multi producers mode
+     /// Thread safe
+     /// @return nullptr, producer pushes to this queue
+     QueuePtr< Value > AttachProducer() override;
+
+     /// @brief Count unregistered producer
+     /// Thread safe
+     /// @param endpoint Ignored
+     void DetachProducer( const QueuePtr< Value > &endpoint ) override;
+
+     /// @brief Get current queue mode
+     /// Thread safe
+     /// @return AdaptiveMode value
+     AdaptiveMode Mode() const;
+
+     /// @brief Check is queue empty.
+     /// Thread safe.
+     /// @return true/false
+     [[nodiscard]] bool Empty() const;
+
+     /// @brief Nonblocking pop from queue.
+     /// Only one consumer thread is allowed.
+     /// @return Object empty value if pop unsuccessfully
+     std::optional< Value > Pop();
+
+     /// @brief Nonblocking push.
+     /// Thread safe
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( const Value &obj );
+
+     /// @brief Nonblocking push.
+     /// Thread safe
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( Value &&obj );
+
+     /// @brief Nonblocking push. Method similar to Push(const &)
+     /// Thread safe
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( const Value &obj );
+
+     /// @brief Nonblocking push. Method similar to Push(&&)
+     /// Thread safe
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( Value &&obj );
+
+private:
+     /// @brief Queue state, switching is possible only from stable Single or Multi states
+     enum class Phase
+     {
+          Single,          ///< Producers push to ring buffer
+          Multi,           ///< Producers push to multi queue
+          SingleDraining,  ///< Producers push to ring buffer, consumer drains multi queue
+          MultiDraining    ///< Producers push to multi queue, consumer drains ring buffer
+     };
+
+     static bool IsSingle( Phase phase );
+
+     template< typename V >
+     State PushFwd( V &&obj );
+
+     template< typename V >
+     bool PushSingle( V &&obj, State &state );
+
+     template< typename V >
+     bool PushMulti( V &&obj, State &state );
+
+     bool TrySwitch( Phase from, Phase to );
+
+     bool Contended( std::size_t contended, std::size_t pushes, double threshold ) const;
+
+private:
+     const AdaptivePolicy policy_;
+
+     SpscRingQueue< Value > single_;
+     MultiQueue multi_;
+
+     CacheAligned< std::atomic< Phase > > phase_;
+     std::atomic< std::size_t > producers_;
+
+     // single mode: producers are serialized by spin lock, failed lock attempts are contention
+     alignas( CacheLineSize ) std::atomic< bool > single_busy_;
+     std::atomic< std::size_t > single_contended_;
+     std::size_t single_pushes_;
+
+     // multi mode: push running while another one is in progress is contention
+     alignas( CacheLineSize ) std::atomic< std::size_t > multi_pushers_;
+     std::atomic< std::size_t > multi_contended_;
+     std::atomic< std::size_t > multi_pushes_;
+};
+
+template< typename Value, typename MultiQueue >
+AdaptiveQueue< Value, MultiQueue >::AdaptiveQueue( std::size_t size, AdaptivePolicy policy )
+     : IQueue< Value >( size ),
+       policy_( policy ),
+       single_( size ),
+       multi_( size ),
+       phase_( Phase::Single ),
+       producers_( 0 ),
+       single_busy_( false ),
+       single_contended_( 0 ),
+       single_pushes_( 0 ),
+       multi_pushers_( 0 ),
+       multi_contended_( 0 ),
+       multi_pushes_( 0 )
+{}
+
+template< typename Value, typename MultiQueue >
+void AdaptiveQueue< Value, MultiQueue >::Enabled( bool enabled )
+{
+     IQueue< Value >::Enabled( enabled );
+     single_.Enabled( enabled );
+     multi_.Enabled( enabled );
+}
+
+template< typename Value, typename MultiQueue >
+void AdaptiveQueue< Value, MultiQueue >::Stop()
+{
+     Enabled( false );
+}
+
+template< typename Value, typename MultiQueue >
+State AdaptiveQueue< Value, MultiQueue >::Resize( std::size_t size )
+{
+     auto state = multi_.Resize( size );
+     if ( state != State::Ok )
+     {
+          return state;
+     }
+
+     single_.Resize( size );
+     return IQueue< Value >::Resize( size );
+}
+
+template< typename Value, typename MultiQueue >
+void AdaptiveQueue< Value, MultiQueue >::AutoGrow( std::size_t limit, std::size_t after )
+{
+     IQueue< Value >::AutoGrow( limit, after );
+     single_.AutoGrow( limit, after );
+     multi_.AutoGrow( limit, after );
+}
+
+template< typename Value, typename MultiQueue >
+QueuePtr< Value > AdaptiveQueue< Value, MultiQueue >::AttachProducer()
+{
+     if ( producers_.fetch_add( 1 ) + 1 > policy_.producers_threshold )
+     {
+          TrySwitch( Phase::Single, Phase::MultiDraining );
+     }
+
+     return nullptr;
+}
+
+template< typename Value, typename MultiQueue >
+void AdaptiveQueue< Value, MultiQueue >::DetachProducer( const QueuePtr< Value > & )
+{
+     // switching back is decided by contention observed on next pushes
+     producers_.fetch_sub( 1 );
+}
+
+template< typename Value, typename MultiQueue >
+AdaptiveMode AdaptiveQueue< Value, MultiQueue >::Mode() const
+{
+     return IsSingle( phase_.load() ) ? AdaptiveMode::Single : AdaptiveMode::Multi;
+}
+
+template< typename Value, typename MultiQueue >
+bool AdaptiveQueue< Value, MultiQueue >::Empty() const
+{
+     return single_.Empty() && multi_.Empty();
+}
+
+template< typename Value, typename MultiQueue >
+std::optional< Value > AdaptiveQueue< Value, MultiQueue >::Pop()
+{
+     auto phase = phase_.load();
+     if ( phase == Phase::MultiDraining )
+     {
+          if ( auto value = single_.Pop(); value.has_value() )
+          {
+               return value;
+          }
+
+          // producer holding the lock may still push to ring buffer
+          if ( single_busy_.load() || !single_.Empty() )
+          {
+               return std::nullopt;
+          }
+
+          phase_.store( phase = Phase::Multi );
+     }
+     else if ( phase == Phase::SingleDraining )
+     {
+          if ( auto value = multi_.Pop(); value.has_value() )
+          {
+               return value;
+          }
+
+          if ( multi_pushers_.load() != 0 || !multi_.Empty() )
+          {
+               return std::nullopt;
+          }
+
+          phase_.store( phase = Phase::Single );
+     }
+
+     return IsSingle( phase ) ? single_.Pop() : multi_.Pop();
+}
+
+template< typename Value, typename MultiQueue >
+State AdaptiveQueue< Value, MultiQueue >::Push( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value, typename MultiQueue >
+State AdaptiveQueue< Value, MultiQueue >::Push( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Value, typename MultiQueue >
+State AdaptiveQueue< Value, MultiQueue >::TryPush( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value, typename MultiQueue >
+State AdaptiveQueue< Value, MultiQueue >::TryPush( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Value, typename MultiQueue >
+template< typename V >
+State AdaptiveQueue< Value, MultiQueue >::PushFwd( V &&obj )
+{
+     if ( !IQueue< Value >::Enabled() ) return State::QueueDisabled;
+
+     // phase may change between check and push, then push is retried with other implementation
+     State state;
+     while ( !( IsSingle( phase_.load() ) ? PushSingle( std::forward< V >( obj ), state )
+                                          : PushMulti( std::forward< V >( obj ), state ) ) );
+     return state;
+}
+
+template< typename Value, typename MultiQueue >
+template< typename V >
+bool AdaptiveQueue< Value, MultiQueue >::PushSingle( V &&obj, State &state )
+{
+     bool expected = false;
+     if ( !single_busy_.compare_exchange_strong( expected, true ) )
+     {
+          single_contended_.fetch_add( 1, std::memory_order_relaxed );
+          while ( single_busy_.exchange( true ) )
+          {
+               std::this_thread::yield();
+          }
+     }
+
+     if ( !IsSingle( phase_.load() ) )
+     {
+          single_busy_.store( false );
+          return false;
+     }
+
+     state = single_.Push( std::forward< V >( obj ));
+     if ( ++single_pushes_ >= policy_.window )
+     {
+          auto contended = single_contended_.exchange( 0, std::memory_order_relaxed );
+          if ( Contended( contended, single_pushes_, policy_.upgrade_contention ) )
+          {
+               TrySwitch( Phase::Single, Phase::MultiDraining );
+          }
+          single_pushes_ = 0;
+     }
+
+     single_busy_.store( false );
+     return true;
+}
+
+template< typename Value, typename MultiQueue >
+template< typename V >
+bool AdaptiveQueue< Value, MultiQueue >::PushMulti( V &&obj, State &state )
+{
+     auto concurrent = multi_pushers_.fetch_add( 1 );
+     if ( IsSingle( phase_.load() ) )
+     {
+          multi_pushers_.fetch_sub( 1 );
+          return false;
+     }
+
+     state = multi_.Push( std::forward< V >( obj ));
+     multi_pushers_.fetch_sub( 1 );
+
+     if ( concurrent != 0 )
+     {
+          multi_contended_.fetch_add( 1, std::memory_order_relaxed );
+     }
+
+     auto pushes = multi_pushes_.fetch_add( 1, std::memory_order_relaxed ) + 1;
+     if ( pushes % policy_.window == 0 )
+     {
+          auto contended = multi_contended_.exchange( 0, std::memory_order_relaxed );
+          if ( producers_.load() <= policy_.producers_threshold &&
+               !Contended( contended, policy_.window, policy_.downgrade_contention ) )
+          {
+               TrySwitch( Phase::Multi, Phase::SingleDraining );
+          }
+     }
+
+     return true;
+}
+
+template< typename Value, typename MultiQueue >
+bool AdaptiveQueue< Value, MultiQueue >::TrySwitch( Phase from, Phase to )
+{
+     return phase_.compare_exchange_strong( from, to );
+}
+
+template< typename Value, typename MultiQueue >
+bool AdaptiveQueue< Value, MultiQueue >::Contended( std::size_t contended, std::size_t pushes, double threshold ) const
+{
+     return static_cast< double >( contended ) > threshold * static_cast< double >( pushes );
+}
+
+template< typename Value, typename MultiQueue >
+bool AdaptiveQueue< Value, MultiQueue >::IsSingle( Phase phase )
+{
+     return phase == Phase::Single || phase == Phase::SingleDraining;
+}
+
+} // qm
+
+#endif // MQP_ADAPTIVE_QUEUE_H_
@@ -5,7 +5,13 @@
 #ifndef MQP_BASE_IQUEUE_H_
 #define MQP_BASE_IQUEUE_H_
 
+#include <algorithm>
 #include <atomic>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
 
 #include <boost/optional.hpp>
 
@@ -21,6 +27,9 @@ template<typename Value>
 class IQueue
 {
 public:
+     /// @brief Type of stored values
+     using ValueType = Value;
+
      explicit IQueue( std::size_t size );
 
      virtual ~IQueue();
@@ -43,19 +52,84 @@ public:
      /// @brief Set is queue enabled
      /// @param enabled - true/false
      /// @details Thread safe
-     inline void Enabled( bool enabled );
+     virtual void Enabled( bool enabled );
 
      /// @brief Queue maximal size
      /// @return size_t
      /// @details Thread safe
      [[nodiscard]] std::size_t MaxSize() const;
 
+     /// @brief Change maximal size of queue while producers and consumers keep running.
+     /// Values over smaller size are kept, pushes are refused until consumer drains queue below it.
+     /// Default implementation changes the limit only, which suits queues allocating storage on growth.
+     /// @param size New maximal size
+     /// @return State::Ok or State::QueueBusy if queue storage can't be resized
+     /// @details Thread safe
+     virtual State Resize( std::size_t size );
+
+     /// @brief Let queue grow when it stays full: after `after` refused pushes in a row
+     /// maximal size is doubled, but not over limit.
+     /// @param limit Maximal size queue may grow to, 0 disables growth
+     /// @param after Count of refused pushes in a row which triggers growth
+     /// @details Thread safe
+     virtual void AutoGrow( std::size_t limit, std::size_t after = 16 );
+
+     /// @brief Get queue endpoint for new registered producer
+     /// @return Queue to push values from producer, nullptr if producer should push to this queue
+     /// @details Called by manager on producer registration
+     virtual QueuePtr< Value > AttachProducer();
+
+     /// @brief Release queue endpoint got from AttachProducer
+     /// @param endpoint Queue returned by AttachProducer or this queue
+     /// @details Called by manager when producer thread is done
+     virtual void DetachProducer( const QueuePtr< Value > &endpoint );
+
+     /// @brief Attach consumer subscribed to queue
+     /// @param consumer Pointer to consumer
+     /// @details Called by manager on subscription
+     virtual void AttachConsumer( const ConsumerPtr< Value > &consumer );
+
+     /// @brief Detach subscribed consumer
+     /// @details Called by manager when consumer thread is done
+     virtual void DetachConsumer();
+
+     /// @brief Fault in pages of preallocated queue storage, so first pushes don't take page faults.
+     /// Default implementation does nothing, queues with storage allocated on growth have nothing to prefault.
+     /// @details Called by manager on AddQueue
+     virtual void Prefault();
+
+     /// @brief Move preallocated queue storage to memory of NUMA node.
+     /// Default implementation does nothing, as does any queue on single node system.
+     /// @param node NUMA node number
+     /// @details Called by manager from consumer thread when it starts, so storage follows consumer
+     virtual void BindToNode( int node );
+
+     /// @brief Call wake once when consumer frees space or queue is disabled, so cooperative producer
+     /// refused by full queue may park instead of polling. Wake is called from consumer thread and must not push.
+     /// Default implementation doesn't signal space.
+     /// @param wake Callable to call
+     /// @return false if queue doesn't signal space, wake is never called then
+     /// @details Thread safe
+     virtual bool NotifyOnSpace( std::function< void() > wake );
+
+     /// @brief Does refused TryPush( Value && ) leave value untouched, so it may be moved to every retry.
+     /// Default is false, producers retrying refused value push its copy then.
+     /// @return true/false
+     virtual bool KeepsRefused() const;
+
 public:
      /// @brief Try pop value from queue
      /// @return Value if pop successful, boost::none otherwise
      /// @attention Thread-safe is required.
      virtual std::optional< Value > Pop() = 0;
 
+     /// @brief Try pop value from queue to existing object, waits like Pop.
+     /// Default implementation moves value returned by Pop.
+     /// @param value Object to move popped value to
+     /// @return true if value is popped, value is not changed otherwise
+     /// @attention Thread-safe is required.
+     virtual bool TryPop( Value &value );
+
      /// @brief Push to the queue ( may block )
      /// @param obj Lvalue const object to push
      /// @return State value
@@ -80,14 +154,87 @@ public:
      /// @attention Thread-safe is required.
      virtual State TryPush( Value &&obj ) = 0;
 
+     /// @brief Nonblocking push of several values, values are moved from array.
+     /// Default implementation pushes values one by one, queues override it to synchronize once per call.
+     /// @param values Pointer to first value
+     /// @param count Values count
+     /// @return Count of pushed values, they are always first values of array
+     /// @attention Thread-safe is required.
+     virtual std::size_t TryPushBulk( Value *values, std::size_t count );
+
+     /// @brief Reserve slot in queue storage for next value, value is built in place and published by Commit.
+     /// Repeated Reserve without Commit returns the same slot. Queues accepting several producers
+     /// give slot to calling thread, other threads get nullptr until it is committed.
+     /// Default implementation doesn't support reservation, e.g. LockFreeQueue copies trivially copyable
+     /// values into its nodes anyway.
+     /// @return Pointer to default constructed value in queue storage,
+     /// nullptr if queue is full, disabled or doesn't support reservation ( build value and Push it then )
+     /// @attention Single producer queues ( e.g. SpscRingQueue ) must be called by one producer only.
+     virtual Value *Reserve();
+
+     /// @brief Publish value built in slot got from Reserve by calling thread
+     /// @return State::Ok, State::QueueDisabled if queue was disabled ( value is dropped ),
+     /// State::QueueAbsent if no slot is reserved
+     /// @attention Single producer queues ( e.g. SpscRingQueue ) must be called by one producer only.
+     virtual State Commit();
+
+     /// @brief Release slot got from Reserve by calling thread without publishing its value
+     /// @return State::Ok, State::QueueAbsent if no slot is reserved
+     /// @attention Single producer queues ( e.g. SpscRingQueue ) must be called by one producer only.
+     virtual State Cancel();
+
+     /// @brief Construct value from args and push it to the queue ( may block ).
+     /// Call through IQueue builds value in slot got from Reserve, slot is released by Cancel if constructor throws.
+     /// If queue has no free slot to reserve ( or Value default constructor may throw ) value is built first
+     /// and pushed by Push( Value && ).
+     /// Queues storing values in own memory hide it to construct value in place without reservation.
+     /// @param args Arguments of Value constructor
+     /// @return State value
+     template< typename... Args >
+     State Emplace( Args &&... args );
+
      /// @brief Is queue empty
      /// @return true/false
      /// @attention Thread-safe is required.
      [[nodiscard]] virtual bool Empty() const = 0;
 
+protected:
+     /// @brief Count refused push for auto growth and grow queue if it stays full long enough.
+     /// Must be called without queue locks held, as it calls Resize.
+     /// @return true if queue is grown and push may be retried
+     bool GrowOnFull();
+
+     /// @brief Reset count of refused pushes in a row, cheap when queue was not full
+     void PushAccepted();
+
+     /// @brief Get limit of auto growth
+     /// @return Maximal size, 0 if growth is disabled
+     std::size_t GrowLimit() const { return grow_limit_.load( std::memory_order_relaxed ); }
+
+     /// @brief Get count of refused pushes in a row which triggers growth
+     /// @return Pushes count
+     std::size_t GrowAfter() const { return grow_after_.load( std::memory_order_relaxed ); }
+
+     /// @brief Register waiter of NotifyOnSpace, for queues calling SpaceFreed
+     /// @param wake Callable to call
+     /// @return true
+     bool AddSpaceWaiter( std::function< void() > wake );
+
+     /// @brief Wake waiters registered by AddSpaceWaiter, one load while there are none.
+     /// Called after pop has made its space visible to pushes.
+     void SpaceFreed();
+
 private:
-     std::size_t size_;
-     std::atomic< bool > enabled_;
+     // limits are read on pushes along with vtable pointer, refused pushes are counted only when queue is full
+     std::atomic< std::size_t > size_;
+     std::atomic< std::size_t > grow_limit_;
+     std::atomic< std::size_t > grow_after_;
+     std::atomic< std::size_t > full_pushes_;
+     CacheAligned< std::atomic< bool > > enabled_;  ///< read on every push, kept apart from derived queue fields
+
+     std::atomic< bool > space_waited_;  ///< read by SpaceFreed on every pop
+     std::mutex space_mtx_;
+     std::vector< std::function< void() > > space_waiters_;  ///< guarded by space_mtx_
 };
 
 template<typename Value>
@@ -98,7 +245,12 @@ struct QueueResult
 };
 
 template<typename Value>
-IQueue< Value >::IQueue( std::size_t size ) : size_( size ), enabled_( true )
+IQueue< Value >::IQueue( std::size_t size ) : size_( size ),
+                                              grow_limit_( 0 ),
+                                              grow_after_( 0 ),
+                                              full_pushes_( 0 ),
+                                              enabled_( true ),
+                                              space_waited_( false )
 {}
 
 template<typename Value>
@@ -117,6 +269,11 @@ template<typename Value>
 void IQueue< Value >::Enabled( bool enabled )
 {
      enabled_.store( enabled );
+     if ( !enabled )
+     {
+          // parked producers see disabled queue on retry
+          SpaceFreed();
+     }
 }
 
 template<typename Value>
@@ -128,9 +285,199 @@ bool IQueue< Value >::Enabled() const
 template<typename Value>
 std::size_t IQueue< Value >::MaxSize() const
 {
-     return size_;
+     return size_.load( std::memory_order_relaxed );
+}
+
+template<typename Value>
+State IQueue< Value >::Resize( std::size_t size )
+{
+     size_.store( size, std::memory_order_relaxed );
+     return State::Ok;
 }
 
+template<typename Value>
+void IQueue< Value >::AutoGrow( std::size_t limit, std::size_t after )
+{
+     grow_after_.store( std::max< std::size_t >( after, 1 ), std::memory_order_relaxed );
+     grow_limit_.store( limit, std::memory_order_relaxed );
+     full_pushes_.store( 0, std::memory_order_relaxed );
+}
+
+template<typename Value>
+bool IQueue< Value >::GrowOnFull()
+{
+     auto limit = grow_limit_.load( std::memory_order_relaxed );
+     auto size = MaxSize();
+     if ( size >= limit )
+     {
+          return false;
+     }
+
+     // only the push completing the series grows queue
+     if ( full_pushes_.fetch_add( 1, std::memory_order_relaxed ) + 1 != grow_after_.load( std::memory_order_relaxed ))
+     {
+          return false;
+     }
+
+     full_pushes_.store( 0, std::memory_order_relaxed );
+     return Resize( std::min( limit, std::max( size * 2, size + 1 ))) == State::Ok;
+}
+
+template<typename Value>
+void IQueue< Value >::PushAccepted()
+{
+     if ( full_pushes_.load( std::memory_order_relaxed ) != 0 )
+     {
+          full_pushes_.store( 0, std::memory_order_relaxed );
+     }
+}
+
+template<typename Value>
+bool IQueue< Value >::TryPop( Value &value )
+{
+     auto result = Pop();
+     if ( !result.has_value() )
+     {
+          return false;
+     }
+
+     value = std::move( result.value() );
+     return true;
+}
+
+template<typename Value>
+std::size_t IQueue< Value >::TryPushBulk( Value *values, std::size_t count )
+{
+     std::size_t pushed = 0;
+     while ( pushed < count && TryPush( std::move( values[ pushed ] )) == State::Ok )
+     {
+          pushed++;
+     }
+
+     return pushed;
+}
+
+template<typename Value>
+Value *IQueue< Value >::Reserve()
+{
+     return nullptr;
+}
+
+template<typename Value>
+State IQueue< Value >::Commit()
+{
+     return State::QueueAbsent;
+}
+
+template<typename Value>
+State IQueue< Value >::Cancel()
+{
+     return State::QueueAbsent;
+}
+
+template<typename Value>
+template< typename... Args >
+State IQueue< Value >::Emplace( Args &&... args )
+{
+     // slot holds default constructed value, it is rebuilt there if constructor throws, so queue can destroy it
+     if constexpr ( std::is_nothrow_default_constructible_v< Value > )
+     {
+          auto slot = Reserve();
+          if ( slot != nullptr )
+          {
+               slot->~Value();
+               try
+               {
+                    new ( slot ) Value( std::forward< Args >( args )... );
+               }
+               catch ( ... )
+               {
+                    new ( slot ) Value();
+                    Cancel();
+                    throw;
+               }
+
+               return Commit();
+          }
+     }
+
+     return Push( Value( std::forward< Args >( args )... ));
+}
+
+template<typename Value>
+bool IQueue< Value >::NotifyOnSpace( std::function< void() > )
+{
+     return false;
+}
+
+template<typename Value>
+bool IQueue< Value >::KeepsRefused() const
+{
+     return false;
+}
+
+template<typename Value>
+bool IQueue< Value >::AddSpaceWaiter( std::function< void() > wake )
+{
+     {
+          std::scoped_lock lock( space_mtx_ );
+          space_waiters_.push_back( std::move( wake ));
+          space_waited_.store( true, std::memory_order_relaxed );
+     }
+
+     // pairs with fence in SpaceFreed: either pop sees waiter or push retried after this sees freed space
+     std::atomic_thread_fence( std::memory_order_seq_cst );
+     return true;
+}
+
+template<typename Value>
+void IQueue< Value >::SpaceFreed()
+{
+     std::atomic_thread_fence( std::memory_order_seq_cst );
+     if ( !space_waited_.load( std::memory_order_relaxed ))
+     {
+          return;
+     }
+
+     std::vector< std::function< void() > > waiters;
+     {
+          std::scoped_lock lock( space_mtx_ );
+          waiters.swap( space_waiters_ );
+          space_waited_.store( false, std::memory_order_relaxed );
+     }
+
+     for ( auto &wake : waiters )
+     {
+          wake();
+     }
+}
+
+template<typename Value>
+QueuePtr< Value > IQueue< Value >::AttachProducer()
+{
+     return nullptr;
+}
+
+template<typename Value>
+void IQueue< Value >::DetachProducer( const QueuePtr< Value > & )
+{}
+
+template<typename Value>
+void IQueue< Value >::AttachConsumer( const ConsumerPtr< Value > & )
+{}
+
+template<typename Value>
+void IQueue< Value >::DetachConsumer()
+{}
+
+template<typename Value>
+void IQueue< Value >::Prefault()
+{}
+
+template<typename Value>
+void IQueue< Value >::BindToNode( int )
+{}
+
 } // namespace qm
 
 #endif // MQP_BASE_IQUEUE_H_
\ No newline at end of file
@@ -7,8 +7,12 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory_resource>
 #include <mutex>
-#include <queue>
+#include <thread>
+#include <type_traits>
 #include <utility>
 
 #include "base_queue.hpp"
@@ -24,15 +28,29 @@ class BlockConcurrentQueue : public IQueue< Value >
 public:
      /// @brief Constructor
      /// @param size Maximal size of queue
-     explicit BlockConcurrentQueue( std::size_t size );
+     /// @param resource Memory resource for queue storage
+     explicit BlockConcurrentQueue( std::size_t size, std::pmr::memory_resource *resource = std::pmr::get_default_resource() );
 
      /// @brief Destructor
      ~BlockConcurrentQueue();
 
+     using IQueue< Value >::Enabled;
+
+     /// @brief Disable or enable queue and wake up waiting threads
+     /// Thread safe.
+     /// @param enabled - true/false
+     void Enabled( bool enabled ) override;
+
      /// @brief Disable queue and stop waiting for threads
      /// Thread safe.
      void Stop();
 
+     /// @brief Change maximal size of queue and wake up pushers waiting for free space
+     /// Thread safe.
+     /// @param size New maximal size
+     /// @return State::Ok
+     State Resize( std::size_t size ) override;
+
      /// @brief Check is queue empty.
      /// Thread safe.
      /// @return true/false
@@ -48,6 +66,12 @@ public:
      /// @return Object empty value if pop unsuccessfully
      std::optional< Value > Pop();
 
+     /// @brief Blocking pop to existing object, waits like Pop.
+     /// Thread safe.
+     /// @param value Object to move popped value to
+     /// @return true if value is popped
+     bool TryPop( Value &value ) override;
+
      /// @brief Blocking push until queue full or queue will be disabled.
      /// Thread safe.
      /// @param obj Lvalue object to push
@@ -72,15 +96,69 @@ public:
      /// @return State::Ok or other state of queue on error
      State TryPush( Value &&obj );
 
+     /// @brief Reserve slot at the end of queue, value is default constructed in queue storage and published by Commit.
+     /// Slot belongs to calling thread, its repeated Reserve returns the same slot. Lock is not held until Commit,
+     /// but values pushed after reserved slot are popped after it is committed.
+     /// Thread safe.
+     /// @return Pointer to value in queue storage,
+     /// nullptr if queue is full, disabled, slot is reserved by other thread or Value is not default constructible
+     Value *Reserve() override;
+
+     /// @brief Publish value built in slot reserved by calling thread
+     /// Thread safe.
+     /// @return State::Ok, State::QueueDisabled if queue was disabled ( value is dropped ),
+     /// State::QueueAbsent if calling thread has no reserved slot
+     State Commit() override;
+
+     /// @brief Drop slot reserved by calling thread
+     /// Thread safe.
+     /// @return State::Ok, State::QueueAbsent if calling thread has no reserved slot
+     State Cancel() override;
+
+     /// @brief Wake producer when pop frees space
+     /// Thread safe.
+     /// @param wake Callable to call
+     /// @return true
+     bool NotifyOnSpace( std::function< void() > wake ) override;
+
+     /// @brief Refused value is not moved from
+     /// @return true
+     bool KeepsRefused() const override;
+
+     /// @brief Blocking push of value constructed in place from args.
+     /// Thread safe.
+     /// @param args Arguments of Value constructor
+     /// @return State::Ok or other state of queue on error
+     template< typename... Args >
+     State Emplace( Args &&... args );
+
+     /// @brief Nonblocking push of several values under one lock.
+     /// Thread safe.
+     /// @param values Pointer to first value
+     /// @param count Values count
+     /// @return Count of pushed values
+     std::size_t TryPushBulk( Value *values, std::size_t count ) override;
+
 private:
      template<typename V>
      State TryPushFwd( V &&obj );
 
-     template<typename V>
-     State PushFwd( V &&obj );
+     template<typename... Args>
+     State PushFwd( Args &&... args );
+
+     /// @brief Count of values consumer may see, reserved slot is not counted. Lock must be held.
+     std::size_t Committed() const;
+
+     /// @brief Is front value committed. Lock must be held.
+     bool Poppable() const;
+
+     /// @brief Remove front value moved out by consumer. Lock must be held.
+     void DropFront();
 
 private:
-     std::queue< Value > queue_;
+     std::pmr::deque< Value > queue_;
+     std::thread::id reserver_;  ///< thread owning reserved slot, guarded by mtx
+     std::size_t reserved_pos_;  ///< position of reserved slot from front, guarded by mtx
 
      mutable std::mutex mtx;
      std::condition_variable pop_cv_;
@@ -89,7 +167,10 @@ private:
 };
 
 template< typename Value >
-BlockConcurrentQueue< Value >::BlockConcurrentQueue( std::size_t size ) : IQueue< Value >( size )
+BlockConcurrentQueue< Value >::BlockConcurrentQueue( std::size_t size, std::pmr::memory_resource *resource ) :
+     IQueue< Value >( size ),
+     queue_( std::pmr::polymorphic_allocator< Value >( resource )),
+     reserved_pos_( 0 )
 {}
 
 template< typename Value >
@@ -99,52 +180,102 @@ BlockConcurrentQueue< Value >::~BlockConcurrentQueue()
 }
 
 template< typename Value >
-void BlockConcurrentQueue< Value >::Stop()
+void BlockConcurrentQueue< Value >::Enabled( bool enabled )
 {
-     IQueue< Value >::Enabled( false );
+     {
+          // flag must be changed under lock, otherwise waiting thread may miss the notification
+          std::unique_lock lock( mtx );
+          IQueue< Value >::Enabled( enabled );
+     }
+
      pop_cv_.notify_all();
      push_cv_.notify_all();
 }
 
+template< typename Value >
+void BlockConcurrentQueue< Value >::Stop()
+{
+     Enabled( false );
+}
+
+template< typename Value >
+State BlockConcurrentQueue< Value >::Resize( std::size_t size )
+{
+     {
+          // limit must be changed under lock, otherwise waiting pusher may miss the notification
+          std::unique_lock lock( mtx );
+          IQueue< Value >::Resize( size );
+     }
+
+     push_cv_.notify_all();
+     IQueue< Value >::SpaceFreed();
+     return State::Ok;
+}
+
 template< typename Value >
 bool BlockConcurrentQueue< Value >::Empty() const
 {
      std::unique_lock lock( mtx );
-     return queue_.empty();
+     return Committed() == 0;
 }
 
 template< typename Value >
 std::size_t BlockConcurrentQueue< Value >::Size() const
 {
      std::unique_lock lock( mtx );
-     return queue_.size();
+     return Committed();
 }
 
 template< typename Value >
 std::optional< Value > BlockConcurrentQueue< Value >::Pop()
 {
-     Value result;
+     std::optional< Value > result;
      {
           std::unique_lock lock( mtx );
           pop_cv_.wait( lock, [ this ]()
           {
-               return !queue_.empty() || !IQueue< Value >::Enabled();
+               return Poppable() || !IQueue< Value >::Enabled();
           } );
 
-          if ( queue_.empty())
+          if ( !Poppable())
           {
                return std::nullopt;
           } else
           {
-               result = queue_.front();
-               queue_.pop();
+               result.emplace( std::move( queue_.front() ));
+               DropFront();
           }
      }
 
      push_cv_.notify_one();
+     IQueue< Value >::SpaceFreed();
      return result;
 }
 
+template< typename Value >
+bool BlockConcurrentQueue< Value >::TryPop( Value &value )
+{
+     {
+          std::unique_lock lock( mtx );
+          pop_cv_.wait( lock, [ this ]()
+          {
+               return Poppable() || !IQueue< Value >::Enabled();
+          } );
+
+          if ( !Poppable())
+          {
+               return false;
+          }
+
+          value = std::move( queue_.front() );
+          DropFront();
+     }
+
+     push_cv_.notify_one();
+     IQueue< Value >::SpaceFreed();
+     return true;
+}
+
 template< typename Value >
 State BlockConcurrentQueue< Value >::Push( const Value &obj )
 {
@@ -169,33 +300,171 @@ State BlockConcurrentQueue< Value >::TryPush( Value &&obj )
      return TryPushFwd( std::move( obj ));
 }
 
+template< typename Value >
+std::size_t BlockConcurrentQueue< Value >::TryPushBulk( Value *values, std::size_t count )
+{
+     std::size_t pushed = 0;
+     do
+     {
+          {
+               std::unique_lock lock( mtx );
+               if ( !IQueue< Value >::Enabled())
+               {
+                    return pushed;
+               }
+
+               while ( pushed < count && queue_.size() < IQueue< Value >::MaxSize())
+               {
+                    queue_.emplace_back( std::move( values[ pushed++ ] ));
+               }
+          }
+
+          if ( pushed != 0 )
+          {
+               pop_cv_.notify_one();
+          }
+     }
+     while ( pushed < count && IQueue< Value >::GrowOnFull());
+
+     if ( pushed == count )
+     {
+          IQueue< Value >::PushAccepted();
+     }
+     return pushed;
+}
+
 template< typename Value >
 template< typename V >
 State BlockConcurrentQueue< Value >::TryPushFwd( V &&obj )
 {
-     std::unique_lock lock( mtx );
-     if ( queue_.size() >= IQueue< Value >::MaxSize())
+     do
      {
-          return State::QueueFull;
+          std::unique_lock lock( mtx );
+          if ( queue_.size() < IQueue< Value >::MaxSize())
+          {
+               if ( !IQueue< Value >::Enabled())
+               {
+                    return State::QueueDisabled;
+               }
+
+               queue_.emplace_back( std::forward< V >( obj ));
+               pop_cv_.notify_one();
+               lock.unlock();
+               IQueue< Value >::PushAccepted();
+               return State::Ok;
+          }
      }
+     while ( IQueue< Value >::GrowOnFull());
+
+     return State::QueueFull;
+}
 
-     if ( !IQueue< Value >::Enabled())
+template< typename Value >
+Value *BlockConcurrentQueue< Value >::Reserve()
+{
+     if constexpr ( std::is_default_constructible_v< Value > )
      {
-          return State::QueueDisabled;
+          std::unique_lock lock( mtx );
+          if ( reserver_ == std::this_thread::get_id() )
+          {
+               return &queue_[ reserved_pos_ ];
+          }
+
+          if ( reserver_ != std::thread::id() || !IQueue< Value >::Enabled() ||
+               queue_.size() >= IQueue< Value >::MaxSize())
+          {
+               return nullptr;
+          }
+
+          // deque keeps references to its values on pushes and pops at the ends, so slot stays in place
+          queue_.emplace_back();
+          reserver_ = std::this_thread::get_id();
+          reserved_pos_ = queue_.size() - 1;
+          return &queue_.back();
      }
+     else
+     {
+          return nullptr;
+     }
+}
 
-     queue_.emplace( std::forward< V >( obj ));
-     pop_cv_.notify_one();
+template< typename Value >
+bool BlockConcurrentQueue< Value >::NotifyOnSpace( std::function< void() > wake )
+{
+     return IQueue< Value >::AddSpaceWaiter( std::move( wake ));
+}
+
+template< typename Value >
+bool BlockConcurrentQueue< Value >::KeepsRefused() const
+{
+     return true;
+}
+
+template< typename Value >
+State BlockConcurrentQueue< Value >::Cancel()
+{
+     {
+          std::unique_lock lock( mtx );
+          if ( reserver_ != std::this_thread::get_id() )
+          {
+               return State::QueueAbsent;
+          }
+
+          reserver_ = std::thread::id();
+          queue_.erase( queue_.begin() + static_cast< std::ptrdiff_t >( reserved_pos_ ));
+     }
+
+     // values pushed after dropped slot become visible
+     pop_cv_.notify_all();
      return State::Ok;
 }
 
 template< typename Value >
-template< typename V >
-State BlockConcurrentQueue< Value >::PushFwd( V &&obj )
+State BlockConcurrentQueue< Value >::Commit()
+{
+     {
+          std::unique_lock lock( mtx );
+          if ( reserver_ != std::this_thread::get_id() )
+          {
+               return State::QueueAbsent;
+          }
+
+          reserver_ = std::thread::id();
+          if ( !IQueue< Value >::Enabled())
+          {
+               queue_.erase( queue_.begin() + static_cast< std::ptrdiff_t >( reserved_pos_ ));
+               return State::QueueDisabled;
+          }
+     }
+
+     // values pushed after reserved slot become visible too
+     pop_cv_.notify_all();
+     IQueue< Value >::PushAccepted();
+     return State::Ok;
+}
+
+template< typename Value >
+template< typename... Args >
+State BlockConcurrentQueue< Value >::Emplace( Args &&... args )
+{
+     return PushFwd( std::forward< Args >( args )... );
+}
+
+template< typename Value >
+template< typename... Args >
+State BlockConcurrentQueue< Value >::PushFwd( Args &&... args )
 {
      {
           std::unique_lock lock( mtx );
-          push_cv_.wait( lock, [ this, obj ]()
+          if ( queue_.size() >= IQueue< Value >::MaxSize())
+          {
+               // push which has to wait is refused one for auto growth
+               lock.unlock();
+               IQueue< Value >::GrowOnFull();
+               lock.lock();
+          }
+
+          push_cv_.wait( lock, [ this ]()
           {
                return queue_.size() < IQueue< Value >::MaxSize() || !IQueue< Value >::Enabled();
           } );
@@ -210,13 +479,36 @@ State BlockConcurrentQueue< Value >::PushFwd( V &&obj )
                return State::QueueFull;
           }
 
-          queue_.emplace( std::forward< V >( obj ));
+          queue_.emplace_back( std::forward< Args >( args )... );
      }
 
      pop_cv_.notify_one();
+     IQueue< Value >::PushAccepted();
      return State::Ok;
 }
 
+template< typename Value >
+std::size_t BlockConcurrentQueue< Value >::Committed() const
+{
+     return queue_.size() - ( reserver_ != std::thread::id() ? 1 : 0 );
+}
+
+template< typename Value >
+bool BlockConcurrentQueue< Value >::Poppable() const
+{
+     return !queue_.empty() && ( reserver_ == std::thread::id() || reserved_pos_ != 0 );
+}
+
+template< typename Value >
+void BlockConcurrentQueue< Value >::DropFront()
+{
+     queue_.pop_front();
+     if ( reserver_ != std::thread::id() )
+     {
+          reserved_pos_--;
+     }
+}
+
 } // qm
 
 #endif // MQP_BLOCKING_CONCURRENT_QUEUE_H_
\ No newline at end of file
@@ -0,0 +1,487 @@
+/// @brief Queue accounting bytes of stored values in shared memory budget
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_BUDGETED_QUEUE_H_
+#define MQP_BUDGETED_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "base_queue.hpp"
+#include "memory_budget.hpp"
+
+namespace qm
+{
+
+/// @brief Queue holding bytes of stored values in MemoryBudget shared with other queues.
+/// Bytes are counted by SizeOf on push and returned on pop. Nonblocking pushes are refused with
+/// State::BudgetExceeded, blocking Push, Emplace and Commit wait until budget has bytes or queue is disabled.
+/// Producers lanes got from AttachProducer are accounted too.
+/// @attention InlineQueue consuming values on push is not supported, its bytes are never returned.
+/// @tparam Queue Concrete queue type derived from IQueue
+/// @tparam SizeOf Functor returning size of value in bytes
+template< typename Queue, typename SizeOf = ValueSize< typename Queue::ValueType > >
+class BudgetedQueue : public Queue
+{
+public:
+     using Value = typename Queue::ValueType;
+
+     /// @brief Constructor
+     /// @param budget Budget shared by queues
+     /// @param reserved Bytes reserved for this queue, see BudgetAccount
+     /// @param args Arguments of Queue constructor
+     template< typename... Args >
+     BudgetedQueue( std::shared_ptr< MemoryBudget > budget, std::size_t reserved, Args &&... args );
+
+     /// @brief Get account of queue in budget
+     /// @return Account
+     const BudgetAccount &Account() const { return *account_; }
+
+     /// @brief Pop value and return its bytes to budget
+     /// @return Value if pop successful
+     std::optional< Value > Pop() override;
+
+     /// @brief Pop value to existing object and return its bytes to budget
+     /// @param value Object to move popped value to
+     /// @return true if value is popped
+     bool TryPop( Value &value ) override;
+
+     /// @brief Push value, waits for budget
+     /// @param obj Lvalue object to push
+     /// @return State value
+     State Push( const Value &obj ) override;
+
+     /// @brief Push value, waits for budget
+     /// @param obj Rvalue object to push
+     /// @return State value
+     State Push( Value &&obj ) override;
+
+     /// @brief Nonblocking push
+     /// @param obj Lvalue object to push
+     /// @return State::BudgetExceeded if budget has not enough bytes, other state of queue otherwise
+     State TryPush( const Value &obj ) override;
+
+     /// @brief Nonblocking push
+     /// @param obj Rvalue object to push
+     /// @return State::BudgetExceeded if budget has not enough bytes, other state of queue otherwise
+     State TryPush( Value &&obj ) override;
+
+     /// @brief Nonblocking push of values fitting budget
+     /// @param values Pointer to first value
+     /// @param count Values count
+     /// @return Count of pushed values
+     std::size_t TryPushBulk( Value *values, std::size_t count ) override;
+
+     /// @brief Reserve slot, bytes of value are taken by Commit
+     /// @return Pointer to value in queue storage or nullptr
+     Value *Reserve() override;
+
+     /// @brief Publish reserved value, waits for budget
+     /// @return State::QueueDisabled if queue is disabled while waiting ( value is dropped ), other state of queue otherwise
+     State Commit() override;
+
+     /// @brief Drop reserved value, no bytes are taken for it
+     /// @return State of queue
+     State Cancel() override;
+
+     /// @brief Construct value and push it, waits for budget
+     /// @param args Arguments of Value constructor
+     /// @return State value
+     template< typename... Args >
+     State Emplace( Args &&... args );
+
+     /// @brief Get producer endpoint, lane of Queue is wrapped to account its values
+     /// @return Endpoint or nullptr
+     QueuePtr< Value > AttachProducer() override;
+
+     /// @brief Release endpoint got from AttachProducer
+     /// @param endpoint Endpoint
+     void DetachProducer( const QueuePtr< Value > &endpoint ) override;
+
+private:
+     class Endpoint;
+
+     // queues without own TryPop or TryPushBulk use IQueue defaults calling virtual Pop and TryPush
+     static constexpr bool OwnTryPop = !std::is_same_v< decltype( &Queue::TryPop ), bool ( IQueue< Value >::* )( Value & ) >;
+     static constexpr bool OwnTryPushBulk =
+          !std::is_same_v< decltype( &Queue::TryPushBulk ), std::size_t ( IQueue< Value >::* )( Value *, std::size_t ) >;
+
+     template< typename V >
+     State PushFwd( V &&obj );
+
+     template< typename V >
+     State TryPushFwd( V &&obj );
+
+     /// @brief Take bytes from account, spinning shortly and then sleeping while budget is exhausted
+     /// @param account Account to take bytes from
+     /// @param bytes Bytes count
+     /// @param enabled Predicate telling that pusher may keep waiting
+     /// @return false if enabled returned false before bytes were taken
+     template< typename Enabled >
+     static bool WaitBudget( BudgetAccount &account, std::size_t bytes, Enabled &&enabled );
+
+private:
+     std::shared_ptr< BudgetAccount > account_;
+     SizeOf size_of_;
+     Value *reserved_slot_;                        ///< written by reserving thread only
+     std::atomic< std::thread::id > reserver_;  ///< thread owning reserved slot
+
+     std::mutex endpoints_mtx_;
+     std::vector< std::pair< QueuePtr< Value >, QueuePtr< Value > > > endpoints_;  ///< endpoint and wrapped lane
+};
+
+/// @brief Producer endpoint accounting values pushed to wrapped lane in queue account
+template< typename Queue, typename SizeOf >
+class BudgetedQueue< Queue, SizeOf >::Endpoint : public IQueue< Value >
+{
+public:
+     Endpoint( QueuePtr< Value > lane, std::shared_ptr< BudgetAccount > account ) :
+          IQueue< Value >( lane->MaxSize() ),
+          lane_( std::move( lane )),
+          account_( std::move( account )),
+          reserved_slot_( nullptr )
+     {}
+
+     std::optional< Value > Pop() override { return std::nullopt; }
+
+     State Push( const Value &obj ) override { return PushFwd( obj ); }
+
+     State Push( Value &&obj ) override { return PushFwd( std::move( obj )); }
+
+     State TryPush( const Value &obj ) override { return TryPushFwd( obj ); }
+
+     State TryPush( Value &&obj ) override { return TryPushFwd( std::move( obj )); }
+
+     Value *Reserve() override { return reserved_slot_ = lane_->Reserve(); }
+
+     State Commit() override
+     {
+          if ( reserved_slot_ == nullptr )
+          {
+               return State::QueueAbsent;
+          }
+
+          auto bytes = size_of_( *reserved_slot_ );
+          reserved_slot_ = nullptr;
+          if ( !WaitBudget( *account_, bytes, [ this ]() { return IQueue< Value >::Enabled() && lane_->Enabled(); } ))
+          {
+               lane_->Cancel();
+               return State::QueueDisabled;
+          }
+
+          auto state = lane_->Commit();
+          if ( state != State::Ok )
+          {
+               account_->Release( bytes );
+          }
+          return state;
+     }
+
+     State Cancel() override
+     {
+          reserved_slot_ = nullptr;
+          return lane_->Cancel();
+     }
+
+     bool NotifyOnSpace( std::function< void() > wake ) override { return lane_->NotifyOnSpace( std::move( wake )); }
+
+     bool KeepsRefused() const override { return lane_->KeepsRefused(); }
+
+     bool Empty() const override { return lane_->Empty(); }
+
+private:
+     template< typename V >
+     State PushFwd( V &&obj )
+     {
+          // lane is disabled with whole queue, endpoint is disabled by manager when queue is removed
+          auto bytes = size_of_( obj );
+          if ( !WaitBudget( *account_, bytes, [ this ]() { return IQueue< Value >::Enabled() && lane_->Enabled(); } ))
+          {
+               return State::QueueDisabled;
+          }
+
+          auto state = lane_->Push( std::forward< V >( obj ));
+          if ( state != State::Ok )
+          {
+               account_->Release( bytes );
+          }
+          return state;
+     }
+
+     template< typename V >
+     State TryPushFwd( V &&obj )
+     {
+          auto bytes = size_of_( obj );
+          if ( !account_->Acquire( bytes ))
+          {
+               return State::BudgetExceeded;
+          }
+
+          auto state = lane_->TryPush( std::forward< V >( obj ));
+          if ( state != State::Ok )
+          {
+               account_->Release( bytes );
+          }
+          return state;
+     }
+
+private:
+     QueuePtr< Value > lane_;
+     std::shared_ptr< BudgetAccount > account_;
+     SizeOf size_of_;
+     Value *reserved_slot_;
+};
+
+template< typename Queue, typename SizeOf >
+template< typename... Args >
+BudgetedQueue< Queue, SizeOf >::BudgetedQueue( std::shared_ptr< MemoryBudget > budget, std::size_t reserved, Args &&... args ) :
+     Queue( std::forward< Args >( args )... ),
+     account_( std::make_shared< BudgetAccount >( std::move( budget ), reserved )),
+     reserved_slot_( nullptr )
+{}
+
+template< typename Queue, typename SizeOf >
+std::optional< typename BudgetedQueue< Queue, SizeOf >::Value > BudgetedQueue< Queue, SizeOf >::Pop()
+{
+     auto value = Queue::Pop();
+     if ( value.has_value() )
+     {
+          account_->Release( size_of_( *value ));
+     }
+     return value;
+}
+
+template< typename Queue, typename SizeOf >
+bool BudgetedQueue< Queue, SizeOf >::TryPop( Value &value )
+{
+     if constexpr ( OwnTryPop )
+     {
+          if ( !Queue::TryPop( value ))
+          {
+               return false;
+          }
+
+          account_->Release( size_of_( value ));
+          return true;
+     }
+     else
+     {
+          // default TryPop pops by virtual Pop of this queue, which returns bytes already
+          return Queue::TryPop( value );
+     }
+}
+
+template< typename Queue, typename SizeOf >
+State BudgetedQueue< Queue, SizeOf >::Push( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Queue, typename SizeOf >
+State BudgetedQueue< Queue, SizeOf >::Push( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Queue, typename SizeOf >
+State BudgetedQueue< Queue, SizeOf >::TryPush( const Value &obj )
+{
+     return TryPushFwd( obj );
+}
+
+template< typename Queue, typename SizeOf >
+State BudgetedQueue< Queue, SizeOf >::TryPush( Value &&obj )
+{
+     return TryPushFwd( std::move( obj ));
+}
+
+template< typename Queue, typename SizeOf >
+std::size_t BudgetedQueue< Queue, SizeOf >::TryPushBulk( Value *values, std::size_t count )
+{
+     if constexpr ( !OwnTryPushBulk )
+     {
+          // default implementation pushes by virtual TryPush of this queue
+          return Queue::TryPushBulk( values, count );
+     }
+     else
+     {
+          std::size_t accepted = 0;
+          while ( accepted < count && account_->Acquire( size_of_( values[ accepted ] )))
+          {
+               accepted++;
+          }
+
+          // values not pushed are not moved from
+          auto pushed = Queue::TryPushBulk( values, accepted );
+          for ( auto i = pushed; i < accepted; i++ )
+          {
+               account_->Release( size_of_( values[ i ] ));
+          }
+          return pushed;
+     }
+}
+
+template< typename Queue, typename SizeOf >
+typename BudgetedQueue< Queue, SizeOf >::Value *BudgetedQueue< Queue, SizeOf >::Reserve()
+{
+     // queues accepting several producers give slot to one thread, others get nullptr and don't touch it
+     auto slot = Queue::Reserve();
+     if ( slot != nullptr )
+     {
+          reserved_slot_ = slot;
+          reserver_.store( std::this_thread::get_id() );
+     }
+     return slot;
+}
+
+template< typename Queue, typename SizeOf >
+State BudgetedQueue< Queue, SizeOf >::Commit()
+{
+     if ( reserver_.load() != std::this_thread::get_id() )
+     {
+          return Queue::Commit();
+     }
+
+     // another thread may reserve as soon as slot is committed or dropped, so fields are cleared before
+     auto bytes = size_of_( *reserved_slot_ );
+     reserved_slot_ = nullptr;
+     reserver_.store( std::thread::id() );
+
+     // slot stays reserved by this thread while it waits for bytes
+     if ( !WaitBudget( *account_, bytes, [ this ]() { return IQueue< Value >::Enabled(); } ))
+     {
+          Queue::Cancel();
+          return State::QueueDisabled;
+     }
+
+     auto state = Queue::Commit();
+     if ( state != State::Ok )
+     {
+          account_->Release( bytes );
+     }
+     return state;
+}
+
+template< typename Queue, typename SizeOf >
+State BudgetedQueue< Queue, SizeOf >::Cancel()
+{
+     if ( reserver_.load() == std::this_thread::get_id() )
+     {
+          reserved_slot_ = nullptr;
+          reserver_.store( std::thread::id() );
+     }
+     return Queue::Cancel();
+}
+
+template< typename Queue, typename SizeOf >
+template< typename... Args >
+State BudgetedQueue< Queue, SizeOf >::Emplace( Args &&... args )
+{
+     // value is built in reserved slot and Commit waits for its bytes
+     return IQueue< Value >::Emplace( std::forward< Args >( args )... );
+}
+
+template< typename Queue, typename SizeOf >
+QueuePtr< typename BudgetedQueue< Queue, SizeOf >::Value > BudgetedQueue< Queue, SizeOf >::AttachProducer()
+{
+     auto lane = Queue::AttachProducer();
+     if ( !lane )
+     {
+          return lane;
+     }
+
+     auto endpoint = std::make_shared< Endpoint >( lane, account_ );
+     std::scoped_lock lock( endpoints_mtx_ );
+     endpoints_.emplace_back( endpoint, lane );
+     return endpoint;
+}
+
+template< typename Queue, typename SizeOf >
+void BudgetedQueue< Queue, SizeOf >::DetachProducer( const QueuePtr< Value > &endpoint )
+{
+     QueuePtr< Value > lane = endpoint;
+     {
+          std::scoped_lock lock( endpoints_mtx_ );
+          auto it = std::find_if( endpoints_.begin(), endpoints_.end(),
+                                  [ &endpoint ]( const auto &pair ) { return pair.first == endpoint; } );
+          if ( it != endpoints_.end() )
+          {
+               lane = it->second;
+               endpoints_.erase( it );
+          }
+     }
+     Queue::DetachProducer( lane );
+}
+
+template< typename Queue, typename SizeOf >
+template< typename V >
+State BudgetedQueue< Queue, SizeOf >::PushFwd( V &&obj )
+{
+     auto bytes = size_of_( obj );
+     if ( !WaitBudget( *account_, bytes, [ this ]() { return IQueue< Value >::Enabled(); } ))
+     {
+          return State::QueueDisabled;
+     }
+
+     auto state = Queue::Push( std::forward< V >( obj ));
+     if ( state != State::Ok )
+     {
+          account_->Release( bytes );
+     }
+     return state;
+}
+
+template< typename Queue, typename SizeOf >
+template< typename V >
+State BudgetedQueue< Queue, SizeOf >::TryPushFwd( V &&obj )
+{
+     auto bytes = size_of_( obj );
+     if ( !account_->Acquire( bytes ))
+     {
+          return State::BudgetExceeded;
+     }
+
+     auto state = Queue::TryPush( std::forward< V >( obj ));
+     if ( state != State::Ok )
+     {
+          account_->Release( bytes );
+     }
+     return state;
+}
+
+template< typename Queue, typename SizeOf >
+template< typename Enabled >
+bool BudgetedQueue< Queue, SizeOf >::WaitBudget( BudgetAccount &account, std::size_t bytes, Enabled &&enabled )
+{
+     // throttled producer spins shortly, then sleeps to let consumers return bytes
+     for ( std::size_t attempt = 0; !account.Acquire( bytes ); attempt++ )
+     {
+          if ( !enabled() )
+          {
+               return false;
+          }
+
+          if ( attempt < 64 )
+          {
+               std::this_thread::yield();
+          }
+          else
+          {
+               std::this_thread::sleep_for( std::chrono::microseconds( 50 ));
+          }
+     }
+     return true;
+}
+
+} // qm
+
+#endif // MQP_BUDGETED_QUEUE_H_
@@ -0,0 +1,510 @@
+/// @brief Blocking queue with direct hand-off of values to idle consumer
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_HAND_OFF_QUEUE_H_
+#define MQP_HAND_OFF_QUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "base_queue.hpp"
+#include "consumer/base_consumer.hpp"
+
+namespace qm
+{
+
+/// @brief Blocking queue with direct hand-off of values to idle consumer.
+/// When queue is empty and subscribed consumer is idle and allows inline calls (IConsumer::Inline),
+/// producer thread claims consumer and calls Consume directly, avoiding enqueue and consumer thread wake up.
+/// Consumer is idle when its thread has come back to Pop after previous value, so values order is kept
+/// and Consume is never called concurrently.
+/// @tparam Value Type for queue store
+template<typename Value>
+class HandOffQueue : public IQueue< Value >
+{
+public:
+     /// @brief Constructor
+     /// @param size Maximal size of queue
+     /// @param resource Memory resource for queue storage
+     explicit HandOffQueue( std::size_t size, std::pmr::memory_resource *resource = std::pmr::get_default_resource() );
+
+     /// @brief Destructor
+     ~HandOffQueue();
+
+     using IQueue< Value >::Enabled;
+
+     /// @brief Disable or enable queue and wake up waiting threads
+     /// Thread safe.
+     /// @param enabled - true/false
+     void Enabled( bool enabled ) override;
+
+     /// @brief Disable queue and stop waiting for threads
+     /// Thread safe.
+     void Stop();
+
+     /// @brief Change maximal size of queue and wake up pushers waiting for free space
+     /// Thread safe.
+     /// @param size New maximal size
+     /// @return State::Ok
+     State Resize( std::size_t size ) override;
+
+     /// @brief Set consumer for direct hand-off
+     /// Thread safe.
+     /// @param consumer Pointer to consumer
+     void AttachConsumer( const ConsumerPtr< Value > &consumer ) override;
+
+     /// @brief Reset consumer, waits for running inline Consume
+     /// Thread safe.
+     void DetachConsumer() override;
+
+     /// @brief Check is queue empty.
+     /// Thread safe.
+     /// @return true/false
+     [[nodiscard]] bool Empty() const;
+
+     /// @brief Get current size of queue
+     /// Thread safe.
+     /// @return Size
+     std::size_t Size() const;
+
+     /// @brief Get count of values consumed directly on producers threads
+     /// Thread safe.
+     /// @return Count
+     std::size_t HandedOff() const;
+
+     /// @brief Blocking pop from queue. Calling thread is treated as consumer thread,
+     /// it is busy with popped value until next Pop call.
+     /// Only one consumer thread is allowed.
+     /// @return Object empty value if pop unsuccessfully
+     std::optional< Value > Pop();
+
+     /// @brief Hand-off value to idle consumer or blocking push until queue full or queue will be disabled.
+     /// Thread safe.
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( const Value &obj );
+
+     /// @brief Hand-off value to idle consumer or blocking push until queue full or queue will be disabled.
+     /// Thread safe.
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( Value &&obj );
+
+     /// @brief Hand-off value to idle consumer or nonblocking push.
+     /// Thread safe.
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( const Value &obj );
+
+     /// @brief Hand-off value to idle consumer or nonblocking push.
+     /// Thread safe.
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( Value &&obj );
+
+     /// @brief Reserve slot at the end of queue, value is default constructed in queue storage and published by Commit.
+     /// Value built in slot is never handed off. Slot belongs to calling thread, its repeated Reserve returns
+     /// the same slot. Lock is not held until Commit, but values pushed after reserved slot wait for it.
+     /// Thread safe.
+     /// @return Pointer to value in queue storage,
+     /// nullptr if queue is full, disabled, slot is reserved by other thread or Value is not default constructible
+     Value *Reserve() override;
+
+     /// @brief Publish value built in slot reserved by calling thread
+     /// Thread safe.
+     /// @return State::Ok, State::QueueDisabled if queue was disabled ( value is dropped ),
+     /// State::QueueAbsent if calling thread has no reserved slot
+     State Commit() override;
+
+     /// @brief Drop slot reserved by calling thread
+     /// Thread safe.
+     /// @return State::Ok, State::QueueAbsent if calling thread has no reserved slot
+     State Cancel() override;
+
+     /// @brief Wake producer when pop frees space
+     /// Thread safe.
+     /// @param wake Callable to call
+     /// @return true
+     bool NotifyOnSpace( std::function< void() > wake ) override;
+
+     /// @brief Refused value is not moved from
+     /// @return true
+     bool KeepsRefused() const override;
+
+private:
+     template<typename V>
+     State PushFwd( V &&obj, bool wait );
+
+     /// @brief Count of values consumer may see, reserved slot is not counted. Lock must be held.
+     std::size_t Committed() const;
+
+     /// @brief Is front value committed. Lock must be held.
+     bool Poppable() const;
+
+     /// @brief Consume value on producer thread, lock is released while consuming.
+     /// Rvalue is moved to consumer, so it reaches ConsumeMoved.
+     /// @return true if value was consumed, value is not touched otherwise
+     template<typename V>
+     bool HandOff( std::unique_lock< std::mutex > &lock, V &&obj );
+
+     /// @brief Release consumer claimed by HandOff, relocks queue and wakes up waiting threads
+     class InlineRelease;
+
+private:
+     std::pmr::deque< Value > queue_;
+     std::thread::id reserver_;  ///< thread owning reserved slot
+     std::size_t reserved_pos_;  ///< position of reserved slot from front
+     ConsumerPtr< Value > consumer_;
+     bool consumer_busy_;  ///< consumer thread holds popped value
+     bool inline_busy_;    ///< producer thread runs Consume
+     std::size_t handed_off_;
+
+     mutable std::mutex mtx;
+     std::condition_variable pop_cv_;
+     std::condition_variable push_cv_;
+};
+
+template< typename Value >
+HandOffQueue< Value >::HandOffQueue( std::size_t size, std::pmr::memory_resource *resource ) :
+     IQueue< Value >( size ),
+     queue_( std::pmr::polymorphic_allocator< Value >( resource )),
+     reserved_pos_( 0 ),
+     consumer_busy_( false ),
+     inline_busy_( false ),
+     handed_off_( 0 )
+{}
+
+template< typename Value >
+HandOffQueue< Value >::~HandOffQueue()
+{
+     Stop();
+}
+
+template< typename Value >
+void HandOffQueue< Value >::Enabled( bool enabled )
+{
+     {
+          std::unique_lock lock( mtx );
+          IQueue< Value >::Enabled( enabled );
+     }
+
+     pop_cv_.notify_all();
+     push_cv_.notify_all();
+}
+
+template< typename Value >
+void HandOffQueue< Value >::Stop()
+{
+     Enabled( false );
+}
+
+template< typename Value >
+State HandOffQueue< Value >::Resize( std::size_t size )
+{
+     {
+          std::unique_lock lock( mtx );
+          IQueue< Value >::Resize( size );
+     }
+
+     push_cv_.notify_all();
+     IQueue< Value >::SpaceFreed();
+     return State::Ok;
+}
+
+template< typename Value >
+void HandOffQueue< Value >::AttachConsumer( const ConsumerPtr< Value > &consumer )
+{
+     std::unique_lock lock( mtx );
+     push_cv_.wait( lock, [ this ]() { return !inline_busy_; } );
+     consumer_ = consumer;
+     consumer_busy_ = false;
+}
+
+template< typename Value >
+void HandOffQueue< Value >::DetachConsumer()
+{
+     std::unique_lock lock( mtx );
+     push_cv_.wait( lock, [ this ]() { return !inline_busy_; } );
+     consumer_ = nullptr;
+}
+
+template< typename Value >
+bool HandOffQueue< Value >::Empty() const
+{
+     std::unique_lock lock( mtx );
+     return Committed() == 0 && !inline_busy_;
+}
+
+template< typename Value >
+std::size_t HandOffQueue< Value >::Size() const
+{
+     std::unique_lock lock( mtx );
+     return Committed();
+}
+
+template< typename Value >
+std::size_t HandOffQueue< Value >::HandedOff() const
+{
+     std::unique_lock lock( mtx );
+     return handed_off_;
+}
+
+template< typename Value >
+std::optional< Value > HandOffQueue< Value >::Pop()
+{
+     std::optional< Value > result;
+     {
+          std::unique_lock lock( mtx );
+          // consumer is back, previous value is done
+          consumer_busy_ = false;
+          pop_cv_.wait( lock, [ this ]()
+          {
+               return ( Poppable() && !inline_busy_ ) || !IQueue< Value >::Enabled();
+          } );
+
+          // inline Consume must not overlap with consumer thread even if queue is disabled
+          if ( !Poppable() || inline_busy_ )
+          {
+               return std::nullopt;
+          }
+
+          result.emplace( std::move( queue_.front() ));
+          queue_.pop_front();
+          if ( reserver_ != std::thread::id() )
+          {
+               reserved_pos_--;
+          }
+          consumer_busy_ = true;
+     }
+
+     push_cv_.notify_one();
+     IQueue< Value >::SpaceFreed();
+     return result;
+}
+
+template< typename Value >
+State HandOffQueue< Value >::Push( const Value &obj )
+{
+     return PushFwd( obj, true );
+}
+
+template< typename Value >
+State HandOffQueue< Value >::Push( Value &&obj )
+{
+     return PushFwd( std::move( obj ), true );
+}
+
+template< typename Value >
+State HandOffQueue< Value >::TryPush( const Value &obj )
+{
+     return PushFwd( obj, false );
+}
+
+template< typename Value >
+State HandOffQueue< Value >::TryPush( Value &&obj )
+{
+     return PushFwd( std::move( obj ), false );
+}
+
+template< typename Value >
+Value *HandOffQueue< Value >::Reserve()
+{
+     if constexpr ( std::is_default_constructible_v< Value > )
+     {
+          std::unique_lock lock( mtx );
+          if ( reserver_ == std::this_thread::get_id() )
+          {
+               return &queue_[ reserved_pos_ ];
+          }
+
+          if ( reserver_ != std::thread::id() || !IQueue< Value >::Enabled() ||
+               queue_.size() >= IQueue< Value >::MaxSize())
+          {
+               return nullptr;
+          }
+
+          // queue isn't empty while slot is reserved, so producers don't hand off values overtaking it
+          queue_.emplace_back();
+          reserver_ = std::this_thread::get_id();
+          reserved_pos_ = queue_.size() - 1;
+          return &queue_.back();
+     }
+     else
+     {
+          return nullptr;
+     }
+}
+
+template< typename Value >
+bool HandOffQueue< Value >::NotifyOnSpace( std::function< void() > wake )
+{
+     return IQueue< Value >::AddSpaceWaiter( std::move( wake ));
+}
+
+template< typename Value >
+bool HandOffQueue< Value >::KeepsRefused() const
+{
+     return true;
+}
+
+template< typename Value >
+State HandOffQueue< Value >::Cancel()
+{
+     {
+          std::unique_lock lock( mtx );
+          if ( reserver_ != std::this_thread::get_id() )
+          {
+               return State::QueueAbsent;
+          }
+
+          reserver_ = std::thread::id();
+          queue_.erase( queue_.begin() + static_cast< std::ptrdiff_t >( reserved_pos_ ));
+     }
+
+     // values pushed after dropped slot become visible
+     pop_cv_.notify_all();
+     return State::Ok;
+}
+
+template< typename Value >
+State HandOffQueue< Value >::Commit()
+{
+     {
+          std::unique_lock lock( mtx );
+          if ( reserver_ != std::this_thread::get_id() )
+          {
+               return State::QueueAbsent;
+          }
+
+          reserver_ = std::thread::id();
+          if ( !IQueue< Value >::Enabled())
+          {
+               queue_.erase( queue_.begin() + static_cast< std::ptrdiff_t >( reserved_pos_ ));
+               return State::QueueDisabled;
+          }
+     }
+
+     pop_cv_.notify_one();
+     IQueue< Value >::PushAccepted();
+     return State::Ok;
+}
+
+template< typename Value >
+std::size_t HandOffQueue< Value >::Committed() const
+{
+     return queue_.size() - ( reserver_ != std::thread::id() ? 1 : 0 );
+}
+
+template< typename Value >
+bool HandOffQueue< Value >::Poppable() const
+{
+     return !queue_.empty() && ( reserver_ == std::thread::id() || reserved_pos_ != 0 );
+}
+
+template< typename Value >
+template< typename V >
+State HandOffQueue< Value >::PushFwd( V &&obj, bool wait )
+{
+     {
+          std::unique_lock lock( mtx );
+          while ( queue_.size() >= IQueue< Value >::MaxSize() && IQueue< Value >::Enabled())
+          {
+               // refused or waiting push counts for auto growth
+               lock.unlock();
+               auto grown = IQueue< Value >::GrowOnFull();
+               lock.lock();
+               if ( !grown )
+               {
+                    break;
+               }
+          }
+
+          if ( wait )
+          {
+               push_cv_.wait( lock, [ this ]()
+               {
+                    return queue_.size() < IQueue< Value >::MaxSize() || !IQueue< Value >::Enabled();
+               } );
+          }
+
+          if ( !IQueue< Value >::Enabled())
+          {
+               return State::QueueDisabled;
+          }
+
+          if ( HandOff( lock, std::forward< V >( obj )))
+          {
+               IQueue< Value >::PushAccepted();
+               return State::Ok;
+          }
+
+          if ( queue_.size() >= IQueue< Value >::MaxSize())
+          {
+               return State::QueueFull;
+          }
+
+          queue_.emplace_back( std::forward< V >( obj ));
+     }
+
+     pop_cv_.notify_one();
+     IQueue< Value >::PushAccepted();
+     return State::Ok;
+}
+
+template< typename Value >
+class HandOffQueue< Value >::InlineRelease
+{
+public:
+     InlineRelease( HandOffQueue &queue, std::unique_lock< std::mutex > &lock ) : queue_( queue ), lock_( lock ) {}
+
+     InlineRelease( const InlineRelease & ) = delete;
+
+     InlineRelease &operator=( const InlineRelease & ) = delete;
+
+     ~InlineRelease()
+     {
+          lock_.lock();
+          queue_.inline_busy_ = false;
+          queue_.pop_cv_.notify_one();
+          queue_.push_cv_.notify_all();
+     }
+
+private:
+     HandOffQueue &queue_;
+     std::unique_lock< std::mutex > &lock_;
+};
+
+template< typename Value >
+template< typename V >
+bool HandOffQueue< Value >::HandOff( std::unique_lock< std::mutex > &lock, V &&obj )
+{
+     if ( !queue_.empty() || consumer_busy_ || inline_busy_ ||
+          !consumer_ || !consumer_->Inline() || !consumer_->Enabled() )
+     {
+          return false;
+     }
+
+     // claim consumer, values pushed meanwhile are queued and wait for inline_busy_ reset
+     inline_busy_ = true;
+     // consumer is not replaced or reset while inline_busy_ is set, so it is borrowed without refcounting
+     auto consumer = consumer_.get();
+     {
+          // consumer is released even if Consume throws, otherwise Pop and consumer detaching wait forever
+          InlineRelease release( *this, lock );
+          lock.unlock();
+          consumer->Deliver( std::forward< V >( obj ));
+     }
+     handed_off_++;
+     return true;
+}
+
+} // qm
+
+#endif // MQP_HAND_OFF_QUEUE_H_
@@ -0,0 +1,224 @@
+/// @brief Not synchronized queue which consumes values on producer thread
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_INLINE_QUEUE_H_
+#define MQP_INLINE_QUEUE_H_
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+#include "base_queue.hpp"
+#include "consumer/base_consumer.hpp"
+
+namespace qm
+{
+
+/// @brief Not synchronized queue for single threaded deployments.
+/// When consumer is attached, values are consumed synchronously on Push. With batch size set,
+/// values are deferred and consumed when batch is complete, when queue is full or on explicit Flush.
+/// Deferred values have no time limit, so producer must call Flush when it pauses before batch is complete.
+/// Without consumer (or with disabled one) queue stores values like a regular bounded queue.
+/// @attention No thread safety, all calls must be done from one thread.
+/// @tparam Value Type for queue store
+template< typename Value >
+class InlineQueue : public IQueue< Value >
+{
+public:
+     /// @brief Constructor
+     /// @param size Maximal count of deferred values
+     /// @param batch Count of values deferred before consuming, 0 - consume immediately.
+     /// Batch larger than size is reduced to size, so it is completed before queue is full.
+     explicit InlineQueue( std::size_t size, std::size_t batch = 0 );
+
+     /// @brief Destructor
+     ~InlineQueue() = default;
+
+     /// @brief Set consumer and consume deferred values
+     /// @param consumer Pointer to consumer
+     void AttachConsumer( const ConsumerPtr< Value > &consumer ) override;
+
+     /// @brief Reset consumer, deferred values are kept
+     void DetachConsumer() override;
+
+     /// @brief Consume all deferred values
+     /// @return Count of consumed values
+     std::size_t Flush();
+
+     /// @brief Check is queue empty.
+     /// @return true/false
+     [[nodiscard]] bool Empty() const;
+
+     /// @brief Get count of deferred values
+     /// @return Size
+     std::size_t Size() const;
+
+     /// @brief Pop deferred value
+     /// @return Object empty value if queue is empty
+     std::optional< Value > Pop();
+
+     /// @brief Consume or defer value
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( const Value &obj );
+
+     /// @brief Consume or defer value
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( Value &&obj );
+
+     /// @brief Consume or defer value. Method similar to Push(const &)
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( const Value &obj );
+
+     /// @brief Consume or defer value. Method similar to Push(&&)
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( Value &&obj );
+
+private:
+     template< typename V >
+     State PushFwd( V &&obj );
+
+     bool ConsumerReady() const;
+
+private:
+     const std::size_t batch_;
+     std::deque< Value > deferred_;
+     ConsumerPtr< Value > consumer_;
+     bool flushing_;
+};
+
+template< typename Value >
+InlineQueue< Value >::InlineQueue( std::size_t size, std::size_t batch ) : IQueue< Value >( size ),
+                                                                           batch_( std::min( batch, size )),
+                                                                           flushing_( false )
+{}
+
+template< typename Value >
+void InlineQueue< Value >::AttachConsumer( const ConsumerPtr< Value > &consumer )
+{
+     consumer_ = consumer;
+     Flush();
+}
+
+template< typename Value >
+void InlineQueue< Value >::DetachConsumer()
+{
+     consumer_ = nullptr;
+}
+
+template< typename Value >
+std::size_t InlineQueue< Value >::Flush()
+{
+     // values pushed by Consume are deferred and consumed in the same loop
+     if ( flushing_ )
+     {
+          return 0;
+     }
+
+     std::size_t consumed = 0;
+     flushing_ = true;
+     while ( !deferred_.empty() && ConsumerReady() )
+     {
+          Value value = std::move( deferred_.front() );
+          deferred_.pop_front();
+          consumer_->ConsumeMoved( std::move( value ));
+          consumed++;
+     }
+     flushing_ = false;
+
+     return consumed;
+}
+
+template< typename Value >
+bool InlineQueue< Value >::Empty() const
+{
+     return deferred_.empty();
+}
+
+template< typename Value >
+std::size_t InlineQueue< Value >::Size() const
+{
+     return deferred_.size();
+}
+
+template< typename Value >
+std::optional< Value > InlineQueue< Value >::Pop()
+{
+     if ( deferred_.empty() )
+     {
+          return std::nullopt;
+     }
+
+     std::optional< Value > result( std::move( deferred_.front() ));
+     deferred_.pop_front();
+     return result;
+}
+
+template< typename Value >
+State InlineQueue< Value >::Push( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value >
+State InlineQueue< Value >::Push( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Value >
+State InlineQueue< Value >::TryPush( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value >
+State InlineQueue< Value >::TryPush( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Value >
+template< typename V >
+State InlineQueue< Value >::PushFwd( V &&obj )
+{
+     if ( !IQueue< Value >::Enabled() ) return State::QueueDisabled;
+
+     if ( batch_ == 0 && deferred_.empty() && !flushing_ && ConsumerReady() )
+     {
+          consumer_->Deliver( std::forward< V >( obj ));
+          return State::Ok;
+     }
+
+     // queue shrunk by Resize below batch is flushed when full
+     if ( deferred_.size() >= IQueue< Value >::MaxSize() )
+     {
+          Flush();
+          if ( deferred_.size() >= IQueue< Value >::MaxSize() )
+          {
+               return State::QueueFull;
+          }
+     }
+
+     deferred_.emplace_back( std::forward< V >( obj ));
+     if ( deferred_.size() >= batch_ )
+     {
+          Flush();
+     }
+
+     return State::Ok;
+}
+
+template< typename Value >
+bool InlineQueue< Value >::ConsumerReady() const
+{
+     return consumer_ && consumer_->Enabled();
+}
+
+} // qm
+
+#endif // MQP_INLINE_QUEUE_H_
@@ -5,6 +5,11 @@
 #ifndef MQP_LOCK_FREE_QUEUE_H_
 #define MQP_LOCK_FREE_QUEUE_H_
 
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <type_traits>
+
 #include <boost/lockfree/queue.hpp>
 
 #include <queue/base_queue.hpp>
@@ -14,13 +19,18 @@ namespace qm
 
 /// @brief Lock free queue for multi producers multi consumers model.
 /// @tparam Value Type for queue store
-template< typename Value >
+/// @tparam Capacity Maximal size of queue fixed at compile time. Nodes are kept in array inside queue
+/// and linked by 16 bit indices instead of tagged pointers to runtime node pool. 0 means runtime size.
+template< typename Value, std::size_t Capacity = 0 >
 class LockFreeQueue : public IQueue< Value >
 {
+     static_assert( Capacity < std::numeric_limits< std::uint16_t >::max(),
+                    "Compile time capacity is limited by 16 bit node indices" );
+
 public:
      /// @brief Constructor
-     /// @param size Maximal size of queue
-     explicit LockFreeQueue( std::size_t size );
+     /// @param size Maximal size of queue, ignored if Capacity is set
+     explicit LockFreeQueue( std::size_t size = Capacity );
 
      /// @brief Destructor
      ~LockFreeQueue() = default;
@@ -29,6 +39,17 @@ public:
      /// Thread safe
      void Stop();
 
+     /// @brief Grow node pool of queue, nodes are added while producers and consumers keep running.
+     /// Pool can't give nodes back, so queue can't shrink, neither can queue with compile time Capacity.
+     /// Thread safe
+     /// @param size New maximal size
+     /// @return State::Ok or State::QueueBusy if queue can't be resized to size
+     State Resize( std::size_t size ) override;
+
+     /// @brief Value is copied into node, so refused value is not moved from
+     /// @return true
+     bool KeepsRefused() const override;
+
      /// @brief Check is queue empty.
      /// Thread safe.
      /// @return true/false
@@ -39,6 +60,12 @@ public:
      /// @return Object empty value if pop unsuccessfully
      std::optional< Value > Pop();
 
+     /// @brief Lock free pop to existing object.
+     /// Thread safe.
+     /// @param value Object to store popped value
+     /// @return true if value is popped
+     bool TryPop( Value &value ) override;
+
      /// @brief Lock free push.
      /// Thread safe
      /// @param obj Lvalue object to push
@@ -64,30 +91,81 @@ public:
      State TryPush( Value &&obj );
 
 private:
-     boost::lockfree::queue< Value > queue_;
+     using Storage = std::conditional_t< Capacity == 0,
+                                         boost::lockfree::queue< Value >,
+                                         boost::lockfree::queue< Value, boost::lockfree::capacity< Capacity > > >;
+
+     static Storage MakeStorage( std::size_t size );
+
+     State PushFwd( const Value &obj );
+
+private:
+     Storage queue_;
+     std::mutex resize_mtx_;
 
 };
 
-template< typename Value >
-void LockFreeQueue< Value >::Stop()
+template< typename Value, std::size_t Capacity >
+void LockFreeQueue< Value, Capacity >::Stop()
 {
      // Queue is nonblocking, nothing to do here
      IQueue< Value >::Enabled( false );
 }
 
-template< typename Value >
-LockFreeQueue< Value >::LockFreeQueue( std::size_t size ) : IQueue< Value >( size ),
-                                                            queue_( boost::lockfree::queue< Value >( size ))
+template< typename Value, std::size_t Capacity >
+LockFreeQueue< Value, Capacity >::LockFreeQueue( std::size_t size ) : IQueue< Value >( Capacity == 0 ? size : Capacity ),
+                                                                      queue_( MakeStorage( size ))
 {}
 
-template< typename Value >
-bool LockFreeQueue< Value >::Empty() const
+template< typename Value, std::size_t Capacity >
+typename LockFreeQueue< Value, Capacity >::Storage LockFreeQueue< Value, Capacity >::MakeStorage( std::size_t size )
+{
+     if constexpr ( Capacity == 0 )
+     {
+          return Storage( size );
+     }
+     else
+     {
+          return Storage();
+     }
+}
+
+template< typename Value, std::size_t Capacity >
+State LockFreeQueue< Value, Capacity >::Resize( std::size_t size )
+{
+     if constexpr ( Capacity == 0 )
+     {
+          std::scoped_lock lock( resize_mtx_ );
+          auto current = IQueue< Value >::MaxSize();
+          if ( size < current )
+          {
+               return State::QueueBusy;
+          }
+
+          // nodes are added to pool before limit is raised, so pushes never allocate
+          queue_.reserve( size - current );
+          return IQueue< Value >::Resize( size );
+     }
+     else
+     {
+          return size == Capacity ? State::Ok : State::QueueBusy;
+     }
+}
+
+template< typename Value, std::size_t Capacity >
+bool LockFreeQueue< Value, Capacity >::KeepsRefused() const
+{
+     return true;
+}
+
+template< typename Value, std::size_t Capacity >
+bool LockFreeQueue< Value, Capacity >::Empty() const
 {
      return queue_.empty();
 }
 
-template< typename Value >
-std::optional< Value > LockFreeQueue< Value >::Pop()
+template< typename Value, std::size_t Capacity >
+std::optional< Value > LockFreeQueue< Value, Capacity >::Pop()
 {
      Value value;
      if ( queue_.pop( value ))
@@ -98,32 +176,53 @@ std::optional< Value > LockFreeQueue< Value >::Pop()
      return std::nullopt;
 }
 
-template< typename Value >
-State LockFreeQueue< Value >::Push( const Value &obj )
+template< typename Value, std::size_t Capacity >
+bool LockFreeQueue< Value, Capacity >::TryPop( Value &value )
 {
-     if ( !IQueue< Value >::Enabled() ) return State::QueueDisabled;
-     return queue_.bounded_push( obj ) ? State::Ok : State::QueueFull;
+     return queue_.pop( value );
 }
 
-template< typename Value >
-State LockFreeQueue< Value >::Push( Value &&obj )
+template< typename Value, std::size_t Capacity >
+State LockFreeQueue< Value, Capacity >::Push( const Value &obj )
 {
-     if ( !IQueue< Value >::Enabled() ) return State::QueueDisabled;
-     return queue_.bounded_push( std::move( obj )) ? State::Ok : State::QueueFull;
+     return PushFwd( obj );
 }
 
-template< typename Value >
-State LockFreeQueue< Value >::TryPush( const Value &obj )
+template< typename Value, std::size_t Capacity >
+State LockFreeQueue< Value, Capacity >::Push( Value &&obj )
 {
-     if ( !IQueue< Value >::Enabled() ) return State::QueueDisabled;
-     return queue_.bounded_push( obj ) ? State::Ok : State::QueueFull;
+     return PushFwd( obj );
 }
 
-template< typename Value >
-State LockFreeQueue< Value >::TryPush( Value &&obj )
+template< typename Value, std::size_t Capacity >
+State LockFreeQueue< Value, Capacity >::TryPush( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value, std::size_t Capacity >
+State LockFreeQueue< Value, Capacity >::TryPush( Value &&obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value, std::size_t Capacity >
+State LockFreeQueue< Value, Capacity >::PushFwd( const Value &obj )
 {
      if ( !IQueue< Value >::Enabled() ) return State::QueueDisabled;
-     return queue_.bounded_push( std::move( obj )) ? State::Ok : State::QueueFull;
+
+     // boost queue copies value into node, so failed push may be retried with the same object
+     do
+     {
+          if ( queue_.bounded_push( obj ))
+          {
+               IQueue< Value >::PushAccepted();
+               return State::Ok;
+          }
+     }
+     while ( IQueue< Value >::GrowOnFull());
+
+     return State::QueueFull;
 }
 
 } // qm
@@ -0,0 +1,170 @@
+/// @brief Byte budget shared by queues
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_MEMORY_BUDGET_H_
+#define MQP_MEMORY_BUDGET_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "common.h"
+
+namespace qm
+{
+
+/// @brief Limit of bytes held by all queues sharing budget ( e.g. all queues of manager ).
+/// Queue may reserve part of budget for itself, the rest is shared pool taken on demand.
+/// Usage is one atomic counter, readable from any thread.
+class MemoryBudget
+{
+public:
+     /// @brief Constructor
+     /// @param limit Maximal count of bytes held by queues
+     explicit MemoryBudget( std::size_t limit ) : limit_( limit ), used_( 0 ), shared_( 0 )
+     {}
+
+     /// @brief Get limit of budget
+     /// @return Bytes count
+     std::size_t Limit() const { return limit_; }
+
+     /// @brief Get bytes held by all queues
+     /// @return Bytes count
+     /// @details Thread safe
+     std::size_t Used() const { return used_.load( std::memory_order_relaxed ); }
+
+     /// @brief Get bytes taken from shared pool, reservations included
+     /// @return Bytes count
+     /// @details Thread safe
+     std::size_t Taken() const { return shared_.load( std::memory_order_relaxed ); }
+
+     /// @brief Take bytes from shared pool
+     /// @param bytes Bytes count
+     /// @return false if pool has not enough bytes
+     /// @details Thread safe
+     bool Take( std::size_t bytes )
+     {
+          auto taken = shared_.load( std::memory_order_relaxed );
+          do
+          {
+               if ( bytes > limit_ - taken )
+               {
+                    return false;
+               }
+          }
+          while ( !shared_.compare_exchange_weak( taken, taken + bytes, std::memory_order_relaxed ));
+          return true;
+     }
+
+     /// @brief Return bytes to shared pool
+     /// @param bytes Bytes count got by Take
+     /// @details Thread safe
+     void Give( std::size_t bytes ) { shared_.fetch_sub( bytes, std::memory_order_relaxed ); }
+
+     /// @brief Account bytes stored to or removed from queues
+     /// @param bytes Bytes count, negative for removed values
+     /// @details Thread safe
+     void Count( std::ptrdiff_t bytes ) { used_.fetch_add( static_cast< std::size_t >( bytes ), std::memory_order_relaxed ); }
+
+private:
+     const std::size_t limit_;
+     CacheAligned< std::atomic< std::size_t > > used_;    ///< bytes held by queues
+     CacheAligned< std::atomic< std::size_t > > shared_;  ///< bytes of pool taken by reservations and overflows
+};
+
+/// @brief Account of one queue in MemoryBudget.
+/// Values fitting queue reservation touch only account counter, overflow is taken from shared pool.
+class BudgetAccount
+{
+public:
+     /// @brief Constructor, reservation is taken from pool if pool has enough bytes
+     /// @param budget Shared budget
+     /// @param reserved Bytes reserved for queue
+     BudgetAccount( std::shared_ptr< MemoryBudget > budget, std::size_t reserved ) :
+          budget_( std::move( budget )),
+          reserved_( budget_->Take( reserved ) ? reserved : 0 ),
+          used_( 0 )
+     {}
+
+     /// @brief Destructor, returns reservation and bytes of values left in queue
+     ~BudgetAccount()
+     {
+          Release( used_.load() );
+          budget_->Give( reserved_ );
+     }
+
+     /// @brief Copying is forbidden
+     BudgetAccount( const BudgetAccount & ) = delete;
+
+     /// @brief Copying is forbidden
+     BudgetAccount &operator=( const BudgetAccount & ) = delete;
+
+     /// @brief Get budget of account
+     /// @return Budget
+     const std::shared_ptr< MemoryBudget > &Budget() const { return budget_; }
+
+     /// @brief Get bytes reserved for queue
+     /// @return Bytes count, 0 if pool had not enough bytes for reservation
+     std::size_t Reserved() const { return reserved_; }
+
+     /// @brief Get bytes held by queue
+     /// @return Bytes count
+     /// @details Thread safe
+     std::size_t Used() const { return used_.load( std::memory_order_relaxed ); }
+
+     /// @brief Account value stored to queue
+     /// @param bytes Size of value
+     /// @return false if neither reservation nor pool has enough bytes
+     /// @details Thread safe
+     bool Acquire( std::size_t bytes )
+     {
+          auto used = used_.load( std::memory_order_relaxed );
+          for ( ;; )
+          {
+               auto overflow = Overflow( used + bytes ) - Overflow( used );
+               if ( overflow != 0 && !budget_->Take( overflow ))
+               {
+                    return false;
+               }
+
+               if ( used_.compare_exchange_weak( used, used + bytes, std::memory_order_relaxed ))
+               {
+                    budget_->Count( static_cast< std::ptrdiff_t >( bytes ));
+                    return true;
+               }
+
+               // usage is changed by other thread, overflow is computed again
+               if ( overflow != 0 )
+               {
+                    budget_->Give( overflow );
+               }
+          }
+     }
+
+     /// @brief Account value removed from queue
+     /// @param bytes Size of value passed to Acquire
+     /// @details Thread safe
+     void Release( std::size_t bytes )
+     {
+          auto used = used_.fetch_sub( bytes, std::memory_order_relaxed );
+          auto overflow = Overflow( used ) - Overflow( used - bytes );
+          if ( overflow != 0 )
+          {
+               budget_->Give( overflow );
+          }
+          budget_->Count( -static_cast< std::ptrdiff_t >( bytes ));
+     }
+
+private:
+     std::size_t Overflow( std::size_t used ) const { return used > reserved_ ? used - reserved_ : 0; }
+
+private:
+     const std::shared_ptr< MemoryBudget > budget_;
+     const std::size_t reserved_;
+     std::atomic< std::size_t > used_;
+};
+
+} // qm
+
+#endif // MQP_MEMORY_BUDGET_H_
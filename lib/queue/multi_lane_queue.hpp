@@ -0,0 +1,515 @@
+/// @brief Multi producers single consumer queue composed from single producer lanes.
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_MULTI_LANE_QUEUE_H_
+#define MQP_MULTI_LANE_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base_queue.hpp"
+#include "spsc_ring_queue.hpp"
+
+namespace qm
+{
+
+/// @brief Multi producers single consumer queue composed from single producer lanes.
+/// Each registered producer gets its own SpscRingQueue lane, so producers never contend with each other.
+/// Consumer drains lanes with round robin rotation. Values pushed directly to this queue
+/// (e.g. by manager Enqueue) go to the shared lane guarded by mutex.
+/// @tparam Value Type for queue store
+template< typename Value >
+class MultiLaneQueue : public IQueue< Value >
+{
+public:
+     /// @brief Constructor
+     /// @param size Maximal size of each lane
+     /// @param resource Memory resource for lanes and their storage
+     explicit MultiLaneQueue( std::size_t size, std::pmr::memory_resource *resource = std::pmr::get_default_resource() );
+
+     /// @brief Destructor
+     ~MultiLaneQueue() = default;
+
+     using IQueue< Value >::Enabled;
+
+     /// @brief Disable or enable queue with all its lanes
+     /// Thread safe
+     /// @param enabled - true/false
+     void Enabled( bool enabled ) override;
+
+     /// @brief Disable queue with all its lanes
+     /// Thread safe
+     void Stop();
+
+     /// @brief Create new lane for registered producer
+     /// Thread safe
+     /// @return Lane queue
+     QueuePtr< Value > AttachProducer() override;
+
+     /// @brief Retire producer lane. Values left in lane will be consumed.
+     /// Thread safe
+     /// @param endpoint Lane queue returned by AttachProducer
+     void DetachProducer( const QueuePtr< Value > &endpoint ) override;
+
+     /// @brief Change maximal size of shared and producers lanes, lanes of producers attached later get it too
+     /// Thread safe
+     /// @param size New maximal size of each lane
+     /// @return State::Ok
+     State Resize( std::size_t size ) override;
+
+     /// @brief Let shared and producers lanes grow when they stay full, each lane grows on its own
+     /// Thread safe
+     /// @param limit Maximal size lane may grow to, 0 disables growth
+     /// @param after Count of refused pushes in a row which triggers growth
+     void AutoGrow( std::size_t limit, std::size_t after = 16 ) override;
+
+     /// @brief Fault in storage pages of shared and producers lanes
+     /// Thread safe
+     void Prefault() override;
+
+     /// @brief Move storage of shared and producers lanes to memory of NUMA node,
+     /// lanes of producers attached later are moved too
+     /// Thread safe
+     /// @param node NUMA node number
+     void BindToNode( int node ) override;
+
+     /// @brief Check are all lanes empty.
+     /// Thread safe.
+     /// @return true/false
+     [[nodiscard]] bool Empty() const;
+
+     /// @brief Get number of active producer lanes
+     /// Thread safe.
+     /// @return Lanes count
+     std::size_t Lanes() const;
+
+     /// @brief Nonblocking pop from next nonempty lane.
+     /// Only one consumer thread is allowed.
+     /// @return Object empty value if pop unsuccessfully
+     std::optional< Value > Pop();
+
+     /// @brief Nonblocking pop from next nonempty lane to existing object.
+     /// Only one consumer thread is allowed.
+     /// @param value Object to move popped value to
+     /// @return true if value is popped
+     bool TryPop( Value &value ) override;
+
+     /// @brief Nonblocking push to shared lane.
+     /// Thread safe
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( const Value &obj );
+
+     /// @brief Nonblocking push to shared lane.
+     /// Thread safe
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( Value &&obj );
+
+     /// @brief Nonblocking push to shared lane. Method similar to Push(const &)
+     /// Thread safe
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( const Value &obj );
+
+     /// @brief Nonblocking push to shared lane. Method similar to Push(&&)
+     /// Thread safe
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( Value &&obj );
+
+     /// @brief Nonblocking push of value constructed in place in shared lane.
+     /// Registered producers reserve slots in own lanes by Reserve/Commit of endpoint.
+     /// Thread safe
+     /// @param args Arguments of Value constructor
+     /// @return State::Ok or other state of queue on error
+     template< typename... Args >
+     State Emplace( Args &&... args );
+
+     /// @brief Reserve slot in shared lane, value is default constructed in lane storage and published by Commit.
+     /// Slot belongs to calling thread, its repeated Reserve returns the same slot. Pushes to shared lane
+     /// are refused with State::QueueBusy until slot is committed. Registered producers reserve in own lanes.
+     /// Thread safe
+     /// @return Pointer to value in lane storage, nullptr if lane is full, disabled or reserved by other thread
+     Value *Reserve() override;
+
+     /// @brief Publish value built in slot of shared lane reserved by calling thread
+     /// Thread safe
+     /// @return State::Ok, State::QueueDisabled if queue was disabled ( value is dropped ),
+     /// State::QueueAbsent if calling thread has no reserved slot
+     State Commit() override;
+
+     /// @brief Drop slot of shared lane reserved by calling thread
+     /// Thread safe
+     /// @return State::Ok, State::QueueAbsent if calling thread has no reserved slot
+     State Cancel() override;
+
+     /// @brief Wake producer when consumer frees space in shared lane, registered producers park on own lanes
+     /// Thread safe
+     /// @param wake Callable to call
+     /// @return true
+     bool NotifyOnSpace( std::function< void() > wake ) override;
+
+     /// @brief Refused value is not moved from
+     /// @return true
+     bool KeepsRefused() const override;
+
+     /// @brief Nonblocking push of several values to shared lane under one lock.
+     /// Thread safe
+     /// @param values Pointer to first value
+     /// @param count Values count
+     /// @return Count of pushed values
+     std::size_t TryPushBulk( Value *values, std::size_t count ) override;
+
+private:
+     using LanePtr = std::shared_ptr< SpscRingQueue< Value > >;
+
+     template< typename... Args >
+     State PushFwd( Args &&... args );
+
+     template< typename Result, typename Op >
+     Result PopFwd( Op &&pop );
+
+     void RefreshLanes();
+
+     LanePtr MakeLane() const;
+
+private:
+     std::pmr::memory_resource *resource_;
+
+     // producers, consumer and lanes registration touch separate cache lines
+     alignas( CacheLineSize ) std::mutex shared_lane_mtx_;
+     LanePtr shared_lane_;
+     std::thread::id reserver_;  ///< thread owning slot reserved in shared lane, guarded by shared_lane_mtx_
+
+     alignas( CacheLineSize ) mutable std::mutex lanes_mtx_;
+     std::vector< LanePtr > lanes_;
+     std::vector< LanePtr > retired_;
+     CacheAligned< std::atomic< std::size_t > > version_;
+     int node_;  ///< NUMA node of consumer, -1 if not bound
+
+     // consumer side state, accessed only from consumer thread
+     alignas( CacheLineSize ) std::vector< LanePtr > consumer_lanes_;
+     std::size_t consumer_version_;
+     std::size_t next_lane_;
+     bool has_retired_;
+};
+
+template< typename Value >
+MultiLaneQueue< Value >::MultiLaneQueue( std::size_t size, std::pmr::memory_resource *resource ) :
+     IQueue< Value >( size ),
+     resource_( resource ),
+     shared_lane_( MakeLane() ),
+     version_( 1 ),
+     node_( -1 ),
+     consumer_version_( 0 ),
+     next_lane_( 0 ),
+     has_retired_( false )
+{}
+
+template< typename Value >
+void MultiLaneQueue< Value >::Enabled( bool enabled )
+{
+     std::scoped_lock lock( lanes_mtx_ );
+     IQueue< Value >::Enabled( enabled );
+     shared_lane_->Enabled( enabled );
+     for ( auto &lane : lanes_ )
+     {
+          lane->Enabled( enabled );
+     }
+}
+
+template< typename Value >
+void MultiLaneQueue< Value >::Stop()
+{
+     Enabled( false );
+}
+
+template< typename Value >
+QueuePtr< Value > MultiLaneQueue< Value >::AttachProducer()
+{
+     auto lane = MakeLane();
+
+     std::scoped_lock lock( lanes_mtx_ );
+     lane->Enabled( IQueue< Value >::Enabled() );
+     lane->AutoGrow( IQueue< Value >::GrowLimit(), IQueue< Value >::GrowAfter() );
+     if ( lane->MaxSize() != IQueue< Value >::MaxSize() )
+     {
+          // queue is resized while lane was created
+          lane->Resize( IQueue< Value >::MaxSize() );
+     }
+     if ( node_ >= 0 )
+     {
+          lane->BindToNode( node_ );
+     }
+     lanes_.push_back( lane );
+     version_.fetch_add( 1, std::memory_order_release );
+     return lane;
+}
+
+template< typename Value >
+void MultiLaneQueue< Value >::DetachProducer( const QueuePtr< Value > &endpoint )
+{
+     std::scoped_lock lock( lanes_mtx_ );
+     auto it = std::find( lanes_.begin(), lanes_.end(), endpoint );
+     if ( it == lanes_.end() )
+     {
+          return;
+     }
+
+     // producer is done, so lane will not be refilled and may be dropped when consumer drains it
+     if ( !( *it )->Empty() )
+     {
+          retired_.push_back( *it );
+     }
+
+     lanes_.erase( it );
+     version_.fetch_add( 1, std::memory_order_release );
+}
+
+template< typename Value >
+State MultiLaneQueue< Value >::Resize( std::size_t size )
+{
+     std::scoped_lock lock( lanes_mtx_ );
+     IQueue< Value >::Resize( size );
+     shared_lane_->Resize( size );
+     for ( const auto &lane : lanes_ )
+     {
+          lane->Resize( size );
+     }
+     return State::Ok;
+}
+
+template< typename Value >
+void MultiLaneQueue< Value >::AutoGrow( std::size_t limit, std::size_t after )
+{
+     std::scoped_lock lock( lanes_mtx_ );
+     IQueue< Value >::AutoGrow( limit, after );
+     shared_lane_->AutoGrow( limit, after );
+     for ( const auto &lane : lanes_ )
+     {
+          lane->AutoGrow( limit, after );
+     }
+}
+
+template< typename Value >
+void MultiLaneQueue< Value >::Prefault()
+{
+     shared_lane_->Prefault();
+
+     std::scoped_lock lock( lanes_mtx_ );
+     for ( const auto &lane : lanes_ )
+     {
+          lane->Prefault();
+     }
+}
+
+template< typename Value >
+void MultiLaneQueue< Value >::BindToNode( int node )
+{
+     shared_lane_->BindToNode( node );
+
+     std::scoped_lock lock( lanes_mtx_ );
+     node_ = node;
+     for ( const auto &lane : lanes_ )
+     {
+          lane->BindToNode( node );
+     }
+}
+
+template< typename Value >
+bool MultiLaneQueue< Value >::Empty() const
+{
+     std::scoped_lock lock( lanes_mtx_ );
+     auto is_empty = []( const LanePtr &lane ) { return lane->Empty(); };
+     return shared_lane_->Empty() &&
+            std::all_of( lanes_.begin(), lanes_.end(), is_empty ) &&
+            std::all_of( retired_.begin(), retired_.end(), is_empty );
+}
+
+template< typename Value >
+std::size_t MultiLaneQueue< Value >::Lanes() const
+{
+     std::scoped_lock lock( lanes_mtx_ );
+     return lanes_.size();
+}
+
+template< typename Value >
+std::optional< Value > MultiLaneQueue< Value >::Pop()
+{
+     return PopFwd< std::optional< Value > >( []( const LanePtr &lane ) { return lane->Pop(); } );
+}
+
+template< typename Value >
+bool MultiLaneQueue< Value >::TryPop( Value &value )
+{
+     return PopFwd< bool >( [ &value ]( const LanePtr &lane ) { return lane->TryPop( value ); } );
+}
+
+template< typename Value >
+template< typename Result, typename Op >
+Result MultiLaneQueue< Value >::PopFwd( Op &&pop )
+{
+     if ( version_.load( std::memory_order_acquire ) != consumer_version_ )
+     {
+          RefreshLanes();
+     }
+
+     // shared lane takes the last position in rotation
+     const auto count = consumer_lanes_.size() + 1;
+     for ( std::size_t i = 0; i < count; ++i )
+     {
+          auto index = ( next_lane_ + i ) % count;
+          auto &lane = index == consumer_lanes_.size() ? shared_lane_ : consumer_lanes_[ index ];
+          Result result = pop( lane );
+          if ( result )
+          {
+               next_lane_ = index + 1;
+               return result;
+          }
+     }
+
+     if ( has_retired_ )
+     {
+          RefreshLanes();
+     }
+
+     return Result();
+}
+
+template< typename Value >
+void MultiLaneQueue< Value >::RefreshLanes()
+{
+     std::scoped_lock lock( lanes_mtx_ );
+     retired_.erase( std::remove_if( retired_.begin(), retired_.end(),
+                                     []( const LanePtr &lane ) { return lane->Empty(); } ),
+                     retired_.end() );
+
+     consumer_lanes_ = lanes_;
+     consumer_lanes_.insert( consumer_lanes_.end(), retired_.begin(), retired_.end() );
+     has_retired_ = !retired_.empty();
+     consumer_version_ = version_.load( std::memory_order_relaxed );
+}
+
+template< typename Value >
+typename MultiLaneQueue< Value >::LanePtr MultiLaneQueue< Value >::MakeLane() const
+{
+     // lane object and its ring come from the same resource
+     return std::allocate_shared< SpscRingQueue< Value > >(
+          std::pmr::polymorphic_allocator< SpscRingQueue< Value > >( resource_ ), IQueue< Value >::MaxSize(), resource_ );
+}
+
+template< typename Value >
+State MultiLaneQueue< Value >::Push( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value >
+State MultiLaneQueue< Value >::Push( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Value >
+State MultiLaneQueue< Value >::TryPush( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value >
+State MultiLaneQueue< Value >::TryPush( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Value >
+std::size_t MultiLaneQueue< Value >::TryPushBulk( Value *values, std::size_t count )
+{
+     if ( !IQueue< Value >::Enabled() ) return 0;
+
+     std::scoped_lock lock( shared_lane_mtx_ );
+     return shared_lane_->TryPushBulk( values, count );
+}
+
+template< typename Value >
+Value *MultiLaneQueue< Value >::Reserve()
+{
+     if ( !IQueue< Value >::Enabled() ) return nullptr;
+
+     std::scoped_lock lock( shared_lane_mtx_ );
+     if ( reserver_ != std::thread::id() && reserver_ != std::this_thread::get_id() )
+     {
+          return nullptr;
+     }
+
+     // lane is single producer, so its reservation is handed to one thread at a time
+     auto slot = shared_lane_->Reserve();
+     reserver_ = slot ? std::this_thread::get_id() : std::thread::id();
+     return slot;
+}
+
+template< typename Value >
+State MultiLaneQueue< Value >::Commit()
+{
+     std::scoped_lock lock( shared_lane_mtx_ );
+     if ( reserver_ != std::this_thread::get_id() )
+     {
+          return State::QueueAbsent;
+     }
+
+     reserver_ = std::thread::id();
+     return shared_lane_->Commit();
+}
+
+template< typename Value >
+bool MultiLaneQueue< Value >::NotifyOnSpace( std::function< void() > wake )
+{
+     return shared_lane_->NotifyOnSpace( std::move( wake ));
+}
+
+template< typename Value >
+bool MultiLaneQueue< Value >::KeepsRefused() const
+{
+     return true;
+}
+
+template< typename Value >
+State MultiLaneQueue< Value >::Cancel()
+{
+     std::scoped_lock lock( shared_lane_mtx_ );
+     if ( reserver_ != std::this_thread::get_id() )
+     {
+          return State::QueueAbsent;
+     }
+
+     reserver_ = std::thread::id();
+     return shared_lane_->Cancel();
+}
+
+template< typename Value >
+template< typename... Args >
+State MultiLaneQueue< Value >::Emplace( Args &&... args )
+{
+     return PushFwd( std::forward< Args >( args )... );
+}
+
+template< typename Value >
+template< typename... Args >
+State MultiLaneQueue< Value >::PushFwd( Args &&... args )
+{
+     if ( !IQueue< Value >::Enabled() ) return State::QueueDisabled;
+
+     std::scoped_lock lock( shared_lane_mtx_ );
+     return shared_lane_->Emplace( std::forward< Args >( args )... );
+}
+
+} // qm
+
+#endif // MQP_MULTI_LANE_QUEUE_H_
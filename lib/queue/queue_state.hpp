@@ -16,7 +16,8 @@ enum class State
      QueueBusy,          ///< Queue is busy ( by other producer or consumer )
      QueueAbsent,        ///< Queue is absent
      QueueDisabled,      ///< Queue is disabled, operation impossible
-     ProducerNotFound    ///< Producer is not found for queue
+     ProducerNotFound,   ///< Producer is not found for queue
+     BudgetExceeded      ///< Memory budget shared by queues is exhausted
 };
 
 /// @brief Text representation of queue state
@@ -42,7 +43,11 @@ inline std::string StateStr( State s )
                return "queue is disabled";
           case State::ProducerNotFound:
                return "producer is not found";
+          case State::BudgetExceeded:
+               return "memory budget is exceeded";
      }
+
+     return "unknown state";
 }
 
 } // qm
@@ -0,0 +1,558 @@
+/// @brief Unbounded lock free queue of array segments for multi producers multi consumers model.
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_SEGMENTED_QUEUE_H_
+#define MQP_SEGMENTED_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "base_queue.hpp"
+#include "manager/epoch_domain.hpp"
+
+namespace qm
+{
+
+/// @brief Unbounded lock free queue of array segments for multi producers multi consumers model.
+/// Producers and consumers take cells of segment by fetch-and-add of its indexes, so one push or pop
+/// costs one contended read-modify-write and no allocation. Producer overflowing segment links the next one.
+/// Drained segments are reclaimed by epoch domain of queue and recycled through pool.
+/// Queue is never full: with soft memory limit set, segments beyond it are refused,
+/// TryPush returns State::BudgetExceeded and Push waits for consumers to drain segments.
+/// @tparam Value Type for queue store, must be move constructible and move assignable
+/// @tparam SegmentSize Count of cells in segment
+template< typename Value, std::size_t SegmentSize = 1024 >
+class SegmentedQueue : public IQueue< Value >
+{
+     static_assert( SegmentSize > 0, "Segment must hold at least one value" );
+
+public:
+     /// @brief Constructor
+     /// @param memory_limit Soft limit of bytes held by segments, 0 means no limit. Limit is raised to two segments,
+     /// as drained segment is recycled only after producers have linked the next one.
+     /// @param pool_size Maximal count of drained segments kept for reuse
+     /// @param resource Memory resource for segments, used under pool lock only
+     explicit SegmentedQueue( std::size_t memory_limit = 0,
+                              std::size_t pool_size = 4,
+                              std::pmr::memory_resource *resource = std::pmr::get_default_resource() );
+
+     /// @brief Destructor, destroys values left in queue
+     ~SegmentedQueue();
+
+     /// @brief Disable queue
+     /// Thread safe
+     void Stop();
+
+     /// @brief Queue is unbounded, use memory limit to bound it
+     /// Thread safe
+     /// @param size Ignored
+     /// @return State::QueueBusy
+     State Resize( std::size_t size ) override;
+
+     /// @brief Check is queue empty.
+     /// Thread safe.
+     /// @return true/false
+     [[nodiscard]] bool Empty() const;
+
+     /// @brief Get approximate size of queue, values being pushed are counted too
+     /// Thread safe.
+     /// @return Size
+     std::size_t Size() const;
+
+     /// @brief Get count of allocated segments, pooled ones included
+     /// Thread safe.
+     /// @return Segments count
+     std::size_t Segments() const;
+
+     /// @brief Get count of drained segments kept for reuse
+     /// Thread safe.
+     /// @return Segments count
+     std::size_t PooledSegments() const;
+
+     /// @brief Get size of segment memory
+     /// @return Bytes count
+     static constexpr std::size_t SegmentBytes();
+
+     /// @brief Lock free pop from queue.
+     /// Thread safe.
+     /// @return Object empty value if pop unsuccessfully
+     std::optional< Value > Pop();
+
+     /// @brief Lock free pop to existing object.
+     /// Thread safe.
+     /// @param value Object to move popped value to
+     /// @return true if value is popped
+     bool TryPop( Value &value ) override;
+
+     /// @brief Lock free push, waits only if memory limit is reached.
+     /// Thread safe
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( const Value &obj );
+
+     /// @brief Lock free push, waits only if memory limit is reached.
+     /// Thread safe
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( Value &&obj );
+
+     /// @brief Lock free push.
+     /// Thread safe
+     /// @param obj Lvalue object to push
+     /// @return State::Ok, State::BudgetExceeded if memory limit is reached or other state of queue on error
+     State TryPush( const Value &obj );
+
+     /// @brief Lock free push, object is left untouched if push is refused.
+     /// Thread safe
+     /// @param obj Rvalue object to push
+     /// @return State::Ok, State::BudgetExceeded if memory limit is reached or other state of queue on error
+     State TryPush( Value &&obj );
+
+     /// @brief Push of value constructed from args, waits only if memory limit is reached.
+     /// Thread safe
+     /// @param args Arguments of Value constructor
+     /// @return State::Ok or other state of queue on error
+     template< typename... Args >
+     State Emplace( Args &&... args );
+
+private:
+     using Storage = std::aligned_storage_t< sizeof( Value ), alignof( Value ) >;
+
+     enum class CellState : std::uint8_t
+     {
+          Empty,  ///< cell is not written yet
+          Ready,  ///< value is published by producer
+          Taken   ///< value is taken or cell is given up by consumer
+     };
+
+     struct Cell
+     {
+          std::atomic< CellState > state_{ CellState::Empty };
+          Storage storage_;
+
+          Value *Get() { return std::launder( reinterpret_cast< Value * >( &storage_ )); }
+     };
+
+     struct Segment
+     {
+          alignas( CacheLineSize ) std::atomic< std::size_t > enq_{ 0 };      ///< cells taken by producers
+          alignas( CacheLineSize ) std::atomic< std::size_t > deq_{ 0 };      ///< cells taken by consumers
+          alignas( CacheLineSize ) std::atomic< Segment * > next_{ nullptr };  ///< linked by overflowing producer
+          alignas( CacheLineSize ) Cell cells_[ SegmentSize ];
+     };
+
+     /// @brief Push value moved from object, object gets value back if push is refused
+     State PushValue( Value &value, bool wait );
+
+     /// @brief Put value to tail segment, epoch must be pinned
+     /// @return false if new segment is refused by memory limit
+     bool Enqueue( Value &value );
+
+     /// @brief Take value from head segment, epoch must be pinned
+     /// @param take Functor moving value out of cell
+     /// @return false if queue is empty
+     template< typename Op >
+     bool Dequeue( Op &&take );
+
+     /// @brief Move head and tail from drained segment and retire it
+     void Advance( Segment *segment, Segment *next );
+
+     /// @brief Get segment from pool or allocate new one
+     /// @return Segment or nullptr if memory limit is reached
+     Segment *Take();
+
+     /// @brief Reset drained segment and return it to pool
+     void Recycle( Segment *segment );
+
+     void Free( Segment *segment );
+
+private:
+     std::pmr::memory_resource *resource_;
+     const std::size_t memory_limit_;
+     const std::size_t pool_size_;
+
+     mutable std::mutex pool_mtx_;
+     std::pmr::vector< Segment * > pool_;  ///< guarded by pool_mtx_
+     std::size_t segments_;                ///< allocated segments, guarded by pool_mtx_
+
+     mutable EpochDomain domain_;
+
+     alignas( CacheLineSize ) std::atomic< Segment * > tail_;
+     alignas( CacheLineSize ) std::atomic< Segment * > head_;
+};
+
+template< typename Value, std::size_t SegmentSize >
+SegmentedQueue< Value, SegmentSize >::SegmentedQueue( std::size_t memory_limit, std::size_t pool_size,
+                                                      std::pmr::memory_resource *resource ) :
+     IQueue< Value >( std::numeric_limits< std::size_t >::max() ),
+     resource_( resource ),
+     memory_limit_( memory_limit == 0 ? 0 : std::max( memory_limit, 2 * sizeof( Segment ))),
+     pool_size_( pool_size ),
+     pool_( std::pmr::polymorphic_allocator< Segment * >( resource )),
+     segments_( 0 )
+{
+     // the first segment is taken regardless of limit
+     auto segment = new ( resource_->allocate( sizeof( Segment ), alignof( Segment ))) Segment;
+     segments_ = 1;
+     tail_.store( segment, std::memory_order_relaxed );
+     head_.store( segment, std::memory_order_relaxed );
+}
+
+template< typename Value, std::size_t SegmentSize >
+SegmentedQueue< Value, SegmentSize >::~SegmentedQueue()
+{
+     // no operations are running, so chain from head holds all values left
+     for ( auto segment = head_.load(); segment != nullptr; )
+     {
+          auto end = std::min( segment->enq_.load(), SegmentSize );
+          for ( std::size_t index = 0; index < end; index++ )
+          {
+               if ( segment->cells_[ index ].state_.load() == CellState::Ready )
+               {
+                    segment->cells_[ index ].Get()->~Value();
+               }
+          }
+
+          auto next = segment->next_.load();
+          Free( segment );
+          segment = next;
+     }
+
+     // no guards are pinned, retired segments return to pool now
+     domain_.Collect();
+     for ( auto segment : pool_ )
+     {
+          Free( segment );
+     }
+}
+
+template< typename Value, std::size_t SegmentSize >
+void SegmentedQueue< Value, SegmentSize >::Stop()
+{
+     // Queue is nonblocking, nothing to do here
+     IQueue< Value >::Enabled( false );
+}
+
+template< typename Value, std::size_t SegmentSize >
+State SegmentedQueue< Value, SegmentSize >::Resize( std::size_t )
+{
+     return State::QueueBusy;
+}
+
+template< typename Value, std::size_t SegmentSize >
+bool SegmentedQueue< Value, SegmentSize >::Empty() const
+{
+     auto guard = domain_.Pin();
+     for ( auto segment = head_.load( std::memory_order_acquire ); segment != nullptr;
+           segment = segment->next_.load( std::memory_order_acquire ))
+     {
+          if ( segment->deq_.load( std::memory_order_acquire ) <
+               std::min( segment->enq_.load( std::memory_order_acquire ), SegmentSize ))
+          {
+               return false;
+          }
+     }
+
+     return true;
+}
+
+template< typename Value, std::size_t SegmentSize >
+std::size_t SegmentedQueue< Value, SegmentSize >::Size() const
+{
+     auto guard = domain_.Pin();
+     std::size_t size = 0;
+     for ( auto segment = head_.load( std::memory_order_acquire ); segment != nullptr;
+           segment = segment->next_.load( std::memory_order_acquire ))
+     {
+          auto deq = segment->deq_.load( std::memory_order_acquire );
+          auto enq = std::min( segment->enq_.load( std::memory_order_acquire ), SegmentSize );
+          size += enq > deq ? enq - deq : 0;
+     }
+
+     return size;
+}
+
+template< typename Value, std::size_t SegmentSize >
+std::size_t SegmentedQueue< Value, SegmentSize >::Segments() const
+{
+     std::scoped_lock lock( pool_mtx_ );
+     return segments_;
+}
+
+template< typename Value, std::size_t SegmentSize >
+std::size_t SegmentedQueue< Value, SegmentSize >::PooledSegments() const
+{
+     std::scoped_lock lock( pool_mtx_ );
+     return pool_.size();
+}
+
+template< typename Value, std::size_t SegmentSize >
+constexpr std::size_t SegmentedQueue< Value, SegmentSize >::SegmentBytes()
+{
+     return sizeof( Segment );
+}
+
+template< typename Value, std::size_t SegmentSize >
+std::optional< Value > SegmentedQueue< Value, SegmentSize >::Pop()
+{
+     // value is moved out of cell directly, so Value needn't be default constructible
+     std::optional< Value > result;
+     auto guard = domain_.Pin();
+     Dequeue( [ &result ]( Value &value ) { result.emplace( std::move( value )); } );
+     return result;
+}
+
+template< typename Value, std::size_t SegmentSize >
+bool SegmentedQueue< Value, SegmentSize >::TryPop( Value &value )
+{
+     auto guard = domain_.Pin();
+     return Dequeue( [ &value ]( Value &popped ) { value = std::move( popped ); } );
+}
+
+template< typename Value, std::size_t SegmentSize >
+State SegmentedQueue< Value, SegmentSize >::Push( const Value &obj )
+{
+     Value value( obj );
+     return PushValue( value, true );
+}
+
+template< typename Value, std::size_t SegmentSize >
+State SegmentedQueue< Value, SegmentSize >::Push( Value &&obj )
+{
+     return PushValue( obj, true );
+}
+
+template< typename Value, std::size_t SegmentSize >
+State SegmentedQueue< Value, SegmentSize >::TryPush( const Value &obj )
+{
+     Value value( obj );
+     return PushValue( value, false );
+}
+
+template< typename Value, std::size_t SegmentSize >
+State SegmentedQueue< Value, SegmentSize >::TryPush( Value &&obj )
+{
+     return PushValue( obj, false );
+}
+
+template< typename Value, std::size_t SegmentSize >
+template< typename... Args >
+State SegmentedQueue< Value, SegmentSize >::Emplace( Args &&... args )
+{
+     Value value( std::forward< Args >( args )... );
+     return PushValue( value, true );
+}
+
+template< typename Value, std::size_t SegmentSize >
+State SegmentedQueue< Value, SegmentSize >::PushValue( Value &value, bool wait )
+{
+     for ( std::size_t attempt = 0; ; attempt++ )
+     {
+          if ( !IQueue< Value >::Enabled() ) return State::QueueDisabled;
+
+          {
+               auto guard = domain_.Pin();
+               if ( Enqueue( value ))
+               {
+                    return State::Ok;
+               }
+          }
+
+          // guard is released, so segments drained meanwhile may be reclaimed
+          domain_.Collect();
+          if ( attempt == 0 )
+          {
+               continue;
+          }
+
+          if ( !wait )
+          {
+               return State::BudgetExceeded;
+          }
+
+          // throttled producer spins shortly, then sleeps to let consumers drain segments
+          if ( attempt < 64 )
+          {
+               std::this_thread::yield();
+          }
+          else
+          {
+               std::this_thread::sleep_for( std::chrono::microseconds( 50 ));
+          }
+     }
+}
+
+template< typename Value, std::size_t SegmentSize >
+bool SegmentedQueue< Value, SegmentSize >::Enqueue( Value &value )
+{
+     for ( ;; )
+     {
+          auto segment = tail_.load( std::memory_order_acquire );
+          auto index = segment->enq_.fetch_add( 1, std::memory_order_relaxed );
+          if ( index < SegmentSize )
+          {
+               auto &cell = segment->cells_[ index ];
+               new ( &cell.storage_ ) Value( std::move( value ));
+
+               auto expected = CellState::Empty;
+               if ( cell.state_.compare_exchange_strong( expected, CellState::Ready, std::memory_order_release,
+                                                         std::memory_order_relaxed ))
+               {
+                    return true;
+               }
+
+               // consumer has given up waiting for the cell, value is taken back and pushed to next cell
+               value = std::move( *cell.Get() );
+               cell.Get()->~Value();
+               continue;
+          }
+
+          auto next = segment->next_.load( std::memory_order_acquire );
+          if ( next == nullptr )
+          {
+               auto fresh = Take();
+               if ( fresh == nullptr )
+               {
+                    return false;
+               }
+
+               if ( segment->next_.compare_exchange_strong( next, fresh, std::memory_order_acq_rel ))
+               {
+                    next = fresh;
+               }
+               else
+               {
+                    // other producer has linked its segment, fresh one was never published
+                    Recycle( fresh );
+               }
+          }
+
+          tail_.compare_exchange_strong( segment, next, std::memory_order_release, std::memory_order_relaxed );
+     }
+}
+
+template< typename Value, std::size_t SegmentSize >
+template< typename Op >
+bool SegmentedQueue< Value, SegmentSize >::Dequeue( Op &&take )
+{
+     for ( ;; )
+     {
+          auto segment = head_.load( std::memory_order_acquire );
+          auto index = segment->deq_.load( std::memory_order_relaxed );
+          if ( index < SegmentSize )
+          {
+               // cells are not taken when queue is empty, so idle consumer doesn't waste them
+               if ( index >= segment->enq_.load( std::memory_order_acquire ))
+               {
+                    return false;
+               }
+               index = segment->deq_.fetch_add( 1, std::memory_order_relaxed );
+          }
+
+          if ( index >= SegmentSize )
+          {
+               auto next = segment->next_.load( std::memory_order_acquire );
+               if ( next == nullptr )
+               {
+                    return false;
+               }
+
+               Advance( segment, next );
+               continue;
+          }
+
+          // producer has taken the cell and may be writing value, it is waited for shortly before giving up
+          auto &cell = segment->cells_[ index ];
+          for ( int spin = 0; spin < 256 && cell.state_.load( std::memory_order_relaxed ) == CellState::Empty; spin++ )
+          {}
+
+          if ( cell.state_.exchange( CellState::Taken, std::memory_order_acquire ) == CellState::Ready )
+          {
+               take( *cell.Get() );
+               cell.Get()->~Value();
+               return true;
+          }
+     }
+}
+
+template< typename Value, std::size_t SegmentSize >
+void SegmentedQueue< Value, SegmentSize >::Advance( Segment *segment, Segment *next )
+{
+     // tail must leave segment too, otherwise producers could reach it after retirement
+     auto expected = segment;
+     tail_.compare_exchange_strong( expected, next, std::memory_order_release, std::memory_order_relaxed );
+
+     expected = segment;
+     if ( head_.compare_exchange_strong( expected, next, std::memory_order_acq_rel ))
+     {
+          domain_.RetireFn( [ this, segment ]() { Recycle( segment ); } );
+     }
+}
+
+template< typename Value, std::size_t SegmentSize >
+typename SegmentedQueue< Value, SegmentSize >::Segment *SegmentedQueue< Value, SegmentSize >::Take()
+{
+     std::scoped_lock lock( pool_mtx_ );
+     if ( !pool_.empty() )
+     {
+          auto segment = pool_.back();
+          pool_.pop_back();
+          return segment;
+     }
+
+     if ( memory_limit_ != 0 && ( segments_ + 1 ) * sizeof( Segment ) > memory_limit_ )
+     {
+          return nullptr;
+     }
+
+     auto segment = new ( resource_->allocate( sizeof( Segment ), alignof( Segment ))) Segment;
+     segments_++;
+     return segment;
+}
+
+template< typename Value, std::size_t SegmentSize >
+void SegmentedQueue< Value, SegmentSize >::Recycle( Segment *segment )
+{
+     // all cells are taken by consumers, values are moved out of them
+     segment->enq_.store( 0, std::memory_order_relaxed );
+     segment->deq_.store( 0, std::memory_order_relaxed );
+     segment->next_.store( nullptr, std::memory_order_relaxed );
+     for ( auto &cell : segment->cells_ )
+     {
+          cell.state_.store( CellState::Empty, std::memory_order_relaxed );
+     }
+
+     std::unique_lock lock( pool_mtx_ );
+     if ( pool_.size() < pool_size_ )
+     {
+          pool_.push_back( segment );
+          return;
+     }
+
+     lock.unlock();
+     Free( segment );
+}
+
+template< typename Value, std::size_t SegmentSize >
+void SegmentedQueue< Value, SegmentSize >::Free( Segment *segment )
+{
+     std::scoped_lock lock( pool_mtx_ );
+     segment->~Segment();
+     resource_->deallocate( segment, sizeof( Segment ), alignof( Segment ));
+     segments_--;
+}
+
+} // qm
+
+#endif // MQP_SEGMENTED_QUEUE_H_
@@ -0,0 +1,783 @@
+/// @brief Bounded ring buffer queue for single producer single consumer model.
+/// @author Denis Razinkin
+#pragma once
+
+#ifndef MQP_SPSC_RING_QUEUE_H_
+#define MQP_SPSC_RING_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "base_queue.hpp"
+#include "buffer/huge_page_resource.hpp"
+#include "buffer/numa.hpp"
+
+namespace qm
+{
+
+/// @brief Bounded ring buffer queue for single producer single consumer model.
+/// Producer and consumer only load and store their indexes, no read-modify-write operations are used.
+/// Queue grown over its storage continues in bigger ring: producer moves to it when current ring is full,
+/// consumer follows when it drains current ring, so values order is kept and nobody waits.
+/// @tparam Value Type for queue store
+template< typename Value >
+class SpscRingQueue : public IQueue< Value >
+{
+public:
+     /// @brief Constructor
+     /// @param size Maximal size of queue
+     /// @param resource Memory resource for ring storage
+     explicit SpscRingQueue( std::size_t size, std::pmr::memory_resource *resource = std::pmr::get_default_resource() );
+
+     /// @brief Destructor
+     ~SpscRingQueue();
+
+     /// @brief Disable queue
+     /// Thread safe
+     void Stop();
+
+     /// @brief Change maximal size of queue while producer and consumer keep running.
+     /// Shrinking only lowers the limit. Growing over ring storage allocates new ring at least twice bigger,
+     /// producer moves to it when current ring is full. Old ring storage is freed by next Resize call
+     /// after consumer has drained it.
+     /// Thread safe
+     /// @param size New maximal size
+     /// @return State::Ok
+     State Resize( std::size_t size ) override;
+
+     /// @brief Fault in pages of ring storage, values in it are kept
+     /// Thread safe
+     void Prefault() override;
+
+     /// @brief Move ring storage to memory of NUMA node, storage allocated by later Resize calls is moved too
+     /// Thread safe
+     /// @param node NUMA node number
+     void BindToNode( int node ) override;
+
+     /// @brief Check is queue empty.
+     /// Thread safe.
+     /// @return true/false
+     [[nodiscard]] bool Empty() const;
+
+     /// @brief Get current size of queue
+     /// Thread safe.
+     /// @return Size
+     std::size_t Size() const;
+
+     /// @brief Wait free pop from queue.
+     /// Only one consumer thread is allowed.
+     /// @return Object empty value if pop unsuccessfully
+     std::optional< Value > Pop();
+
+     /// @brief Wait free pop to existing object.
+     /// Only one consumer thread is allowed.
+     /// @param value Object to move popped value to
+     /// @return true if value is popped
+     bool TryPop( Value &value ) override;
+
+     /// @brief Wait free push.
+     /// Only one producer thread is allowed.
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( const Value &obj );
+
+     /// @brief Wait free push.
+     /// Only one producer thread is allowed.
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State Push( Value &&obj );
+
+     /// @brief Wait free push. Method similar to Push(const &)
+     /// Only one producer thread is allowed.
+     /// @param obj Lvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( const Value &obj );
+
+     /// @brief Wait free push. Method similar to Push(&&)
+     /// Only one producer thread is allowed.
+     /// @param obj Rvalue object to push
+     /// @return State::Ok or other state of queue on error
+     State TryPush( Value &&obj );
+
+     /// @brief Wait free push of value constructed in place from args.
+     /// Only one producer thread is allowed.
+     /// @param args Arguments of Value constructor
+     /// @return State::Ok or other state of queue on error
+     template< typename... Args >
+     State Emplace( Args &&... args );
+
+     /// @brief Reserve next slot, value is default constructed in ring storage and published by Commit.
+     /// Pushes are refused with State::QueueBusy until reserved slot is committed.
+     /// Only one producer thread is allowed.
+     /// @return Pointer to value in slot or nullptr if queue is full or disabled
+     Value *Reserve() override;
+
+     /// @brief Publish reserved slot
+     /// Only one producer thread is allowed.
+     /// @return State::Ok or other state of queue on error
+     State Commit() override;
+
+     /// @brief Drop reserved slot
+     /// Only one producer thread is allowed.
+     /// @return State::Ok, State::QueueAbsent if no slot is reserved
+     State Cancel() override;
+
+     /// @brief Wake producer when consumer frees space
+     /// @param wake Callable to call
+     /// @return true
+     bool NotifyOnSpace( std::function< void() > wake ) override;
+
+     /// @brief Refused value is not moved from
+     /// @return true
+     bool KeepsRefused() const override;
+
+     /// @brief Access oldest value in place without moving it out of ring storage.
+     /// Only one consumer thread is allowed.
+     /// @return Pointer to value or nullptr if queue is empty
+     Value *Front();
+
+     /// @brief Destroy value got by Front and free its slot.
+     /// Only one consumer thread is allowed.
+     void Release();
+
+     /// @brief Wait free push of several values, published by one index store.
+     /// Trivially copyable values are copied by memcpy in at most two segments.
+     /// Only one producer thread is allowed.
+     /// @param values Pointer to first value
+     /// @param count Values count
+     /// @return Count of pushed values
+     std::size_t TryPushBulk( Value *values, std::size_t count ) override;
+
+     /// @brief Wait free pop of several values to array, slots are freed by one index store.
+     /// Trivially copyable values are copied by memcpy in at most two segments.
+     /// Only one consumer thread is allowed.
+     /// @param values Pointer to first object to move popped values to
+     /// @param count Maximal count of values to pop
+     /// @return Count of popped values
+     std::size_t TryPopBulk( Value *values, std::size_t count );
+
+private:
+     using Storage = std::aligned_storage_t< sizeof( Value ), alignof( Value ) >;
+
+     // ring slots are contiguous array of values, so runs of them may be copied as raw bytes
+     static constexpr bool Memcpyable = std::is_trivially_copyable_v< Value > && sizeof( Storage ) == sizeof( Value );
+
+     /// @brief Ring of queue storage. Ring header outlives its storage, so it may be read by any thread.
+     struct Ring
+     {
+          Ring( std::size_t capacity, Storage *buffer );
+
+          Value *Slot( std::size_t index );
+
+          std::size_t Next( std::size_t index ) const;
+
+          std::size_t Used( std::size_t head, std::size_t tail ) const;
+
+          void CopyIn( std::size_t tail, const Value *values, std::size_t count );
+
+          void CopyOut( std::size_t head, Value *values, std::size_t count );
+
+          // one slot is always free to distinguish full ring from empty one
+          const std::size_t capacity_;
+          Storage *buffer_;  ///< freed under rings lock when consumer has left ring
+
+          alignas( CacheLineSize ) std::atomic< std::size_t > head_;  ///< written by consumer only
+          alignas( CacheLineSize ) std::atomic< std::size_t > tail_;  ///< written by producer only
+          std::atomic< Ring * > next_;                                 ///< set by producer when it leaves ring
+     };
+
+     template< typename... Args >
+     State PushFwd( Args &&... args );
+
+     /// @brief Get producer ring with free slot, producer moves to pending ring or queue grows if needed
+     /// @return Ring or nullptr if queue is full
+     Ring *ProducerRing();
+
+     /// @brief Get count of values held by producer ring and rings consumer has not drained yet
+     /// @return Values count
+     std::size_t Held( Ring *ring, std::size_t head, std::size_t tail ) const;
+
+     /// @brief Get consumer ring holding oldest value, consumer moves to next ring if current one is drained
+     /// @return Ring or nullptr if queue is empty
+     Ring *ConsumerRing();
+
+     Storage *Allocate( std::size_t capacity );
+
+     /// @brief Free storage of rings consumer has left, rings lock must be held
+     void FreeLeftRings();
+
+private:
+     std::pmr::memory_resource *resource_;
+
+     std::mutex rings_mtx_;
+     std::pmr::list< Ring > rings_;     ///< from the oldest one, guarded by rings_mtx_
+     std::atomic< Ring * > pending_;    ///< allocated by Resize, not reached by producer yet
+     int node_;                         ///< NUMA node of storage, -1 if not bound, guarded by rings_mtx_
+
+     alignas( CacheLineSize ) Ring *producer_;             ///< producer only
+     bool reserved_;                                        ///< slot at tail is reserved, producer only
+     alignas( CacheLineSize ) std::atomic< Ring * > consumer_;  ///< written by consumer only
+};
+
+template< typename Value >
+SpscRingQueue< Value >::SpscRingQueue( std::size_t size, std::pmr::memory_resource *resource ) :
+     IQueue< Value >( size ),
+     resource_( resource ),
+     rings_( std::pmr::polymorphic_allocator< Ring >( resource )),
+     pending_( nullptr ),
+     node_( -1 ),
+     reserved_( false )
+{
+     auto buffer = Allocate( size + 1 );
+     try
+     {
+          rings_.emplace_back( size + 1, buffer );
+     }
+     catch ( ... )
+     {
+          resource_->deallocate( buffer, sizeof( Storage ) * ( size + 1 ), alignof( Storage ));
+          throw;
+     }
+
+     producer_ = &rings_.back();
+     consumer_.store( producer_, std::memory_order_relaxed );
+}
+
+template< typename Value >
+SpscRingQueue< Value >::~SpscRingQueue()
+{
+     if ( reserved_ )
+     {
+          producer_->Slot( producer_->tail_.load() )->~Value();
+     }
+
+     for ( auto &ring : rings_ )
+     {
+          if ( ring.buffer_ == nullptr )
+          {
+               continue;
+          }
+
+          for ( auto index = ring.head_.load(); index != ring.tail_.load(); index = ring.Next( index ) )
+          {
+               ring.Slot( index )->~Value();
+          }
+          resource_->deallocate( ring.buffer_, sizeof( Storage ) * ring.capacity_, alignof( Storage ));
+     }
+}
+
+template< typename Value >
+void SpscRingQueue< Value >::Stop()
+{
+     // Queue is nonblocking, nothing to do here
+     IQueue< Value >::Enabled( false );
+}
+
+template< typename Value >
+State SpscRingQueue< Value >::Resize( std::size_t size )
+{
+     std::scoped_lock lock( rings_mtx_ );
+     FreeLeftRings();
+
+     // the newest ring is the pending one if producer has not reached it yet
+     const auto capacity = rings_.back().capacity_;
+     if ( size + 1 > capacity )
+     {
+          auto grown = std::max( size, 2 * ( capacity - 1 )) + 1;
+          auto buffer = Allocate( grown );
+          auto &ring = rings_.emplace_back( grown, buffer );
+          if ( node_ >= 0 )
+          {
+               BindToNumaNode( buffer, sizeof( Storage ) * grown, node_ );
+          }
+
+          // producer has not taken stale pending ring, so nobody else can reach it
+          if ( auto stale = pending_.exchange( &ring, std::memory_order_acq_rel ))
+          {
+               resource_->deallocate( stale->buffer_, sizeof( Storage ) * stale->capacity_, alignof( Storage ));
+               rings_.remove_if( [ stale ]( const Ring &r ) { return &r == stale; } );
+          }
+     }
+
+     // limit is raised after pending ring is published, so producer finds room for it
+     IQueue< Value >::Resize( size );
+     IQueue< Value >::SpaceFreed();
+     return State::Ok;
+}
+
+template< typename Value >
+void SpscRingQueue< Value >::Prefault()
+{
+     std::scoped_lock lock( rings_mtx_ );
+     FreeLeftRings();
+     for ( auto &ring : rings_ )
+     {
+          if ( ring.buffer_ != nullptr )
+          {
+               PrefaultPages( ring.buffer_, sizeof( Storage ) * ring.capacity_ );
+          }
+     }
+}
+
+template< typename Value >
+void SpscRingQueue< Value >::BindToNode( int node )
+{
+     std::scoped_lock lock( rings_mtx_ );
+     FreeLeftRings();
+     node_ = node;
+     for ( auto &ring : rings_ )
+     {
+          if ( ring.buffer_ != nullptr )
+          {
+               BindToNumaNode( ring.buffer_, sizeof( Storage ) * ring.capacity_, node );
+          }
+     }
+}
+
+template< typename Value >
+bool SpscRingQueue< Value >::Empty() const
+{
+     // ring headers are never freed before queue, so chain may be walked by any thread
+     for ( auto ring = consumer_.load( std::memory_order_acquire ); ring != nullptr;
+           ring = ring->next_.load( std::memory_order_acquire ))
+     {
+          if ( ring->head_.load( std::memory_order_acquire ) != ring->tail_.load( std::memory_order_acquire ))
+          {
+               return false;
+          }
+     }
+
+     return true;
+}
+
+template< typename Value >
+std::size_t SpscRingQueue< Value >::Size() const
+{
+     std::size_t size = 0;
+     for ( auto ring = consumer_.load( std::memory_order_acquire ); ring != nullptr;
+           ring = ring->next_.load( std::memory_order_acquire ))
+     {
+          size += ring->Used( ring->head_.load( std::memory_order_acquire ), ring->tail_.load( std::memory_order_acquire ));
+     }
+
+     return size;
+}
+
+template< typename Value >
+std::optional< Value > SpscRingQueue< Value >::Pop()
+{
+     auto ring = ConsumerRing();
+     if ( ring == nullptr )
+     {
+          return std::nullopt;
+     }
+
+     auto head = ring->head_.load( std::memory_order_relaxed );
+     Value *slot = ring->Slot( head );
+     std::optional< Value > result( std::move( *slot ) );
+     slot->~Value();
+     ring->head_.store( ring->Next( head ), std::memory_order_release );
+     IQueue< Value >::SpaceFreed();
+     return result;
+}
+
+template< typename Value >
+bool SpscRingQueue< Value >::TryPop( Value &value )
+{
+     auto ring = ConsumerRing();
+     if ( ring == nullptr )
+     {
+          return false;
+     }
+
+     auto head = ring->head_.load( std::memory_order_relaxed );
+     Value *slot = ring->Slot( head );
+     value = std::move( *slot );
+     slot->~Value();
+     ring->head_.store( ring->Next( head ), std::memory_order_release );
+     IQueue< Value >::SpaceFreed();
+     return true;
+}
+
+template< typename Value >
+State SpscRingQueue< Value >::Push( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value >
+State SpscRingQueue< Value >::Push( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Value >
+State SpscRingQueue< Value >::TryPush( const Value &obj )
+{
+     return PushFwd( obj );
+}
+
+template< typename Value >
+State SpscRingQueue< Value >::TryPush( Value &&obj )
+{
+     return PushFwd( std::move( obj ));
+}
+
+template< typename Value >
+template< typename... Args >
+State SpscRingQueue< Value >::Emplace( Args &&... args )
+{
+     return PushFwd( std::forward< Args >( args )... );
+}
+
+template< typename Value >
+Value *SpscRingQueue< Value >::Reserve()
+{
+     if constexpr ( std::is_default_constructible_v< Value > )
+     {
+          if ( reserved_ )
+          {
+               return producer_->Slot( producer_->tail_.load( std::memory_order_relaxed ));
+          }
+
+          if ( !IQueue< Value >::Enabled() )
+          {
+               return nullptr;
+          }
+
+          auto ring = ProducerRing();
+          if ( ring == nullptr )
+          {
+               return nullptr;
+          }
+
+          reserved_ = true;
+          return new ( ring->Slot( ring->tail_.load( std::memory_order_relaxed ))) Value();
+     }
+     else
+     {
+          return nullptr;
+     }
+}
+
+template< typename Value >
+bool SpscRingQueue< Value >::NotifyOnSpace( std::function< void() > wake )
+{
+     return IQueue< Value >::AddSpaceWaiter( std::move( wake ));
+}
+
+template< typename Value >
+bool SpscRingQueue< Value >::KeepsRefused() const
+{
+     return true;
+}
+
+template< typename Value >
+State SpscRingQueue< Value >::Cancel()
+{
+     if ( !reserved_ ) return State::QueueAbsent;
+
+     reserved_ = false;
+     producer_->Slot( producer_->tail_.load( std::memory_order_relaxed ))->~Value();
+     return State::Ok;
+}
+
+template< typename Value >
+State SpscRingQueue< Value >::Commit()
+{
+     if ( !reserved_ ) return State::QueueAbsent;
+
+     // producer doesn't leave ring while slot is reserved
+     reserved_ = false;
+     auto ring = producer_;
+     auto tail = ring->tail_.load( std::memory_order_relaxed );
+     if ( !IQueue< Value >::Enabled() )
+     {
+          ring->Slot( tail )->~Value();
+          return State::QueueDisabled;
+     }
+
+     ring->tail_.store( ring->Next( tail ), std::memory_order_release );
+     IQueue< Value >::PushAccepted();
+     return State::Ok;
+}
+
+template< typename Value >
+Value *SpscRingQueue< Value >::Front()
+{
+     auto ring = ConsumerRing();
+     return ring == nullptr ? nullptr : ring->Slot( ring->head_.load( std::memory_order_relaxed ));
+}
+
+template< typename Value >
+void SpscRingQueue< Value >::Release()
+{
+     auto ring = ConsumerRing();
+     if ( ring == nullptr )
+     {
+          return;
+     }
+
+     auto head = ring->head_.load( std::memory_order_relaxed );
+     ring->Slot( head )->~Value();
+     ring->head_.store( ring->Next( head ), std::memory_order_release );
+     IQueue< Value >::SpaceFreed();
+}
+
+template< typename Value >
+std::size_t SpscRingQueue< Value >::TryPushBulk( Value *values, std::size_t count )
+{
+     if ( !IQueue< Value >::Enabled() || reserved_ ) return 0;
+
+     std::size_t pushed = 0;
+     while ( pushed < count )
+     {
+          auto ring = ProducerRing();
+          if ( ring == nullptr )
+          {
+               return pushed;
+          }
+
+          auto tail = ring->tail_.load( std::memory_order_relaxed );
+          auto head = ring->head_.load( std::memory_order_acquire );
+          auto used = Held( ring, head, tail );
+          auto limit = IQueue< Value >::MaxSize();
+          auto free = std::min( ring->capacity_ - 1 - ring->Used( head, tail ), limit > used ? limit - used : 0 );
+          auto run = std::min( count - pushed, free );
+
+          if constexpr ( Memcpyable )
+          {
+               ring->CopyIn( tail, values + pushed, run );
+               tail = ( tail + run ) % ring->capacity_;
+          }
+          else
+          {
+               for ( std::size_t i = 0; i < run; ++i )
+               {
+                    new ( ring->Slot( tail ) ) Value( std::move( values[ pushed + i ] ));
+                    tail = ring->Next( tail );
+               }
+          }
+
+          ring->tail_.store( tail, std::memory_order_release );
+          pushed += run;
+     }
+
+     IQueue< Value >::PushAccepted();
+     return pushed;
+}
+
+template< typename Value >
+std::size_t SpscRingQueue< Value >::TryPopBulk( Value *values, std::size_t count )
+{
+     auto ring = ConsumerRing();
+     if ( ring == nullptr )
+     {
+          return 0;
+     }
+
+     auto head = ring->head_.load( std::memory_order_relaxed );
+     auto tail = ring->tail_.load( std::memory_order_acquire );
+     auto popped = std::min( count, ring->Used( head, tail ));
+
+     if constexpr ( Memcpyable )
+     {
+          ring->CopyOut( head, values, popped );
+          head = ( head + popped ) % ring->capacity_;
+     }
+     else
+     {
+          for ( std::size_t i = 0; i < popped; ++i )
+          {
+               Value *slot = ring->Slot( head );
+               values[ i ] = std::move( *slot );
+               slot->~Value();
+               head = ring->Next( head );
+          }
+     }
+
+     ring->head_.store( head, std::memory_order_release );
+     IQueue< Value >::SpaceFreed();
+     return popped;
+}
+
+template< typename Value >
+template< typename... Args >
+State SpscRingQueue< Value >::PushFwd( Args &&... args )
+{
+     if ( !IQueue< Value >::Enabled() ) return State::QueueDisabled;
+     if ( reserved_ ) return State::QueueBusy;
+
+     auto ring = ProducerRing();
+     if ( ring == nullptr )
+     {
+          return State::QueueFull;
+     }
+
+     auto tail = ring->tail_.load( std::memory_order_relaxed );
+     new ( ring->Slot( tail ) ) Value( std::forward< Args >( args )... );
+     ring->tail_.store( ring->Next( tail ), std::memory_order_release );
+     IQueue< Value >::PushAccepted();
+     return State::Ok;
+}
+
+template< typename Value >
+typename SpscRingQueue< Value >::Ring *SpscRingQueue< Value >::ProducerRing()
+{
+     for ( ;; )
+     {
+          auto ring = producer_;
+          auto tail = ring->tail_.load( std::memory_order_relaxed );
+          auto head = ring->head_.load( std::memory_order_acquire );
+          if ( ring->Next( tail ) != head )
+          {
+               if ( Held( ring, head, tail ) < IQueue< Value >::MaxSize() )
+               {
+                    return ring;
+               }
+          }
+          else if ( pending_.load( std::memory_order_relaxed ) != nullptr )
+          {
+               // ring storage is exhausted, producer continues in ring allocated by Resize
+               if ( auto next = pending_.exchange( nullptr, std::memory_order_acquire ))
+               {
+                    ring->next_.store( next, std::memory_order_release );
+                    producer_ = next;
+                    continue;
+               }
+          }
+
+          if ( !IQueue< Value >::GrowOnFull() )
+          {
+               return nullptr;
+          }
+     }
+}
+
+template< typename Value >
+std::size_t SpscRingQueue< Value >::Held( Ring *ring, std::size_t head, std::size_t tail ) const
+{
+     auto held = ring->Used( head, tail );
+
+     // older rings are left by producer, so chain from consumer ring reaches producer one
+     for ( auto older = consumer_.load( std::memory_order_acquire ); older != ring;
+           older = older->next_.load( std::memory_order_acquire ))
+     {
+          held += older->Used( older->head_.load( std::memory_order_acquire ),
+                               older->tail_.load( std::memory_order_acquire ));
+     }
+
+     return held;
+}
+
+template< typename Value >
+typename SpscRingQueue< Value >::Ring *SpscRingQueue< Value >::ConsumerRing()
+{
+     auto ring = consumer_.load( std::memory_order_relaxed );
+     for ( ;; )
+     {
+          if ( ring->head_.load( std::memory_order_relaxed ) != ring->tail_.load( std::memory_order_acquire ) )
+          {
+               return ring;
+          }
+
+          auto next = ring->next_.load( std::memory_order_acquire );
+          if ( next == nullptr )
+          {
+               return nullptr;
+          }
+
+          // producer has left ring, its last values are visible after next_ is seen
+          if ( ring->head_.load( std::memory_order_relaxed ) != ring->tail_.load( std::memory_order_acquire ) )
+          {
+               return ring;
+          }
+
+          consumer_.store( next, std::memory_order_release );
+          ring = next;
+     }
+}
+
+template< typename Value >
+typename SpscRingQueue< Value >::Storage *SpscRingQueue< Value >::Allocate( std::size_t capacity )
+{
+     return static_cast< Storage * >( resource_->allocate( sizeof( Storage ) * capacity, alignof( Storage )));
+}
+
+template< typename Value >
+void SpscRingQueue< Value >::FreeLeftRings()
+{
+     // rings before consumer one are drained and left by producer and consumer both
+     auto current = consumer_.load( std::memory_order_acquire );
+     for ( auto it = rings_.begin(); &*it != current; ++it )
+     {
+          if ( it->buffer_ != nullptr )
+          {
+               resource_->deallocate( it->buffer_, sizeof( Storage ) * it->capacity_, alignof( Storage ));
+               it->buffer_ = nullptr;
+          }
+     }
+}
+
+template< typename Value >
+SpscRingQueue< Value >::Ring::Ring( std::size_t capacity, Storage *buffer ) :
+     capacity_( capacity ),
+     buffer_( buffer ),
+     head_( 0 ),
+     tail_( 0 ),
+     next_( nullptr )
+{}
+
+template< typename Value >
+Value *SpscRingQueue< Value >::Ring::Slot( std::size_t index )
+{
+     return std::launder( reinterpret_cast< Value * >( &buffer_[ index ] ));
+}
+
+template< typename Value >
+std::size_t SpscRingQueue< Value >::Ring::Next( std::size_t index ) const
+{
+     return ++index == capacity_ ? 0 : index;
+}
+
+template< typename Value >
+std::size_t SpscRingQueue< Value >::Ring::Used( std::size_t head, std::size_t tail ) const
+{
+     return tail >= head ? tail - head : capacity_ - head + tail;
+}
+
+template< typename Value >
+void SpscRingQueue< Value >::Ring::CopyIn( std::size_t tail, const Value *values, std::size_t count )
+{
+     // run may wrap around the end of ring, so it is copied by two segments
+     auto first = std::min( count, capacity_ - tail );
+     std::memcpy( &buffer_[ tail ], values, first * sizeof( Value ));
+     if ( first < count )
+     {
+          std::memcpy( &buffer_[ 0 ], values + first, ( count - first ) * sizeof( Value ));
+     }
+}
+
+template< typename Value >
+void SpscRingQueue< Value >::Ring::CopyOut( std::size_t head, Value *values, std::size_t count )
+{
+     auto first = std::min( count, capacity_ - head );
+     std::memcpy( values, &buffer_[ head ], first * sizeof( Value ));
+     if ( first < count )
+     {
+          std::memcpy( values + first, &buffer_[ 0 ], ( count - first ) * sizeof( Value ));
+     }
+}
+
+} // qm
+
+#endif // MQP_SPSC_RING_QUEUE_H_
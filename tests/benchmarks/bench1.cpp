@@ -1,6 +1,7 @@
 #include <benchmark/benchmark.h>
 
 #include <manager/mpsc_mqueue_manager.hpp>
+#include <manager/static_mqueue_manager.hpp>
 #include <producer/base_producer.hpp>
 #include <queue/block_concurrent_queue.hpp>
 #include <queue/lock_free_queue.hpp>
@@ -8,6 +9,10 @@
 #include "examples/consumer_counter.h"
 #include "examples/producer_thread_loop_example.h"
 
+// queues start small and grow while producers outpace consumers
+constexpr std::size_t InitialQueueSize = 100;
+constexpr std::size_t QueueGrowLimit = 64 * 1024;
+
 template< class QueueType >
 void SimpleLoopProducerRegistration( unsigned int workers, unsigned int loops, unsigned int producer_multiple )
 {
@@ -22,7 +27,9 @@ void SimpleLoopProducerRegistration( unsigned int workers, unsigned int loops, u
      auto mpsc_manager = qm::MPSCQueueManager<std::string, int>();
      for ( std::size_t i = 0; i < workers; i++ )
      {
-          mpsc_manager.AddQueue( std::to_string( i ), std::make_shared< QueueType >( 100 ) );
+          auto queue = std::make_shared< QueueType >( InitialQueueSize );
+          queue->AutoGrow( QueueGrowLimit );
+          mpsc_manager.AddQueue( std::to_string( i ), queue );
      }
 
      for ( std::size_t i = 0; i < workers * producer_multiple; i++ )
@@ -148,4 +155,246 @@ BENCHMARK_TEMPLATE(TestQueueNoRegistration, qm::LockFreeQueue< int > )->Unit(ben
 ->Args( { std::thread::hardware_concurrency() * 8, 1000, 1} )
 ->Args( { std::thread::hardware_concurrency() * 8, 1000, 4} );
 
+template< class QueueType >
+void TaskProducerRegistration( unsigned int workers, unsigned int loops, unsigned int producer_multiple )
+{
+     qm::example::produce_counter_ = 0;
+     qm::example::consumer_counter_ = 0;
+     if ( producer_multiple == 0 )
+     {
+          std::cout << "Invalid producers multiple.";
+          return;
+     }
+
+     auto mpsc_manager = qm::MPSCQueueManager<std::string, int>();
+     mpsc_manager.SetRuntime( std::make_shared< qm::ProducerRuntime >() );
+     for ( std::size_t i = 0; i < workers; i++ )
+     {
+          auto queue = std::make_shared< QueueType >( InitialQueueSize );
+          queue->AutoGrow( QueueGrowLimit );
+          mpsc_manager.AddQueue( std::to_string( i ), queue );
+     }
+
+     for ( std::size_t i = 0; i < workers * producer_multiple; i++ )
+     {
+          auto producer = std::make_shared< qm::example::SimpleLoopProducerTask<std::string, int> >( std::to_string( i / producer_multiple ), loops );
+          if ( mpsc_manager.RegisterProducer( std::to_string( i / producer_multiple ), producer ) == qm::State::Ok )
+          {
+               producer->Produce();
+          }
+     }
+
+     for ( std::size_t i = 0; i < workers; i++ )
+     {
+          auto consumer = std::make_shared< qm::example::ConsumerCounter< std::string, int > > ( std::to_string( i ) );
+          mpsc_manager.Subscribe( std::to_string( i ), consumer );
+     }
+
+     //wait for consumer work done
+     while ( !mpsc_manager.AreAllQueuesEmpty() || !mpsc_manager.AreAllProducersDone() )
+     {
+          std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+     }
+}
+
+template< class Queue>
+static void TestQueueTasks(benchmark::State& state) {
+
+     for (auto _ : state)
+          TaskProducerRegistration< Queue >( state.range(0),
+                                             state.range(1 ), state.range(2 ) );
+}
+BENCHMARK_TEMPLATE(TestQueueTasks, qm::BlockConcurrentQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 1000, 1} )
+->Args( { std::thread::hardware_concurrency(), 1000, 16} )
+->Args( { std::thread::hardware_concurrency(), 100000, 16} )
+->Args( { std::thread::hardware_concurrency() * 8, 1000, 16} )
+->Args( { std::thread::hardware_concurrency() * 8, 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestQueueTasks, qm::LockFreeQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 1000, 1} )
+->Args( { std::thread::hardware_concurrency(), 1000, 16} )
+->Args( { std::thread::hardware_concurrency(), 100000, 16} )
+->Args( { std::thread::hardware_concurrency() * 8, 1000, 16} )
+->Args( { std::thread::hardware_concurrency() * 8, 100000, 4} );
+
+/// @brief Producers threads push directly to queues got from manager, consumers count values
+/// @param get_queue Callable returning queue by key
+/// @param push Callable pushing value to queue
+template< class GetQueue, class Push >
+void DirectPush( GetQueue get_queue, Push push, unsigned int workers, unsigned int loops, unsigned int producer_multiple )
+{
+     std::vector< std::thread > producers;
+     for ( std::size_t i = 0; i < workers * producer_multiple; i++ )
+     {
+          producers.emplace_back( [ queue = get_queue( std::to_string( i / producer_multiple ) ), push, loops ]()
+          {
+               for ( unsigned int value = 0; value < loops; value++ )
+               {
+                    while ( push( queue, value ) == qm::State::QueueFull )
+                    {
+                         std::this_thread::yield();
+                    }
+               }
+          } );
+     }
+
+     for ( auto &producer : producers )
+     {
+          producer.join();
+     }
+
+     //wait for consumer work done
+     while ( qm::example::consumer_counter_ != static_cast< int >( workers * producer_multiple * loops ) )
+     {
+          std::this_thread::yield();
+     }
+}
+
+/// @brief Producers threads push through manager Enqueue by key, consumers count values
+/// @param manager Manager owning queues with keys "0" .. workers - 1
+template< class Manager >
+void ManagerEnqueue( Manager &manager, unsigned int workers, unsigned int loops, unsigned int producer_multiple )
+{
+     std::vector< std::thread > producers;
+     for ( std::size_t i = 0; i < workers * producer_multiple; i++ )
+     {
+          producers.emplace_back( [ &manager, id = std::to_string( i / producer_multiple ), loops ]()
+          {
+               for ( unsigned int value = 0; value < loops; value++ )
+               {
+                    while ( manager.Enqueue( id, static_cast< int >( value ) ) == qm::State::QueueFull )
+                    {
+                         std::this_thread::yield();
+                    }
+               }
+          } );
+     }
+
+     for ( auto &producer : producers )
+     {
+          producer.join();
+     }
+
+     //wait for consumer work done
+     while ( qm::example::consumer_counter_ != static_cast< int >( workers * producer_multiple * loops ) )
+     {
+          std::this_thread::yield();
+     }
+}
+
+template< class QueueType >
+static void TestVirtualManager(benchmark::State& state) {
+
+     for (auto _ : state)
+     {
+          qm::example::consumer_counter_ = 0;
+          auto manager = qm::MPSCQueueManager< std::string, int >();
+          for ( std::size_t i = 0; i < static_cast< std::size_t >( state.range( 0 ) ); i++ )
+          {
+               manager.AddQueue( std::to_string( i ), std::make_shared< QueueType >( 100 ) );
+               manager.Subscribe( std::to_string( i ), std::make_shared< qm::example::ConsumerCounter< std::string, int > >( std::to_string( i ) ) );
+          }
+
+          DirectPush( [ &manager ]( const std::string &id ) { return manager.GetQueue( id ).queue_; },
+                      []( const qm::QueuePtr< int > &queue, int value ) { return queue->TryPush( value ); },
+                      state.range( 0 ), state.range( 1 ), state.range( 2 ) );
+     }
+}
+
+template< class QueueType >
+static void TestStaticManager(benchmark::State& state) {
+
+     using Consumer = qm::example::ConsumerCounter< std::string, int >;
+     for (auto _ : state)
+     {
+          qm::example::consumer_counter_ = 0;
+          qm::StaticMPSCQueueManager< std::string, QueueType, Consumer > manager;
+          for ( std::size_t i = 0; i < static_cast< std::size_t >( state.range( 0 ) ); i++ )
+          {
+               manager.AddQueue( std::to_string( i ), std::make_shared< QueueType >( 100 ) );
+               manager.Subscribe( std::to_string( i ), std::make_shared< Consumer >( std::to_string( i ) ) );
+          }
+
+          DirectPush( [ &manager ]( const std::string &id ) { return manager.GetQueue( id ); },
+                      []( const std::shared_ptr< QueueType > &queue, int value ) { return queue->QueueType::TryPush( value ); },
+                      state.range( 0 ), state.range( 1 ), state.range( 2 ) );
+     }
+}
+
+template< class QueueType >
+static void TestVirtualManagerEnqueue(benchmark::State& state) {
+
+     for (auto _ : state)
+     {
+          qm::example::consumer_counter_ = 0;
+          auto manager = qm::MPSCQueueManager< std::string, int >();
+          for ( std::size_t i = 0; i < static_cast< std::size_t >( state.range( 0 ) ); i++ )
+          {
+               manager.AddQueue( std::to_string( i ), std::make_shared< QueueType >( 100 ) );
+               manager.Subscribe( std::to_string( i ), std::make_shared< qm::example::ConsumerCounter< std::string, int > >( std::to_string( i ) ) );
+          }
+
+          ManagerEnqueue( manager, state.range( 0 ), state.range( 1 ), state.range( 2 ) );
+     }
+}
+
+template< class QueueType >
+static void TestStaticManagerEnqueue(benchmark::State& state) {
+
+     using Consumer = qm::example::ConsumerCounter< std::string, int >;
+     for (auto _ : state)
+     {
+          qm::example::consumer_counter_ = 0;
+          qm::StaticMPSCQueueManager< std::string, QueueType, Consumer > manager;
+          for ( std::size_t i = 0; i < static_cast< std::size_t >( state.range( 0 ) ); i++ )
+          {
+               manager.AddQueue( std::to_string( i ), std::make_shared< QueueType >( 100 ) );
+               manager.Subscribe( std::to_string( i ), std::make_shared< Consumer >( std::to_string( i ) ) );
+          }
+
+          ManagerEnqueue( manager, state.range( 0 ), state.range( 1 ), state.range( 2 ) );
+     }
+}
+
+BENCHMARK_TEMPLATE(TestVirtualManager, qm::LockFreeQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestStaticManager, qm::LockFreeQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestVirtualManager, qm::LockFreeQueue< int, 100 > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestStaticManager, qm::LockFreeQueue< int, 100 > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestVirtualManager, qm::BlockConcurrentQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestStaticManager, qm::BlockConcurrentQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestVirtualManagerEnqueue, qm::LockFreeQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestStaticManagerEnqueue, qm::LockFreeQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestVirtualManagerEnqueue, qm::BlockConcurrentQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
+BENCHMARK_TEMPLATE(TestStaticManagerEnqueue, qm::BlockConcurrentQueue< int > )->Unit(benchmark::kMillisecond)
+->Args( { std::thread::hardware_concurrency(), 100000, 1} )
+->Args( { std::thread::hardware_concurrency(), 100000, 4} );
+
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include <queue/budgeted_queue.hpp>
+#include <queue/spsc_ring_queue.hpp>
+
+namespace
+{
+
+// push and pop of one value, Queue accounts bytes or not
+template< class Queue >
+void PushPop( benchmark::State &state, Queue &queue )
+{
+     int value = 0;
+     for ( auto _ : state )
+     {
+          queue.TryPush( value );
+          queue.TryPop( value );
+          benchmark::DoNotOptimize( value );
+     }
+     state.SetItemsProcessed( state.iterations() );
+}
+
+void PlainQueue( benchmark::State &state )
+{
+     qm::SpscRingQueue< int > queue( 1024 );
+     PushPop( state, queue );
+}
+
+// argument is reservation: 0 takes every value from shared pool, otherwise only queue counter is touched
+void BudgetQueue( benchmark::State &state )
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 1 << 20 );
+     qm::BudgetedQueue< qm::SpscRingQueue< int > > queue( budget, static_cast< std::size_t >( state.range( 0 )), 1024 );
+     PushPop( state, queue );
+}
+
+} // namespace
+
+BENCHMARK( PlainQueue );
+BENCHMARK( BudgetQueue )->Arg( 0 )->Arg( 4096 );
@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <queue/spsc_ring_queue.hpp>
+
+namespace
+{
+
+struct Tick
+{
+     std::int64_t time;
+     double price;
+     double volume;
+     std::int32_t side;
+};
+
+static_assert( sizeof( Tick ) == 32 );
+
+// one thread moves batches through ring: bulk push then bulk pop, bytes are counted once
+template< class Value >
+void BulkTransfer( benchmark::State &state )
+{
+     const auto batch = static_cast< std::size_t >( state.range( 0 ));
+     qm::SpscRingQueue< Value > queue( 1024 );
+     std::vector< Value > in( batch );
+     std::vector< Value > out( batch );
+
+     for ( auto _ : state )
+     {
+          auto pushed = queue.TryPushBulk( in.data(), batch );
+          auto popped = queue.TryPopBulk( out.data(), pushed );
+          benchmark::DoNotOptimize( out.data() );
+          benchmark::DoNotOptimize( popped );
+     }
+     state.SetBytesProcessed( state.iterations() * batch * sizeof( Value ));
+}
+
+// the same traffic moved one value at a time
+template< class Value >
+void SingleTransfer( benchmark::State &state )
+{
+     const auto batch = static_cast< std::size_t >( state.range( 0 ));
+     qm::SpscRingQueue< Value > queue( 1024 );
+     std::vector< Value > in( batch );
+     std::vector< Value > out( batch );
+
+     for ( auto _ : state )
+     {
+          for ( std::size_t i = 0; i < batch; ++i )
+          {
+               queue.TryPush( in[ i ] );
+          }
+          for ( std::size_t i = 0; i < batch; ++i )
+          {
+               queue.TryPop( out[ i ] );
+          }
+          benchmark::DoNotOptimize( out.data() );
+     }
+     state.SetBytesProcessed( state.iterations() * batch * sizeof( Value ));
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE( BulkTransfer, int )->Arg( 64 )->Arg( 700 );
+BENCHMARK_TEMPLATE( SingleTransfer, int )->Arg( 64 )->Arg( 700 );
+BENCHMARK_TEMPLATE( BulkTransfer, Tick )->Arg( 64 )->Arg( 700 );
+BENCHMARK_TEMPLATE( SingleTransfer, Tick )->Arg( 64 )->Arg( 700 );
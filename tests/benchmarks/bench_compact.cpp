@@ -0,0 +1,75 @@
+#include <malloc.h>
+
+#include <memory>
+
+#include <benchmark/benchmark.h>
+
+#include <manager/compact_mqueue_manager.hpp>
+#include <manager/mpsc_mqueue_manager.hpp>
+#include <queue/block_concurrent_queue.hpp>
+
+namespace
+{
+
+class NullConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int &value ) override
+     {
+          benchmark::DoNotOptimize( value );
+     }
+};
+
+std::size_t HeapInUse()
+{
+     return mallinfo2().uordblks;
+}
+
+// idle keys after one message went through each of them, heap growth is reported per key
+void CompactIdleKeys( benchmark::State &state )
+{
+     const auto keys = static_cast< int >( state.range( 0 ));
+     auto consumer = std::make_shared< NullConsumer >();
+     double bytes_per_key = 0;
+     for ( auto _ : state )
+     {
+          auto before = HeapInUse();
+          qm::CompactQueueManager< int, int > manager( 1, std::chrono::milliseconds( 0 ));
+          for ( int id = 0; id < keys; id++ )
+          {
+               manager.AddQueue( id, 1000 );
+               manager.Subscribe( id, consumer );
+               manager.Enqueue( id, id );
+          }
+          manager.StopProcessing();
+          manager.Compact();
+          manager.Compact();
+          bytes_per_key = static_cast< double >( HeapInUse() - before ) / keys;
+     }
+     state.counters[ "bytes_per_key" ] = bytes_per_key;
+}
+
+// the same keys as queues of MPSC manager, stacks of consumers threads of subscribed keys would come on top
+void MpscIdleKeys( benchmark::State &state )
+{
+     const auto keys = static_cast< int >( state.range( 0 ));
+     double bytes_per_key = 0;
+     for ( auto _ : state )
+     {
+          auto before = HeapInUse();
+          qm::MPSCQueueManager< int, int > manager;
+          for ( int id = 0; id < keys; id++ )
+          {
+               manager.AddQueue( id, std::make_shared< qm::BlockConcurrentQueue< int > >( 1000 ));
+               manager.Enqueue( id, id );
+               manager.GetQueue( id ).queue_->Pop();
+          }
+          bytes_per_key = static_cast< double >( HeapInUse() - before ) / keys;
+     }
+     state.counters[ "bytes_per_key" ] = bytes_per_key;
+}
+
+} // namespace
+
+BENCHMARK( CompactIdleKeys )->Arg( 10000 )->Unit( benchmark::kMillisecond );
+BENCHMARK( MpscIdleKeys )->Arg( 10000 )->Unit( benchmark::kMillisecond );
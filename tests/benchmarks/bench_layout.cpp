@@ -0,0 +1,151 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <consumer/base_consumer.hpp>
+#include <manager/mpsc_mqueue_manager.hpp>
+#include <queue/block_concurrent_queue.hpp>
+#include <queue/lock_free_queue.hpp>
+
+namespace
+{
+
+constexpr std::size_t MaxThreads = 64;
+
+// layout of consumer state before hot fields were aligned: flags of neighbours share cache line
+struct PackedConsumer
+{
+     std::atomic< bool > enabled_{ true };
+     std::atomic< bool > inline_{ false };
+     std::atomic< std::size_t > consumed_{ 0 };
+
+     bool Enabled() const { return enabled_.load(); }
+
+     void Consume( const int & ) { consumed_.fetch_add( 1, std::memory_order_relaxed ); }
+};
+
+class AlignedConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int & ) override { consumed_.fetch_add( 1, std::memory_order_relaxed ); }
+
+     std::size_t Consumed() const { return consumed_.load( std::memory_order_relaxed ); }
+
+private:
+     qm::CacheAligned< std::atomic< std::size_t > > consumed_{ 0 };
+};
+
+// each thread takes own consumer from contiguous array, so only layout decides about false sharing
+template< class Consumer >
+void ConsumeOwn( benchmark::State &state )
+{
+     // allocated once and shared by all runs, threads of one run take neighbouring slots
+     static std::unique_ptr< Consumer[] > consumers( new Consumer[ MaxThreads ] );
+     static std::atomic< std::size_t > next_slot{ 0 };
+
+     auto &consumer = consumers[ next_slot.fetch_add( 1 ) % MaxThreads ];
+     for ( auto _ : state )
+     {
+          if ( consumer.Enabled() )
+          {
+               consumer.Consume( 1 );
+          }
+     }
+     state.SetItemsProcessed( state.iterations() );
+}
+
+// each thread pushes to and pops from own queue, queues are allocated back to back by one thread,
+// so hot fields of neighbouring queues are shared only if their layout lets them
+template< class Queue >
+void PushPopOwn( benchmark::State &state )
+{
+     static const auto queues = []()
+     {
+          std::vector< std::unique_ptr< Queue > > result;
+          for ( std::size_t i = 0; i < MaxThreads; i++ )
+          {
+               result.push_back( std::make_unique< Queue >( 100 ));
+          }
+          return result;
+     }();
+     static std::atomic< std::size_t > next_slot{ 0 };
+
+     auto &queue = *queues[ next_slot.fetch_add( 1 ) % MaxThreads ];
+     int value = 0;
+     for ( auto _ : state )
+     {
+          queue.TryPush( 1 );
+          queue.TryPop( value );
+     }
+     benchmark::DoNotOptimize( value );
+     state.SetItemsProcessed( state.iterations() );
+}
+
+// many producers per queue of real manager, as in bench1: producers, queues and consumers of neighbouring
+// keys run on different threads and touch only their own hot fields
+template< class Queue >
+void ManagerManyProducers( benchmark::State &state )
+{
+     const auto queues = static_cast< std::size_t >( state.range( 0 ));
+     const auto loops = static_cast< int >( state.range( 1 ));
+     const auto producer_multiple = static_cast< std::size_t >( state.range( 2 ));
+     for ( auto _ : state )
+     {
+          qm::MPSCQueueManager< std::string, int > manager;
+          std::vector< std::shared_ptr< AlignedConsumer > > consumers;
+          for ( std::size_t i = 0; i < queues; i++ )
+          {
+               consumers.push_back( std::make_shared< AlignedConsumer >() );
+               manager.AddQueue( std::to_string( i ), std::make_shared< Queue >( 100 ));
+               manager.Subscribe( std::to_string( i ), consumers.back() );
+          }
+
+          std::vector< std::thread > producers;
+          for ( std::size_t i = 0; i < queues * producer_multiple; i++ )
+          {
+               producers.emplace_back( [ &manager, id = std::to_string( i / producer_multiple ), loops ]()
+               {
+                    for ( int value = 0; value < loops; value++ )
+                    {
+                         while ( manager.Enqueue( id, value ) == qm::State::QueueFull )
+                         {
+                              std::this_thread::yield();
+                         }
+                    }
+               } );
+          }
+          for ( auto &producer : producers )
+          {
+               producer.join();
+          }
+
+          // wait for consumer work done
+          for ( const auto &consumer : consumers )
+          {
+               while ( consumer->Consumed() != producer_multiple * static_cast< std::size_t >( loops ))
+               {
+                    std::this_thread::yield();
+               }
+          }
+     }
+     state.SetItemsProcessed( state.iterations() * state.range( 0 ) * state.range( 1 ) * state.range( 2 ));
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE( ConsumeOwn, PackedConsumer )->ThreadRange( 1, 8 )->UseRealTime();
+BENCHMARK_TEMPLATE( ConsumeOwn, AlignedConsumer )->ThreadRange( 1, 8 )->UseRealTime();
+
+BENCHMARK_TEMPLATE( PushPopOwn, qm::BlockConcurrentQueue< int > )->ThreadRange( 1, 8 )->UseRealTime();
+BENCHMARK_TEMPLATE( PushPopOwn, qm::LockFreeQueue< int > )->ThreadRange( 1, 8 )->UseRealTime();
+
+BENCHMARK_TEMPLATE( ManagerManyProducers, qm::BlockConcurrentQueue< int > )->Unit( benchmark::kMillisecond )->UseRealTime()
+->Args( { std::thread::hardware_concurrency(), 100000, 1 } )
+->Args( { std::thread::hardware_concurrency(), 100000, 4 } );
+BENCHMARK_TEMPLATE( ManagerManyProducers, qm::LockFreeQueue< int > )->Unit( benchmark::kMillisecond )->UseRealTime()
+->Args( { std::thread::hardware_concurrency(), 100000, 1 } )
+->Args( { std::thread::hardware_concurrency(), 100000, 4 } );
@@ -0,0 +1,50 @@
+#include <memory_resource>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <buffer/numa.hpp>
+#include <queue/spsc_ring_queue.hpp>
+
+namespace
+{
+
+// ring storage is bound to consumer node ( 0 ) or to the next node ( 1 ), then values stream through it.
+// Storage is carved from own arena, so node really holding it is reported. On single node system
+// both runs are local and cross node traffic is zero.
+void NumaTransfer( benchmark::State &state )
+{
+     constexpr std::size_t Size = 1 << 16;
+     constexpr std::size_t Batch = 512;
+     const auto consumer_node = qm::CurrentNumaNode();
+     const auto wanted_node = ( consumer_node + static_cast< int >( state.range( 0 ))) % qm::NumaNodes();
+
+     // arena holds ring storage and list node of ring header
+     std::vector< char > arena_memory( ( Size + 1 ) * sizeof( int ) + 4096 );
+     std::pmr::monotonic_buffer_resource arena( arena_memory.data(), arena_memory.size(), std::pmr::null_memory_resource() );
+     qm::SpscRingQueue< int > queue( Size, &arena );
+     queue.BindToNode( wanted_node );
+     const auto storage_node = qm::NumaNodeOf( arena_memory.data() + arena_memory.size() / 2 );
+
+     std::vector< int > in( Batch, 1 );
+     std::vector< int > out( Batch );
+     for ( auto _ : state )
+     {
+          for ( std::size_t sent = 0; sent < Size; sent += Batch )
+          {
+               auto pushed = queue.TryPushBulk( in.data(), Batch );
+               benchmark::DoNotOptimize( queue.TryPopBulk( out.data(), pushed ));
+          }
+     }
+
+     const auto bytes = static_cast< double >( state.iterations() * Size * sizeof( int ));
+     state.counters[ "consumer_node" ] = consumer_node;
+     state.counters[ "storage_node" ] = storage_node;
+     state.counters[ "cross_node_bytes" ] = benchmark::Counter( storage_node != consumer_node ? bytes : 0.0,
+                                                                 benchmark::Counter::kIsRate );
+     state.SetBytesProcessed( state.iterations() * Size * sizeof( int ));
+}
+
+} // namespace
+
+BENCHMARK( NumaTransfer )->Arg( 0 )->Arg( 1 );
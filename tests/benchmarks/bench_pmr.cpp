@@ -0,0 +1,58 @@
+#include <cstddef>
+#include <memory_resource>
+
+#include <benchmark/benchmark.h>
+
+#include <queue/block_concurrent_queue.hpp>
+
+namespace
+{
+
+// queue is built, filled and drained every iteration: allocations dominate
+template< typename Reset = void ( * )() >
+void QueueChurn( benchmark::State &state, std::pmr::memory_resource *resource, Reset reset = []() {} )
+{
+     const auto count = static_cast< int >( state.range( 0 ));
+     for ( auto _ : state )
+     {
+          qm::BlockConcurrentQueue< int > queue( count, resource );
+          for ( int i = 0; i < count; i++ )
+          {
+               queue.TryPush( i );
+          }
+          // blocking queue waits on empty pop, so drain exactly what was pushed
+          int value = 0;
+          for ( int i = 0; i < count; i++ )
+          {
+               queue.TryPop( value );
+               benchmark::DoNotOptimize( value );
+          }
+          reset();
+     }
+     state.SetItemsProcessed( state.iterations() * count );
+}
+
+void HeapChurn( benchmark::State &state )
+{
+     QueueChurn( state, std::pmr::new_delete_resource() );
+}
+
+void PoolChurn( benchmark::State &state )
+{
+     std::pmr::unsynchronized_pool_resource pool;
+     QueueChurn( state, &pool );
+}
+
+// arena memory is reused by every iteration, release is counted as part of churn
+void ArenaChurn( benchmark::State &state )
+{
+     static std::byte buffer[ 1 << 20 ];
+     std::pmr::monotonic_buffer_resource arena( buffer, sizeof( buffer ));
+     QueueChurn( state, &arena, [ &arena ]() { arena.release(); } );
+}
+
+} // namespace
+
+BENCHMARK( HeapChurn )->Arg( 64 )->Arg( 4096 );
+BENCHMARK( PoolChurn )->Arg( 64 )->Arg( 4096 );
+BENCHMARK( ArenaChurn )->Arg( 64 )->Arg( 4096 );
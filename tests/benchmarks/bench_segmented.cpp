@@ -0,0 +1,80 @@
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <queue/block_concurrent_queue.hpp>
+#include <queue/lock_free_queue.hpp>
+#include <queue/segmented_queue.hpp>
+
+namespace
+{
+
+constexpr std::size_t ValuesCount = 1 << 16;
+
+// producers push ValuesCount values in total while one consumer drains them,
+// bounded queues are sized to hold all values, so no push is refused
+template< class Queue >
+void Transfer( benchmark::State &state, Queue &queue )
+{
+     const auto producers_count = static_cast< std::size_t >( state.range( 0 ));
+     for ( auto _ : state )
+     {
+          std::vector< std::thread > producers;
+          for ( std::size_t p = 0; p < producers_count; p++ )
+          {
+               producers.emplace_back( [ &queue, producers_count ]()
+               {
+                    for ( std::size_t i = 0; i < ValuesCount / producers_count; i++ )
+                    {
+                         while ( queue.TryPush( static_cast< int >( i )) != qm::State::Ok )
+                         {
+                              std::this_thread::yield();
+                         }
+                    }
+               } );
+          }
+
+          int value = 0;
+          for ( std::size_t popped = 0; popped < ValuesCount / producers_count * producers_count; )
+          {
+               if ( queue.TryPop( value ))
+               {
+                    popped++;
+               }
+          }
+          benchmark::DoNotOptimize( value );
+
+          for ( auto &producer : producers )
+          {
+               producer.join();
+          }
+     }
+     state.SetItemsProcessed( state.iterations() * ValuesCount );
+}
+
+void LockFreeTransfer( benchmark::State &state )
+{
+     qm::LockFreeQueue< int > queue( ValuesCount );
+     Transfer( state, queue );
+}
+
+void SegmentedTransfer( benchmark::State &state )
+{
+     qm::SegmentedQueue< int > queue;
+     Transfer( state, queue );
+     state.counters[ "segments" ] = static_cast< double >( queue.Segments() );
+}
+
+// consumer of blocking queue waits in TryPop, so all values are popped before it is called again
+void BlockingTransfer( benchmark::State &state )
+{
+     qm::BlockConcurrentQueue< int > queue( ValuesCount );
+     Transfer( state, queue );
+}
+
+} // namespace
+
+BENCHMARK( BlockingTransfer )->Arg( 1 )->Arg( 4 )->UseRealTime();
+BENCHMARK( LockFreeTransfer )->Arg( 1 )->Arg( 4 )->UseRealTime();
+BENCHMARK( SegmentedTransfer )->Arg( 1 )->Arg( 4 )->UseRealTime();
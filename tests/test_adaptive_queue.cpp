@@ -0,0 +1,115 @@
+#include <future>
+
+#include <gtest/gtest.h>
+
+#include <queue/adaptive_queue.hpp>
+#include <queue/multi_lane_queue.hpp>
+
+TEST(AdaptiveQueue, push_pop)
+{
+     qm::AdaptiveQueue<int> queue( 3 );
+     ASSERT_TRUE( queue.Empty() );
+     ASSERT_EQ( queue.Mode(), qm::AdaptiveMode::Single );
+
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 3 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 4 ), qm::State::QueueFull );
+
+     ASSERT_EQ( queue.Pop().value(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 2 );
+     ASSERT_EQ( queue.Pop().value(), 3 );
+     ASSERT_FALSE( queue.Pop().has_value() );
+
+     queue.Stop();
+     ASSERT_EQ( queue.Push( 1 ), qm::State::QueueDisabled );
+}
+
+TEST(AdaptiveQueue, switch_keeps_order)
+{
+     qm::AdaptivePolicy policy;
+     policy.window = 4;
+     qm::AdaptiveQueue<int> queue( 100, policy );
+
+     int pushed = 0;
+     for ( ; pushed < 3; ++pushed )
+     {
+          ASSERT_EQ( queue.Push( pushed ), qm::State::Ok );
+     }
+
+     // second producer switches queue to multi producers mode
+     ASSERT_EQ( queue.AttachProducer(), nullptr );
+     ASSERT_EQ( queue.Mode(), qm::AdaptiveMode::Single );
+     queue.AttachProducer();
+     ASSERT_EQ( queue.Mode(), qm::AdaptiveMode::Multi );
+
+     for ( ; pushed < 6; ++pushed )
+     {
+          ASSERT_EQ( queue.Push( pushed ), qm::State::Ok );
+     }
+
+     // next switch is possible only when consumer has drained previous implementation
+     int popped = 0;
+     for ( ; popped < 4; ++popped )
+     {
+          ASSERT_EQ( queue.Pop().value(), popped );
+     }
+
+     // without contention queue switches back on the next window
+     queue.DetachProducer( nullptr );
+     for ( ; pushed < 12; ++pushed )
+     {
+          ASSERT_EQ( queue.Push( pushed ), qm::State::Ok );
+     }
+     ASSERT_EQ( queue.Mode(), qm::AdaptiveMode::Single );
+
+     for ( ; popped < pushed; ++popped )
+     {
+          ASSERT_EQ( queue.Pop().value(), popped );
+     }
+     ASSERT_FALSE( queue.Pop().has_value() );
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(AdaptiveQueue, producers_threads)
+{
+     const int values_count = 10000;
+     const int producers_count = 4;
+     qm::AdaptivePolicy policy;
+     policy.window = 64;
+     qm::AdaptiveQueue<std::string, qm::MultiLaneQueue< std::string > > queue( 16, policy );
+
+     std::vector< std::future< void > > producers;
+     for ( int p = 0; p < producers_count; ++p )
+     {
+          producers.push_back( std::async( std::launch::async, [&queue, p] ()
+          {
+               for ( int i = 0; i < values_count; ++i )
+               {
+                    while ( queue.Push( std::to_string( p * values_count + i ) ) != qm::State::Ok )
+                    {
+                         std::this_thread::yield();
+                    }
+               }
+          }));
+     }
+
+     std::vector<int> last( producers_count, -1 );
+     for ( int popped = 0; popped < values_count * producers_count; )
+     {
+          auto value = queue.Pop();
+          if ( !value.has_value() )
+          {
+               std::this_thread::yield();
+          }
+          else
+          {
+               int number = std::stoi( value.value() );
+               int p = number / values_count;
+               ASSERT_GT( number, last[ p ] );
+               last[ p ] = number;
+               popped++;
+          }
+     }
+     ASSERT_TRUE( queue.Empty() );
+}
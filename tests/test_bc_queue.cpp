@@ -1,4 +1,9 @@
+#include <atomic>
+#include <chrono>
 #include <future>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
 
 #include <gtest/gtest.h>
 
@@ -96,4 +101,220 @@ TEST(BlockConcurrentQueue, enable_disable_queue)
      ASSERT_FALSE( queue.Enabled() );
      state = queue.Push( 5 );
      ASSERT_EQ( state, qm::State::QueueDisabled );
-}
\ No newline at end of file
+}
+TEST(BlockConcurrentQueue, push_bulk)
+{
+     std::vector<int> values = { 1, 2, 3, 4, 5 };
+     qm::BlockConcurrentQueue<int> queue( 3 );
+
+     auto pushed = queue.TryPushBulk( values.data(), values.size() );
+     ASSERT_EQ( pushed, 3 );
+     ASSERT_EQ( queue.Size(), 3 );
+
+     for ( int i = 0; i < 3; i++ )
+     {
+          ASSERT_EQ( queue.Pop().value(), values[ i ] );
+     }
+
+     queue.Stop();
+     pushed = queue.TryPushBulk( values.data() + 3, 2 );
+     ASSERT_EQ( pushed, 0 );
+}
+
+TEST(BlockConcurrentQueue, emplace)
+{
+     struct Counted
+     {
+          explicit Counted( int value, int *copies ) : value_( value ), copies_( copies ) {}
+          Counted( const Counted &other ) : value_( other.value_ ), copies_( other.copies_ ) { ++*copies_; }
+          Counted( Counted &&other ) = default;
+          Counted &operator=( Counted &&other ) = default;
+
+          int value_;
+          int *copies_;
+     };
+
+     int copies = 0;
+     qm::BlockConcurrentQueue<Counted> queue( 3 );
+     ASSERT_EQ( queue.Emplace( 1, &copies ), qm::State::Ok );
+
+     Counted value( 2, &copies );
+     ASSERT_EQ( queue.Push( value ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( std::move( value )), qm::State::Ok );
+     ASSERT_EQ( copies, 1 );
+
+     ASSERT_EQ( queue.Pop()->value_, 1 );
+     ASSERT_EQ( queue.Pop()->value_, 2 );
+     ASSERT_EQ( queue.Pop()->value_, 2 );
+}
+
+TEST(BlockConcurrentQueue, reserve_commit)
+{
+     qm::BlockConcurrentQueue<std::string> queue( 3 );
+     ASSERT_EQ( queue.Commit(), qm::State::QueueAbsent );
+     ASSERT_EQ( queue.Push( "a" ), qm::State::Ok );
+
+     auto slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     ASSERT_EQ( queue.Reserve(), slot );
+     slot->assign( "b" );
+
+     // other threads neither get the slot nor pop it before commit, values pushed after it wait
+     ASSERT_EQ( std::async( std::launch::async, [ &queue ]() { return queue.Reserve(); } ).get(), nullptr );
+     ASSERT_EQ( std::async( std::launch::async, [ &queue ]() { return queue.Commit(); } ).get(), qm::State::QueueAbsent );
+     ASSERT_EQ( queue.TryPush( "c" ), qm::State::Ok );
+     ASSERT_EQ( queue.Size(), 2 );
+     ASSERT_EQ( queue.Reserve(), slot );
+     ASSERT_EQ( queue.Pop().value(), "a" );
+
+     auto pop = std::async( std::launch::async, [ &queue ]() { return queue.Pop(); } );
+     ASSERT_EQ( pop.wait_for( std::chrono::milliseconds( 20 )), std::future_status::timeout );
+     ASSERT_EQ( queue.Commit(), qm::State::Ok );
+     ASSERT_EQ( pop.get().value(), "b" );
+     ASSERT_EQ( queue.Pop().value(), "c" );
+     ASSERT_TRUE( queue.Empty() );
+
+     // dropped slot releases values pushed after it
+     ASSERT_EQ( queue.Cancel(), qm::State::QueueAbsent );
+     slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     ASSERT_EQ( queue.TryPush( "d" ), qm::State::Ok );
+     ASSERT_EQ( queue.Cancel(), qm::State::Ok );
+     ASSERT_EQ( queue.Pop().value(), "d" );
+     ASSERT_TRUE( queue.Empty() );
+
+     // value reserved by disabled queue is dropped
+     slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     queue.Stop();
+     ASSERT_EQ( queue.Commit(), qm::State::QueueDisabled );
+     ASSERT_EQ( queue.Reserve(), nullptr );
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(BlockConcurrentQueue, emplace_through_interface)
+{
+     struct Counted
+     {
+          Counted() = default;
+          Counted( int value, std::atomic< int > *moves ) noexcept : value_( value ), moves_( moves ) {}
+          Counted( Counted &&other ) noexcept : value_( other.value_ ), moves_( other.moves_ ) { ++*moves_; }
+          Counted &operator=( Counted &&other ) noexcept
+          {
+               value_ = other.value_;
+               moves_ = other.moves_;
+               ++*moves_;
+               return *this;
+          }
+          Counted( const Counted & ) = default;
+          Counted &operator=( const Counted & ) = default;
+
+          int value_ = 0;
+          std::atomic< int > *moves_ = nullptr;
+     };
+
+     std::atomic< int > moves = 0;
+     qm::QueuePtr< Counted > queue = std::make_shared< qm::BlockConcurrentQueue< Counted > >( 1 );
+     ASSERT_EQ( queue->Emplace( 1, &moves ), qm::State::Ok );
+     ASSERT_EQ( moves, 0 );
+
+     // full queue has no slot to reserve, value is built and pushed by blocking Push
+     auto blocked = std::async( std::launch::async, [ &queue, &moves ]() { return queue->Emplace( 2, &moves ); } );
+     ASSERT_EQ( queue->Pop()->value_, 1 );
+     ASSERT_EQ( blocked.get(), qm::State::Ok );
+     ASSERT_EQ( queue->Pop()->value_, 2 );
+}
+
+TEST(BlockConcurrentQueue, emplace_throwing_constructor)
+{
+     struct Checked
+     {
+          Checked() = default;
+          explicit Checked( int value ) : value_( value )
+          {
+               if ( value < 0 )
+               {
+                    throw std::invalid_argument( "negative" );
+               }
+          }
+
+          int value_ = 0;
+     };
+
+     // constructor may throw, value is still built in reserved slot and slot is dropped on throw
+     qm::QueuePtr< Checked > queue = std::make_shared< qm::BlockConcurrentQueue< Checked > >( 2 );
+     ASSERT_THROW( queue->Emplace( -1 ), std::invalid_argument );
+     ASSERT_TRUE( queue->Empty() );
+     ASSERT_EQ( queue->Emplace( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue->Emplace( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue->Pop()->value_, 1 );
+     ASSERT_EQ( queue->Pop()->value_, 2 );
+}
+
+TEST(BlockConcurrentQueue, memory_resource)
+{
+     // arena without upstream fails any allocation outside of buffer
+     std::byte buffer[ 4096 ];
+     std::pmr::monotonic_buffer_resource arena( buffer, sizeof( buffer ), std::pmr::null_memory_resource() );
+     qm::BlockConcurrentQueue< int > queue( 100, &arena );
+
+     for ( int i = 0; i < 100; i++ )
+     {
+          ASSERT_EQ( queue.Push( i ), qm::State::Ok );
+     }
+     for ( int i = 0; i < 100; i++ )
+     {
+          ASSERT_EQ( queue.Pop().value(), i );
+     }
+}
+
+TEST(BlockConcurrentQueue, resize)
+{
+     qm::BlockConcurrentQueue< int > queue( 2 );
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+
+     // blocked pusher is woken up by growth
+     auto pusher = std::async( std::launch::async, [ &queue ]() { return queue.Push( 3 ); } );
+     ASSERT_EQ( queue.Resize( 4 ), qm::State::Ok );
+     ASSERT_EQ( pusher.get(), qm::State::Ok );
+     ASSERT_EQ( queue.MaxSize(), 4 );
+
+     // values over smaller size are kept, pushes wait for them to be consumed
+     ASSERT_EQ( queue.Resize( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Size(), 3 );
+     ASSERT_EQ( queue.TryPush( 4 ), qm::State::QueueFull );
+     ASSERT_EQ( queue.Pop().value(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 2 );
+     ASSERT_EQ( queue.Pop().value(), 3 );
+     ASSERT_EQ( queue.TryPush( 4 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 5 ), qm::State::QueueFull );
+}
+
+TEST(BlockConcurrentQueue, auto_grow)
+{
+     qm::BlockConcurrentQueue< int > queue( 2 );
+     queue.AutoGrow( 5, 3 );
+
+     ASSERT_EQ( queue.TryPush( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 3 ), qm::State::QueueFull );
+     ASSERT_EQ( queue.TryPush( 3 ), qm::State::QueueFull );
+
+     // third refused push in a row doubles size
+     ASSERT_EQ( queue.TryPush( 3 ), qm::State::Ok );
+     ASSERT_EQ( queue.MaxSize(), 4 );
+     ASSERT_EQ( queue.TryPush( 4 ), qm::State::Ok );
+
+     // growth stops at limit
+     for ( int i = 0; i < 3; i++ )
+     {
+          ASSERT_EQ( queue.TryPush( 5 ), i < 2 ? qm::State::QueueFull : qm::State::Ok );
+     }
+     ASSERT_EQ( queue.MaxSize(), 5 );
+     for ( int i = 0; i < 10; i++ )
+     {
+          ASSERT_EQ( queue.TryPush( 6 ), qm::State::QueueFull );
+     }
+     ASSERT_EQ( queue.MaxSize(), 5 );
+}
@@ -0,0 +1,233 @@
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <queue/block_concurrent_queue.hpp>
+#include <queue/budgeted_queue.hpp>
+#include <queue/hand_off_queue.hpp>
+#include <queue/multi_lane_queue.hpp>
+#include <queue/spsc_ring_queue.hpp>
+
+namespace
+{
+
+struct TenBytes
+{
+     std::size_t operator()( const int & ) const { return 10; }
+};
+
+} // namespace
+
+TEST(BudgetedQueue, refuse_over_budget)
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 100 );
+     qm::BudgetedQueue< qm::SpscRingQueue< std::string > > queue( budget, 0, 10 );
+     const auto base = sizeof( std::string );
+
+     ASSERT_EQ( queue.TryPush( std::string( 100 - 2 * base - 10, 'a' )), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( std::string( 5, 'b' )), qm::State::Ok );
+     ASSERT_EQ( budget->Used(), 100 - 5 );
+     ASSERT_EQ( queue.TryPush( std::string( 6, 'c' )), qm::State::BudgetExceeded );
+     ASSERT_EQ( qm::StateStr( qm::State::BudgetExceeded ), "memory budget is exceeded" );
+
+     ASSERT_EQ( queue.Pop().value().size(), 100 - 2 * base - 10 );
+     ASSERT_EQ( budget->Used(), base + 5 );
+     std::string value;
+     ASSERT_TRUE( queue.TryPop( value ));
+     ASSERT_EQ( budget->Used(), 0 );
+     ASSERT_EQ( budget->Taken(), 0 );
+}
+
+TEST(BudgetedQueue, reservations)
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 100 );
+     qm::BudgetedQueue< qm::BlockConcurrentQueue< int >, TenBytes > first( budget, 60, 100 );
+     qm::BudgetedQueue< qm::BlockConcurrentQueue< int >, TenBytes > second( budget, 60, 100 );
+     ASSERT_EQ( first.Account().Reserved(), 60 );
+     ASSERT_EQ( second.Account().Reserved(), 0 );
+
+     // reserved bytes don't touch shared pool
+     for ( int i = 0; i < 6; i++ )
+     {
+          ASSERT_EQ( first.TryPush( i ), qm::State::Ok );
+     }
+     ASSERT_EQ( budget->Taken(), 60 );
+     ASSERT_EQ( budget->Used(), 60 );
+
+     for ( int i = 0; i < 4; i++ )
+     {
+          ASSERT_EQ( second.TryPush( i ), qm::State::Ok );
+     }
+     ASSERT_EQ( second.TryPush( 5 ), qm::State::BudgetExceeded );
+     ASSERT_EQ( first.TryPush( 5 ), qm::State::BudgetExceeded );
+
+     // bytes over reservation go back to pool
+     ASSERT_TRUE( second.Pop().has_value() );
+     ASSERT_EQ( first.TryPush( 5 ), qm::State::Ok );
+     ASSERT_EQ( first.Account().Used(), 70 );
+     ASSERT_EQ( budget->Used(), 100 );
+}
+
+TEST(BudgetedQueue, push_bulk)
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 35 );
+     qm::BudgetedQueue< qm::SpscRingQueue< int >, TenBytes > queue( budget, 0, 100 );
+     int values[] = { 1, 2, 3, 4, 5 };
+     ASSERT_EQ( queue.TryPushBulk( values, 5 ), 3 );
+     ASSERT_EQ( budget->Used(), 30 );
+
+     // queue limit is hit before budget
+     qm::BudgetedQueue< qm::SpscRingQueue< int >, TenBytes > small( budget, 0, 1 );
+     ASSERT_EQ( small.TryPushBulk( values, 5 ), 0 );
+     ASSERT_EQ( budget->Used(), 30 );
+
+     qm::BudgetedQueue< qm::HandOffQueue< int >, TenBytes > hand_off( budget, 0, 10 );
+     ASSERT_EQ( hand_off.TryPushBulk( values, 5 ), 0 );
+     ASSERT_EQ( budget->Used(), 30 );
+}
+
+TEST(BudgetedQueue, throttled_push)
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 10 );
+     auto queue = std::make_shared< qm::BudgetedQueue< qm::SpscRingQueue< int >, TenBytes > >( budget, 0, 10 );
+     ASSERT_EQ( queue->Push( 1 ), qm::State::Ok );
+
+     auto push = std::async( std::launch::async, [ &queue ]() { return queue->Push( 2 ); } );
+     ASSERT_EQ( push.wait_for( std::chrono::milliseconds( 20 )), std::future_status::timeout );
+     ASSERT_EQ( queue->Pop().value(), 1 );
+     ASSERT_EQ( push.get(), qm::State::Ok );
+     ASSERT_EQ( queue->Pop().value(), 2 );
+
+     ASSERT_EQ( queue->Emplace( 3 ), qm::State::Ok );
+     auto blocked = std::async( std::launch::async, [ &queue ]() { return queue->Emplace( 4 ); } );
+     queue->Stop();
+     ASSERT_EQ( blocked.get(), qm::State::QueueDisabled );
+     ASSERT_EQ( budget->Used(), 10 );
+}
+
+TEST(BudgetedQueue, throttled_commit)
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 10 );
+     auto queue = std::make_shared< qm::BudgetedQueue< qm::BlockConcurrentQueue< int >, TenBytes > >( budget, 0, 10 );
+     ASSERT_EQ( queue->Push( 1 ), qm::State::Ok );
+
+     // reserved value waits for budget in Commit, its bytes are taken when it is published
+     auto commit = std::async( std::launch::async, [ &queue ]()
+     {
+          *queue->Reserve() = 2;
+          return queue->Commit();
+     } );
+     ASSERT_EQ( commit.wait_for( std::chrono::milliseconds( 20 )), std::future_status::timeout );
+     ASSERT_EQ( queue->Pop().value(), 1 );
+     ASSERT_EQ( commit.get(), qm::State::Ok );
+     ASSERT_EQ( budget->Used(), 10 );
+
+     // dropped value takes no bytes
+     *queue->Reserve() = 3;
+     ASSERT_EQ( queue->Cancel(), qm::State::Ok );
+     ASSERT_EQ( queue->Pop().value(), 2 );
+     ASSERT_TRUE( queue->Empty() );
+     ASSERT_EQ( budget->Used(), 0 );
+}
+
+TEST(BudgetedQueue, producer_lanes)
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 1000 );
+     auto queue = std::make_shared< qm::BudgetedQueue< qm::MultiLaneQueue< int >, TenBytes > >( budget, 0, 10 );
+     auto lane = queue->AttachProducer();
+     ASSERT_EQ( queue->Lanes(), 1 );
+     ASSERT_EQ( lane->TryPush( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue->TryPush( 2 ), qm::State::Ok );
+     ASSERT_EQ( budget->Used(), 20 );
+
+     int value = 0;
+     ASSERT_TRUE( queue->TryPop( value ));
+     ASSERT_TRUE( queue->TryPop( value ));
+     ASSERT_EQ( budget->Used(), 0 );
+
+     queue->DetachProducer( lane );
+     ASSERT_EQ( queue->Lanes(), 0 );
+}
+
+TEST(BudgetedQueue, throttled_lane_push)
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 10 );
+     auto queue = std::make_shared< qm::BudgetedQueue< qm::MultiLaneQueue< int >, TenBytes > >( budget, 0, 10 );
+     auto lane = queue->AttachProducer();
+     ASSERT_EQ( lane->Push( 1 ), qm::State::Ok );
+
+     // blocking push of producer lane waits for budget like push to queue
+     auto push = std::async( std::launch::async, [ &lane ]() { return lane->Push( 2 ); } );
+     ASSERT_EQ( push.wait_for( std::chrono::milliseconds( 20 )), std::future_status::timeout );
+     int value = 0;
+     ASSERT_TRUE( queue->TryPop( value ));
+     ASSERT_EQ( push.get(), qm::State::Ok );
+
+     auto blocked = std::async( std::launch::async, [ &lane ]() { return lane->Push( 3 ); } );
+     queue->Stop();
+     ASSERT_EQ( blocked.get(), qm::State::QueueDisabled );
+}
+
+TEST(BudgetedQueue, concurrent_reserve_commit)
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 1000 );
+     qm::BudgetedQueue< qm::BlockConcurrentQueue< int >, TenBytes > queue( budget, 0, 1000 );
+     const int per_thread = 2000;
+
+     // slot is released to other threads by commit, it must not be cleared after that
+     std::vector< std::thread > producers;
+     for ( int t = 0; t < 4; t++ )
+     {
+          producers.emplace_back( [ &queue ]()
+          {
+               for ( int i = 0; i < per_thread; )
+               {
+                    auto *slot = queue.Reserve();
+                    if ( slot == nullptr )
+                    {
+                         std::this_thread::yield();
+                         continue;
+                    }
+
+                    *slot = 1;
+                    EXPECT_EQ( queue.Commit(), qm::State::Ok );
+                    i++;
+               }
+          } );
+     }
+
+     long sum = 0;
+     int value = 0;
+     while ( sum < 4 * per_thread )
+     {
+          if ( queue.TryPop( value ))
+          {
+               sum += value;
+          }
+     }
+     for ( auto &producer : producers )
+     {
+          producer.join();
+     }
+     ASSERT_EQ( budget->Used(), 0 );
+}
+
+TEST(BudgetedQueue, destruction_returns_bytes)
+{
+     auto budget = std::make_shared< qm::MemoryBudget >( 1000 );
+     {
+          qm::BudgetedQueue< qm::SpscRingQueue< int >, TenBytes > queue( budget, 50, 100 );
+          for ( int i = 0; i < 10; i++ )
+          {
+               ASSERT_EQ( queue.TryPush( i ), qm::State::Ok );
+          }
+          ASSERT_EQ( budget->Used(), 100 );
+          ASSERT_EQ( budget->Taken(), 100 );
+     }
+     ASSERT_EQ( budget->Used(), 0 );
+     ASSERT_EQ( budget->Taken(), 0 );
+}
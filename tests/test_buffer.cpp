@@ -0,0 +1,108 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <buffer/buffer.hpp>
+#include <queue/spsc_ring_queue.hpp>
+
+TEST(Buffer, copy_slice_share_storage)
+{
+     auto pool = qm::BufferPool::Create( 64 );
+     auto buffer = pool->Copy( "header:payload" );
+     ASSERT_EQ( buffer.View(), "header:payload" );
+     ASSERT_EQ( buffer.Size(), 14 );
+
+     auto payload = buffer.Slice( 7 );
+     auto header = buffer.Slice( 0, 6 );
+     ASSERT_EQ( payload.View(), "payload" );
+     ASSERT_EQ( header.View(), "header" );
+     ASSERT_EQ( payload.Data(), buffer.Data() + 7 );
+     ASSERT_TRUE( buffer.Slice( 100 ).Empty() );
+
+     // slice keeps storage alive after original buffer is gone
+     buffer = qm::Buffer();
+     ASSERT_TRUE( buffer.Empty() );
+     ASSERT_EQ( buffer.Data(), nullptr );
+     ASSERT_EQ( payload.View(), "payload" );
+     ASSERT_EQ( pool->Blocks(), 1 );
+
+     ASSERT_EQ( qm::ValueSize< qm::Buffer >()( payload ), sizeof( qm::Buffer ) + 7 );
+}
+
+TEST(Buffer, reuse_blocks)
+{
+     auto pool = qm::BufferPool::Create( 64 );
+     const char *data = nullptr;
+     {
+          auto buffer = pool->Allocate( 10 );
+          data = buffer.Data();
+     }
+
+     auto buffer = pool->Allocate( 20 );
+     ASSERT_EQ( buffer.Data(), data );
+     ASSERT_EQ( pool->Blocks(), 1 );
+
+     // oversized buffer is not pooled
+     auto big = pool->Allocate( 100 );
+     ASSERT_EQ( big.Size(), 100 );
+     ASSERT_EQ( pool->Blocks(), 2 );
+}
+
+TEST(Buffer, reuse_cache_of_exited_thread)
+{
+     auto pool = qm::BufferPool::Create( 64 );
+     for ( int i = 0; i < 10; ++i )
+     {
+          // each thread frees its block to own cache, next thread takes over the cache
+          std::thread thread( [ &pool ]() { pool->Copy( "message" ); } );
+          thread.join();
+     }
+
+     ASSERT_EQ( pool->Blocks(), 1 );
+}
+
+TEST(Buffer, return_to_origin_thread)
+{
+     auto pool = qm::BufferPool::Create( 64 );
+     qm::SpscRingQueue< qm::Buffer > queue( 16 );
+     const int rounds = 20;
+     const int per_round = 100;
+     std::size_t warm_blocks = 0;
+
+     for ( int round = 0; round < rounds; ++round )
+     {
+          std::thread consumer( [ &queue ]()
+          {
+               qm::Buffer buffer;
+               int received = 0;
+               while ( received < per_round )
+               {
+                    if ( queue.TryPop( buffer ))
+                    {
+                         ASSERT_EQ( buffer.View(), "message" );
+                         buffer = qm::Buffer();
+                         received++;
+                    }
+               }
+          } );
+
+          for ( int i = 0; i < per_round; ++i )
+          {
+               auto buffer = pool->Copy( "message" );
+               while ( queue.TryPush( std::move( buffer )) == qm::State::QueueFull )
+               {
+                    std::this_thread::yield();
+               }
+          }
+          consumer.join();
+
+          if ( round == 1 )
+          {
+               warm_blocks = pool->Blocks();
+          }
+     }
+
+     // blocks freed by consumers came back to producer's cache, flow needed no new blocks
+     ASSERT_LE( pool->Blocks(), warm_blocks );
+     ASSERT_LE( warm_blocks, static_cast< std::size_t >( 2 * per_round ));
+}
@@ -0,0 +1,263 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <manager/compact_mqueue_manager.hpp>
+#include <consumer/base_consumer.hpp>
+
+namespace
+{
+
+class SumConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int &value ) override
+     {
+          sum_ += value;
+          count_++;
+     }
+
+     std::atomic< long > sum_ = 0;
+     std::atomic< long > count_ = 0;
+};
+
+// checks that values of each key come in push order
+class OrderConsumer : public qm::IConsumer< std::pair< int, int > >
+{
+public:
+     void Consume( const std::pair< int, int > &value ) override
+     {
+          std::scoped_lock lock( mtx_ );
+          auto &last = last_[ value.first ];
+          ordered_ = ordered_ && value.second == last + 1;
+          last = value.second;
+     }
+
+     std::mutex mtx_;
+     std::unordered_map< int, int > last_;
+     bool ordered_ = true;
+};
+
+// blocks worker inside Consume until gate is opened
+class GateConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int & ) override
+     {
+          entered_ = true;
+          while ( !open_ )
+          {
+               std::this_thread::yield();
+          }
+     }
+
+     std::atomic< bool > entered_ = false;
+     std::atomic< bool > open_ = false;
+};
+
+} // namespace
+
+TEST(CompactQueueManager, enqueue_consume)
+{
+     qm::CompactQueueManager< int, int > manager( 2 );
+     auto consumer = std::make_shared< SumConsumer >();
+     for ( int id = 0; id < 1000; id++ )
+     {
+          ASSERT_EQ( manager.AddQueue( id, 10 ), qm::State::Ok );
+          ASSERT_EQ( manager.Subscribe( id, consumer ), qm::State::Ok );
+     }
+     ASSERT_EQ( manager.Queues(), 1000 );
+     ASSERT_EQ( manager.AllocatedQueues(), 0 );
+
+     for ( int id = 0; id < 1000; id++ )
+     {
+          ASSERT_EQ( manager.Enqueue( id, id ), qm::State::Ok );
+     }
+     manager.StopProcessing();
+     ASSERT_EQ( consumer->count_, 1000 );
+     ASSERT_EQ( consumer->sum_, 999 * 1000 / 2 );
+     ASSERT_TRUE( manager.AreAllQueuesEmpty() );
+     ASSERT_EQ( manager.Enqueue( 1, 1 ), qm::State::QueueDisabled );
+
+     manager.StartProcessing();
+     ASSERT_EQ( manager.Enqueue( 1, 1 ), qm::State::Ok );
+}
+
+TEST(CompactQueueManager, states)
+{
+     qm::CompactQueueManager< std::string, int > manager;
+     auto consumer = std::make_shared< SumConsumer >();
+     ASSERT_EQ( manager.Enqueue( "session", 1 ), qm::State::QueueAbsent );
+     ASSERT_EQ( manager.Subscribe( "session", consumer ), qm::State::QueueAbsent );
+     ASSERT_EQ( manager.AddQueue( "session", 2 ), qm::State::Ok );
+     ASSERT_EQ( manager.AddQueue( "session", 2 ), qm::State::QueueExists );
+     ASSERT_EQ( manager.Unsubscribe( "session" ), qm::State::QueueAbsent );
+
+     // without consumer values are kept until queue is full
+     ASSERT_EQ( manager.Enqueue( "session", 1 ), qm::State::Ok );
+     ASSERT_EQ( manager.Enqueue( "session", 2 ), qm::State::Ok );
+     ASSERT_EQ( manager.Enqueue( "session", 3 ), qm::State::QueueFull );
+     ASSERT_FALSE( manager.AreAllQueuesEmpty() );
+
+     ASSERT_EQ( manager.Subscribe( "session", consumer ), qm::State::Ok );
+     ASSERT_EQ( manager.Subscribe( "session", consumer ), qm::State::QueueBusy );
+     while ( !manager.AreAllQueuesEmpty() )
+     {
+          std::this_thread::yield();
+     }
+     ASSERT_EQ( manager.Unsubscribe( "session" ), qm::State::Ok );
+     ASSERT_EQ( consumer->sum_, 3 );
+
+     ASSERT_EQ( manager.RemoveQueue( "session" ), qm::State::Ok );
+     ASSERT_EQ( manager.RemoveQueue( "session" ), qm::State::QueueAbsent );
+     ASSERT_EQ( manager.Queues(), 0 );
+}
+
+TEST(CompactQueueManager, order_per_key)
+{
+     qm::CompactQueueManager< int, std::pair< int, int > > manager( 4 );
+     auto consumer = std::make_shared< OrderConsumer >();
+     for ( int id = 0; id < 8; id++ )
+     {
+          ASSERT_EQ( manager.AddQueue( id, 100000 ), qm::State::Ok );
+          ASSERT_EQ( manager.Subscribe( id, consumer ), qm::State::Ok );
+     }
+
+     std::vector< std::thread > producers;
+     for ( int id = 0; id < 8; id++ )
+     {
+          producers.emplace_back( [ &manager, id ]()
+                                  {
+                                       for ( int i = 1; i <= 10000; i++ )
+                                       {
+                                            manager.Enqueue( id, { id, i } );
+                                       }
+                                  } );
+     }
+     for ( auto &producer : producers )
+     {
+          producer.join();
+     }
+     manager.StopProcessing();
+
+     ASSERT_TRUE( consumer->ordered_ );
+     for ( int id = 0; id < 8; id++ )
+     {
+          ASSERT_EQ( consumer->last_[ id ], 10000 );
+     }
+}
+
+TEST(CompactQueueManager, compact_idle_storage)
+{
+     qm::CompactQueueManager< int, int > manager( 1, std::chrono::milliseconds( 0 ));
+     auto consumer = std::make_shared< SumConsumer >();
+     for ( int id = 0; id < 100; id++ )
+     {
+          ASSERT_EQ( manager.AddQueue( id, 10 ), qm::State::Ok );
+     }
+     for ( int id = 0; id < 10; id++ )
+     {
+          ASSERT_EQ( manager.Enqueue( id, 1 ), qm::State::Ok );
+     }
+     ASSERT_EQ( manager.AllocatedQueues(), 10 );
+
+     // queues with values are kept
+     ASSERT_EQ( manager.Compact(), 0 );
+     for ( int id = 0; id < 10; id++ )
+     {
+          ASSERT_EQ( manager.Subscribe( id, consumer ), qm::State::Ok );
+     }
+     manager.StopProcessing();
+     ASSERT_EQ( consumer->sum_, 10 );
+
+     // storage is freed after it stays empty for one whole round
+     ASSERT_EQ( manager.Compact(), 0 );
+     ASSERT_EQ( manager.AllocatedQueues(), 10 );
+     ASSERT_EQ( manager.Compact(), 10 );
+     ASSERT_EQ( manager.AllocatedQueues(), 0 );
+}
+
+TEST(CompactQueueManager, remove_allocated_queues)
+{
+     qm::CompactQueueManager< int, int > manager( 1, std::chrono::milliseconds( 0 ), 1 );
+     for ( int id = 0; id < 10; id++ )
+     {
+          ASSERT_EQ( manager.AddQueue( id, 10 ), qm::State::Ok );
+          ASSERT_EQ( manager.Enqueue( id, id ), qm::State::Ok );
+     }
+     ASSERT_EQ( manager.AllocatedQueues(), 10 );
+
+     // removed keys leave allocated list, remaining ones keep their values
+     for ( int id = 0; id < 10; id += 3 )
+     {
+          ASSERT_EQ( manager.RemoveQueue( id ), qm::State::Ok );
+     }
+     ASSERT_EQ( manager.AllocatedQueues(), 6 );
+     ASSERT_EQ( manager.Compact(), 0 );
+
+     auto consumer = std::make_shared< SumConsumer >();
+     for ( int id : { 1, 2, 4, 5, 7, 8 } )
+     {
+          ASSERT_EQ( manager.Subscribe( id, consumer ), qm::State::Ok );
+     }
+     manager.StopProcessing();
+     ASSERT_EQ( consumer->sum_, 27 );
+
+     ASSERT_EQ( manager.Compact(), 0 );
+     ASSERT_EQ( manager.Compact(), 6 );
+     ASSERT_EQ( manager.AllocatedQueues(), 0 );
+}
+
+TEST(CompactQueueManager, automatic_compaction)
+{
+     qm::CompactQueueManager< int, int > manager( 1, std::chrono::milliseconds( 5 ));
+     auto consumer = std::make_shared< SumConsumer >();
+     ASSERT_EQ( manager.AddQueue( 1, 10 ), qm::State::Ok );
+     ASSERT_EQ( manager.Subscribe( 1, consumer ), qm::State::Ok );
+     ASSERT_EQ( manager.Enqueue( 1, 1 ), qm::State::Ok );
+
+     auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 5 );
+     while ( manager.AllocatedQueues() != 0 && std::chrono::steady_clock::now() < deadline )
+     {
+          std::this_thread::sleep_for( std::chrono::milliseconds( 1 ));
+     }
+     ASSERT_EQ( manager.AllocatedQueues(), 0 );
+     ASSERT_EQ( consumer->sum_, 1 );
+}
+
+TEST(CompactQueueManager, remove_while_draining)
+{
+     qm::CompactQueueManager< int, int > manager( 1, std::chrono::milliseconds( 1000 ), 1 );
+     auto consumer = std::make_shared< GateConsumer >();
+     ASSERT_EQ( manager.AddQueue( 0, 10 ), qm::State::Ok );
+     ASSERT_EQ( manager.Subscribe( 0, consumer ), qm::State::Ok );
+     ASSERT_EQ( manager.Enqueue( 0, 1 ), qm::State::Ok );
+     while ( !consumer->entered_ )
+     {
+          std::this_thread::yield();
+     }
+
+     // both wait for worker, meanwhile shard map is rehashed and one of them removes the entry
+     std::atomic< qm::State > unsubscribed = qm::State::Ok;
+     std::atomic< qm::State > removed = qm::State::Ok;
+     std::thread unsubscriber( [ & ]() { unsubscribed = manager.Unsubscribe( 0 ); } );
+     std::thread remover( [ & ]() { removed = manager.RemoveQueue( 0 ); } );
+     std::this_thread::sleep_for( std::chrono::milliseconds( 20 ));
+     for ( int id = 1; id < 1000; id++ )
+     {
+          ASSERT_EQ( manager.AddQueue( id, 10 ), qm::State::Ok );
+     }
+     consumer->open_ = true;
+     unsubscriber.join();
+     remover.join();
+
+     ASSERT_EQ( removed, qm::State::Ok );
+     ASSERT_TRUE( unsubscribed == qm::State::Ok || unsubscribed == qm::State::QueueAbsent );
+     ASSERT_EQ( manager.Queues(), 999 );
+}
@@ -0,0 +1,106 @@
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <manager/epoch_domain.hpp>
+
+struct Tracked
+{
+     explicit Tracked( std::atomic< int > &deleted ) : deleted_( deleted ) {}
+     ~Tracked() { deleted_++; }
+
+     std::atomic< int > &deleted_;
+};
+
+TEST(EpochDomain, retire_without_readers)
+{
+     std::atomic< int > deleted = 0;
+     qm::EpochDomain domain;
+
+     domain.Retire( new Tracked( deleted ));
+     ASSERT_EQ( deleted, 1 );
+     ASSERT_EQ( domain.Pending(), 0 );
+}
+
+TEST(EpochDomain, retire_with_pinned_reader)
+{
+     std::atomic< int > deleted = 0;
+     qm::EpochDomain domain( 4 );
+     {
+          auto guard = domain.Pin();
+          domain.Retire( new Tracked( deleted ));
+          ASSERT_EQ( deleted, 0 );
+          ASSERT_EQ( domain.Pending(), 1 );
+
+          // readers pinned after retirement don't hold the object
+          std::thread reader( [ &domain ]() { auto late = domain.Pin(); } );
+          reader.join();
+          ASSERT_EQ( domain.Collect(), 0 );
+     }
+
+     ASSERT_EQ( domain.Collect(), 1 );
+     ASSERT_EQ( deleted, 1 );
+
+     {
+          auto guard = domain.Pin();
+          auto moved = std::move( guard );
+          domain.Retire( new Tracked( deleted ));
+          ASSERT_EQ( deleted, 1 );
+     }
+
+     domain.Collect();
+     ASSERT_EQ( deleted, 2 );
+}
+
+TEST(EpochDomain, destructor_deletes_retired)
+{
+     std::atomic< int > deleted = 0;
+     {
+          qm::EpochDomain domain;
+          auto guard = domain.Pin();
+          domain.Retire( new Tracked( deleted ));
+          domain.Retire( new Tracked( deleted ));
+          ASSERT_EQ( deleted, 0 );
+     }
+
+     ASSERT_EQ( deleted, 2 );
+}
+
+TEST(EpochDomain, concurrent_readers)
+{
+     std::atomic< int > deleted = 0;
+     std::atomic< bool > stop = false;
+     qm::EpochDomain domain( 2 );
+     std::atomic< std::vector< int > * > shared = new std::vector< int >( 100, 1 );
+
+     std::vector< std::thread > readers;
+     for ( int i = 0; i < 4; i++ )
+     {
+          readers.emplace_back( [ & ]()
+          {
+               while ( !stop )
+               {
+                    auto guard = domain.Pin();
+                    auto *values = shared.load();
+                    ASSERT_EQ( values->front() + values->back(), 2 );
+               }
+          } );
+     }
+
+     for ( int i = 0; i < 1000; i++ )
+     {
+          domain.Retire( shared.exchange( new std::vector< int >( 100, 1 )));
+          if ( i % 100 == 0 ) std::this_thread::yield();
+     }
+
+     stop = true;
+     for ( auto &reader : readers )
+     {
+          reader.join();
+     }
+
+     domain.Collect();
+     ASSERT_EQ( domain.Pending(), 0 );
+     delete shared.load();
+}
@@ -0,0 +1,178 @@
+#include <future>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <manager/mpsc_mqueue_manager.hpp>
+#include <queue/hand_off_queue.hpp>
+
+class OrderTestConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int &value ) override
+     {
+          values_.push_back( value );
+          threads_.insert( std::this_thread::get_id() );
+     };
+
+     std::vector< int > values_;
+     std::set< std::thread::id > threads_;
+};
+
+TEST(HandOffQueue, push_pop_without_consumer)
+{
+     qm::HandOffQueue<int> queue( 2 );
+     ASSERT_TRUE( queue.Empty() );
+
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 3 ), qm::State::QueueFull );
+     ASSERT_EQ( queue.Size(), 2 );
+
+     ASSERT_EQ( queue.Pop().value(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 2 );
+     ASSERT_EQ( queue.HandedOff(), 0 );
+
+     auto pop_future = std::async( std::launch::async, [&queue] ()
+     {
+          auto value = queue.Pop();
+          ASSERT_FALSE( value.has_value() );
+     });
+
+     queue.Stop();
+     ASSERT_FALSE( queue.Enabled() );
+     ASSERT_EQ( queue.Push( 1 ), qm::State::QueueDisabled );
+}
+
+TEST(HandOffQueue, hand_off_to_idle_consumer)
+{
+     qm::HandOffQueue<int> queue( 10 );
+     auto consumer = std::make_shared< OrderTestConsumer >();
+     queue.AttachConsumer( consumer );
+
+     // consumer doesn't allow inline calls
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Size(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 1 );
+
+     // consumer thread is busy with popped value until next Pop
+     consumer->Inline( true );
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.Size(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 2 );
+
+     // new subscription makes consumer idle, queue is empty, so value is consumed on this thread
+     queue.AttachConsumer( consumer );
+     ASSERT_EQ( queue.Push( 3 ), qm::State::Ok );
+     ASSERT_EQ( queue.HandedOff(), 1 );
+     ASSERT_TRUE( queue.Empty() );
+     ASSERT_EQ( consumer->values_, std::vector< int >( { 3 } ) );
+     ASSERT_EQ( consumer->threads_.count( std::this_thread::get_id() ), 1 );
+
+     queue.DetachConsumer();
+     ASSERT_EQ( queue.Push( 4 ), qm::State::Ok );
+     ASSERT_EQ( queue.Pop().value(), 4 );
+     ASSERT_EQ( queue.HandedOff(), 1 );
+}
+
+class ThrowingConsumer : public qm::IConsumer< std::string >
+{
+public:
+     void Consume( const std::string &value ) override
+     {
+          copied_.push_back( value );
+     }
+
+     void ConsumeMoved( std::string &&value ) override
+     {
+          if ( value == "throw" )
+          {
+               throw std::runtime_error( value );
+          }
+          moved_.push_back( std::move( value ));
+     }
+
+     std::vector< std::string > copied_;
+     std::vector< std::string > moved_;
+};
+
+TEST(HandOffQueue, hand_off_moves_value_and_survives_exception)
+{
+     qm::HandOffQueue< std::string > queue( 10 );
+     auto consumer = std::make_shared< ThrowingConsumer >();
+     consumer->Inline( true );
+     queue.AttachConsumer( consumer );
+
+     // rvalue reaches ConsumeMoved, lvalue is copied
+     const std::string lvalue = "3";
+     ASSERT_EQ( queue.Push( std::string( "1" )), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( std::string( "2" )), qm::State::Ok );
+     ASSERT_EQ( queue.Push( lvalue ), qm::State::Ok );
+     ASSERT_EQ( queue.HandedOff(), 3 );
+     ASSERT_EQ( consumer->moved_, std::vector< std::string >( { "1", "2" } ));
+     ASSERT_EQ( consumer->copied_, std::vector< std::string >( { "3" } ));
+
+     // consumer is released after exception, so queue keeps working
+     ASSERT_THROW( queue.Push( std::string( "throw" )), std::runtime_error );
+     ASSERT_TRUE( queue.Empty() );
+     ASSERT_EQ( queue.Push( std::string( "4" )), qm::State::Ok );
+     ASSERT_EQ( queue.HandedOff(), 4 );
+
+     queue.DetachConsumer();
+     ASSERT_EQ( queue.Push( std::string( "5" )), qm::State::Ok );
+     ASSERT_EQ( queue.Pop().value(), "5" );
+}
+
+TEST(HandOffQueue, reserve_commit)
+{
+     qm::HandOffQueue< int > queue( 10 );
+     auto consumer = std::make_shared< OrderTestConsumer >();
+     consumer->Inline( true );
+     queue.AttachConsumer( consumer );
+
+     // value in reserved slot is never handed off, later values don't overtake it
+     auto slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     *slot = 1;
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.HandedOff(), 0 );
+     ASSERT_EQ( queue.Size(), 1 );
+
+     ASSERT_EQ( queue.Commit(), qm::State::Ok );
+     ASSERT_EQ( queue.Size(), 2 );
+     ASSERT_EQ( queue.Pop().value(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 2 );
+}
+
+TEST(HandOffQueue, manager_keeps_order)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::string, int > >();
+     auto queue = std::make_shared< qm::HandOffQueue< int > >( 10 );
+     ASSERT_EQ( manager->AddQueue( "queue1", queue ), qm::State::Ok );
+
+     auto consumer = std::make_shared< OrderTestConsumer >();
+     consumer->Inline( true );
+     ASSERT_EQ( manager->Subscribe( "queue1", consumer ), qm::State::Ok );
+
+     const int values_count = 10000;
+     std::vector< int > expected;
+     for ( int i = 0; i < values_count; ++i )
+     {
+          while ( manager->Enqueue( "queue1", i ) != qm::State::Ok )
+          {
+               std::this_thread::yield();
+          }
+          expected.push_back( i );
+     }
+
+     while ( !manager->AreAllQueuesEmpty() )
+     {
+          std::this_thread::yield();
+     }
+
+     manager->StopProcessing();
+     ASSERT_EQ( consumer->values_, expected );
+}
@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <buffer/huge_page_resource.hpp>
+#include <manager/mpsc_mqueue_manager.hpp>
+#include <queue/spsc_ring_queue.hpp>
+
+namespace
+{
+
+std::size_t ResidentPages( void *address, std::size_t size )
+{
+     const auto page = static_cast< std::size_t >( sysconf( _SC_PAGESIZE ));
+     std::vector< unsigned char > pages( ( size + page - 1 ) / page );
+     if ( mincore( address, size, pages.data() ) != 0 )
+     {
+          return 0;
+     }
+
+     std::size_t resident = 0;
+     for ( auto p : pages )
+     {
+          resident += p & 1;
+     }
+     return resident;
+}
+
+} // namespace
+
+TEST(HugePageResource, allocate_from_chunks)
+{
+     qm::HugePageResource resource;
+     ASSERT_EQ( resource.Chunks(), 0 );
+
+     auto a = resource.allocate( 100, 8 );
+     auto b = resource.allocate( 1000, 64 );
+     ASSERT_EQ( resource.Chunks(), 1 );
+     ASSERT_EQ( reinterpret_cast< std::uintptr_t >( a ) % qm::HugePageResource::HugePageSize, 0 );
+     ASSERT_EQ( reinterpret_cast< std::uintptr_t >( b ) % 64, 0 );
+     ASSERT_GE( static_cast< char * >( b ), static_cast< char * >( a ) + 100 );
+
+     // big allocation gets own chunk, small ones continue in the first chunk
+     auto big = resource.allocate( 3 * qm::HugePageResource::HugePageSize, 64 );
+     ASSERT_EQ( resource.Chunks(), 2 );
+     auto c = resource.allocate( 8, 8 );
+     ASSERT_EQ( resource.Chunks(), 2 );
+     ASSERT_GT( static_cast< char * >( c ), static_cast< char * >( b ));
+     ASSERT_LT( static_cast< char * >( c ), static_cast< char * >( a ) + qm::HugePageResource::HugePageSize );
+     ASSERT_LE( resource.HugeChunks(), resource.Chunks() );
+
+     // chunks are faulted in on mapping
+     ASSERT_EQ( ResidentPages( big, 3 * qm::HugePageResource::HugePageSize ),
+                3 * qm::HugePageResource::HugePageSize / static_cast< std::size_t >( sysconf( _SC_PAGESIZE )));
+     resource.deallocate( big, 3 * qm::HugePageResource::HugePageSize, 64 );
+}
+
+TEST(HugePageResource, prefault_pages)
+{
+     const std::size_t size = 64 * static_cast< std::size_t >( sysconf( _SC_PAGESIZE ));
+     auto p = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+     ASSERT_NE( p, MAP_FAILED );
+     ASSERT_EQ( ResidentPages( p, size ), 0 );
+
+     static_cast< char * >( p )[ 100 ] = 42;
+     if ( qm::PrefaultPages( static_cast< char * >( p ) + 100, size - 100 ))
+     {
+          ASSERT_EQ( ResidentPages( p, size ), 64 );
+          ASSERT_EQ( static_cast< char * >( p )[ 100 ], 42 );
+     }
+     munmap( p, size );
+}
+
+TEST(HugePageResource, queue_storage)
+{
+     qm::HugePageResource huge_pages( false );
+     std::pmr::synchronized_pool_resource pool( &huge_pages );
+     auto manager = std::make_shared< qm::MPSCQueueManager< int, int > >();
+
+     std::vector< std::shared_ptr< qm::SpscRingQueue< int > > > queues;
+     for ( int id = 0; id < 100; id++ )
+     {
+          queues.push_back( std::make_shared< qm::SpscRingQueue< int > >( 1000, &pool ));
+          ASSERT_EQ( manager->AddQueue( id, queues.back() ), qm::State::Ok );
+     }
+     ASSERT_GE( huge_pages.Chunks(), 1 );
+
+     for ( int id = 0; id < 100; id++ )
+     {
+          ASSERT_EQ( manager->Enqueue( id, id ), qm::State::Ok );
+     }
+     for ( int id = 0; id < 100; id++ )
+     {
+          ASSERT_EQ( queues[ id ]->Pop().value(), id );
+     }
+}
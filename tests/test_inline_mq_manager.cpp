@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <manager/inline_mqueue_manager.hpp>
+#include <queue/block_concurrent_queue.hpp>
+#include <queue/inline_queue.hpp>
+#include <consumer/base_consumer.hpp>
+#include <producer/base_producer.hpp>
+
+class InlineSumConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int &value ) override
+     {
+          sum_ += value;
+     };
+
+     int sum_ = 0;
+};
+
+/// @brief Produce values from 1 to n on caller's thread
+class InlineSequenceProducer : public qm::IProducer< std::string, int >
+{
+public:
+     InlineSequenceProducer( const std::string &id, int n ) : IProducer< std::string, int >( id ), n_( n )
+     {};
+
+     void WaitThreadDone() override
+     {}
+
+     void Produce() override
+     {
+          for ( int i = 1; i < n_ + 1 && enabled_.load(); ++i )
+          {
+               queue_->Push( i );
+          }
+          done_ = true;
+     }
+
+private:
+     int n_;
+};
+
+class TestInline : public ::testing::Test
+{
+protected:
+     void SetUp() override
+     {
+          manager = std::make_shared< qm::InlineQueueManager< std::string, int > >();
+     }
+
+     std::shared_ptr< qm::InlineQueueManager< std::string, int > > manager;
+};
+
+TEST_F(TestInline, enqueue_consumes_synchronously)
+{
+     auto queue = std::make_shared< qm::InlineQueue< int > >( 10 );
+     ASSERT_EQ( manager->AddQueue( "queue1", queue ), qm::State::Ok );
+     ASSERT_EQ( manager->Enqueue( "queue1", 1 ), qm::State::Ok );
+
+     auto consumer = std::make_shared< InlineSumConsumer >();
+     ASSERT_EQ( manager->Subscribe( "queue1", consumer ), qm::State::Ok );
+     ASSERT_EQ( manager->Subscribe( "queue1", consumer ), qm::State::QueueBusy );
+     ASSERT_EQ( consumer->sum_, 1 );
+
+     ASSERT_EQ( manager->Enqueue( "queue1", 2 ), qm::State::Ok );
+     ASSERT_EQ( consumer->sum_, 3 );
+     ASSERT_EQ( manager->Enqueue( "queue2", 2 ), qm::State::QueueAbsent );
+
+     ASSERT_EQ( manager->Unsubscribe( "queue1" ), qm::State::Ok );
+     ASSERT_EQ( manager->Enqueue( "queue1", 3 ), qm::State::Ok );
+     ASSERT_EQ( consumer->sum_, 3 );
+     ASSERT_FALSE( manager->AreAllQueuesEmpty() );
+}
+
+TEST_F(TestInline, batch_and_flush)
+{
+     auto inline_queue = std::make_shared< qm::InlineQueue< int > >( 10, 2 );
+     auto blocking_queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 10 );
+     manager->AddQueue( "queue1", inline_queue );
+     manager->AddQueue( "queue2", blocking_queue );
+
+     auto consumer1 = std::make_shared< InlineSumConsumer >();
+     auto consumer2 = std::make_shared< InlineSumConsumer >();
+     manager->Subscribe( "queue1", consumer1 );
+     manager->Subscribe( "queue2", consumer2 );
+
+     manager->Enqueue( "queue1", 1 );
+     manager->Enqueue( "queue2", 1 );
+     ASSERT_EQ( consumer1->sum_, 0 );
+     ASSERT_EQ( consumer2->sum_, 0 );
+
+     manager->Enqueue( "queue1", 2 );
+     ASSERT_EQ( consumer1->sum_, 3 );
+
+     manager->Enqueue( "queue1", 3 );
+     ASSERT_EQ( manager->Flush(), 2 );
+     ASSERT_EQ( consumer1->sum_, 6 );
+     ASSERT_EQ( consumer2->sum_, 1 );
+     ASSERT_TRUE( manager->AreAllQueuesEmpty() );
+}
+
+TEST_F(TestInline, register_producer)
+{
+     auto queue = std::make_shared< qm::InlineQueue< int > >( 10 );
+     manager->AddQueue( "queue1", queue );
+
+     auto consumer = std::make_shared< InlineSumConsumer >();
+     manager->Subscribe( "queue1", consumer );
+
+     auto producer1 = std::make_shared< InlineSequenceProducer >( "queue1", 100 );
+     auto producer2 = std::make_shared< InlineSequenceProducer >( "queue1", 100 );
+     ASSERT_EQ( manager->RegisterProducer( "queue1", producer1 ), qm::State::Ok );
+     ASSERT_EQ( manager->RegisterProducer( "queue1", producer2 ), qm::State::Ok );
+
+     producer1->Produce();
+     producer2->Produce();
+     ASSERT_TRUE( manager->AreAllProducersDone() );
+     ASSERT_EQ( consumer->sum_, 2 * 5050 );
+
+     manager->StopProcessing();
+     ASSERT_EQ( manager->Enqueue( "queue1", 1 ), qm::State::QueueDisabled );
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <queue/inline_queue.hpp>
+
+class InlineTestConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int &value ) override
+     {
+          values_.push_back( value );
+     };
+
+     std::vector< int > values_;
+};
+
+TEST(InlineQueue, push_pop_without_consumer)
+{
+     qm::InlineQueue<int> queue( 2 );
+     ASSERT_TRUE( queue.Empty() );
+
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 3 ), qm::State::QueueFull );
+     ASSERT_EQ( queue.Size(), 2 );
+
+     ASSERT_EQ( queue.Pop().value(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 2 );
+     ASSERT_FALSE( queue.Pop().has_value() );
+
+     queue.Stop();
+     ASSERT_EQ( queue.Push( 1 ), qm::State::QueueDisabled );
+}
+
+TEST(InlineQueue, consume_on_push)
+{
+     qm::InlineQueue<int> queue( 10 );
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+
+     auto consumer = std::make_shared< InlineTestConsumer >();
+     queue.AttachConsumer( consumer );
+     ASSERT_EQ( consumer->values_, std::vector< int >( { 1 } ) );
+
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( consumer->values_, std::vector< int >( { 1, 2 } ) );
+     ASSERT_TRUE( queue.Empty() );
+
+     consumer->Enabled( false );
+     ASSERT_EQ( queue.Push( 3 ), qm::State::Ok );
+     ASSERT_EQ( queue.Size(), 1 );
+
+     consumer->Enabled( true );
+     ASSERT_EQ( queue.Flush(), 1 );
+     ASSERT_EQ( consumer->values_, std::vector< int >( { 1, 2, 3 } ) );
+}
+
+TEST(InlineQueue, batch_deferral)
+{
+     qm::InlineQueue<int> queue( 10, 3 );
+     auto consumer = std::make_shared< InlineTestConsumer >();
+     queue.AttachConsumer( consumer );
+
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+     ASSERT_TRUE( consumer->values_.empty() );
+
+     ASSERT_EQ( queue.Push( 3 ), qm::State::Ok );
+     ASSERT_EQ( consumer->values_, std::vector< int >( { 1, 2, 3 } ) );
+
+     ASSERT_EQ( queue.Push( 4 ), qm::State::Ok );
+     ASSERT_EQ( queue.Flush(), 1 );
+     ASSERT_EQ( consumer->values_, std::vector< int >( { 1, 2, 3, 4 } ) );
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(InlineQueue, batch_over_size)
+{
+     // batch is reduced to size, so full queue doesn't refuse pushes while consumer is ready
+     qm::InlineQueue<int> queue( 2, 5 );
+     auto consumer = std::make_shared< InlineTestConsumer >();
+     queue.AttachConsumer( consumer );
+     for ( int i = 1; i <= 4; i++ )
+     {
+          ASSERT_EQ( queue.Push( i ), qm::State::Ok );
+     }
+     ASSERT_EQ( consumer->values_, std::vector< int >( { 1, 2, 3, 4 } ) );
+
+     // queue shrunk below batch is flushed when full
+     qm::InlineQueue<int> shrunk( 10, 5 );
+     shrunk.AttachConsumer( consumer );
+     ASSERT_EQ( shrunk.Resize( 2 ), qm::State::Ok );
+     for ( int i = 5; i <= 7; i++ )
+     {
+          ASSERT_EQ( shrunk.Push( i ), qm::State::Ok );
+     }
+     ASSERT_EQ( consumer->values_, std::vector< int >( { 1, 2, 3, 4, 5, 6 } ) );
+     ASSERT_EQ( shrunk.Size(), 1 );
+
+     // without consumer full queue refuses values
+     shrunk.DetachConsumer();
+     ASSERT_EQ( shrunk.Push( 8 ), qm::State::Ok );
+     ASSERT_EQ( shrunk.Push( 9 ), qm::State::QueueFull );
+}
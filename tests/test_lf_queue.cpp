@@ -89,4 +89,67 @@ TEST(LockFreeQueue, enable_disable_queue)
      ASSERT_FALSE( queue.Enabled() );
      state = queue.Push( 5 );
      ASSERT_EQ( state, qm::State::QueueDisabled );
-}
\ No newline at end of file
+}
+TEST(LockFreeQueue, fixed_capacity)
+{
+     qm::LockFreeQueue< int, 3 > queue;
+     ASSERT_EQ( queue.MaxSize(), 3 );
+     ASSERT_TRUE( queue.Empty() );
+
+     for ( int value = 1; value <= 3; value++ )
+     {
+          ASSERT_EQ( queue.Push( value ), qm::State::Ok );
+     }
+     ASSERT_EQ( queue.TryPush( 4 ), qm::State::QueueFull );
+
+     int value = 0;
+     ASSERT_TRUE( queue.TryPop( value ));
+     ASSERT_EQ( value, 1 );
+     ASSERT_EQ( queue.Pop(), 2 );
+     ASSERT_EQ( queue.TryPush( 4 ), qm::State::Ok );
+     ASSERT_EQ( queue.Pop(), 3 );
+     ASSERT_EQ( queue.Pop(), 4 );
+     ASSERT_TRUE( queue.Empty() );
+
+     queue.Stop();
+     ASSERT_EQ( queue.Push( 5 ), qm::State::QueueDisabled );
+}
+
+TEST(LockFreeQueue, resize)
+{
+     qm::LockFreeQueue< int > queue( 2 );
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 3 ), qm::State::QueueFull );
+
+     ASSERT_EQ( queue.Resize( 4 ), qm::State::Ok );
+     ASSERT_EQ( queue.MaxSize(), 4 );
+     ASSERT_EQ( queue.TryPush( 3 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 4 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 5 ), qm::State::QueueFull );
+
+     // node pool can't shrink
+     ASSERT_EQ( queue.Resize( 2 ), qm::State::QueueBusy );
+     ASSERT_EQ( queue.MaxSize(), 4 );
+
+     for ( int value = 1; value <= 4; value++ )
+     {
+          ASSERT_EQ( queue.Pop(), value );
+     }
+
+     qm::LockFreeQueue< int, 3 > fixed;
+     ASSERT_EQ( fixed.Resize( 10 ), qm::State::QueueBusy );
+     ASSERT_EQ( fixed.MaxSize(), 3 );
+}
+
+TEST(LockFreeQueue, auto_grow)
+{
+     qm::LockFreeQueue< int > queue( 1 );
+     queue.AutoGrow( 64, 1 );
+     for ( int value = 0; value < 64; value++ )
+     {
+          ASSERT_EQ( queue.TryPush( value ), qm::State::Ok );
+     }
+     ASSERT_EQ( queue.MaxSize(), 64 );
+     ASSERT_EQ( queue.TryPush( 64 ), qm::State::QueueFull );
+}
@@ -1,10 +1,13 @@
 #include <future>
+#include <memory_resource>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include <manager/mpsc_mqueue_manager.hpp>
 #include <queue/block_concurrent_queue.hpp>
 #include <queue/lock_free_queue.hpp>
+#include <queue/multi_lane_queue.hpp>
 #include <consumer/base_consumer.hpp>
 #include <producer/base_producer.hpp>
 
@@ -152,6 +155,77 @@ TEST_F(TestMpsc, remove_queue)
      ASSERT_TRUE( manager->AreAllQueuesEmpty() );
 }
 
+TEST_F(TestMpsc, resize_queue)
+{
+     auto queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 1 );
+     ASSERT_EQ( manager->AddQueue( "queue1", queue ), qm::State::Ok );
+     ASSERT_EQ( manager->Enqueue( "queue1", 1 ), qm::State::Ok );
+
+     ASSERT_EQ( manager->Resize( "queue1", 10 ), qm::State::Ok );
+     ASSERT_EQ( queue->MaxSize(), 10 );
+     ASSERT_EQ( manager->Enqueue( "queue1", 2 ), qm::State::Ok );
+     ASSERT_EQ( queue->Size(), 2 );
+
+     ASSERT_EQ( manager->Resize( "queue2", 10 ), qm::State::QueueAbsent );
+
+     auto lock_free = std::make_shared< qm::LockFreeQueue< int > >( 10 );
+     ASSERT_EQ( manager->AddQueue( "queue2", lock_free ), qm::State::Ok );
+     ASSERT_EQ( manager->Resize( "queue2", 5 ), qm::State::QueueBusy );
+}
+
+TEST_F(TestMpsc, borrow_queue)
+{
+     auto queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 100 );
+     ASSERT_EQ( manager->AddQueue( "queue1", queue ), qm::State::Ok );
+
+     auto owners = queue.use_count();
+     auto result = manager->BorrowQueue( "queue1" );
+     ASSERT_EQ( result.s_, qm::State::Ok );
+     ASSERT_EQ( result.queue_.Get(), queue.get() );
+     ASSERT_EQ( queue.use_count(), owners + 1 );
+
+     ASSERT_EQ( result.queue_->Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue->Pop().value(), 1 );
+
+     result = manager->BorrowQueue( "queue2" );
+     ASSERT_EQ( result.s_, qm::State::QueueAbsent );
+     ASSERT_FALSE( result.queue_ );
+}
+
+TEST_F(TestMpsc, borrowed_queue_outlives_remove)
+{
+     std::weak_ptr< qm::BlockConcurrentQueue< int > > weak;
+     {
+          auto queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 100 );
+          weak = queue;
+          ASSERT_EQ( manager->AddQueue( "queue1", queue ), qm::State::Ok );
+     }
+
+     auto result = manager->BorrowQueue( "queue1" );
+     ASSERT_EQ( manager->RemoveQueue( "queue1" ), qm::State::Ok );
+     ASSERT_FALSE( weak.expired() );
+     ASSERT_EQ( result.queue_->Push( 1 ), qm::State::QueueDisabled );
+
+     // queue is reclaimed after handle is released
+     result.queue_ = qm::QueueRef< int >();
+     ASSERT_TRUE( weak.expired() );
+}
+
+TEST_F(TestMpsc, borrowed_queues_dont_block_enqueue)
+{
+     ASSERT_EQ( manager->AddQueue( "queue1", std::make_shared< qm::BlockConcurrentQueue< int > >( 1000 )), qm::State::Ok );
+
+     // handles don't take slots of manager epoch domain used by Enqueue
+     std::vector< qm::QueueRef< int > > handles;
+     for ( int i = 0; i < 1000; i++ )
+     {
+          handles.push_back( manager->BorrowQueue( "queue1" ).queue_ );
+     }
+     ASSERT_EQ( manager->Enqueue( "queue1", 5 ), qm::State::Ok );
+     ASSERT_EQ( manager->RemoveQueue( "queue1" ), qm::State::Ok );
+     ASSERT_EQ( handles.back()->Push( 1 ), qm::State::QueueDisabled );
+}
+
 TEST_F(TestMpsc, enqueue)
 {
      auto queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 100 );
@@ -272,6 +346,66 @@ TEST_F(TestMpsc, register_unregister)
      ASSERT_EQ( consumer->Result(), Accumulate( producer->Produced() ) );
 }
 
+/// @brief Producer blocked outside of queue until released
+class SlowProducer : public qm::IProducer< std::string, int >
+{
+public:
+     explicit SlowProducer( const std::string &id ) : IProducer< std::string, int >( id ) {}
+
+     ~SlowProducer() override
+     {
+          WaitThreadDone();
+     }
+
+     void Produce() override
+     {
+          thread_ = std::thread( [ this ]()
+          {
+               release_.get_future().wait();
+               state_ = queue_->Push( 1 );
+               done_ = true;
+          } );
+     }
+
+     void WaitThreadDone() override
+     {
+          if ( thread_.joinable() ) thread_.join();
+     }
+
+     std::promise< void > release_;
+     qm::State state_ = qm::State::Ok;
+
+private:
+     std::thread thread_;
+};
+
+TEST_F(TestMpsc, remove_queue_with_running_producer)
+{
+     auto queue = std::make_shared< qm::MultiLaneQueue< int > >( 100 );
+     ASSERT_EQ( manager->AddQueue( "queue1", queue ), qm::State::Ok );
+     ASSERT_EQ( manager->Subscribe( "queue1", std::make_shared< QueueTestConsumer >() ), qm::State::Ok );
+
+     auto producer = std::make_shared< SlowProducer >( "queue1" );
+     ASSERT_EQ( manager->RegisterProducer( "queue1", producer ), qm::State::Ok );
+     producer->Produce();
+
+     // producer's thread is still running, removal doesn't wait for it and keeps its lane attached
+     ASSERT_EQ( manager->RemoveQueue( "queue1" ), qm::State::Ok );
+     ASSERT_FALSE( producer->Enabled() );
+     ASSERT_FALSE( producer->Done() );
+     ASSERT_EQ( queue->Lanes(), 1 );
+     ASSERT_EQ( manager->Enqueue( "queue1", 1 ), qm::State::QueueAbsent );
+
+     producer->release_.set_value();
+     producer->WaitThreadDone();
+     ASSERT_EQ( producer->state_, qm::State::QueueDisabled );
+
+     // done producer is detached by next registration
+     ASSERT_EQ( manager->AddQueue( "queue2", std::make_shared< qm::MultiLaneQueue< int > >( 100 )), qm::State::Ok );
+     ASSERT_EQ( manager->RegisterProducer( "queue2", std::make_shared< SlowProducer >( "queue2" )), qm::State::Ok );
+     ASSERT_EQ( queue->Lanes(), 0 );
+}
+
 TEST_F(TestMpsc, register_subscribe_unsibscribe)
 {
      auto queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 100 );
@@ -299,4 +433,181 @@ TEST_F(TestMpsc, register_subscribe_unsibscribe)
 
      manager->StopProcessing();
      ASSERT_EQ( consumer->Result() + consumer2->Result(), Accumulate( producer->Produced() ) );
-}
\ No newline at end of file
+}
+
+TEST_F(TestMpsc, register_producers_multi_lane)
+{
+     auto queue = std::make_shared< qm::MultiLaneQueue< int > >( 100 );
+     auto state = manager->AddQueue( "queue1", queue );
+
+     auto consumer = std::make_shared<QueueTestConsumer>();
+     state = manager->Subscribe( "queue1", consumer );
+     ASSERT_EQ( state, qm::State::Ok );
+
+     const int values_count = 1000;
+     std::vector< std::shared_ptr< SequenceValuesProducer > > producers;
+     for ( int i = 0; i < 4; ++i )
+     {
+          auto producer = std::make_shared<SequenceValuesProducer>( "queue1", values_count );
+          state = manager->RegisterProducer( "queue1", producer );
+          ASSERT_EQ( state, qm::State::Ok );
+          producers.push_back( producer );
+     }
+     ASSERT_EQ( queue->Lanes(), producers.size() );
+
+     for ( auto &producer : producers )
+     {
+          producer->Produce();
+     }
+
+     state = manager->UnregisterProducer( "queue1", producers.front() );
+     ASSERT_EQ( state, qm::State::Ok );
+     ASSERT_EQ( queue->Lanes(), producers.size() - 1 );
+
+     for ( auto &producer : producers )
+     {
+          producer->WaitThreadDone();
+     }
+
+     manager->StopProcessing();
+     ASSERT_EQ( queue->Lanes(), 0 );
+     ASSERT_EQ( consumer->Result(), Accumulate( values_count ) * 3 + Accumulate( producers.front()->Produced() ) );
+}
+class PayloadTestConsumer : public qm::IConsumer< std::vector< int > >
+{
+public:
+     void Consume( const std::vector< int > & ) override
+     {
+          copied_++;
+     }
+
+     void ConsumeMoved( std::vector< int > &&value ) override
+     {
+          std::scoped_lock lock( mtx_ );
+          values_.push_back( std::move( value ));
+     }
+
+     std::size_t Count()
+     {
+          std::scoped_lock lock( mtx_ );
+          return values_.size();
+     }
+
+     /// @brief Address of first consumed payload storage
+     const int *Data()
+     {
+          std::scoped_lock lock( mtx_ );
+          return values_.front().data();
+     }
+
+     std::atomic< int > copied_ = 0;
+
+private:
+     std::mutex mtx_;
+     std::vector< std::vector< int > > values_;
+};
+
+TEST(TestMpscPayload, consume_moved_values)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::string, std::vector< int > > >();
+     auto consumer = std::make_shared< PayloadTestConsumer >();
+     std::vector< qm::QueuePtr< std::vector< int > > > queues = {
+          std::make_shared< qm::BlockConcurrentQueue< std::vector< int > > >( 10 ),
+          std::make_shared< qm::MultiLaneQueue< std::vector< int > > >( 10 ) };
+
+     for ( auto &queue : queues )
+     {
+          ASSERT_EQ( manager->AddQueue( "queue1", queue ), qm::State::Ok );
+
+          std::vector< int > payload( 1000, 1 );
+          const int *data = payload.data();
+          ASSERT_EQ( manager->Enqueue( "queue1", std::move( payload )), qm::State::Ok );
+          ASSERT_EQ( manager->Subscribe( "queue1", consumer ), qm::State::Ok );
+
+          while ( consumer->Count() == 0 )
+          {
+               std::this_thread::yield();
+          }
+
+          ASSERT_EQ( consumer->Data(), data );
+          ASSERT_EQ( consumer->copied_, 0 );
+
+          manager->RemoveQueue( "queue1" );
+          consumer = std::make_shared< PayloadTestConsumer >();
+     }
+}
+
+TEST(TestMpscIntegralKeys, dense_registry)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::uint32_t, int > >();
+     std::vector< qm::QueuePtr< int > > queues;
+     for ( std::uint32_t id : { 5u, 1u, 4000000000u } )
+     {
+          queues.push_back( std::make_shared< qm::BlockConcurrentQueue< int > >( 10 ) );
+          ASSERT_EQ( manager->AddQueue( id, queues.back() ), qm::State::Ok );
+     }
+     ASSERT_EQ( manager->AddQueue( 1, queues.back() ), qm::State::QueueExists );
+
+     ASSERT_EQ( manager->Enqueue( 5, 1 ), qm::State::Ok );
+     ASSERT_EQ( manager->Enqueue( 4000000000u, 2 ), qm::State::Ok );
+     ASSERT_EQ( manager->Enqueue( 2, 3 ), qm::State::QueueAbsent );
+     ASSERT_EQ( queues[ 0 ]->Pop().value(), 1 );
+     ASSERT_EQ( queues[ 2 ]->Pop().value(), 2 );
+
+     ASSERT_EQ( manager->RemoveQueue( 5 ), qm::State::Ok );
+     ASSERT_EQ( manager->GetQueue( 5 ).s_, qm::State::QueueAbsent );
+     ASSERT_EQ( manager->GetQueue( 1 ).queue_, queues[ 1 ] );
+     ASSERT_EQ( manager->BorrowQueue( 4000000000u ).queue_.Get(), queues[ 2 ].get() );
+     ASSERT_TRUE( manager->AreAllQueuesEmpty() );
+}
+
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+     std::size_t Allocated() const { return allocated_; }
+
+     std::size_t Outstanding() const { return outstanding_; }
+
+private:
+     void *do_allocate( std::size_t bytes, std::size_t alignment ) override
+     {
+          allocated_ += bytes;
+          outstanding_ += bytes;
+          return std::pmr::new_delete_resource()->allocate( bytes, alignment );
+     }
+
+     void do_deallocate( void *p, std::size_t bytes, std::size_t alignment ) override
+     {
+          outstanding_ -= bytes;
+          std::pmr::new_delete_resource()->deallocate( p, bytes, alignment );
+     }
+
+     bool do_is_equal( const std::pmr::memory_resource &other ) const noexcept override
+     {
+          return this == &other;
+     }
+
+     std::size_t allocated_ = 0;
+     std::size_t outstanding_ = 0;
+};
+
+TEST(TestMpscMemoryResource, registries)
+{
+     CountingResource resource;
+     {
+          auto manager = std::make_shared< qm::MPSCQueueManager< std::string, int > >( &resource );
+          for ( auto id : { "queue1", "queue2", "queue3" } )
+          {
+               ASSERT_EQ( manager->AddQueue( id, std::make_shared< qm::BlockConcurrentQueue< int > >( 10 ) ), qm::State::Ok );
+          }
+          ASSERT_GT( resource.Allocated(), 0 );
+
+          auto consumer = std::make_shared< QueueTestConsumer >();
+          ASSERT_EQ( manager->Subscribe( "queue2", consumer ), qm::State::Ok );
+          ASSERT_EQ( manager->Enqueue( "queue2", 3 ), qm::State::Ok );
+          ASSERT_EQ( manager->RemoveQueue( "queue1" ), qm::State::Ok );
+          manager->StopProcessing();
+          ASSERT_EQ( consumer->Result(), 3 );
+     }
+     ASSERT_EQ( resource.Outstanding(), 0 );
+}
@@ -0,0 +1,173 @@
+#include <future>
+
+#include <gtest/gtest.h>
+
+#include <queue/multi_lane_queue.hpp>
+
+TEST(MultiLaneQueue, shared_lane_push_pop)
+{
+     qm::MultiLaneQueue<int> queue( 2 );
+     ASSERT_TRUE( queue.Empty() );
+
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.TryPush( 3 ), qm::State::QueueFull );
+
+     ASSERT_EQ( queue.Pop().value(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 2 );
+     ASSERT_FALSE( queue.Pop().has_value() );
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(MultiLaneQueue, shared_lane_reserve_commit)
+{
+     qm::MultiLaneQueue< int > queue( 4 );
+     auto slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     ASSERT_EQ( queue.Reserve(), slot );
+     *slot = 1;
+
+     // shared lane is owned by reserving thread until commit
+     ASSERT_EQ( std::async( std::launch::async, [ &queue ]() { return queue.Reserve(); } ).get(), nullptr );
+     ASSERT_EQ( std::async( std::launch::async, [ &queue ]() { return queue.TryPush( 2 ); } ).get(),
+                qm::State::QueueBusy );
+     ASSERT_FALSE( queue.Pop().has_value() );
+
+     ASSERT_EQ( queue.Commit(), qm::State::Ok );
+     ASSERT_EQ( queue.Commit(), qm::State::QueueAbsent );
+     ASSERT_EQ( queue.TryPush( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.Pop().value(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 2 );
+}
+
+TEST(MultiLaneQueue, lanes_rotation)
+{
+     qm::MultiLaneQueue<int> queue( 10 );
+     auto lane1 = queue.AttachProducer();
+     auto lane2 = queue.AttachProducer();
+     ASSERT_NE( lane1, nullptr );
+     ASSERT_NE( lane1, lane2 );
+     ASSERT_EQ( queue.Lanes(), 2 );
+
+     for ( int i = 0; i < 3; ++i )
+     {
+          ASSERT_EQ( lane1->Push( 10 + i ), qm::State::Ok );
+          ASSERT_EQ( lane2->Push( 20 + i ), qm::State::Ok );
+     }
+     ASSERT_FALSE( queue.Empty() );
+
+     // lanes are drained in turn, order inside a lane is kept
+     std::vector<int> expected = { 10, 20, 11, 21, 12, 22 };
+     for ( int value : expected )
+     {
+          ASSERT_EQ( queue.Pop().value(), value );
+     }
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(MultiLaneQueue, detach_drains_lane)
+{
+     qm::MultiLaneQueue<int> queue( 10 );
+     auto lane = queue.AttachProducer();
+     ASSERT_EQ( lane->Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( lane->Push( 2 ), qm::State::Ok );
+
+     queue.DetachProducer( lane );
+     ASSERT_EQ( queue.Lanes(), 0 );
+     ASSERT_FALSE( queue.Empty() );
+
+     ASSERT_EQ( queue.Pop().value(), 1 );
+     ASSERT_EQ( queue.Pop().value(), 2 );
+     ASSERT_FALSE( queue.Pop().has_value() );
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(MultiLaneQueue, enable_disable_queue)
+{
+     qm::MultiLaneQueue<int> queue( 10 );
+     auto lane = queue.AttachProducer();
+
+     queue.Enabled( false );
+     ASSERT_EQ( queue.Push( 1 ), qm::State::QueueDisabled );
+     ASSERT_EQ( lane->Push( 1 ), qm::State::QueueDisabled );
+
+     queue.Enabled( true );
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( lane->Push( 1 ), qm::State::Ok );
+
+     queue.Stop();
+     ASSERT_FALSE( queue.Enabled() );
+     ASSERT_FALSE( lane->Enabled() );
+}
+
+TEST(MultiLaneQueue, producers_threads)
+{
+     const int values_count = 10000;
+     const int producers_count = 4;
+     qm::MultiLaneQueue<int> queue( 16 );
+
+     std::vector< std::future< void > > producers;
+     for ( int p = 0; p < producers_count; ++p )
+     {
+          auto lane = queue.AttachProducer();
+          producers.push_back( std::async( std::launch::async, [lane, p] ()
+          {
+               for ( int i = 0; i < values_count; ++i )
+               {
+                    while ( lane->Push( p * values_count + i ) != qm::State::Ok )
+                    {
+                         std::this_thread::yield();
+                    }
+               }
+          }));
+     }
+
+     std::vector<int> last( producers_count, -1 );
+     for ( int popped = 0; popped < values_count * producers_count; )
+     {
+          auto value = queue.Pop();
+          if ( !value.has_value() )
+          {
+               std::this_thread::yield();
+          }
+          else
+          {
+               int p = value.value() / values_count;
+               ASSERT_GT( value.value(), last[ p ] );
+               last[ p ] = value.value();
+               popped++;
+          }
+     }
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(MultiLaneQueue, resize_lanes)
+{
+     qm::MultiLaneQueue< int > queue( 1 );
+     auto lane = queue.AttachProducer();
+     ASSERT_EQ( lane->Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( lane->Push( 2 ), qm::State::QueueFull );
+     ASSERT_EQ( queue.Push( 3 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 4 ), qm::State::QueueFull );
+
+     ASSERT_EQ( queue.Resize( 2 ), qm::State::Ok );
+     ASSERT_EQ( lane->Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( 4 ), qm::State::Ok );
+
+     // lanes attached later get new size and growth policy
+     queue.AutoGrow( 4, 1 );
+     auto late_lane = queue.AttachProducer();
+     ASSERT_EQ( late_lane->MaxSize(), 2 );
+     for ( int value = 5; value < 9; value++ )
+     {
+          ASSERT_EQ( late_lane->Push( value ), qm::State::Ok );
+     }
+     ASSERT_EQ( late_lane->MaxSize(), 4 );
+
+     int sum = 0;
+     while ( auto value = queue.Pop() )
+     {
+          sum += value.value();
+     }
+     ASSERT_EQ( sum, 36 );
+}
@@ -0,0 +1,55 @@
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <buffer/numa.hpp>
+#include <queue/multi_lane_queue.hpp>
+#include <queue/spsc_ring_queue.hpp>
+
+TEST(Numa, nodes)
+{
+     ASSERT_GE( qm::NumaNodes(), 1 );
+     ASSERT_GE( qm::CurrentNumaNode(), 0 );
+     ASSERT_LT( qm::CurrentNumaNode(), qm::NumaNodes() );
+
+     std::vector< char > data( 1 << 16, 1 );
+     auto node = qm::NumaNodeOf( data.data() );
+     ASSERT_GE( node, 0 );
+     ASSERT_LT( node, qm::NumaNodes() );
+}
+
+TEST(Numa, bind_range)
+{
+     std::vector< char > data( 1 << 20, 1 );
+     ASSERT_FALSE( qm::BindToNumaNode( data.data(), data.size(), -1 ));
+     ASSERT_FALSE( qm::BindToNumaNode( data.data(), data.size(), qm::NumaNodes() ));
+
+     // every node of multi node system takes memory, single node system has nothing to bind
+     for ( int node = 0; node < qm::NumaNodes(); node++ )
+     {
+          if ( qm::NumaNodes() == 1 )
+          {
+               ASSERT_FALSE( qm::BindToNumaNode( data.data(), data.size(), node ));
+          }
+          else if ( qm::BindToNumaNode( data.data(), data.size(), node ))
+          {
+               ASSERT_EQ( qm::NumaNodeOf( data.data() + data.size() / 2 ), node );
+          }
+          ASSERT_EQ( data[ data.size() / 2 ], 1 );
+     }
+}
+
+TEST(Numa, bind_queues)
+{
+     qm::SpscRingQueue< int > queue( 1000 );
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     queue.BindToNode( qm::CurrentNumaNode() );
+     ASSERT_EQ( queue.Pop().value(), 1 );
+
+     qm::MultiLaneQueue< int > lanes( 100 );
+     lanes.BindToNode( qm::CurrentNumaNode() );
+     auto lane = lanes.AttachProducer();
+     ASSERT_EQ( lane->Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( lanes.Pop().value(), 2 );
+}
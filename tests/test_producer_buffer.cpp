@@ -0,0 +1,90 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <producer/producer_buffer.hpp>
+#include <queue/block_concurrent_queue.hpp>
+#include <queue/lock_free_queue.hpp>
+
+TEST(ProducerBuffer, count_threshold)
+{
+     auto queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 100 );
+     qm::ProducerBuffer< int > buffer( queue, { 4, 0, std::chrono::seconds( 10 ) } );
+
+     for ( int i = 0; i < 3; i++ )
+     {
+          ASSERT_EQ( buffer.Push( i ), qm::State::Ok );
+     }
+     ASSERT_EQ( buffer.Size(), 3 );
+     ASSERT_TRUE( queue->Empty() );
+
+     ASSERT_EQ( buffer.Push( 3 ), qm::State::Ok );
+     ASSERT_EQ( buffer.Size(), 0 );
+     ASSERT_EQ( queue->Size(), 4 );
+
+     for ( int i = 0; i < 4; i++ )
+     {
+          ASSERT_EQ( queue->Pop().value(), i );
+     }
+}
+
+TEST(ProducerBuffer, bytes_threshold)
+{
+     auto queue = std::make_shared< qm::BlockConcurrentQueue< std::string > >( 100 );
+     qm::BufferPolicy policy{ 100, sizeof( std::string ) * 2 + 10, std::chrono::seconds( 10 ) };
+     qm::ProducerBuffer< std::string > buffer( queue, policy );
+
+     ASSERT_EQ( buffer.Push( std::string( "abc" )), qm::State::Ok );
+     ASSERT_EQ( buffer.Bytes(), sizeof( std::string ) + 3 );
+     ASSERT_TRUE( queue->Empty() );
+
+     ASSERT_EQ( buffer.Push( std::string( "defghij" )), qm::State::Ok );
+     ASSERT_EQ( buffer.Size(), 0 );
+     ASSERT_EQ( buffer.Bytes(), 0 );
+     ASSERT_EQ( queue->Pop().value(), "abc" );
+     ASSERT_EQ( queue->Pop().value(), "defghij" );
+}
+
+TEST(ProducerBuffer, linger)
+{
+     auto queue = std::make_shared< qm::LockFreeQueue< int > >( 100 );
+     qm::ProducerBuffer< int > buffer( queue, { 100, 0, std::chrono::milliseconds( 1 ) } );
+
+     ASSERT_EQ( buffer.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( buffer.Poll(), qm::State::Ok );
+     ASSERT_EQ( buffer.Size(), 1 );
+
+     std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+     ASSERT_EQ( buffer.Poll(), qm::State::Ok );
+     ASSERT_EQ( buffer.Size(), 0 );
+     ASSERT_EQ( queue->Pop().value(), 1 );
+}
+
+TEST(ProducerBuffer, full_queue)
+{
+     auto queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 3 );
+     qm::ProducerBuffer< int > buffer( queue, { 2, 0, std::chrono::seconds( 10 ) } );
+
+     ASSERT_EQ( buffer.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( buffer.Push( 2 ), qm::State::Ok );
+     ASSERT_EQ( buffer.Push( 3 ), qm::State::Ok );
+     ASSERT_EQ( buffer.Push( 4 ), qm::State::Ok );
+     ASSERT_EQ( buffer.Size(), 1 );
+     ASSERT_EQ( buffer.Push( 5 ), qm::State::Ok );
+     ASSERT_EQ( buffer.Push( 6 ), qm::State::QueueFull );
+     ASSERT_EQ( buffer.Flush(), qm::State::QueueFull );
+
+     ASSERT_EQ( queue->Pop().value(), 1 );
+     ASSERT_EQ( queue->Pop().value(), 2 );
+     ASSERT_EQ( buffer.Flush(), qm::State::Ok );
+     ASSERT_EQ( buffer.Size(), 0 );
+
+     for ( int i = 3; i <= 5; i++ )
+     {
+          ASSERT_EQ( queue->Pop().value(), i );
+     }
+
+     queue->Stop();
+     ASSERT_EQ( buffer.Push( 7 ), qm::State::Ok );
+     ASSERT_EQ( buffer.Flush(), qm::State::QueueDisabled );
+}
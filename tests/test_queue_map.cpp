@@ -0,0 +1,168 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <manager/queue_map.hpp>
+
+static_assert( std::is_same_v< qm::QueueMap< std::uint32_t, int >, qm::DenseQueueMap< std::uint32_t, int > > );
+static_assert( std::is_same_v< qm::PublishedMap< std::uint32_t, int >, qm::DensePublishedQueueMap< std::uint32_t, int > > );
+static_assert( std::is_same_v< qm::PublishedMap< std::string, int >, qm::PublishedQueueMap< std::string, int > > );
+static_assert( std::is_same_v< qm::QueueMap< std::string, int >,
+                              boost::container::flat_map< std::string, int, std::less< std::string >,
+                                                          std::allocator< std::pair< std::string, int > > > > );
+
+TEST(DenseQueueMap, emplace_find_erase)
+{
+     qm::DenseQueueMap< std::uint32_t, std::string > map;
+     ASSERT_TRUE( map.empty() );
+     ASSERT_EQ( map.find( 7 ), map.end() );
+
+     ASSERT_TRUE( map.emplace( 7, "seven" ).second );
+     ASSERT_TRUE( map.emplace( 3, "three" ).second );
+     ASSERT_TRUE( map.emplace( 100, "hundred" ).second );
+     ASSERT_FALSE( map.emplace( 3, "other" ).second );
+     ASSERT_EQ( map.size(), 3 );
+     ASSERT_EQ( map.find( 3 )->second, "three" );
+     ASSERT_EQ( map.find( 4 ), map.end() );
+     ASSERT_EQ( map.find( 1000 ), map.end() );
+
+     // erasing first value moves the last one to its position
+     map.erase( map.find( 7 ));
+     ASSERT_EQ( map.find( 7 ), map.end() );
+     ASSERT_EQ( map.find( 100 )->second, "hundred" );
+     ASSERT_EQ( map.find( 3 )->second, "three" );
+
+     ASSERT_EQ( map.erase( 100u ), 1 );
+     ASSERT_EQ( map.erase( 100u ), 0 );
+     ASSERT_EQ( map.size(), 1 );
+     ASSERT_EQ( map.begin()->first, 3 );
+}
+
+TEST(DenseQueueMap, out_of_range_keys)
+{
+     qm::DenseQueueMap< std::int64_t, int > map;
+     const std::int64_t big = qm::KeyTraits< std::int64_t >::DenseLimit + 5;
+
+     ASSERT_TRUE( map.emplace( -1, 1 ).second );
+     ASSERT_TRUE( map.emplace( big, 2 ).second );
+     ASSERT_TRUE( map.emplace( 0, 3 ).second );
+     ASSERT_FALSE( map.emplace( -1, 4 ).second );
+
+     ASSERT_EQ( map.find( -1 )->second, 1 );
+     ASSERT_EQ( map.find( big )->second, 2 );
+     ASSERT_EQ( map.find( 0 )->second, 3 );
+     ASSERT_EQ( map.find( -2 ), map.end() );
+
+     map.erase( map.find( -1 ));
+     ASSERT_EQ( map.find( -1 ), map.end() );
+     ASSERT_EQ( map.find( big )->second, 2 );
+     ASSERT_EQ( map.find( 0 )->second, 3 );
+
+     int sum = 0;
+     for ( const auto &value : map )
+     {
+          sum += value.second;
+     }
+     ASSERT_EQ( sum, 5 );
+}
+
+TEST(PublishedQueueMap, insert_find_erase)
+{
+     qm::EpochDomain epochs;
+     std::vector< int > queues( 1000 );
+     {
+          qm::PublishedQueueMap< std::string, int > map( epochs );
+          auto guard = epochs.Pin();
+          ASSERT_EQ( map.Find( "0" ), nullptr );
+
+          // table is rebuilt while growing, replaced tables wait for pinned reader
+          for ( int i = 0; i < 1000; i++ )
+          {
+               map.Insert( std::to_string( i ), &queues[ i ] );
+          }
+          ASSERT_GT( epochs.Pending(), 0 );
+          for ( int i = 0; i < 1000; i++ )
+          {
+               ASSERT_EQ( map.Find( std::to_string( i )), &queues[ i ] );
+          }
+          ASSERT_EQ( map.Find( "1000" ), nullptr );
+
+          map.Erase( "5" );
+          map.Erase( "5" );
+          ASSERT_EQ( map.Find( "5" ), nullptr );
+          ASSERT_EQ( map.Find( "6" ), &queues[ 6 ] );
+
+          map.Insert( "5", &queues[ 0 ] );
+          ASSERT_EQ( map.Find( "5" ), &queues[ 0 ] );
+     }
+     ASSERT_GT( epochs.Collect(), 0 );
+     ASSERT_EQ( epochs.Pending(), 0 );
+}
+
+TEST(PublishedQueueMap, strided_integral_keys)
+{
+     qm::EpochDomain epochs;
+     qm::PublishedQueueMap< std::uint64_t, int > map( epochs );
+     std::vector< int > queues( 512 );
+     for ( std::uint64_t i = 0; i < queues.size(); i++ )
+     {
+          map.Insert( i << 20, &queues[ i ] );
+     }
+
+     // erased keys are dropped when table is rebuilt
+     for ( std::uint64_t round = 0; round < 4; round++ )
+     {
+          for ( std::uint64_t i = 0; i < queues.size(); i++ )
+          {
+               map.Erase( i << 20 );
+               map.Insert( ( i << 20 ) + round + 1, &queues[ i ] );
+          }
+     }
+
+     auto guard = epochs.Pin();
+     for ( std::uint64_t i = 0; i < queues.size(); i++ )
+     {
+          ASSERT_EQ( map.Find( i << 20 ), nullptr );
+          ASSERT_EQ( map.Find( ( i << 20 ) + 4 ), &queues[ i ] );
+     }
+}
+
+TEST(DensePublishedQueueMap, direct_and_overflow_keys)
+{
+     qm::EpochDomain epochs;
+     std::vector< int > queues( 1000 );
+     {
+          qm::DensePublishedQueueMap< std::int64_t, int > map( epochs );
+          auto guard = epochs.Pin();
+          ASSERT_EQ( map.Find( 0 ), nullptr );
+
+          // array grows while keys are added, replaced arrays wait for pinned reader
+          for ( int i = 0; i < 1000; i++ )
+          {
+               map.Insert( i, &queues[ i ] );
+          }
+          ASSERT_GT( epochs.Pending(), 0 );
+          map.Insert( -1, &queues[ 1 ] );
+          map.Insert( std::int64_t{ 1 } << 40, &queues[ 2 ] );
+
+          for ( int i = 0; i < 1000; i++ )
+          {
+               ASSERT_EQ( map.Find( i ), &queues[ i ] );
+          }
+          ASSERT_EQ( map.Find( 1000 ), nullptr );
+          ASSERT_EQ( map.Find( 100000 ), nullptr );
+          ASSERT_EQ( map.Find( -1 ), &queues[ 1 ] );
+          ASSERT_EQ( map.Find( std::int64_t{ 1 } << 40 ), &queues[ 2 ] );
+
+          map.Erase( 5 );
+          map.Erase( -1 );
+          map.Erase( 100000 );
+          ASSERT_EQ( map.Find( 5 ), nullptr );
+          ASSERT_EQ( map.Find( -1 ), nullptr );
+          ASSERT_EQ( map.Find( 6 ), &queues[ 6 ] );
+     }
+     ASSERT_GT( epochs.Collect(), 0 );
+     ASSERT_EQ( epochs.Pending(), 0 );
+}
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <queue/segmented_queue.hpp>
+
+TEST(SegmentedQueue, push_pop)
+{
+     qm::SegmentedQueue< std::string, 4 > queue;
+     ASSERT_TRUE( queue.Empty() );
+     ASSERT_FALSE( queue.Pop().has_value() );
+
+     // queue is never full, segments are linked on overflow
+     for ( int i = 0; i < 100; i++ )
+     {
+          ASSERT_EQ( queue.TryPush( std::to_string( i )), qm::State::Ok );
+     }
+     ASSERT_EQ( queue.Size(), 100 );
+     ASSERT_EQ( queue.Segments(), 25 );
+
+     std::string value;
+     for ( int i = 0; i < 100; i++ )
+     {
+          ASSERT_TRUE( queue.TryPop( value ));
+          ASSERT_EQ( value, std::to_string( i ));
+     }
+     ASSERT_TRUE( queue.Empty() );
+     ASSERT_FALSE( queue.TryPop( value ));
+
+     ASSERT_EQ( queue.Emplace( 3, 'a' ), qm::State::Ok );
+     ASSERT_EQ( queue.Pop().value(), "aaa" );
+}
+
+TEST(SegmentedQueue, recycle_segments)
+{
+     qm::SegmentedQueue< int, 4 > queue( 0, 2 );
+     for ( int round = 0; round < 100; round++ )
+     {
+          for ( int i = 0; i < 10; i++ )
+          {
+               ASSERT_EQ( queue.Push( i ), qm::State::Ok );
+          }
+          for ( int i = 0; i < 10; i++ )
+          {
+               ASSERT_EQ( queue.Pop().value(), i );
+          }
+     }
+
+     // drained segments come back from pool instead of new allocations
+     ASSERT_LE( queue.Segments(), 6 );
+     ASSERT_LE( queue.PooledSegments(), 2 );
+}
+
+TEST(SegmentedQueue, memory_limit)
+{
+     using Queue = qm::SegmentedQueue< int, 4 >;
+     Queue queue( 2 * Queue::SegmentBytes() );
+     for ( int i = 0; i < 8; i++ )
+     {
+          ASSERT_EQ( queue.TryPush( i ), qm::State::Ok );
+     }
+
+     int value = 8;
+     ASSERT_EQ( queue.TryPush( std::move( value )), qm::State::BudgetExceeded );
+     ASSERT_EQ( value, 8 );
+     ASSERT_EQ( queue.Segments(), 2 );
+
+     // blocked producer continues when consumer drains segment
+     auto producer = std::async( std::launch::async, [ &queue ]() { return queue.Push( 8 ); } );
+     for ( int i = 0; i < 5; i++ )
+     {
+          ASSERT_EQ( queue.Pop().value(), i );
+     }
+     ASSERT_EQ( producer.get(), qm::State::Ok );
+     ASSERT_EQ( queue.Segments(), 2 );
+
+     for ( int i = 5; i <= 8; i++ )
+     {
+          ASSERT_EQ( queue.Pop().value(), i );
+     }
+}
+
+TEST(SegmentedQueue, limit_below_two_segments)
+{
+     using Queue = qm::SegmentedQueue< int, 4 >;
+     Queue queue( Queue::SegmentBytes() + 1 );
+
+     // queue keeps flowing after the first segment is drained
+     for ( int round = 0; round < 4; round++ )
+     {
+          for ( int i = 0; i < 4; i++ )
+          {
+               ASSERT_EQ( queue.TryPush( i ), qm::State::Ok );
+          }
+          for ( int i = 0; i < 4; i++ )
+          {
+               ASSERT_EQ( queue.Pop().value(), i );
+          }
+          ASSERT_TRUE( queue.Empty() );
+     }
+     ASSERT_LE( queue.Segments(), 2 );
+}
+
+TEST(SegmentedQueue, values_destroyed)
+{
+     auto token = std::make_shared< int >( 0 );
+     {
+          qm::SegmentedQueue< std::shared_ptr< int >, 4 > queue;
+          for ( int i = 0; i < 10; i++ )
+          {
+               ASSERT_EQ( queue.Push( token ), qm::State::Ok );
+          }
+          ASSERT_TRUE( queue.Pop().has_value() );
+          ASSERT_EQ( token.use_count(), 10 );
+
+          queue.Stop();
+          ASSERT_EQ( queue.Push( token ), qm::State::QueueDisabled );
+          ASSERT_EQ( queue.Resize( 100 ), qm::State::QueueBusy );
+     }
+     ASSERT_EQ( token.use_count(), 1 );
+}
+
+TEST(SegmentedQueue, producers_consumers_threads)
+{
+     const int producers_count = 4;
+     const int consumers_count = 2;
+     const int values_count = 20000;
+     qm::SegmentedQueue< int, 64 > queue;
+
+     std::vector< std::future< void > > producers;
+     for ( int p = 0; p < producers_count; p++ )
+     {
+          producers.push_back( std::async( std::launch::async, [ &queue, p ]()
+          {
+               for ( int i = 0; i < values_count; i++ )
+               {
+                    ASSERT_EQ( queue.Push( p * values_count + i ), qm::State::Ok );
+               }
+          } ));
+     }
+
+     std::atomic< int > popped{ 0 };
+     std::vector< std::future< std::vector< int > > > consumers;
+     for ( int c = 0; c < consumers_count; c++ )
+     {
+          consumers.push_back( std::async( std::launch::async, [ &queue, &popped ]()
+          {
+               // values of each producer come in push order
+               std::vector< int > last( producers_count, -1 );
+               std::vector< int > values;
+               while ( popped.load() < producers_count * values_count )
+               {
+                    int value = 0;
+                    if ( !queue.TryPop( value ))
+                    {
+                         std::this_thread::yield();
+                         continue;
+                    }
+                    EXPECT_GT( value % values_count, last[ value / values_count ] );
+                    last[ value / values_count ] = value % values_count;
+                    values.push_back( value );
+                    popped++;
+               }
+               return values;
+          } ));
+     }
+
+     for ( auto &producer : producers )
+     {
+          producer.get();
+     }
+
+     std::vector< int > all;
+     for ( auto &consumer : consumers )
+     {
+          auto values = consumer.get();
+          all.insert( all.end(), values.begin(), values.end() );
+     }
+
+     std::sort( all.begin(), all.end() );
+     ASSERT_EQ( all.size(), producers_count * values_count );
+     for ( int i = 0; i < producers_count * values_count; i++ )
+     {
+          ASSERT_EQ( all[ i ], i );
+     }
+     ASSERT_TRUE( queue.Empty() );
+}
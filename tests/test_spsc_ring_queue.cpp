@@ -0,0 +1,349 @@
+#include <future>
+#include <memory_resource>
+#include <numeric>
+
+#include <gtest/gtest.h>
+
+#include <queue/spsc_ring_queue.hpp>
+
+TEST(SpscRingQueue, push_pop)
+{
+     qm::SpscRingQueue<int> queue( 10 );
+     ASSERT_TRUE( queue.Empty() );
+
+     auto state = queue.Push( 1 );
+     ASSERT_EQ( state, qm::State::Ok );
+     state = queue.Push( 2 );
+     ASSERT_EQ( state, qm::State::Ok );
+     ASSERT_EQ( queue.Size(), 2 );
+
+     auto value = queue.Pop();
+     ASSERT_TRUE( value.has_value() );
+     ASSERT_EQ( value.value(), 1 );
+
+     value = queue.Pop();
+     ASSERT_TRUE( value.has_value() );
+     ASSERT_EQ( value.value(), 2 );
+
+     value = queue.Pop();
+     ASSERT_FALSE( value.has_value() );
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(SpscRingQueue, full_queue)
+{
+     std::vector<int> values = { 1, 2, 3 };
+     qm::SpscRingQueue<int> queue( values.size() );
+
+     for ( int round = 0; round < 3; ++round )
+     {
+          for ( const int &value : values )
+          {
+               auto state = queue.Push( value );
+               ASSERT_EQ( state, qm::State::Ok );
+          }
+          ASSERT_EQ( queue.Size(), values.size() );
+
+          auto state = queue.TryPush( 4 );
+          ASSERT_EQ( state, qm::State::QueueFull );
+
+          for ( const int &value : values )
+          {
+               ASSERT_EQ( queue.Pop().value(), value );
+          }
+     }
+}
+
+TEST(SpscRingQueue, enable_disable_queue)
+{
+     qm::SpscRingQueue<std::string> queue( 3 );
+     auto state = queue.Push( "a" );
+     ASSERT_EQ( state, qm::State::Ok );
+
+     queue.Enabled( false );
+     state = queue.Push( "b" );
+     ASSERT_EQ( state, qm::State::QueueDisabled );
+     ASSERT_EQ( queue.Pop().value(), "a" );
+
+     queue.Enabled( true );
+     state = queue.Push( "b" );
+     ASSERT_EQ( state, qm::State::Ok );
+
+     queue.Stop();
+     ASSERT_FALSE( queue.Enabled() );
+}
+
+TEST(SpscRingQueue, producer_consumer_threads)
+{
+     const int values_count = 10000;
+     qm::SpscRingQueue<int> queue( 16 );
+
+     auto producer = std::async( std::launch::async, [&queue] ()
+     {
+          for ( int i = 1; i <= values_count; ++i )
+          {
+               while ( queue.Push( i ) != qm::State::Ok )
+               {
+                    std::this_thread::yield();
+               }
+          }
+     });
+
+     int expected = 1;
+     while ( expected <= values_count )
+     {
+          auto value = queue.Pop();
+          if ( !value.has_value() )
+          {
+               std::this_thread::yield();
+               continue;
+          }
+          ASSERT_EQ( value.value(), expected++ );
+     }
+}
+
+TEST(SpscRingQueue, push_bulk)
+{
+     std::vector<std::string> values = { "a", "b", "c", "d" };
+     qm::SpscRingQueue<std::string> queue( 3 );
+
+     for ( int round = 0; round < 3; ++round )
+     {
+          auto copy = values;
+          auto pushed = queue.TryPushBulk( copy.data(), copy.size() );
+          ASSERT_EQ( pushed, 3 );
+          ASSERT_EQ( queue.Size(), 3 );
+          ASSERT_EQ( copy[ 3 ], "d" );
+
+          for ( std::size_t i = 0; i < pushed; ++i )
+          {
+               ASSERT_EQ( queue.Pop().value(), values[ i ] );
+          }
+          ASSERT_TRUE( queue.Empty() );
+     }
+}
+
+TEST(SpscRingQueue, bulk_wrap_around)
+{
+     struct Tick
+     {
+          std::int64_t time;
+          double price;
+          double volume;
+          std::int32_t side;
+     };
+
+     qm::SpscRingQueue< Tick > queue( 5 );
+     std::vector< Tick > values( 4 );
+     std::vector< Tick > popped( 4 );
+     std::int32_t pushed = 0;
+     std::int32_t expected = 0;
+
+     // 4 of 6 ring slots are used per round, so runs wrap around the end of ring
+     for ( int round = 0; round < 5; ++round )
+     {
+          for ( auto &value : values )
+          {
+               value = { pushed, pushed * 0.5, 1.0, pushed };
+               pushed++;
+          }
+
+          ASSERT_EQ( queue.TryPushBulk( values.data(), values.size() ), 4 );
+          ASSERT_EQ( queue.Size(), 4 );
+
+          ASSERT_EQ( queue.TryPopBulk( popped.data(), 3 ), 3 );
+          ASSERT_EQ( queue.TryPopBulk( popped.data() + 3, 3 ), 1 );
+          for ( const auto &tick : popped )
+          {
+               ASSERT_EQ( tick.time, expected );
+               ASSERT_EQ( tick.price, expected * 0.5 );
+               ASSERT_EQ( tick.side, expected++ );
+          }
+          ASSERT_TRUE( queue.Empty() );
+     }
+
+     ASSERT_EQ( queue.TryPushBulk( values.data(), values.size() ), 4 );
+     ASSERT_EQ( queue.TryPushBulk( values.data(), values.size() ), 1 );
+     ASSERT_EQ( queue.TryPopBulk( popped.data(), popped.size() ), 4 );
+     ASSERT_EQ( queue.TryPopBulk( popped.data(), popped.size() ), 1 );
+     ASSERT_EQ( popped[ 0 ].time, values[ 0 ].time );
+}
+
+TEST(SpscRingQueue, pop_bulk)
+{
+     qm::SpscRingQueue<std::string> queue( 3 );
+     std::vector<std::string> values = { "a", "b", "c" };
+     ASSERT_EQ( queue.TryPushBulk( values.data(), values.size() ), 3 );
+
+     std::vector<std::string> popped( 2 );
+     ASSERT_EQ( queue.TryPopBulk( popped.data(), popped.size() ), 2 );
+     ASSERT_EQ( popped, std::vector<std::string>( { "a", "b" } ));
+     ASSERT_EQ( queue.Pop().value(), "c" );
+     ASSERT_EQ( queue.TryPopBulk( popped.data(), popped.size() ), 0 );
+}
+
+TEST(SpscRingQueue, emplace)
+{
+     qm::SpscRingQueue<std::pair<int, std::string>> queue( 2 );
+
+     ASSERT_EQ( queue.Emplace( 1, "a" ), qm::State::Ok );
+     ASSERT_EQ( queue.Emplace( 2, "b" ), qm::State::Ok );
+     ASSERT_EQ( queue.Emplace( 3, "c" ), qm::State::QueueFull );
+
+     auto value = queue.Pop();
+     ASSERT_EQ( value->first, 1 );
+     ASSERT_EQ( value->second, "a" );
+}
+
+TEST(SpscRingQueue, reserve_commit)
+{
+     qm::SpscRingQueue<std::string> queue( 2 );
+
+     auto slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     ASSERT_EQ( queue.Reserve(), slot );
+     slot->assign( "a" );
+     ASSERT_TRUE( queue.Empty() );
+     ASSERT_EQ( queue.Push( "b" ), qm::State::QueueBusy );
+
+     ASSERT_EQ( queue.Commit(), qm::State::Ok );
+     ASSERT_EQ( queue.Commit(), qm::State::QueueAbsent );
+     ASSERT_EQ( queue.Size(), 1 );
+
+     slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     slot->assign( "b" );
+     ASSERT_EQ( queue.Commit(), qm::State::Ok );
+     ASSERT_EQ( queue.Reserve(), nullptr );
+
+     auto front = queue.Front();
+     ASSERT_NE( front, nullptr );
+     ASSERT_EQ( *front, "a" );
+     queue.Release();
+     ASSERT_EQ( *queue.Front(), "b" );
+     queue.Release();
+     ASSERT_EQ( queue.Front(), nullptr );
+     ASSERT_TRUE( queue.Empty() );
+
+     slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     slot->assign( "c" );
+     ASSERT_EQ( queue.Cancel(), qm::State::Ok );
+     ASSERT_EQ( queue.Cancel(), qm::State::QueueAbsent );
+     ASSERT_TRUE( queue.Empty() );
+
+     slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     queue.Stop();
+     ASSERT_EQ( queue.Commit(), qm::State::QueueDisabled );
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(SpscRingQueue, memory_resource)
+{
+     std::byte buffer[ 1024 ];
+     std::pmr::monotonic_buffer_resource arena( buffer, sizeof( buffer ), std::pmr::null_memory_resource() );
+     qm::SpscRingQueue< int > queue( 100, &arena );
+
+     ASSERT_EQ( queue.Push( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Pop().value(), 1 );
+
+     // ring storage does not fit arena anymore
+     ASSERT_THROW( qm::SpscRingQueue< int >( 1000, &arena ), std::bad_alloc );
+}
+
+TEST(SpscRingQueue, resize)
+{
+     qm::SpscRingQueue< std::string > queue( 2 );
+     ASSERT_EQ( queue.Push( "a" ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( "b" ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( "c" ), qm::State::QueueFull );
+
+     // queue continues in new ring, values of old ring are consumed first
+     ASSERT_EQ( queue.Resize( 5 ), qm::State::Ok );
+     for ( const auto *value : { "c", "d", "e" } )
+     {
+          ASSERT_EQ( queue.Push( value ), qm::State::Ok );
+     }
+     ASSERT_EQ( queue.Size(), 5 );
+     ASSERT_EQ( queue.Pop().value(), "a" );
+     ASSERT_EQ( queue.Push( "f" ), qm::State::Ok );
+     ASSERT_EQ( queue.Size(), 5 );
+     for ( const auto *value : { "b", "c", "d", "e", "f" } )
+     {
+          ASSERT_EQ( queue.Pop().value(), value );
+     }
+     ASSERT_TRUE( queue.Empty() );
+
+     // shrinking keeps storage and lowers limit
+     ASSERT_EQ( queue.Resize( 1 ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( "g" ), qm::State::Ok );
+     ASSERT_EQ( queue.Push( "h" ), qm::State::QueueFull );
+     ASSERT_EQ( queue.Pop().value(), "g" );
+}
+
+TEST(SpscRingQueue, resize_while_running)
+{
+     const int values_count = 100000;
+     qm::SpscRingQueue< int > queue( 4 );
+
+     auto producer = std::async( std::launch::async, [ &queue ]()
+     {
+          for ( int i = 1; i <= values_count; ++i )
+          {
+               while ( queue.Push( i ) != qm::State::Ok )
+               {
+                    std::this_thread::yield();
+               }
+          }
+     });
+
+     auto resizer = std::async( std::launch::async, [ &queue ]()
+     {
+          for ( std::size_t size = 8; size <= 4096; size *= 2 )
+          {
+               ASSERT_EQ( queue.Resize( size ), qm::State::Ok );
+               ASSERT_EQ( queue.Resize( size / 4 ), qm::State::Ok );
+               std::this_thread::yield();
+          }
+     });
+
+     int expected = 1;
+     while ( expected <= values_count )
+     {
+          int value = 0;
+          if ( !queue.TryPop( value ))
+          {
+               std::this_thread::yield();
+               continue;
+          }
+          ASSERT_EQ( value, expected++ );
+     }
+     resizer.get();
+     ASSERT_TRUE( queue.Empty() );
+}
+
+TEST(SpscRingQueue, auto_grow)
+{
+     qm::SpscRingQueue< int > queue( 2 );
+     queue.AutoGrow( 8, 1 );
+
+     std::vector< int > values( 8 );
+     std::iota( values.begin(), values.end(), 0 );
+     ASSERT_EQ( queue.TryPushBulk( values.data(), values.size() ), 8 );
+     ASSERT_EQ( queue.MaxSize(), 8 );
+     ASSERT_EQ( queue.Push( 8 ), qm::State::QueueFull );
+
+     // reserved slot may be taken from ring allocated by growth
+     queue.AutoGrow( 16, 1 );
+     auto slot = queue.Reserve();
+     ASSERT_NE( slot, nullptr );
+     *slot = 8;
+     ASSERT_EQ( queue.Commit(), qm::State::Ok );
+
+     for ( int value = 0; value <= 8; value++ )
+     {
+          ASSERT_EQ( queue.Pop().value(), value );
+     }
+     ASSERT_TRUE( queue.Empty() );
+}
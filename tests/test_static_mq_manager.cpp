@@ -0,0 +1,150 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <manager/static_mqueue_manager.hpp>
+#include <queue/block_concurrent_queue.hpp>
+#include <queue/lock_free_queue.hpp>
+#include <consumer/base_consumer.hpp>
+
+class StaticTestConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int &value ) override
+     {
+          sum_ += value;
+          count_++;
+     }
+
+     std::atomic< int > sum_ = 0;
+     std::atomic< int > count_ = 0;
+};
+
+using StaticManager = qm::StaticMPSCQueueManager< std::string, qm::BlockConcurrentQueue< int >, StaticTestConsumer >;
+
+TEST(StaticMPSCQueueManager, add_remove_queue)
+{
+     StaticManager manager;
+     auto queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 10 );
+     ASSERT_EQ( manager.AddQueue( "queue1", queue ), qm::State::Ok );
+     ASSERT_EQ( manager.AddQueue( "queue1", queue ), qm::State::QueueExists );
+     ASSERT_EQ( manager.GetQueue( "queue1" ), queue );
+     ASSERT_EQ( manager.GetQueue( "queue2" ), nullptr );
+     ASSERT_EQ( manager.BorrowQueue( "queue1" ).Get(), queue.get() );
+     ASSERT_FALSE( manager.BorrowQueue( "queue2" ));
+
+     ASSERT_EQ( manager.Enqueue( "queue1", 1 ), qm::State::Ok );
+     ASSERT_EQ( manager.Enqueue( "queue2", 1 ), qm::State::QueueAbsent );
+     ASSERT_FALSE( manager.AreAllQueuesEmpty() );
+
+     ASSERT_EQ( manager.RemoveQueue( "queue1" ), qm::State::Ok );
+     ASSERT_FALSE( queue->Enabled() );
+     ASSERT_EQ( manager.RemoveQueue( "queue1" ), qm::State::QueueAbsent );
+     ASSERT_EQ( manager.GetQueue( "queue1" ), nullptr );
+}
+
+TEST(StaticMPSCQueueManager, subscribe_consume)
+{
+     StaticManager manager;
+     auto consumer = std::make_shared< StaticTestConsumer >();
+     ASSERT_EQ( manager.Subscribe( "queue1", consumer ), qm::State::QueueAbsent );
+     ASSERT_EQ( manager.AddQueue( "queue1", std::make_shared< qm::BlockConcurrentQueue< int > >( 10 )), qm::State::Ok );
+     ASSERT_EQ( manager.Subscribe( "queue1", consumer ), qm::State::Ok );
+     ASSERT_EQ( manager.Subscribe( "queue1", consumer ), qm::State::QueueBusy );
+
+     const int n = 1000;
+     auto producer = [ queue = manager.GetQueue( "queue1" ) ]()
+     {
+          for ( int i = 1; i <= n; i++ )
+          {
+               ASSERT_EQ( queue->Push( i ), qm::State::Ok );
+          }
+     };
+
+     std::thread first( producer );
+     std::thread second( producer );
+     first.join();
+     second.join();
+
+     while ( consumer->count_ != 2 * n )
+     {
+          std::this_thread::yield();
+     }
+     ASSERT_EQ( consumer->sum_, n * ( n + 1 ));
+
+     manager.StopProcessing();
+     ASSERT_FALSE( consumer->Enabled() );
+     ASSERT_EQ( manager.Enqueue( "queue1", 1 ), qm::State::QueueDisabled );
+
+     manager.StartProcessing();
+     ASSERT_EQ( manager.Enqueue( "queue1", 1 ), qm::State::Ok );
+     while ( consumer->count_ != 2 * n + 1 )
+     {
+          std::this_thread::yield();
+     }
+}
+
+TEST(StaticMPSCQueueManager, unsubscribe)
+{
+     qm::StaticMPSCQueueManager< int, qm::LockFreeQueue< int >, StaticTestConsumer > manager;
+     auto consumer = std::make_shared< StaticTestConsumer >();
+     ASSERT_EQ( manager.AddQueue( 1, std::make_shared< qm::LockFreeQueue< int > >( 10 )), qm::State::Ok );
+     ASSERT_EQ( manager.Subscribe( 1, consumer ), qm::State::Ok );
+     ASSERT_EQ( manager.Enqueue( 1, 5 ), qm::State::Ok );
+
+     ASSERT_EQ( manager.Unsubscribe( 1 ), qm::State::Ok );
+     ASSERT_EQ( manager.Unsubscribe( 1 ), qm::State::QueueAbsent );
+     ASSERT_EQ( consumer->sum_, 5 );
+     ASSERT_TRUE( manager.AreAllQueuesEmpty() );
+}
+
+TEST(StaticMPSCQueueManager, borrowed_queue_outlives_remove)
+{
+     StaticManager manager;
+     std::weak_ptr< qm::BlockConcurrentQueue< int > > weak;
+     {
+          auto queue = std::make_shared< qm::BlockConcurrentQueue< int > >( 10 );
+          weak = queue;
+          ASSERT_EQ( manager.AddQueue( "queue1", queue ), qm::State::Ok );
+     }
+
+     auto borrowed = manager.BorrowQueue( "queue1" );
+     ASSERT_EQ( manager.RemoveQueue( "queue1" ), qm::State::Ok );
+     ASSERT_FALSE( weak.expired() );
+     ASSERT_EQ( borrowed->Push( 1 ), qm::State::QueueDisabled );
+
+     // queue is reclaimed after handle is released
+     borrowed = decltype( borrowed )();
+     ASSERT_TRUE( weak.expired() );
+}
+
+TEST(StaticMPSCQueueManager, enqueue_while_queues_removed)
+{
+     qm::StaticMPSCQueueManager< int, qm::LockFreeQueue< int >, StaticTestConsumer > manager;
+     std::atomic< bool > done = false;
+     std::thread producer( [ & ]()
+     {
+          while ( !done )
+          {
+               for ( int id = 0; id < 4; id++ )
+               {
+                    auto state = manager.Enqueue( id, id );
+                    ASSERT_TRUE( state == qm::State::Ok || state == qm::State::QueueAbsent ||
+                                 state == qm::State::QueueFull || state == qm::State::QueueDisabled );
+               }
+          }
+     } );
+
+     for ( int i = 0; i < 1000; i++ )
+     {
+          const int id = i % 4;
+          ASSERT_EQ( manager.AddQueue( id, std::make_shared< qm::LockFreeQueue< int > >( 10 )), qm::State::Ok );
+          ASSERT_EQ( manager.RemoveQueue( id ), qm::State::Ok );
+     }
+
+     done = true;
+     producer.join();
+     ASSERT_EQ( manager.Enqueue( 0, 1 ), qm::State::QueueAbsent );
+}
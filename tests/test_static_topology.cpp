@@ -0,0 +1,132 @@
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <manager/static_topology.hpp>
+#include <queue/block_concurrent_queue.hpp>
+#include <queue/lock_free_queue.hpp>
+#include <consumer/base_consumer.hpp>
+
+namespace
+{
+
+struct Orders {};
+struct Fills {};
+struct Heartbeats {};
+
+struct Order
+{
+     std::string symbol;
+     int quantity = 0;
+};
+
+struct Fill
+{
+     int order_id;
+     double price;
+};
+
+class OrderConsumer : public qm::IConsumer< Order >
+{
+public:
+     void Consume( const Order &order ) override
+     {
+          quantity_ += order.quantity;
+          count_++;
+     }
+
+     std::atomic< int > quantity_ = 0;
+     std::atomic< int > count_ = 0;
+};
+
+class FillConsumer : public qm::IConsumer< Fill >
+{
+public:
+     void Consume( const Fill &fill ) override
+     {
+          last_order_ = fill.order_id;
+          count_++;
+     }
+
+     std::atomic< int > last_order_ = 0;
+     std::atomic< int > count_ = 0;
+};
+
+class HeartbeatConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int & ) override
+     {
+          count_++;
+     }
+
+     std::atomic< int > count_ = 0;
+};
+
+using Topology = qm::StaticTopology< qm::Channel< Orders, qm::BlockConcurrentQueue< Order >, OrderConsumer >,
+                                     qm::Channel< Fills, qm::LockFreeQueue< Fill >, FillConsumer >,
+                                     qm::Channel< Heartbeats, qm::LockFreeQueue< int, 16 >, HeartbeatConsumer > >;
+
+static_assert( std::is_same_v< Topology::Queue< Fills >, qm::LockFreeQueue< Fill > > );
+static_assert( std::is_same_v< Topology::Value< Orders >, Order > );
+
+template< typename Counter >
+void WaitCount( const Counter &counter, int expected )
+{
+     while ( counter.count_ != expected )
+     {
+          std::this_thread::yield();
+     }
+}
+
+} // namespace
+
+TEST(StaticTopology, enqueue_consume)
+{
+     Topology topology( 10 );
+     auto orders = std::make_shared< OrderConsumer >();
+     auto fills = std::make_shared< FillConsumer >();
+     auto heartbeats = std::make_shared< HeartbeatConsumer >();
+
+     ASSERT_EQ( topology.Enqueue< Orders >( Order{ "A", 2 } ), qm::State::Ok );
+     ASSERT_FALSE( topology.AreAllQueuesEmpty() );
+
+     ASSERT_EQ( topology.Subscribe< Orders >( orders ), qm::State::Ok );
+     ASSERT_EQ( topology.Subscribe< Orders >( orders ), qm::State::QueueBusy );
+     ASSERT_EQ( topology.Subscribe< Fills >( fills ), qm::State::Ok );
+     ASSERT_EQ( topology.Subscribe< Heartbeats >( heartbeats ), qm::State::Ok );
+
+     const Fill fill{ 7, 1.5 };
+     ASSERT_EQ( topology.Enqueue< Fills >( fill ), qm::State::Ok );
+     ASSERT_EQ( topology.Enqueue< Orders >( Order{ "B", 3 } ), qm::State::Ok );
+     ASSERT_EQ( topology.GetQueue< Heartbeats >().Push( 1 ), qm::State::Ok );
+
+     WaitCount( *orders, 2 );
+     WaitCount( *fills, 1 );
+     WaitCount( *heartbeats, 1 );
+     ASSERT_EQ( orders->quantity_, 5 );
+     ASSERT_EQ( fills->last_order_, 7 );
+}
+
+TEST(StaticTopology, stop_start_unsubscribe)
+{
+     Topology topology( 10 );
+     auto heartbeats = std::make_shared< HeartbeatConsumer >();
+     ASSERT_EQ( topology.Unsubscribe< Heartbeats >(), qm::State::QueueAbsent );
+     ASSERT_EQ( topology.Subscribe< Heartbeats >( heartbeats ), qm::State::Ok );
+
+     topology.StopProcessing();
+     ASSERT_FALSE( heartbeats->Enabled() );
+     ASSERT_EQ( topology.Enqueue< Heartbeats >( 1 ), qm::State::QueueDisabled );
+
+     topology.StartProcessing();
+     ASSERT_TRUE( heartbeats->Enabled() );
+     ASSERT_EQ( topology.Enqueue< Heartbeats >( 1 ), qm::State::Ok );
+     WaitCount( *heartbeats, 1 );
+
+     ASSERT_EQ( topology.Unsubscribe< Heartbeats >(), qm::State::Ok );
+     ASSERT_EQ( topology.Enqueue< Heartbeats >( 1 ), qm::State::Ok );
+     ASSERT_FALSE( topology.AreAllQueuesEmpty() );
+     ASSERT_EQ( heartbeats->count_, 1 );
+}
@@ -0,0 +1,335 @@
+#include <functional>
+#include <mutex>
+
+#include <gtest/gtest.h>
+
+#include <manager/mpsc_mqueue_manager.hpp>
+#include <producer/task_producer.hpp>
+#include <queue/block_concurrent_queue.hpp>
+#include <queue/budgeted_queue.hpp>
+#include <queue/lock_free_queue.hpp>
+
+class TaskTestConsumer : public qm::IConsumer< int >
+{
+public:
+     void Consume( const int &value ) override
+     {
+          sum_ += value;
+     };
+
+     std::atomic< long long > sum_ = 0;
+};
+
+/// @brief Produce values from 1 to n as cooperative task
+class SequenceValuesTask : public qm::TaskProducer< std::string, int >
+{
+public:
+     SequenceValuesTask( const std::string &id, int n ) : TaskProducer< std::string, int >( id ), n_( n )
+     {};
+
+protected:
+     std::optional< int > Next() override
+     {
+          if ( i_ == n_ )
+          {
+               return std::nullopt;
+          }
+          return ++i_;
+     }
+
+private:
+     int n_;
+     int i_ = 0;
+};
+
+long long AccumulateTasks( long long n )
+{
+     return n * ( n + 1 ) / 2;
+}
+
+TEST(ProducerRuntime, run_tasks)
+{
+     class CountTask : public qm::ITask
+     {
+     public:
+          qm::TaskState Step() override
+          {
+               return ++steps_ == 100 ? qm::TaskState::Done : qm::TaskState::Ready;
+          }
+
+          std::atomic< int > steps_ = 0;
+     };
+
+     std::vector< std::shared_ptr< CountTask > > tasks;
+     {
+          qm::ProducerRuntime runtime( 2, 8 );
+          ASSERT_EQ( runtime.Workers(), 2 );
+          for ( int i = 0; i < 16; ++i )
+          {
+               tasks.push_back( std::make_shared< CountTask >() );
+               runtime.Submit( tasks.back() );
+          }
+
+          while ( !std::all_of( tasks.begin(), tasks.end(), []( auto &task ) { return task->steps_ == 100; } ) )
+          {
+               std::this_thread::yield();
+          }
+     }
+
+     for ( auto &task : tasks )
+     {
+          ASSERT_EQ( task.use_count(), 1 );
+     }
+}
+
+TEST(ProducerRuntime, stop_from_worker)
+{
+     class StopTask : public qm::ITask
+     {
+     public:
+          explicit StopTask( qm::RuntimePtr runtime ) : runtime_( std::move( runtime )) {}
+
+          qm::TaskState Step() override
+          {
+               // the last reference is released on worker thread, so runtime is destroyed there too
+               runtime_->Stop();
+               runtime_.reset();
+               done_ = true;
+               return qm::TaskState::Done;
+          }
+
+          qm::RuntimePtr runtime_;
+          std::atomic< bool > done_ = false;
+     };
+
+     auto runtime = std::make_shared< qm::ProducerRuntime >( 2 );
+     auto task = std::make_shared< StopTask >( runtime );
+     runtime->Submit( task );
+     runtime.reset();
+
+     while ( !task->done_ )
+     {
+          std::this_thread::yield();
+     }
+}
+
+TEST(ProducerRuntime, blocked_task_backs_off)
+{
+     class BlockedTask : public qm::ITask
+     {
+     public:
+          qm::TaskState Step() override
+          {
+               steps_++;
+               return qm::TaskState::Blocked;
+          }
+
+          std::atomic< std::size_t > steps_ = 0;
+     };
+
+     auto task = std::make_shared< BlockedTask >();
+     {
+          qm::ProducerRuntime runtime( 1 );
+          runtime.Submit( task );
+          std::this_thread::sleep_for( std::chrono::milliseconds( 100 ));
+     }
+
+     // worker sleeps between retries after short spinning, so steps are bounded by sleeps count
+     ASSERT_GT( task->steps_, 0 );
+     ASSERT_LT( task->steps_, 64 + 100000 / 50 );
+}
+
+TEST(ProducerRuntime, parked_task_waits_for_wake)
+{
+     class ParkTask : public qm::ITask
+     {
+     public:
+          qm::TaskState Step() override
+          {
+               return ++steps_ == 1 ? qm::TaskState::Blocked : qm::TaskState::Done;
+          }
+
+          bool Park( std::function< void() > wake ) override
+          {
+               std::scoped_lock lock( mtx_ );
+               wake_ = std::move( wake );
+               return true;
+          }
+
+          void Cancel() override { cancelled_ = true; }
+
+          std::function< void() > Wake()
+          {
+               std::scoped_lock lock( mtx_ );
+               return wake_;
+          }
+
+          std::atomic< int > steps_ = 0;
+          std::atomic< bool > cancelled_ = false;
+          std::mutex mtx_;
+          std::function< void() > wake_;
+     };
+
+     auto woken = std::make_shared< ParkTask >();
+     auto forgotten = std::make_shared< ParkTask >();
+     {
+          qm::ProducerRuntime runtime( 1 );
+          runtime.Submit( woken );
+          runtime.Submit( forgotten );
+          while ( !woken->Wake() || !forgotten->Wake() )
+          {
+               std::this_thread::yield();
+          }
+
+          // parked tasks are not polled
+          std::this_thread::sleep_for( std::chrono::milliseconds( 20 ));
+          ASSERT_EQ( woken->steps_, 1 );
+          ASSERT_EQ( forgotten->steps_, 1 );
+
+          auto wake = woken->Wake();
+          wake();
+          wake();
+          while ( woken->steps_ != 2 )
+          {
+               std::this_thread::yield();
+          }
+     }
+
+     // task parked when runtime stops is cancelled, its wake does nothing then
+     ASSERT_EQ( woken->steps_, 2 );
+     ASSERT_FALSE( woken->cancelled_ );
+     ASSERT_TRUE( forgotten->cancelled_ );
+     forgotten->Wake()();
+     ASSERT_EQ( forgotten->steps_, 1 );
+}
+
+TEST(TaskProducer, start_reports_state)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::string, int > >();
+     manager->AddQueue( "queue1", std::make_shared< qm::LockFreeQueue< int > >( 10 ) );
+
+     auto producer = std::make_shared< SequenceValuesTask >( "queue1", 10 );
+     ASSERT_EQ( producer->Start(), qm::State::QueueAbsent );
+
+     ASSERT_EQ( manager->RegisterProducer( "queue1", producer ), qm::State::Ok );
+     ASSERT_EQ( producer->Start(), qm::State::QueueDisabled );
+     ASSERT_FALSE( producer->Done() );
+     ASSERT_EQ( manager->UnregisterProducer( "queue1", producer ), qm::State::Ok );
+}
+
+TEST(TaskProducer, many_producers_few_threads)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::string, int > >();
+     manager->SetRuntime( std::make_shared< qm::ProducerRuntime >( 2 ) );
+
+     const int queues_count = 4;
+     const int producers_count = 64;
+     const int values_count = 1000;
+     std::vector< std::shared_ptr< TaskTestConsumer > > consumers;
+     for ( int i = 0; i < queues_count; ++i )
+     {
+          manager->AddQueue( std::to_string( i ), std::make_shared< qm::BlockConcurrentQueue< int > >( 10 ) );
+          consumers.push_back( std::make_shared< TaskTestConsumer >() );
+          ASSERT_EQ( manager->Subscribe( std::to_string( i ), consumers.back() ), qm::State::Ok );
+     }
+
+     std::vector< std::shared_ptr< SequenceValuesTask > > producers;
+     for ( int i = 0; i < producers_count; ++i )
+     {
+          auto producer = std::make_shared< SequenceValuesTask >( std::to_string( i % queues_count ), values_count );
+          ASSERT_EQ( manager->RegisterProducer( std::to_string( i % queues_count ), producer ), qm::State::Ok );
+          producer->Produce();
+          producers.push_back( producer );
+     }
+
+     for ( auto &producer : producers )
+     {
+          producer->WaitThreadDone();
+          ASSERT_TRUE( producer->Done() );
+     }
+
+     manager->StopProcessing();
+     long long sum = 0;
+     for ( auto &consumer : consumers )
+     {
+          sum += consumer->sum_;
+     }
+     ASSERT_EQ( sum, AccumulateTasks( values_count ) * producers_count );
+}
+
+TEST(TaskProducer, exhausted_budget_blocks_task)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::string, int > >();
+     manager->SetRuntime( std::make_shared< qm::ProducerRuntime >( 1 ) );
+
+     // budget holds two values, producer retries refused values instead of finishing
+     auto budget = std::make_shared< qm::MemoryBudget >( 2 * sizeof( int ));
+     using Queue = qm::BudgetedQueue< qm::BlockConcurrentQueue< int > >;
+     ASSERT_EQ( manager->AddQueue( "queue1", std::make_shared< Queue >( budget, 0, 100 )), qm::State::Ok );
+     auto consumer = std::make_shared< TaskTestConsumer >();
+     ASSERT_EQ( manager->Subscribe( "queue1", consumer ), qm::State::Ok );
+
+     const int values_count = 1000;
+     auto producer = std::make_shared< SequenceValuesTask >( "queue1", values_count );
+     ASSERT_EQ( manager->RegisterProducer( "queue1", producer ), qm::State::Ok );
+     producer->Produce();
+     producer->WaitThreadDone();
+
+     manager->StopProcessing();
+     ASSERT_EQ( consumer->sum_, AccumulateTasks( values_count ));
+}
+
+TEST(TaskProducer, stop_processing_stops_tasks)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::string, int > >();
+     manager->SetRuntime( std::make_shared< qm::ProducerRuntime >( 1 ) );
+     manager->AddQueue( "queue1", std::make_shared< qm::LockFreeQueue< int > >( 10 ) );
+
+     // no consumer, producer is blocked on full queue
+     auto producer = std::make_shared< SequenceValuesTask >( "queue1", 1000 );
+     ASSERT_EQ( manager->RegisterProducer( "queue1", producer ), qm::State::Ok );
+     producer->Produce();
+
+     manager->StopProcessing();
+     ASSERT_TRUE( producer->Done() );
+     ASSERT_TRUE( manager->AreAllProducersDone() );
+}
+
+TEST(TaskProducer, parked_until_consumer_pops)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::string, int > >();
+     manager->SetRuntime( std::make_shared< qm::ProducerRuntime >( 1 ) );
+     manager->AddQueue( "queue1", std::make_shared< qm::BlockConcurrentQueue< int > >( 10 ) );
+
+     // queue signals space, so producer refused by full queue waits for consumer without retries
+     const int values_count = 1000;
+     auto producer = std::make_shared< SequenceValuesTask >( "queue1", values_count );
+     ASSERT_EQ( manager->RegisterProducer( "queue1", producer ), qm::State::Ok );
+     producer->Produce();
+     std::this_thread::sleep_for( std::chrono::milliseconds( 20 ));
+     ASSERT_FALSE( producer->Done() );
+
+     auto consumer = std::make_shared< TaskTestConsumer >();
+     ASSERT_EQ( manager->Subscribe( "queue1", consumer ), qm::State::Ok );
+     producer->WaitThreadDone();
+     ASSERT_TRUE( producer->Done() );
+
+     manager->StopProcessing();
+     ASSERT_EQ( consumer->sum_, AccumulateTasks( values_count ));
+}
+
+TEST(TaskProducer, unregister_parked_producer)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::string, int > >();
+     manager->SetRuntime( std::make_shared< qm::ProducerRuntime >( 1 ) );
+     manager->AddQueue( "queue1", std::make_shared< qm::BlockConcurrentQueue< int > >( 10 ) );
+
+     auto producer = std::make_shared< SequenceValuesTask >( "queue1", 1000 );
+     ASSERT_EQ( manager->RegisterProducer( "queue1", producer ), qm::State::Ok );
+     producer->Produce();
+     std::this_thread::sleep_for( std::chrono::milliseconds( 20 ));
+
+     // producer parked on full queue is woken to see it is disabled
+     ASSERT_EQ( manager->UnregisterProducer( "queue1", producer ), qm::State::Ok );
+     ASSERT_TRUE( producer->Done() );
+}
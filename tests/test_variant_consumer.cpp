@@ -0,0 +1,132 @@
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <consumer/variant_consumer.hpp>
+#include <manager/mpsc_mqueue_manager.hpp>
+#include <manager/static_mqueue_manager.hpp>
+#include <queue/block_concurrent_queue.hpp>
+#include <queue/spsc_ring_queue.hpp>
+
+namespace
+{
+
+struct Order
+{
+     std::vector< int > legs;
+};
+
+struct Fill
+{
+     int order_id;
+     double price;
+};
+
+using Message = std::variant< Order, Fill, int >;
+
+class MessageConsumer : public qm::VariantConsumer< MessageConsumer, Order, Fill, int >
+{
+public:
+     using VariantConsumer::Consume;
+
+     void Consume( const Order &order )
+     {
+          legs_ += static_cast< int >( order.legs.size() );
+          copied_orders_++;
+          count_++;
+     }
+
+     void Consume( Order &&order )
+     {
+          legs_ += static_cast< int >( order.legs.size() );
+          last_legs_ = order.legs.data();
+          count_++;
+     }
+
+     void Consume( const Fill &fill )
+     {
+          fills_ += fill.order_id;
+          count_++;
+     }
+
+     void Consume( const int &heartbeat )
+     {
+          heartbeats_ += heartbeat;
+          count_++;
+     }
+
+     void WaitCount( int expected ) const
+     {
+          while ( count_ != expected )
+          {
+               std::this_thread::yield();
+          }
+     }
+
+     std::atomic< int > count_ = 0;
+     std::atomic< int > legs_ = 0;
+     std::atomic< int > fills_ = 0;
+     std::atomic< int > heartbeats_ = 0;
+     std::atomic< int > copied_orders_ = 0;
+     std::atomic< const int * > last_legs_ = nullptr;
+};
+
+} // namespace
+
+TEST(VariantConsumer, dispatch_alternatives)
+{
+     MessageConsumer consumer;
+     qm::IConsumer< Message > &base = consumer;
+
+     const Message order = Order{ { 1, 2, 3 } };
+     base.Consume( order );
+     base.Consume( Message( Fill{ 4, 1.5 } ));
+     base.Consume( Message( 2 ));
+
+     ASSERT_EQ( consumer.count_, 3 );
+     ASSERT_EQ( consumer.legs_, 3 );
+     ASSERT_EQ( consumer.copied_orders_, 1 );
+     ASSERT_EQ( consumer.fills_, 4 );
+     ASSERT_EQ( consumer.heartbeats_, 2 );
+}
+
+TEST(VariantConsumer, mpsc_manager_moves_payload)
+{
+     auto manager = std::make_shared< qm::MPSCQueueManager< std::string, Message > >();
+     auto consumer = std::make_shared< MessageConsumer >();
+     ASSERT_EQ( manager->AddQueue( "mixed", std::make_shared< qm::BlockConcurrentQueue< Message > >( 10 )), qm::State::Ok );
+
+     Order order{ std::vector< int >( 100, 1 ) };
+     const int *legs = order.legs.data();
+     ASSERT_EQ( manager->Enqueue( "mixed", Message( std::move( order ))), qm::State::Ok );
+     ASSERT_EQ( manager->Enqueue( "mixed", Fill{ 7, 2.0 } ), qm::State::Ok );
+     ASSERT_EQ( manager->Enqueue( "mixed", 1 ), qm::State::Ok );
+     ASSERT_EQ( manager->Subscribe( "mixed", consumer ), qm::State::Ok );
+
+     consumer->WaitCount( 3 );
+     ASSERT_EQ( consumer->legs_, 100 );
+     ASSERT_EQ( consumer->copied_orders_, 0 );
+     ASSERT_EQ( consumer->last_legs_, legs );
+     ASSERT_EQ( consumer->fills_, 7 );
+     ASSERT_EQ( consumer->heartbeats_, 1 );
+}
+
+TEST(VariantConsumer, static_manager)
+{
+     qm::StaticMPSCQueueManager< int, qm::SpscRingQueue< Message >, MessageConsumer > manager;
+     auto consumer = std::make_shared< MessageConsumer >();
+     ASSERT_EQ( manager.AddQueue( 1, std::make_shared< qm::SpscRingQueue< Message > >( 10 )), qm::State::Ok );
+     ASSERT_EQ( manager.Subscribe( 1, consumer ), qm::State::Ok );
+
+     auto queue = manager.BorrowQueue( 1 );
+     ASSERT_EQ( queue->Emplace( std::in_place_type< Fill >, Fill{ 3, 1.0 } ), qm::State::Ok );
+     ASSERT_EQ( queue->Emplace( std::in_place_type< Order >, Order{ { 1, 2 } } ), qm::State::Ok );
+
+     consumer->WaitCount( 2 );
+     ASSERT_EQ( consumer->fills_, 3 );
+     ASSERT_EQ( consumer->legs_, 2 );
+     ASSERT_EQ( consumer->copied_orders_, 0 );
+}